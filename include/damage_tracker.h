@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+// Tile-granular damage tracking for a RGB565 or packed paletted framebuffer.
+// Drawing code marks the rectangles it touches; collect() hashes only those
+// tiles (plus the ones drawn in the previous frame, which were erased) and
+// returns the windows whose content actually changed on the panel. The first
+// collect() returns the whole frame.
+//
+// A tile counts as unchanged when its FNV-1a 32-bit hash matches the last
+// pushed one, so on a collision the panel keeps the stale tile until its
+// content changes again (about one candidate tile in 2^32).
+
+static const uint8_t DAMAGE_TILE_SIZE = 16;
+static const uint8_t DAMAGE_MAX_TILES_X = 16; // up to 256 px wide
+static const uint8_t DAMAGE_MAX_TILES_Y = 16; // up to 256 px high
+static const uint16_t DAMAGE_MAX_RECTS = DAMAGE_MAX_TILES_X * DAMAGE_MAX_TILES_Y;
+
+struct DamageRect {
+  uint16_t x;
+  uint16_t y;
+  uint16_t w;
+  uint16_t h;
+};
+
+class DamageTracker {
+public:
+  DamageTracker(uint16_t width, uint16_t height);
+
+  void markRect(int16_t x, int16_t y, int16_t w, int16_t h);
+  void markPixel(int16_t x, int16_t y);
+
+  // Returns the number of rects filled in rects(); the tracker then assumes
+  // they were pushed and starts a new frame.
+  uint16_t collect(const uint16_t *fb) { return collect(fb, 16); }
+  // Same for a framebuffer of 1, 2, 4, 8 or 16 bits per pixel, rows packed
+  // ceil(width * bitsPerPixel / 8) bytes apart. Pushed bytes stay RGB565.
+  uint16_t collect(const void *fb, uint8_t bitsPerPixel);
+  const DamageRect *rects() const { return rects_; }
+  uint32_t lastBytes() const { return lastBytes_; }
+
+private:
+  uint32_t tileHash(const void *fb, uint8_t bitsPerPixel, uint8_t tx, uint8_t ty) const;
+
+  uint16_t width_;
+  uint16_t height_;
+  uint8_t tilesX_;
+  uint8_t tilesY_;
+  bool forceAll_; // until the first collect()
+  uint16_t touched_[DAMAGE_MAX_TILES_Y];  // bit tx set = tile drawn this frame
+  uint16_t previous_[DAMAGE_MAX_TILES_Y]; // tiles drawn in the previous frame
+  uint32_t hash_[DAMAGE_MAX_TILES_Y][DAMAGE_MAX_TILES_X];
+  DamageRect rects_[DAMAGE_MAX_RECTS];
+  uint32_t lastBytes_;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+
+static const uint8_t EVENT_SCHEDULER_CAPACITY = 24;
+static const uint32_t EVENT_NO_DEADLINE = 0xFFFFFFFFu;
+
+typedef void (*EventCallback)(void *ctx);
+
+// Fixed-capacity timer set ordered by a binary min-heap on the deadline.
+// Timers are registered once (add) and then armed and disarmed as needed;
+// only armed timers sit in the heap. Deadlines are millis() values compared
+// with wraparound, so they must lie within 2^31 ms of the current time.
+//
+// Periodic timers are re-armed from their previous deadline, not from the
+// time they ran, so they do not drift; periods missed during a stall are
+// skipped rather than replayed. Callbacks may add, arm, disarm or remove any
+// timer, including their own.
+class EventScheduler {
+public:
+  EventScheduler();
+
+  // Registers a disarmed timer; periodMs 0 makes it one-shot. Returns its id
+  // or -1 when full.
+  int8_t add(EventCallback cb, void *ctx, uint32_t periodMs = 0);
+  // add() and arm the first run one period from nowMs.
+  int8_t every(EventCallback cb, void *ctx, uint32_t periodMs, uint32_t nowMs);
+  bool remove(int8_t id);
+
+  // (Re)arms at an absolute deadline, replacing any earlier one.
+  bool armAt(int8_t id, uint32_t dueMs);
+  bool armIn(int8_t id, uint32_t nowMs, uint32_t delayMs) { return armAt(id, nowMs + delayMs); }
+  // Arms only if that moves the deadline earlier (or the timer is disarmed).
+  bool armNoLaterThan(int8_t id, uint32_t dueMs);
+  void disarm(int8_t id);
+  bool armed(int8_t id) const;
+  uint32_t dueAt(int8_t id) const;
+
+  // Runs every timer due at nowMs in deadline order (ties in arming order).
+  uint8_t run(uint32_t nowMs);
+  // Milliseconds until the earliest deadline, 0 when one is overdue,
+  // EVENT_NO_DEADLINE when nothing is armed.
+  uint32_t msUntilNext(uint32_t nowMs) const;
+  uint8_t armedCount() const { return size_; }
+
+private:
+  struct Timer {
+    bool used;
+    int8_t heapPos; // -1 while disarmed
+    uint32_t due;
+    uint32_t period;
+    uint32_t seq;   // arming order, breaks deadline ties
+    EventCallback cb;
+    void *ctx;
+  };
+
+  bool valid(int8_t id) const { return id >= 0 && id < (int8_t)EVENT_SCHEDULER_CAPACITY && timers_[id].used; }
+  bool before(int8_t a, int8_t b) const;
+  void place(uint8_t pos, int8_t id);
+  void siftUp(uint8_t pos);
+  void siftDown(uint8_t pos);
+  void heapRemove(uint8_t pos);
+
+  Timer timers_[EVENT_SCHEDULER_CAPACITY];
+  int8_t heap_[EVENT_SCHEDULER_CAPACITY];
+  uint8_t size_;
+  uint32_t seq_;
+};
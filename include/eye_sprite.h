@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "damage_tracker.h"
+
+// Up to this many blink levels per cache; level 0 is fully open, the last one
+// fully closed.
+static const uint8_t EYE_SPRITE_MAX_LEVELS = 64;
+
+// A run of w pixels starting x pixels right of the sprite's left edge. A
+// sprite row is its runs followed by an end marker with w == 0.
+struct EyeSpan {
+  uint8_t x;
+  uint8_t w;
+};
+
+// Fills w pixels of row y from x; used to draw sprites into framebuffers other
+// than plain RGB565. Runs arrive already clipped.
+typedef void (*EyeSpanFill)(void *ctx, int16_t x, int16_t y, int16_t w);
+
+// Adafruit_GFX::fillRoundRect on a plain framebuffer, pixel for pixel
+// (including GFXcanvas16 clipping). With damage set, every primitive it draws
+// is marked the way TrackedCanvas16 marks it. The sprite cache is built from
+// this and compared against it.
+void fillRoundRectInto(uint16_t *fb, uint16_t fbW, uint16_t fbH, DamageTracker *damage, int16_t x, int16_t y,
+                       int16_t w, int16_t h, int16_t r, uint16_t color);
+
+// The eye white (a w x h rounded rect with radius w/2, squashed vertically as
+// the eye blinks) pre-rasterized at a fixed number of blink levels, and the
+// pupil (a fixed rounded rect), both run-length encoded per row. A frame then
+// costs a few clipped fills per row instead of fillRoundRect's column walk.
+// Spans live in caller storage, sized with spansNeeded().
+class EyeSpriteCache {
+public:
+  EyeSpriteCache(EyeSpan *spans, uint16_t capacity);
+
+  // Spans build() takes for this geometry, 0 when blinkLevels is out of range.
+  static uint16_t spansNeeded(uint8_t eyeW, uint8_t eyeH, uint8_t blinkLevels, uint8_t pupilW, uint8_t pupilH,
+                              uint8_t pupilR);
+
+  // Returns false (and leaves the cache empty) when blinkLevels is outside
+  // 2..EYE_SPRITE_MAX_LEVELS or the storage is too small.
+  bool build(uint8_t eyeW, uint8_t eyeH, uint8_t blinkLevels, uint8_t pupilW, uint8_t pupilH, uint8_t pupilR);
+  bool ready() const { return levels_ > 0; }
+
+  // Nearest level for a blink amount in [0, 1] (0 open, 1 closed).
+  uint8_t levelFor(float blinkAmt) const;
+  uint8_t levels() const { return levels_; }
+  uint8_t whiteHeight(uint8_t level) const { return white_[level].h; }
+
+  // Eye white centered on (cx, cy) with the same rounding as
+  // fillRoundRect((int)(cx - w/2), (int)(cy - eh/2), ...) where eh is the
+  // level's height before truncation; the pupil at its top-left corner.
+  void drawWhite(uint16_t *fb, uint16_t fbW, uint16_t fbH, DamageTracker *damage, float cx, float cy, uint8_t level,
+                 uint16_t color) const;
+  void drawPupil(uint16_t *fb, uint16_t fbW, uint16_t fbH, DamageTracker *damage, int16_t x, int16_t y,
+                 uint16_t color) const;
+  // Same through a fill callback; the color is the callback's business.
+  void drawWhite(EyeSpanFill fill, void *ctx, uint16_t fbW, uint16_t fbH, DamageTracker *damage, float cx, float cy,
+                 uint8_t level) const;
+  void drawPupil(EyeSpanFill fill, void *ctx, uint16_t fbW, uint16_t fbH, DamageTracker *damage, int16_t x,
+                 int16_t y) const;
+
+  // Spans plus level headers actually in use.
+  size_t bytesUsed() const;
+
+private:
+  struct Sprite {
+    float eh;       // untruncated height, for placement
+    uint16_t first; // index of the first span in spans_
+    uint8_t w;
+    uint8_t h;
+  };
+
+  bool rasterize(Sprite &s, uint8_t w, uint8_t h, uint8_t r);
+  template <typename Fill>
+  void blit(Fill &fill, uint16_t fbW, uint16_t fbH, DamageTracker *damage, const Sprite &s, int16_t x, int16_t y) const;
+
+  EyeSpan *spans_;
+  uint16_t capacity_;
+  uint16_t used_;
+  uint8_t levels_;
+  Sprite white_[EYE_SPRITE_MAX_LEVELS];
+  Sprite pupil_;
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Build flag so installations with long rule tables can queue a whole
+// retained schedule/current.
+#ifndef EVE_MQTT_OUTBOX_ARENA
+#define EVE_MQTT_OUTBOX_ARENA 4096
+#endif
+
+static const uint16_t MQTT_OUTBOX_ARENA = EVE_MQTT_OUTBOX_ARENA; // topic + NUL + payload bytes
+static_assert(MQTT_OUTBOX_ARENA <= 32768, "wrapped spans must fit in 16 bits");
+static const uint8_t MQTT_OUTBOX_SLOTS = 32;
+
+// State topics keep only their latest value (an older queued value is
+// superseded); event topics are delivered one by one in order.
+enum MqttOutboxKind : uint8_t { MQTT_OUTBOX_STATE = 0, MQTT_OUTBOX_EVENT = 1 };
+
+// Returns false when the message could not be handed to the client; it stays
+// at the head of the queue and is retried on the next drain.
+typedef bool (*MqttOutboxSend)(const char *topic, const uint8_t *payload, size_t len, bool retained);
+typedef bool (*MqttOutboxContextSend)(void *ctx, const char *topic, const uint8_t *payload, size_t len, bool retained);
+
+struct MqttOutboxStats {
+  uint32_t enqueued;
+  uint32_t sent;
+  uint32_t coalesced;    // state values superseded before being sent
+  uint32_t dropped;      // oldest messages discarded to make room, or too large
+  uint32_t sendFailures;
+  uint8_t highWater;     // most messages queued at once
+};
+
+// Bounded FIFO of outbound publishes that outlives broker disconnects.
+// Messages live in a byte ring (one contiguous span each, wrapping at the end
+// of the arena) described by a ring of slots; superseded state messages are
+// tombstoned in place and reclaimed when they reach the head. When space runs
+// out the oldest messages are dropped.
+class MqttOutbox {
+public:
+  MqttOutbox();
+
+  bool enqueue(const char *topic, const char *payload, size_t len, bool retained, MqttOutboxKind kind);
+  // Sends up to maxMessages in order, stopping at the first failure.
+  uint8_t drain(MqttOutboxSend send, uint8_t maxMessages);
+  uint8_t drain(MqttOutboxContextSend send, void *ctx, uint8_t maxMessages);
+  void clear();
+
+  uint8_t depth() const { return live_; }
+  uint16_t bytesUsed() const { return used_; }
+  const MqttOutboxStats &stats() const { return stats_; }
+
+private:
+  struct Slot {
+    uint16_t offset;     // start of topic
+    uint16_t span;       // bytes released on pop, including any wrap gap
+    uint16_t payloadLen;
+    uint8_t topicLen;
+    uint8_t kind;
+    bool retained;
+    bool dead;
+    uint32_t hash;
+  };
+
+  bool reserve(uint16_t n, uint16_t &offset, uint16_t &span) const;
+  void popHead();
+  void dropHead();
+
+  uint8_t arena_[MQTT_OUTBOX_ARENA];
+  Slot slots_[MQTT_OUTBOX_SLOTS];
+  uint8_t head_;   // oldest slot
+  uint8_t count_;  // slots in use, including tombstones
+  uint8_t live_;   // slots not tombstoned
+  uint16_t used_;  // arena bytes held by slots
+  uint16_t write_; // next arena offset
+  MqttOutboxStats stats_;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+static const uint8_t MQTT_ROUTER_MAX_ROUTES = 8;
+static const uint8_t MQTT_ROUTER_TABLE_SIZE = 16; // power of two, > MAX_ROUTES
+static const uint8_t MQTT_ROUTER_MAX_SUFFIX = 32;
+static const uint8_t MQTT_ROUTER_MAX_ROOT = 32;
+
+// relay is 1..relayCount for relay routes, 0 for root routes. The payload is
+// the client's receive buffer and is not NUL-terminated.
+typedef void (*MqttRouteHandler)(uint8_t relay, const char *payload, size_t len);
+// Same, for handlers bound to an object: ctx is the pointer given at add time.
+typedef void (*MqttRouteContextHandler)(void *ctx, uint8_t relay, const char *payload, size_t len);
+
+// Matches inbound topics of the form <root>relay/<n>/<suffix> and
+// <root><suffix> straight on the char* topic: the relay number is parsed in
+// place and the suffix is looked up in a small open-addressed hash table, so
+// the cost per message depends only on the topic length.
+class MqttTopicRouter {
+public:
+  MqttTopicRouter(const char *root, uint8_t relayCount);
+
+  bool addRelayRoute(const char *suffix, MqttRouteHandler handler);
+  bool addRoute(const char *suffix, MqttRouteHandler handler);
+  bool addRelayRoute(const char *suffix, MqttRouteContextHandler handler, void *ctx);
+  bool addRoute(const char *suffix, MqttRouteContextHandler handler, void *ctx);
+  bool dispatch(const char *topic, const uint8_t *payload, size_t len) const;
+
+  size_t formatRelayTopic(char *buf, size_t cap, uint8_t relay, const char *suffix) const;
+  size_t formatTopic(char *buf, size_t cap, const char *suffix) const;
+
+  // Topic filters to subscribe to, one per route: relay routes become
+  // <root>relay/+/<suffix>, so a reconnect costs one SUBSCRIBE per route
+  // whatever the relay count.
+  uint8_t filterCount() const { return routeCount_; }
+  bool filterTopic(uint8_t index, char *buf, size_t cap) const;
+
+private:
+  struct Route {
+    char suffix[MQTT_ROUTER_MAX_SUFFIX];
+    uint8_t len;
+    bool relayScoped;
+    uint32_t hash;
+    MqttRouteHandler handler;
+    MqttRouteContextHandler ctxHandler;
+    void *ctx;
+  };
+
+  bool add(const char *suffix, bool relayScoped, MqttRouteHandler handler, MqttRouteContextHandler ctxHandler,
+           void *ctx);
+  int8_t find(const char *suffix, size_t len, bool relayScoped) const;
+
+  char root_[MQTT_ROUTER_MAX_ROOT];
+  uint8_t rootLen_;
+  uint8_t relayCount_;
+  uint8_t routeCount_;
+  Route routes_[MQTT_ROUTER_MAX_ROUTES];
+  int8_t table_[MQTT_ROUTER_TABLE_SIZE];
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <type_traits>
+
+// Compile-time registry of fixed-size ESP-NOW packets. Each packet struct is
+// declared packed (#pragma pack(1), explicit reserved bytes where the old
+// naturally aligned layout had padding) and registered once:
+//
+//   EVE_PACKET(PowerScheduleAckPacket, 15, 8);
+//   EVE_PACKET_FIELD(PowerScheduleAckPacket, ms, 4);
+//
+// which pins its type byte and checks its wire size and field offsets. A
+// PacketSet lists the packets one side accepts; PacketDispatcher turns a set
+// into a 256-entry slot table indexed by the type byte (built at compile time)
+// and hands every frame of the right length to handler.onPacket(const P &) in
+// place, without copying. At most one packet per set may be untyped
+// (PACKET_UNTYPED, like the legacy telemetry frame): it is recognized by
+// length when no typed packet matches, so its size must differ from every
+// typed one in the set.
+
+static const int16_t PACKET_UNTYPED = -1;
+
+template <typename Packet>
+struct PacketTraits; // specialized by EVE_PACKET
+
+#define EVE_PACKET(Packet, TypeId, WireSize)                                                   \
+  template <>                                                                                  \
+  struct PacketTraits<Packet> {                                                                \
+    static constexpr int16_t TYPE = (TypeId);                                                  \
+  };                                                                                           \
+  static_assert(sizeof(Packet) == (WireSize), #Packet ": wire size changed");                  \
+  static_assert(alignof(Packet) == 1, #Packet ": must be packed");                             \
+  static_assert(std::is_trivially_copyable<Packet>::value && std::is_standard_layout<Packet>::value, \
+                #Packet ": must be plain data")
+
+#define EVE_PACKET_FIELD(Packet, field, offset) \
+  static_assert(offsetof(Packet, field) == (offset), #Packet "." #field ": wire offset changed")
+
+// Bounds-checked view of one frame as a registered packet: nullptr unless the
+// length and type byte match.
+template <typename Packet>
+const Packet *packetAs(const uint8_t *data, size_t len) {
+  if (len != sizeof(Packet)) return nullptr;
+  if (PacketTraits<Packet>::TYPE != PACKET_UNTYPED && data[0] != (uint8_t)PacketTraits<Packet>::TYPE) return nullptr;
+  return reinterpret_cast<const Packet *>(data);
+}
+
+template <typename... Packets>
+struct PacketSet;
+
+template <>
+struct PacketSet<> {
+  static constexpr size_t MAX_SIZE = 0;
+  static constexpr uint8_t typeCount(int16_t) { return 0; }
+  static constexpr uint8_t typedSizeCount(size_t) { return 0; }
+  static constexpr bool valid() { return true; }
+  // 1-based position of the packet with this type, 0 when absent.
+  static constexpr uint8_t slotOf(int16_t, uint8_t) { return 0; }
+};
+
+template <typename P, typename... Rest>
+struct PacketSet<P, Rest...> {
+  typedef PacketSet<Rest...> Tail;
+  static constexpr int16_t TYPE = PacketTraits<P>::TYPE;
+
+  static constexpr size_t MAX_SIZE = sizeof(P) > Tail::MAX_SIZE ? sizeof(P) : Tail::MAX_SIZE;
+  static constexpr uint8_t typeCount(int16_t type) { return (TYPE == type ? 1 : 0) + Tail::typeCount(type); }
+  static constexpr uint8_t typedSizeCount(size_t size) {
+    return (TYPE != PACKET_UNTYPED && sizeof(P) == size ? 1 : 0) + Tail::typedSizeCount(size);
+  }
+  // Type bytes unique (so at most one untyped packet) and the untyped packet's
+  // length unused by typed ones.
+  static constexpr bool valid() {
+    return Tail::typeCount(TYPE) == 0 && (TYPE != PACKET_UNTYPED || typedSizeCount(sizeof(P)) == 0) &&
+           Tail::valid();
+  }
+  static constexpr uint8_t slotOf(int16_t type, uint8_t pos = 1) {
+    return TYPE == type ? pos : Tail::slotOf(type, (uint8_t)(pos + 1));
+  }
+};
+
+namespace packet_detail {
+
+template <size_t... I>
+struct IndexList {};
+template <size_t N, size_t... I>
+struct MakeIndexList : MakeIndexList<N - 1, N - 1, I...> {};
+template <size_t... I>
+struct MakeIndexList<0, I...> {
+  typedef IndexList<I...> type;
+};
+
+template <typename Handler, typename Packet>
+void deliver(Handler &h, const uint8_t *data) {
+  h.onPacket(*reinterpret_cast<const Packet *>(data));
+}
+
+template <typename Set, typename Indices>
+struct SlotTable;
+
+template <typename Set, size_t... I>
+struct SlotTable<Set, IndexList<I...> > {
+  static constexpr uint8_t slots[sizeof...(I)] = {Set::slotOf((int16_t)I)...};
+};
+
+template <typename Set, size_t... I>
+constexpr uint8_t SlotTable<Set, IndexList<I...> >::slots[sizeof...(I)];
+
+} // namespace packet_detail
+
+template <typename Handler, typename Set>
+class PacketDispatcher;
+
+template <typename Handler, typename... Packets>
+class PacketDispatcher<Handler, PacketSet<Packets...> > {
+  typedef PacketSet<Packets...> Set;
+  static_assert(Set::valid(), "packet set: duplicate type byte, or untyped packet length shared with a typed one");
+  static_assert(sizeof...(Packets) < 255, "packet set too large");
+
+  struct Entry {
+    uint8_t size;
+    void (*fn)(Handler &, const uint8_t *);
+  };
+  typedef packet_detail::SlotTable<Set, typename packet_detail::MakeIndexList<256>::type> Slots;
+
+  static constexpr Entry ENTRIES[sizeof...(Packets) + 1] = {
+      {0, nullptr}, {(uint8_t)sizeof(Packets), &packet_detail::deliver<Handler, Packets>}...};
+  static constexpr uint8_t UNTYPED_SLOT = Set::slotOf(PACKET_UNTYPED);
+
+public:
+  // True when the frame was a registered packet of exactly its size and was
+  // handed to the handler.
+  static bool dispatch(Handler &h, const uint8_t *data, size_t len) {
+    if (len == 0) return false;
+    const Entry &e = ENTRIES[Slots::slots[data[0]]];
+    if (e.fn != nullptr && len == e.size) {
+      e.fn(h, data);
+      return true;
+    }
+    if (UNTYPED_SLOT != 0 && len == ENTRIES[UNTYPED_SLOT].size) {
+      ENTRIES[UNTYPED_SLOT].fn(h, data);
+      return true;
+    }
+    return false;
+  }
+};
+
+template <typename Handler, typename... Packets>
+constexpr typename PacketDispatcher<Handler, PacketSet<Packets...> >::Entry
+    PacketDispatcher<Handler, PacketSet<Packets...> >::ENTRIES[sizeof...(Packets) + 1];
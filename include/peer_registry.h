@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+// ESP-NOW allows 20 unencrypted peers; the broadcast peer takes one of them.
+static const uint8_t PEER_REGISTRY_CAPACITY = 19;
+static const uint8_t PEER_REGISTRY_BUCKETS = 32; // power of two, > capacity
+
+struct PeerEntry {
+  bool used;
+  uint8_t mac[6];
+  uint32_t firstSeenMs;
+  uint32_t lastSeenMs;
+};
+
+// Called for every entry leaving the table (expiry, eviction, remove), before
+// its slot is reused. Entry ids stay stable while an entry is registered.
+typedef void (*PeerEvictHandler)(uint8_t id, const uint8_t mac[6]);
+typedef void (*PeerEvictContextHandler)(void *ctx, uint8_t id, const uint8_t mac[6]);
+
+// Peer table keyed by a hash of the 6-byte MAC: entries live in fixed slots,
+// a linear-probing index maps MAC -> slot (backward-shift deletion, so no
+// tombstones build up under churn).
+class PeerRegistry {
+public:
+  PeerRegistry();
+
+  void setEvictHandler(PeerEvictHandler handler) { onEvict_ = handler; onEvictCtx_ = nullptr; }
+  void setEvictHandler(PeerEvictContextHandler handler, void *ctx) {
+    onEvict_ = nullptr;
+    onEvictCtx_ = handler;
+    evictCtx_ = ctx;
+  }
+
+  // Finds or registers mac and refreshes lastSeenMs. When the table is full the
+  // least recently seen entry is evicted if it has been idle for at least
+  // evictIdleMs; otherwise -1 is returned.
+  int8_t touch(const uint8_t mac[6], uint32_t nowMs, uint32_t evictIdleMs, bool &added);
+  int8_t find(const uint8_t mac[6]) const;
+  bool remove(const uint8_t mac[6]);
+  uint8_t expire(uint32_t nowMs, uint32_t maxIdleMs);
+
+  uint8_t count() const { return count_; }
+  const PeerEntry &entry(uint8_t id) const { return entries_[id]; }
+
+private:
+  int8_t bucketOf(const uint8_t mac[6]) const;
+  void removeAt(uint8_t id);
+
+  PeerEntry entries_[PEER_REGISTRY_CAPACITY];
+  int8_t buckets_[PEER_REGISTRY_BUCKETS];
+  uint8_t count_;
+  PeerEvictHandler onEvict_;
+  PeerEvictContextHandler onEvictCtx_;
+  void *evictCtx_;
+};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+// Thin task layer: FreeRTOS tasks on the device, detached std::threads on the
+// host so the handoff code can be exercised under real concurrency.
+typedef void (*PlatformTaskFn)(void *arg);
+
+// priority and stackBytes are ignored on the host. The task function must not
+// return on the device.
+bool platformStartTask(const char *name, PlatformTaskFn fn, void *arg, uint32_t stackBytes, uint8_t priority);
+void platformSleepMs(uint32_t ms);
+uint32_t platformMillis();
+
+// Event wait for the main loop: platformWaitForEvent blocks for up to
+// timeoutMs or until another task calls platformSignalEvent (a signal sent
+// while nobody waits is kept for the next wait). One waiting task only.
+void platformWaitForEvent(uint32_t timeoutMs);
+void platformSignalEvent();
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Boundary between the master logic (PowerMaster) and the platform: ESP-NOW,
+// PubSubClient, Preferences and the Arduino clock on the device (main.cpp),
+// in-process stand-ins on the host (sim_hal.h). Calls are made from the
+// thread that drives PowerMaster only.
+
+class RadioHal {
+public:
+  virtual ~RadioHal() {}
+  // mac may be the broadcast address. Returns false when the frame was not
+  // queued; delivery is reported later through PowerMaster::onRadioSent.
+  virtual bool send(const uint8_t mac[6], const uint8_t *data, size_t len) = 0;
+  virtual bool addPeer(const uint8_t mac[6]) = 0;
+  virtual void removePeer(const uint8_t mac[6]) = 0;
+};
+
+class MqttHal {
+public:
+  virtual ~MqttHal() {}
+  virtual bool connected() = 0;
+  // Must accept payloads larger than the client's receive buffer.
+  virtual bool publish(const char *topic, const uint8_t *payload, size_t len, bool retained) = 0;
+  virtual bool subscribe(const char *topic) = 0;
+  virtual bool unsubscribe(const char *topic) = 0;
+};
+
+class KvStoreHal {
+public:
+  virtual ~KvStoreHal() {}
+  virtual bool hasKey(const char *key) = 0;
+  // Both return the bytes read/written, 0 on failure. getString stores a
+  // NUL-terminated value and fails when it does not fit.
+  virtual size_t getBytes(const char *key, uint8_t *buf, size_t cap) = 0;
+  virtual size_t putBytes(const char *key, const uint8_t *data, size_t len) = 0;
+  virtual size_t getString(const char *key, char *buf, size_t cap) = 0;
+};
+
+class ClockHal {
+public:
+  virtual ~ClockHal() {}
+  virtual uint32_t millis() = 0;
+  // Jitter source for retry backoff.
+  virtual uint32_t random() = 0;
+  // Local wall-clock time, false until it is known (NTP).
+  virtual bool localWeekTime(uint8_t &weekdayMon0, uint16_t &minuteOfDay) = 0;
+  // UTC time with milliseconds, read together with the local offset (DST
+  // included); false until it is known.
+  virtual bool wallClock(uint32_t &epochSec, uint16_t &ms, int16_t &utcOffsetMin) = 0;
+};
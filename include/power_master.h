@@ -0,0 +1,339 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "event_scheduler.h"
+#include "mqtt_outbox.h"
+#include "mqtt_router.h"
+#include "peer_registry.h"
+#include "power_hal.h"
+#include "power_schedule_core.h"
+#include "relay_routes.h"
+#include "rtt_estimator.h"
+#include "state_snapshot.h"
+#include "telemetry_series.h"
+#include "time_sync.h"
+
+static const uint8_t POWER_COMMAND_TYPE = 1;
+static const uint8_t POWER_HELLO_TYPE = 2;
+static const uint8_t POWER_TIME_SYNC_TYPE = 6;
+
+#pragma pack(push, 1)
+// The first POWER packet: no type byte, recognized by its length.
+typedef struct {
+  float t;
+  float h;
+  uint8_t soil;
+  uint8_t batt;
+  uint8_t r1, r2, r3;
+  uint8_t presence;
+  uint32_t ms;
+} TelemetryPacket;
+
+typedef struct { uint8_t type; uint8_t ch; uint32_t ms; } HelloPacket;
+typedef struct { uint8_t type; uint16_t minuteOfDay; uint8_t weekdayMon0; uint8_t valid; uint32_t ms; } TimeSyncPacket;
+typedef struct { uint8_t type; uint8_t r1; uint8_t r2; uint8_t r3; uint8_t irrig; uint16_t liveSec; uint32_t ms; } CommandPacket;
+#pragma pack(pop)
+
+EVE_PACKET(TelemetryPacket, PACKET_UNTYPED, 18);
+EVE_PACKET_FIELD(TelemetryPacket, soil, 8);
+EVE_PACKET_FIELD(TelemetryPacket, ms, 14);
+EVE_PACKET(HelloPacket, POWER_HELLO_TYPE, 6);
+EVE_PACKET(TimeSyncPacket, POWER_TIME_SYNC_TYPE, 9);
+EVE_PACKET_FIELD(TimeSyncPacket, minuteOfDay, 1);
+EVE_PACKET_FIELD(TimeSyncPacket, ms, 5);
+EVE_PACKET(CommandPacket, POWER_COMMAND_TYPE, 11);
+EVE_PACKET_FIELD(CommandPacket, liveSec, 5);
+EVE_PACKET_FIELD(CommandPacket, ms, 7);
+
+// Everything a slave sends the master. A new slave-to-master packet is
+// registered above (or next to its struct) and listed here; the receive path
+// sizes its buffers from MAX_SIZE.
+typedef PacketSet<TelemetryPacket, PowerScheduleAckPacket, PowerExecutedPacket, PowerMultiScheduleAckPacket,
+                  PowerFragmentAckPacket, TimeSyncRequestPacket>
+    PowerMasterInbound;
+
+// Retransmissions after the first send. ACK timeouts come from the per-peer
+// RTT estimate (RTT_INITIAL_RTO_MS while the relay has no route).
+static const uint8_t SCHEDULE_RETRY_BUDGET = 4;
+static const uint32_t SCHEDULE_PERSIST_DELAY_MS = 2000;
+// Schedules set within this window travel together in one type-17 frame per
+// slave (MQTT delivers a full-house update as back-to-back messages).
+static const uint32_t SCHEDULE_BATCH_WINDOW_MS = 40;
+
+// On reconnect the master reads back the retained snapshot (<root>snapshot)
+// and republishes its retained topics only when the broker's version differs
+// or none arrives within this window. The first connection after boot always
+// publishes, and so does any reconnect after the outbox dropped a message.
+static const uint32_t SNAPSHOT_CHECK_MS = 1500;
+
+// Peers are registered on first contact and dropped again when idle: stale
+// ones make room for new slaves once the table is full, and everything silent
+// for PEER_EXPIRE_MS is removed periodically.
+static const uint32_t PEER_EVICT_IDLE_MS = 60000;
+static const uint32_t PEER_EXPIRE_MS = 10UL * 60UL * 1000UL;
+static const uint32_t RELAY_ROUTE_TTL_MS = 15UL * 60UL * 1000UL;
+// A delivery report comes within a few ms of its send; unicast frames still
+// unreported after this long had their report dropped and are forgotten.
+static const uint32_t TX_REPORT_STALE_MS = 1000;
+
+// Windowed telemetry slots, handed out to peers on their first telemetry
+// packet and freed when the peer is evicted.
+static const uint8_t TELEMETRY_MAX_SLAVES = 6; // ~1.5 KB each
+
+static const uint8_t PEER_CAN_DELTA = 0x01;   // answered a type 19 (applied or base mismatch)
+static const uint8_t PEER_LACKS_DELTA = 0x02; // answered only the type-14 retry after one
+static const uint8_t PEER_CAN_MULTI = 0x04;   // answered a type 17 with type 18
+static const uint8_t PEER_LACKS_MULTI = 0x08; // answered only the type-14 retry after one
+
+static const uint8_t POWER_BCAST_MAC[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+
+typedef void (*PowerLogFn)(const char *line);
+
+// The master side of the POWER protocol: peers and relay routes, the schedule
+// pipeline (MQTT schedule/set, per relay or bulk -> type 14/17/19/20 -> ACK ->
+// retained publish and persistence), manual relay commands, time sync and
+// per-slave clock tracking, telemetry windows and the outbound MQTT queue.
+// Everything platform-specific goes through the HAL, so the same code runs on
+// the device and in the host simulator. Periodic work and deadlines (hello,
+// time sync, batch window, ACK timeouts, delayed persistence) are timers on
+// the caller's EventScheduler. Not thread-safe: radio frames and delivery
+// reports are handed in from the thread that runs the scheduler.
+class PowerMaster {
+public:
+  PowerMaster(RadioHal &radio, MqttHal &mqtt, KvStoreHal &store, ClockHal &clock, EventScheduler &timers,
+              uint8_t radioChannel);
+
+  void setLogger(PowerLogFn log) { log_ = log; }
+  // Loads the persisted schedules and registers the timers.
+  void begin();
+
+  // Inbound traffic, decoded in place through the PowerMasterInbound registry.
+  // Frames of unknown kind or the wrong length still register the sender.
+  void onRadioFrame(const uint8_t mac[6], const uint8_t *data, size_t len, uint32_t atMs);
+  void onRadioSent(const uint8_t mac[6], bool ok, uint32_t atMs);
+  bool onMqttMessage(const char *topic, const uint8_t *payload, size_t len);
+  // Subscribes (one filter per route) and republishes the retained state,
+  // or first checks the broker's snapshot version on a reconnect.
+  void onMqttConnected();
+
+  // Hands up to maxMessages queued publishes to the client while connected,
+  // after queueing route diagnostics that changed.
+  uint8_t drainOutbox(uint8_t maxMessages);
+  // Writes pending schedules now instead of at the persist deadline.
+  void flushSchedules();
+
+  // Queues a publish on <root><suffix>.
+  bool publish(const char *suffix, const char *payload, size_t len, bool retained);
+
+  const MqttOutbox &outbox() const { return outbox_; }
+  const PeerRegistry &peers() const { return peers_; }
+  const RelayRouteTable &routes() const { return routes_; }
+  const PowerRelaySchedule &activeSchedule(uint8_t relay) const { return active_[relay - 1]; }
+  bool awaitingAck(uint8_t relay) const { return awaiting(relay - 1); }
+  const TelemetryPacket &lastTelemetry() const { return lastTelemetry_; }
+  uint32_t lastTelemetryAt() const { return lastTelemetryAt_; }
+  // The slave's clock against ours, by peer registry id.
+  const TimeSyncEstimator &peerClock(uint8_t id) const { return peerClock_[id].est; }
+  const RttEstimator &peerRtt(uint8_t id) const { return peerRtt_[id]; }
+  const StateSnapshot &snapshot() const { return snapshot_; }
+  bool checkingSnapshot() const { return snapshotCheck_; }
+
+private:
+  struct AckTimer {
+    PowerMaster *self;
+    uint8_t relay;
+  };
+
+  // One received frame; the packet dispatcher calls the overload for its type.
+  struct RadioFrame {
+    PowerMaster &self;
+    const uint8_t *mac;
+    int8_t peerId;
+    uint32_t atMs;
+    void onPacket(const TelemetryPacket &p);
+    void onPacket(const PowerScheduleAckPacket &ack);
+    void onPacket(const PowerMultiScheduleAckPacket &ack);
+    void onPacket(const PowerFragmentAckPacket &ack);
+    void onPacket(const PowerExecutedPacket &ex);
+    void onPacket(const TimeSyncRequestPacket &req);
+  };
+
+  // The last answered request: the next one reports when our reply arrived.
+  struct PeerClock {
+    TimeSyncEstimator est;
+    uint32_t lastT1 = 0;
+    uint32_t lastT2 = 0;
+    uint32_t lastT3 = 0;
+  };
+  // Unicast frames handed to the radio and not reported yet; the last
+  // scheduleRun of them carried a pending schedule for the relays in
+  // scheduleMask. A failed report belongs to a schedule frame only while every
+  // unreported frame is one.
+  struct PeerTx {
+    uint8_t inFlight = 0;
+    uint8_t scheduleRun = 0;
+    uint8_t scheduleMask = 0;
+    uint32_t lastSendMs = 0;
+  };
+
+  static void onHelloTimer(void *ctx);
+  static void onTimeSyncTimer(void *ctx);
+  static void onExpiryTimer(void *ctx);
+  static void onTelemetryTimer(void *ctx);
+  static void onDiagTimer(void *ctx);
+  static void onBatchTimer(void *ctx);
+  static void onPersistTimer(void *ctx);
+  static void onAckTimer(void *ctx);
+  static void onSnapshotTimer(void *ctx);
+  static void onPeerEvicted(void *ctx, uint8_t id, const uint8_t mac[6]);
+  static void onRelaySet(void *ctx, uint8_t relay, const char *payload, size_t len);
+  static void onScheduleSet(void *ctx, uint8_t relay, const char *payload, size_t len);
+  static void onBulkScheduleSet(void *ctx, uint8_t relay, const char *payload, size_t len);
+  static bool sendQueued(void *ctx, const char *topic, const uint8_t *payload, size_t len, bool retained);
+
+  void logf(const char *fmt, ...);
+  void publishRelay(uint8_t relay, const char *suffix, const char *payload, bool retained = false);
+  void publishOutboxStats();
+  void publishPeerClocks();
+
+  bool addPeerIfNeeded(const uint8_t mac[6]);
+  void evictPeer(uint8_t id, const uint8_t mac[6]);
+  bool sendToAllPeers(const uint8_t *data, size_t len);
+  const uint8_t *routedMac(uint8_t relay);
+  bool sendToRelay(uint8_t relay, const uint8_t *data, size_t len, bool schedule);
+  bool sendToPeer(const uint8_t mac[6], const uint8_t *data, size_t len, uint8_t scheduleRelays);
+  void learnRoute(uint8_t relay, const uint8_t mac[6], uint32_t atMs);
+
+  void markSchedulesDirty();
+  void loadLegacySchedules();
+  void publishNextTransition(uint8_t relay);
+  void publishScheduleCurrent(uint8_t relay);
+  void publishRoute(uint8_t relay);
+  void publishRetainedState();
+  void publishAck(uint8_t relay, SnapshotAck ack);
+  void refreshSnapshot(uint8_t relay);
+  void publishSnapshot();
+  void handleBrokerSnapshot(const uint8_t *payload, size_t len);
+  void endSnapshotCheck();
+
+  bool sendRulesPacket(uint8_t relay, const PowerRelaySchedule &schedule);
+  bool sendRuleFragments(uint8_t relay);
+  int8_t routedPeer(uint8_t relay);
+  bool peerLacks(uint8_t relay, uint8_t frameBit);
+  void notePeerFrames(uint8_t idx, int8_t peerId, uint8_t ackType, bool baseMismatch);
+  uint32_t relayRtoMs(uint8_t relay);
+  void armScheduleAttempt(uint8_t relay, uint32_t now);
+  bool sendScheduleAttempt(uint8_t relay);
+  bool sendScheduleBatch(uint8_t mask, const uint8_t *mac);
+  void beginScheduleTransfer(uint8_t relay, const PowerRelaySchedule &table);
+  void queueScheduleSend(uint8_t relay);
+  void flushScheduleSends();
+  void sampleAckRtt(uint8_t idx, int8_t peerId, uint32_t atMs);
+  bool awaiting(uint8_t idx) const { return waitingAck_[idx] && !(sendQueued_ & (1u << idx)); }
+  void commitScheduleResult(uint8_t relay, bool ok);
+  void onAckTimeout(uint8_t relay);
+  void settleBulk(uint8_t relay, bool ok);
+  void publishBulkResult(const char *result);
+
+  void handleScheduleAck(const PowerScheduleAckPacket &ack, int8_t peerId, uint32_t atMs);
+  void handleMultiScheduleAck(const PowerMultiScheduleAckPacket &ack, int8_t peerId, uint32_t atMs);
+  void handleFragmentAck(const PowerFragmentAckPacket &ack, int8_t peerId, uint32_t atMs);
+  void handleExecuted(const PowerExecutedPacket &ex, int8_t peerId);
+  void publishExecutionLag(const PowerExecutedPacket &ex, int8_t peerId);
+  void handleScheduleSet(uint8_t relay, const char *payload, size_t len);
+  void handleBulkScheduleSet(const char *payload, size_t len);
+  void handleRelaySet(uint8_t relay, const char *payload, size_t len);
+
+  void recordTelemetry(int8_t peerId, const TelemetryPacket &p, uint32_t atMs);
+  void publishTelemetry();
+  void sendHello();
+  void sendTimeSync();
+  bool fillTimeSyncResponse(TimeSyncResponsePacket &resp);
+  void handleTimeSyncRequest(const TimeSyncRequestPacket &req, const uint8_t mac[6], int8_t peerId, uint32_t atMs);
+
+  RadioHal &radio_;
+  MqttHal &mqtt_;
+  KvStoreHal &store_;
+  ClockHal &clock_;
+  EventScheduler &timers_;
+  uint8_t radioChannel_;
+  PowerLogFn log_;
+
+  PeerRegistry peers_;
+  RelayRouteTable routes_;
+  uint8_t routesToPublish_; // bit relay-1: route changed, publish diagnostics
+  RttEstimator peerRtt_[PEER_REGISTRY_CAPACITY]; // indexed by peer registry id
+  PeerClock peerClock_[PEER_REGISTRY_CAPACITY];
+  PeerTx peerTx_[PEER_REGISTRY_CAPACITY];
+  // Optional schedule frames per peer (PEER_*_DELTA / PEER_*_MULTI bits): a
+  // peer that only ever answered the type-14 retry after a type 19 or 17 is
+  // sent type 14 straight away, so its first attempt is answered and its RTT
+  // gets sampled.
+  uint8_t peerFrames_[PEER_REGISTRY_CAPACITY];
+
+  MqttTopicRouter router_;
+  MqttOutbox outbox_;
+
+  PowerRelaySchedule active_[POWER_RELAY_COUNT];
+  PowerRelaySchedule pending_[POWER_RELAY_COUNT];
+  PowerScheduleIndex index_[POWER_RELAY_COUNT];
+  bool waitingAck_[POWER_RELAY_COUNT];
+  uint8_t sendAttempts_[POWER_RELAY_COUNT];
+  uint8_t firstFrame_[POWER_RELAY_COUNT]; // type of the transfer's first send (14, 17, 19 or 20)
+  uint32_t sentAtMs_[POWER_RELAY_COUNT];
+  uint8_t relayState_[POWER_RELAY_COUNT]; // SNAPSHOT_STATE_UNKNOWN until a slave reports
+  uint8_t ackStatus_[POWER_RELAY_COUNT];  // last final SnapshotAck
+  uint8_t sendQueued_; // bit relay-1: waiting for the batch window
+  // Fragmented transfers: id of the pending table's transfer and the
+  // fragments the slave reported holding (resends skip those).
+  uint8_t transferId_[POWER_RELAY_COUNT];
+  uint32_t fragmentsHeld_[POWER_RELAY_COUNT];
+  // Type-17 frames carry a batch id the type-18 ACK echoes: batchXfer_ is the
+  // id of the frame that carried the pending table (0: none did).
+  uint8_t nextBatchXfer_;
+  uint8_t batchXfer_[POWER_RELAY_COUNT];
+  // ACKs arriving close together mark the store dirty once; the binary record
+  // for all relays is written a short while after the first change, or when
+  // the last relay of a bulk set resolves.
+  bool schedulesDirty_;
+
+  // Bulk schedule/set: the parsed document, then which relays it listed, which
+  // of those are still in flight, failed or needed no transfer (bit relay-1).
+  PowerRelaySchedule bulk_[POWER_RELAY_COUNT];
+  uint8_t bulkRelays_;
+  uint8_t bulkOpen_;
+  uint8_t bulkFailed_;
+  uint8_t bulkUnchanged_;
+
+  // Retained snapshot: dirty until the current version is queued. While a
+  // reconnect check is pending nothing is queued, so the broker's copy can be
+  // compared with ours.
+  StateSnapshot snapshot_;
+  char snapshotTopic_[MQTT_ROUTER_MAX_ROOT + 16];
+  bool snapshotDirty_;
+  bool snapshotCheck_;
+  bool retainedPublished_; // since boot
+  uint32_t retainedDrops_; // outbox drops when everything retained was last queued
+
+  int8_t batchTimer_;
+  int8_t snapshotTimer_;
+  int8_t persistTimer_;
+  int8_t ackTimer_[POWER_RELAY_COUNT]; // ACK deadline of the current attempt
+  AckTimer ackTimerCtx_[POWER_RELAY_COUNT];
+
+  TelemetryPacket lastTelemetry_;
+  uint32_t lastTelemetryAt_;
+  TelemetrySeries telemetry_[TELEMETRY_MAX_SLAVES];
+  int8_t telemetryOwner_[TELEMETRY_MAX_SLAVES]; // peer registry id, -1 when free
+  char telemetryJson_[TELEM_JSON_MAX];
+  // One buffer for the large one-shot encodings (store record, schedule and
+  // snapshot JSON), kept off the loop task's stack: with 8 relays of 96 rules
+  // each is several KB. None of their users nests inside another.
+  union Scratch {
+    uint8_t store[scheduleStoreMaxSize(POWER_RELAY_COUNT)];
+    char scheduleJson[POWER_SCHEDULE_JSON_MAX + 1];
+    char snapshotJson[POWER_SNAPSHOT_JSON_MAX];
+  } scratch_;
+};
@@ -1,9 +1,33 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 #include <string>
 
-static const uint8_t POWER_MAX_SCHEDULE_RULES = 10;
+#include "packet_registry.h"
+
+// Capacities are build flags (-D EVE_POWER_RELAY_COUNT=8 ...). Every per-relay
+// table, buffer and NVS record scales with them.
+#ifndef EVE_POWER_RELAY_COUNT
+#define EVE_POWER_RELAY_COUNT 3
+#endif
+#ifndef EVE_POWER_MAX_SCHEDULE_RULES
+#define EVE_POWER_MAX_SCHEDULE_RULES 10
+#endif
+
+static const uint8_t POWER_RELAY_COUNT = EVE_POWER_RELAY_COUNT;
+static const uint16_t POWER_MAX_SCHEDULE_RULES = EVE_POWER_MAX_SCHEDULE_RULES;
+// Rules a type-14, type-17 or type-19 frame can describe per relay: the table
+// size of slave firmware that predates fragmented transfer (type 20).
+static const uint8_t POWER_RULES_PACKET_MAX = 10;
+// ESP-NOW payload limit.
+static const size_t POWER_RADIO_FRAME_MAX = 250;
+
+// Relay masks are one byte on the wire; rule counts are one byte in the NVS
+// record; every table must fit in a type-14 frame's worth of rules.
+static_assert(POWER_RELAY_COUNT >= 1 && POWER_RELAY_COUNT <= 8, "EVE_POWER_RELAY_COUNT must be 1..8");
+static_assert(POWER_MAX_SCHEDULE_RULES >= POWER_RULES_PACKET_MAX && POWER_MAX_SCHEDULE_RULES <= 255,
+              "EVE_POWER_MAX_SCHEDULE_RULES must be 10..255");
 
 struct PowerScheduleRule {
   uint8_t hh;
@@ -12,16 +36,31 @@ struct PowerScheduleRule {
   uint8_t daysMask; // bit0 Mon ... bit6 Sun
 };
 
-struct PowerRelaySchedule {
-  uint8_t count;
-  PowerScheduleRule rules[POWER_MAX_SCHEDULE_RULES];
+// Rule table of one relay. The firmware uses PowerRelaySchedule (the
+// configured capacity); other capacities serve reassembly and tests.
+template <uint16_t MaxRules>
+struct PowerRelayScheduleT {
+  static const uint16_t CAPACITY = MaxRules;
+  uint16_t count;
+  PowerScheduleRule rules[MaxRules];
 };
 
+typedef PowerRelayScheduleT<POWER_MAX_SCHEDULE_RULES> PowerRelaySchedule;
+
+static const uint8_t POWER_RULES_TYPE = 14;
+static const uint8_t POWER_ACK_TYPE = 15;
+static const uint8_t POWER_EXECUTED_TYPE = 16;
+
+// Fixed-size frames, registered in packet_registry.h. The reserved bytes are
+// where the original naturally aligned structs had padding: the wire layout
+// is unchanged.
+#pragma pack(push, 1)
 struct PowerRelayRulesPacket {
   uint8_t type;   // 14
-  uint8_t ch;     // 1..3
+  uint8_t ch;     // 1..POWER_RELAY_COUNT
   uint8_t count;  // 0..10
-  PowerScheduleRule rules[POWER_MAX_SCHEDULE_RULES];
+  PowerScheduleRule rules[POWER_RULES_PACKET_MAX];
+  uint8_t reserved;
   uint32_t ms;
 };
 
@@ -33,17 +72,318 @@ struct PowerScheduleAckPacket {
   uint32_t ms;
 };
 
+// Answer to a multi-relay rules frame (type 17): relayMask lists the relays the
+// slave owns and handled, okMask those it applied (bit relay-1), xfer echoes
+// the frame's batch id.
+struct PowerMultiScheduleAckPacket {
+  uint8_t type;   // 18
+  uint8_t relayMask;
+  uint8_t okMask;
+  uint8_t xfer;
+  uint32_t ms;
+};
+
 struct PowerExecutedPacket {
   uint8_t type;         // 16
   uint8_t ch;
   uint8_t state;
+  uint8_t reserved;
   uint16_t minuteOfDay;
   uint8_t weekdayMon0;
+  uint8_t reserved2;
   uint32_t ms;
 };
+#pragma pack(pop)
+
+EVE_PACKET(PowerRelayRulesPacket, POWER_RULES_TYPE, 48);
+EVE_PACKET_FIELD(PowerRelayRulesPacket, rules, 3);
+EVE_PACKET_FIELD(PowerRelayRulesPacket, ms, 44);
+EVE_PACKET(PowerScheduleAckPacket, POWER_ACK_TYPE, 8);
+EVE_PACKET_FIELD(PowerScheduleAckPacket, ms, 4);
+EVE_PACKET(PowerExecutedPacket, POWER_EXECUTED_TYPE, 12);
+EVE_PACKET_FIELD(PowerExecutedPacket, minuteOfDay, 4);
+EVE_PACKET_FIELD(PowerExecutedPacket, weekdayMon0, 6);
+EVE_PACKET_FIELD(PowerExecutedPacket, ms, 8);
+
+// Upper bound on scheduleToJson output: brackets plus, per rule, a comma and
+// {"at":"HH:MM","state":"OFF","days":"1111111"}.
+static const size_t POWER_SCHEDULE_JSON_MAX = 2 + POWER_MAX_SCHEDULE_RULES * 46;
+
+// Allocation-free codec over a rule array of any capacity. error points to a
+// static message on failure. writeScheduleRulesJson returns the length written
+// (NUL-terminated when cap allows) or 0 when cap is smaller than
+// scheduleRulesJsonLength().
+bool parseScheduleRules(const char *json, size_t len, PowerScheduleRule *rules, uint16_t capacity, uint16_t &count,
+                        const char *&error);
+size_t scheduleRulesJsonLength(const PowerScheduleRule *rules, uint16_t count);
+size_t writeScheduleRulesJson(const PowerScheduleRule *rules, uint16_t count, char *buf, size_t cap);
+
+template <uint16_t N>
+bool parseScheduleJson(const char *json, size_t len, PowerRelayScheduleT<N> &out, const char *&error) {
+  return parseScheduleRules(json, len, out.rules, N, out.count, error);
+}
+
+// Tables for several relays in one document, keyed by relay number:
+//   {"1":[{"at":"07:00","state":"ON","days":"1111100"}],"3":[]}
+// Each relay 1..relayCount at most once. All or nothing: on failure relayMask
+// is meaningless, and errorRelay is the relay whose key or table is at fault
+// (0 when the envelope itself is).
+bool parseBulkScheduleRules(const char *json, size_t len, uint8_t relayCount, PowerScheduleRule *const *rules,
+                            uint16_t capacity, uint16_t *counts, uint8_t &relayMask, uint8_t &errorRelay,
+                            const char *&error);
+
+// out[relay - 1] receives each listed relay's table and the others are left
+// alone; after a failure the listed ones may be partly written.
+template <uint16_t N>
+bool parseBulkScheduleJson(const char *json, size_t len, PowerRelayScheduleT<N> *out, uint8_t relayCount,
+                           uint8_t &relayMask, uint8_t &errorRelay, const char *&error) {
+  PowerScheduleRule *rules[8];
+  uint16_t counts[8] = {};
+  if (relayCount > 8) relayCount = 8;
+  for (uint8_t i = 0; i < relayCount; i++) rules[i] = out[i].rules;
+  if (!parseBulkScheduleRules(json, len, relayCount, rules, N, counts, relayMask, errorRelay, error)) return false;
+  for (uint8_t i = 0; i < relayCount; i++) {
+    if (relayMask & (1u << i)) out[i].count = counts[i];
+  }
+  return true;
+}
+
+// Upper bound on a bulk document carrying every relay's largest table.
+static const size_t POWER_BULK_SCHEDULE_JSON_MAX = 2 + POWER_RELAY_COUNT * (POWER_SCHEDULE_JSON_MAX + 5);
+
+template <uint16_t N>
+size_t scheduleJsonLength(const PowerRelayScheduleT<N> &schedule) {
+  return scheduleRulesJsonLength(schedule.rules, schedule.count);
+}
+
+template <uint16_t N>
+size_t writeScheduleJson(const PowerRelayScheduleT<N> &schedule, char *buf, size_t cap) {
+  return writeScheduleRulesJson(schedule.rules, schedule.count, buf, cap);
+}
+
+template <uint16_t N>
+bool parseScheduleJson(const std::string &json, PowerRelayScheduleT<N> &out, std::string &error) {
+  const char *msg = "";
+  if (parseScheduleJson(json.data(), json.size(), out, msg)) return true;
+  error = msg;
+  return false;
+}
+
+template <uint16_t N>
+std::string scheduleToJson(const PowerRelayScheduleT<N> &schedule) {
+  std::string out(scheduleJsonLength(schedule), '\0');
+  writeScheduleJson(schedule, &out[0], out.size());
+  return out;
+}
+
+// Binary persistence record for all relays:
+//   magic u32 | version u8 | relayCount u8 | payloadLen u16 |
+//   per relay: count u8, count x {hh, mm, state, daysMask} | crc32 u32
+// Integers are little-endian; the CRC covers everything before it.
+static const uint32_t POWER_SCHEDULE_STORE_MAGIC = 0x43535645; // "EVSC"
+static const uint8_t POWER_SCHEDULE_STORE_VERSION = 1;
+
+constexpr size_t scheduleStoreMaxSize(uint8_t relayCount) {
+  return 8 + relayCount * (1 + POWER_MAX_SCHEDULE_RULES * 4) + 4;
+}
+
+uint32_t powerCrc32(const uint8_t *data, size_t len);
+size_t encodeScheduleStore(const PowerRelaySchedule *schedules, uint8_t relayCount, uint8_t *buf, size_t cap);
+// Leaves schedules untouched unless the whole record is valid.
+bool decodeScheduleStore(const uint8_t *buf, size_t len, PowerRelaySchedule *schedules, uint8_t relayCount);
+
+// Compiled weekly view of a schedule: one sorted entry per minute of the week
+// at which the relay actually switches (rules firing at the same minute are
+// resolved in list order, rules that keep the current state are dropped).
+static const uint16_t POWER_MINUTES_PER_DAY = 1440;
+static const uint16_t POWER_MINUTES_PER_WEEK = 7 * POWER_MINUTES_PER_DAY;
+static const uint16_t POWER_MAX_TRANSITIONS =
+    POWER_MAX_SCHEDULE_RULES * 7 < POWER_MINUTES_PER_WEEK ? POWER_MAX_SCHEDULE_RULES * 7 : POWER_MINUTES_PER_WEEK;
+
+struct PowerScheduleTransition {
+  uint16_t weekMinute; // weekdayMon0 * 1440 + minuteOfDay
+  uint8_t state;
+};
+
+struct PowerScheduleIndex {
+  uint16_t count;
+  PowerScheduleTransition transitions[POWER_MAX_TRANSITIONS];
+};
+
+void buildScheduleIndex(const PowerRelaySchedule &schedule, PowerScheduleIndex &out);
+// Expected relay state (0/1), or -1 when the schedule never fires.
+int8_t scheduleStateAt(const PowerScheduleIndex &index, uint8_t weekdayMon0, uint16_t minuteOfDay);
+// True when the schedule switches the relay at exactly this minute.
+bool scheduleSwitchesAt(const PowerScheduleIndex &index, uint8_t weekdayMon0, uint16_t minuteOfDay);
+// First switch strictly after the given minute, wrapping around the week.
+bool scheduleNextTransition(const PowerScheduleIndex &index, uint8_t weekdayMon0, uint16_t minuteOfDay,
+                            PowerScheduleTransition &next);
+
+bool scheduleRulesEqual(const PowerScheduleRule *a, uint16_t aCount, const PowerScheduleRule *b, uint16_t bCount);
 
-bool parseScheduleJson(const std::string &json, PowerRelaySchedule &out, std::string &error);
-std::string scheduleToJson(const PowerRelaySchedule &schedule);
-bool schedulesEqual(const PowerRelaySchedule &a, const PowerRelaySchedule &b);
+template <uint16_t N, uint16_t M>
+bool schedulesEqual(const PowerRelayScheduleT<N> &a, const PowerRelayScheduleT<M> &b) {
+  return scheduleRulesEqual(a.rules, a.count, b.rules, b.count);
+}
+
+// Fails for tables longer than POWER_RULES_PACKET_MAX.
 bool buildRulesPacket(uint8_t relay, const PowerRelaySchedule &schedule, uint32_t nowMs, PowerRelayRulesPacket &out);
 
+// Multi-relay rules frame, variable length, little-endian:
+//   type u8 (17) | relayMask u8 | xfer u8 | ms u32 |
+//   per set bit, lowest relay first: count u8, count x rule (3 bytes)
+// A rule packs minute-of-day in 11 bits: b0 = minute & 0xFF,
+// b1 = minute >> 8 | state << 7, b2 = daysMask.
+static const uint8_t POWER_MULTI_RULES_TYPE = 17;
+static const uint8_t POWER_MULTI_ACK_TYPE = 18;
+EVE_PACKET(PowerMultiScheduleAckPacket, POWER_MULTI_ACK_TYPE, 8);
+EVE_PACKET_FIELD(PowerMultiScheduleAckPacket, xfer, 3);
+EVE_PACKET_FIELD(PowerMultiScheduleAckPacket, ms, 4);
+static const size_t POWER_MULTI_RULES_MAX = 7 + POWER_RELAY_COUNT * (1 + POWER_RULES_PACKET_MAX * 3);
+
+// schedules is indexed by relay-1; returns the frame length or 0 (also when a
+// table is longer than POWER_RULES_PACKET_MAX or the frame would not fit in
+// POWER_RADIO_FRAME_MAX).
+size_t encodeMultiRulesPacket(const PowerRelaySchedule *schedules, uint8_t relayMask, uint8_t xfer, uint32_t nowMs,
+                              uint8_t *buf, size_t cap);
+// Fills schedules[relay-1] for every relay in relayMask; leaves them untouched
+// unless the whole frame is valid.
+bool decodeMultiRulesPacket(const uint8_t *buf, size_t len, uint8_t &relayMask, uint8_t &xfer,
+                            PowerRelaySchedule *schedules, uint32_t &ms);
+
+// Edit script between two rule tables (Levenshtein over whole rules). Edits
+// are listed with non-increasing index and are applied in order; an edit
+// count never exceeds max(base.count, target.count). Both tables must hold at
+// most POWER_RULES_PACKET_MAX rules (edit indices are 6 bits on the wire).
+enum PowerScheduleEditOp : uint8_t { POWER_EDIT_REPLACE = 0, POWER_EDIT_INSERT = 1, POWER_EDIT_DELETE = 2 };
+
+struct PowerScheduleEdit {
+  uint8_t op;
+  uint8_t index;
+  PowerScheduleRule rule; // unused for deletes
+};
+
+struct PowerScheduleDelta {
+  uint8_t count;
+  PowerScheduleEdit edits[POWER_RULES_PACKET_MAX];
+};
+
+// FNV-1a over count and the rules in use; identifies the base of a delta and
+// the table of a fragmented transfer. Tables of up to 255 rules fold the
+// count as one byte, as before capacities were configurable.
+uint32_t scheduleRulesHash(const PowerScheduleRule *rules, uint16_t count);
+
+template <uint16_t N>
+uint32_t scheduleHash(const PowerRelayScheduleT<N> &schedule) {
+  return scheduleRulesHash(schedule.rules, schedule.count);
+}
+
+// Returns false (and an empty delta) when a table is too long to diff.
+bool diffSchedules(const PowerRelaySchedule &base, const PowerRelaySchedule &target, PowerScheduleDelta &out);
+bool applyScheduleDelta(const PowerRelaySchedule &base, const PowerScheduleDelta &delta, PowerRelaySchedule &out);
+
+// Delta rules frame, little-endian:
+//   type u8 (19) | ch u8 | baseHash u32 | targetHash u32 | ms u32 | edits u8 |
+//   per edit: op << 6 | index, then the 3-byte rule unless op is delete
+// The slave applies it only when its table hashes to baseHash and the result
+// to targetHash; otherwise it answers type 15 with ok = POWER_ACK_BASE_MISMATCH
+// and the master resends the full table.
+static const uint8_t POWER_DELTA_RULES_TYPE = 19;
+static const uint8_t POWER_ACK_BASE_MISMATCH = 2;
+static const size_t POWER_DELTA_PACKET_MAX = 15 + POWER_RULES_PACKET_MAX * 4;
+
+size_t buildDeltaPacket(uint8_t relay, const PowerRelaySchedule &base, const PowerRelaySchedule &target, uint32_t nowMs,
+                        uint8_t *buf, size_t cap);
+bool decodeDeltaPacket(const uint8_t *buf, size_t len, uint8_t &relay, uint32_t &baseHash, uint32_t &targetHash,
+                       PowerScheduleDelta &delta, uint32_t &ms);
+
+// Fragmented rules transfer, for tables longer than POWER_RULES_PACKET_MAX.
+// Fragment frame, little-endian:
+//   type u8 (20) | ch u8 | xfer u8 | index u8 | total u8 | rules u16 |
+//   tableHash u32 | ms u32 | up to POWER_FRAGMENT_RULES rules (3 bytes, as in type 17)
+// Fragment i carries rules [i * POWER_FRAGMENT_RULES, ...); an empty table is
+// one fragment without rules. xfer changes with every new table, and
+// tableHash (scheduleRulesHash) lets the slave check the reassembled table.
+// The slave answers every fragment with a type-21 ACK listing the fragments it
+// holds; the master resends only those missing.
+static const uint8_t POWER_FRAGMENT_TYPE = 20;
+static const uint8_t POWER_FRAGMENT_ACK_TYPE = 21;
+static const size_t POWER_FRAGMENT_HEADER = 15;
+static const uint8_t POWER_FRAGMENT_RULES = (POWER_RADIO_FRAME_MAX - POWER_FRAGMENT_HEADER) / 3;
+static const uint8_t POWER_FRAGMENT_MAX = 32; // one bit each in the ACK
+static const size_t POWER_FRAGMENT_FRAME_MAX = POWER_FRAGMENT_HEADER + POWER_FRAGMENT_RULES * 3;
+// type-21 ok value while fragments are missing.
+static const uint8_t POWER_ACK_INCOMPLETE = 3;
+
+#pragma pack(push, 1)
+struct PowerFragmentAckPacket {
+  uint8_t type;      // 21
+  uint8_t ch;
+  uint8_t xfer;
+  uint8_t ok;        // 1 applied, 0 rejected, POWER_ACK_INCOMPLETE
+  uint32_t received; // bit i: fragment i held by the slave
+  uint32_t ms;
+};
+#pragma pack(pop)
+
+EVE_PACKET(PowerFragmentAckPacket, POWER_FRAGMENT_ACK_TYPE, 12);
+EVE_PACKET_FIELD(PowerFragmentAckPacket, received, 4);
+EVE_PACKET_FIELD(PowerFragmentAckPacket, ms, 8);
+
+// A decoded fragment; rules points into the frame.
+struct PowerRuleFragment {
+  uint8_t relay;
+  uint8_t xfer;
+  uint8_t index;
+  uint8_t total;
+  uint16_t ruleCount; // whole table
+  uint32_t tableHash;
+  uint32_t ms;
+  uint8_t frameRules; // rules in this fragment
+  const uint8_t *rules;
+};
+
+// Fragments for a table of count rules, 0 when it needs more than POWER_FRAGMENT_MAX.
+uint8_t ruleFragmentCount(uint16_t count);
+// Fragment index of the table; returns the frame length or 0.
+size_t encodeRuleFragment(uint8_t relay, uint8_t xfer, const PowerScheduleRule *rules, uint16_t count, uint8_t index,
+                          uint32_t nowMs, uint8_t *buf, size_t cap);
+bool decodeRuleFragment(const uint8_t *buf, size_t len, PowerRuleFragment &out);
+
+// Receive side of one relay's transfers. A fragment of a different transfer
+// (xfer, size or hash) drops what was collected and starts over.
+struct PowerRuleTransferState {
+  bool open;
+  uint8_t xfer;
+  uint8_t total;
+  uint16_t count;
+  uint32_t tableHash;
+  uint32_t received; // bit i: fragment i stored
+};
+
+// Stores the fragment's rules into rules (capacity entries) and returns the
+// type-21 ok value: 1 once every fragment is in and the table matches its
+// hash (again for duplicates), POWER_ACK_INCOMPLETE while some are missing, 0
+// when the table does not fit or fails the hash check.
+uint8_t acceptRuleFragment(PowerRuleTransferState &state, const PowerRuleFragment &fragment, PowerScheduleRule *rules,
+                           uint16_t capacity);
+
+template <uint16_t MaxRules>
+class PowerRuleReassembler {
+public:
+  PowerRuleReassembler() : state_(), table_() {}
+
+  uint8_t accept(const PowerRuleFragment &fragment) {
+    uint8_t ok = acceptRuleFragment(state_, fragment, table_.rules, MaxRules);
+    table_.count = ok == 1 ? state_.count : 0;
+    return ok;
+  }
+  uint8_t transfer() const { return state_.xfer; }
+  uint32_t received() const { return state_.received; }
+  // The reassembled table, after accept() returned 1.
+  const PowerRelayScheduleT<MaxRules> &table() const { return table_; }
+
+private:
+  PowerRuleTransferState state_;
+  PowerRelayScheduleT<MaxRules> table_;
+};
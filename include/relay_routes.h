@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "power_schedule_core.h"
+
+struct RelayRoute {
+  bool known;
+  uint8_t mac[6];
+  uint32_t learnedMs;  // first seen on this MAC
+  uint32_t lastSeenMs; // last ACK/executed from it
+  uint32_t unicastSends;
+  uint32_t fanoutSends;
+  uint32_t changes;    // learned or moved to another MAC
+  uint32_t expiries;   // dropped for age, failure or peer eviction
+};
+
+// Which slave owns each relay channel, learned from the source MAC of ACK and
+// executed packets. Relays are 1..POWER_RELAY_COUNT.
+class RelayRouteTable {
+public:
+  explicit RelayRouteTable(uint32_t ttlMs);
+
+  // Returns true when the route is new or moved to another MAC.
+  bool learn(uint8_t relay, const uint8_t mac[6], uint32_t nowMs);
+  // Route MAC, or nullptr when unknown/expired (caller falls back to fan-out).
+  const uint8_t *lookup(uint8_t relay, uint32_t nowMs);
+  bool invalidate(uint8_t relay);
+  // Bitmask (bit relay-1) of the routes dropped.
+  uint8_t forgetMac(const uint8_t mac[6]);
+  uint8_t expire(uint32_t nowMs);
+
+  void countUnicast(uint8_t relay);
+  void countFanout(uint8_t relay);
+  const RelayRoute &route(uint8_t relay) const { return routes_[relay - 1]; }
+
+private:
+  bool valid(uint8_t relay) const { return relay >= 1 && relay <= POWER_RELAY_COUNT; }
+
+  uint32_t ttlMs_;
+  RelayRoute routes_[POWER_RELAY_COUNT];
+};
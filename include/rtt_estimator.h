@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+
+static const uint32_t RTT_INITIAL_RTO_MS = 3000; // before the first sample
+static const uint32_t RTT_MIN_RTO_MS = 100;
+static const uint32_t RTT_MAX_RTO_MS = 8000;
+
+// Smoothed RTT and mean deviation in the style of RFC 6298 (alpha 1/8,
+// beta 1/4, RTO = SRTT + 4 * RTTVAR), kept in fixed point. Feed it only
+// samples from exchanges that were not retransmitted (Karn's rule).
+class RttEstimator {
+public:
+  RttEstimator(uint32_t initialRtoMs = RTT_INITIAL_RTO_MS, uint32_t minRtoMs = RTT_MIN_RTO_MS,
+               uint32_t maxRtoMs = RTT_MAX_RTO_MS);
+
+  void reset();
+  void sample(uint32_t rttMs);
+  // Delivery failure reported by the radio: double the timeout (capped) until
+  // the next valid sample.
+  void onLoss();
+
+  uint32_t timeoutMs() const;
+  bool hasSample() const { return samples_ > 0; }
+  uint32_t srttMs() const { return srtt8_ / 8; }
+  uint32_t rttvarMs() const { return rttvar4_ / 4; }
+  uint32_t samples() const { return samples_; }
+  uint32_t losses() const { return losses_; }
+
+private:
+  uint32_t initialRtoMs_;
+  uint32_t minRtoMs_;
+  uint32_t maxRtoMs_;
+  uint32_t srtt8_;   // SRTT * 8
+  uint32_t rttvar4_; // RTTVAR * 4
+  uint8_t backoffShift_;
+  uint32_t samples_;
+  uint32_t losses_;
+};
+
+// Wait before retransmission number `attempt` (0 = first send): baseMs doubled
+// per attempt and capped at maxMs, with "equal jitter" (uniform in [d/2, d])
+// from attempt 1 on so retries from several relays do not line up.
+uint32_t backoffDelayMs(uint32_t baseMs, uint8_t attempt, uint32_t maxMs, uint32_t random);
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Latest-value handoff between exactly one writer and one reader task (e.g.
+// network loop -> render task). Three slots: the writer always fills a slot
+// that is neither the latest published one nor the one the reader holds, so
+// neither side ever waits and the reader never sees a half-written value.
+// Like SpscQueue it uses only atomic loads and stores (seq_cst where the two
+// sides must agree on who owns a slot), no read-modify-write.
+template <typename T>
+class SnapshotChannel {
+public:
+  SnapshotChannel() : latest_(NONE), reading_(NONE), written_(0), lastRead_(0) {}
+
+  // Writer side.
+  void write(const T &value) {
+    uint8_t latest = latest_.load(std::memory_order_relaxed); // only the writer stores it
+    uint8_t reading = reading_.load(std::memory_order_seq_cst);
+    uint8_t slot = 0;
+    while (slot == latest || slot == reading) slot++;
+    slots_[slot].value = value;
+    slots_[slot].seq = ++written_;
+    latest_.store(slot, std::memory_order_seq_cst);
+  }
+
+  // Reader side. Copies the newest snapshot into out and returns true when it
+  // is newer than the previous read.
+  bool read(T &out) {
+    for (;;) {
+      uint8_t slot = latest_.load(std::memory_order_seq_cst);
+      if (slot == NONE) return false;
+      reading_.store(slot, std::memory_order_seq_cst);
+      // The writer may have picked this slot before seeing reading_; it
+      // cannot have published it since, so a changed latest_ means retry.
+      if (latest_.load(std::memory_order_seq_cst) != slot) continue;
+      bool fresh = slots_[slot].seq != lastRead_;
+      if (fresh) {
+        out = slots_[slot].value;
+        lastRead_ = slots_[slot].seq;
+      }
+      reading_.store(NONE, std::memory_order_release);
+      return fresh;
+    }
+  }
+
+  // Snapshots written so far (writer side).
+  uint32_t written() const { return written_; }
+
+private:
+  static const uint8_t NONE = 0xFF;
+
+  struct Slot {
+    T value;
+    uint32_t seq;
+  };
+
+  Slot slots_[3];
+  std::atomic<uint8_t> latest_;
+  std::atomic<uint8_t> reading_;
+  uint32_t written_;  // writer only
+  uint32_t lastRead_; // reader only
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// Fixed-capacity lock-free ring for exactly one producer and one consumer
+// (e.g. the ESP-NOW receive callback and loop()). Indices run freely and are
+// masked on access; only plain atomic loads/stores are used, so it needs no
+// RMW support from the target.
+template <typename T, uint32_t Capacity>
+class SpscQueue {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+  // Producer side. Returns false and counts an overflow when full.
+  bool push(const T &item) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    uint32_t head = head_.load(std::memory_order_acquire);
+    uint32_t used = tail - head;
+    if (used >= Capacity) {
+      overflows_.store(overflows_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      return false;
+    }
+    items_[tail & (Capacity - 1)] = item;
+    tail_.store(tail + 1, std::memory_order_release);
+    if (used + 1 > highWater_.load(std::memory_order_relaxed)) highWater_.store(used + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Consumer side.
+  bool pop(T &out) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t tail = tail_.load(std::memory_order_acquire);
+    if (head == tail) return false;
+    out = items_[head & (Capacity - 1)];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  uint32_t size() const { return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire); }
+  uint32_t capacity() const { return Capacity; }
+  uint32_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+  uint32_t highWater() const { return highWater_.load(std::memory_order_relaxed); }
+
+private:
+  T items_[Capacity];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+  std::atomic<uint32_t> overflows_{0}; // written by the producer only
+  std::atomic<uint32_t> highWater_{0}; // written by the producer only
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "power_schedule_core.h"
+
+// One retained document with what a subscriber needs about every relay,
+// tagged with a version that changes whenever any relay's part does:
+//
+//   {"version":"9f1c02ab","relays":{"1":{"state":"ON","ack":"OK","rules":3,
+//    "schedule":"5d41c0f2"},"2":{"state":null,"ack":null,"rules":0,
+//    "schedule":"050c5d1f"}}}
+//
+// "schedule" is scheduleHash() of the active table: the rules themselves stay
+// on relay/<n>/schedule/current, so the document stays small enough for the
+// client's receive buffer at any relay and rule count. Each relay's segment
+// is rendered when that relay changes and kept; the document is only the
+// cached segments joined.
+static const uint8_t SNAPSHOT_STATE_UNKNOWN = 0xFF;
+
+enum SnapshotAck : uint8_t {
+  SNAPSHOT_ACK_NONE = 0, // nothing sent since boot
+  SNAPSHOT_ACK_PENDING,
+  SNAPSHOT_ACK_OK,
+  SNAPSHOT_ACK_ERROR,
+};
+
+// Payload of schedule/slave/ack for a status ("" for SNAPSHOT_ACK_NONE).
+const char *snapshotAckName(uint8_t ack);
+
+struct SnapshotRelay {
+  uint8_t state; // 0, 1 or SNAPSHOT_STATE_UNKNOWN
+  uint8_t ack;   // SnapshotAck
+  uint16_t rules;
+  uint32_t scheduleHash;
+};
+
+static const size_t SNAPSHOT_SEGMENT_MAX = 80;
+static const size_t POWER_SNAPSHOT_JSON_MAX = 40 + POWER_RELAY_COUNT * SNAPSHOT_SEGMENT_MAX;
+
+class StateSnapshot {
+public:
+  // Every relay starts unknown, no ack, empty schedule.
+  StateSnapshot();
+
+  // relay is 1..POWER_RELAY_COUNT. Returns true (and re-renders that relay
+  // only) when anything changed.
+  bool update(uint8_t relay, const SnapshotRelay &r);
+  const SnapshotRelay &relay(uint8_t relay) const { return relays_[relay - 1]; }
+
+  uint32_t version() const { return version_; }
+  // The whole document, NUL-terminated; 0 when cap is too small.
+  size_t write(char *buf, size_t cap) const;
+  // Segments rendered so far, including the initial ones.
+  uint32_t segmentBuilds() const { return segmentBuilds_; }
+
+  // The version of a document, without parsing the rest of it.
+  static bool parseVersion(const char *payload, size_t len, uint32_t &version);
+
+private:
+  void render(uint8_t idx);
+
+  SnapshotRelay relays_[POWER_RELAY_COUNT];
+  char segments_[POWER_RELAY_COUNT][SNAPSHOT_SEGMENT_MAX];
+  uint8_t segmentLen_[POWER_RELAY_COUNT];
+  uint32_t segmentHash_[POWER_RELAY_COUNT];
+  uint32_t version_;
+  uint32_t segmentBuilds_;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Channels of a slave TelemetryPacket, stored as scaled int16:
+// temperature and humidity in tenths, soil and battery in %, relay and
+// presence bits as 0/100 so a window mean reads as duty cycle in %.
+enum TelemetryChannel : uint8_t {
+  TELEM_TEMP = 0,
+  TELEM_HUM,
+  TELEM_SOIL,
+  TELEM_BATT,
+  TELEM_R1,
+  TELEM_R2,
+  TELEM_R3,
+  TELEM_PRESENCE,
+  TELEM_CHANNELS
+};
+
+static const int16_t TELEM_MISSING = -32768; // channel not reported (e.g. NaN)
+
+static const uint8_t TELEM_WINDOWS = 3;
+static const uint32_t TELEM_WINDOW_MS[TELEM_WINDOWS] = {10000, 60000, 900000};
+static const char *const TELEM_WINDOW_NAME[TELEM_WINDOWS] = {"10s", "1m", "15m"};
+// Closed buckets published together per window: one message per minute,
+// every 5 minutes and every 15 minutes respectively.
+static const uint8_t TELEM_PUBLISH_BATCH[TELEM_WINDOWS] = {6, 5, 1};
+static const uint8_t TELEM_HISTORY = 6; // closed buckets kept per window, >= batch
+
+// {"window":"15m","buckets":[...]} with, per bucket,
+// {"ago":N,"n":N,"t":[min,mean,max],...} for every channel.
+static const size_t TELEM_JSON_MAX = 32 + TELEM_HISTORY * (28 + TELEM_CHANNELS * 30);
+
+struct TelemetrySample {
+  int16_t v[TELEM_CHANNELS];
+};
+
+struct TelemetryStats {
+  uint16_t n; // samples with this channel present; 0 = no data
+  int16_t min;
+  int16_t max;
+  int16_t mean;
+};
+
+// Min/max/mean of one slave's telemetry over fixed windows aligned to
+// multiples of the window length. Each window keeps an open accumulator and a
+// ring of closed buckets stored channel-major (struct of arrays), so adding a
+// sample or rendering a batch touches contiguous rows.
+class TelemetrySeries {
+public:
+  TelemetrySeries();
+
+  void reset();
+  void add(const TelemetrySample &sample, uint32_t nowMs);
+  // Closes buckets whose window has ended even if no sample arrived since.
+  void tick(uint32_t nowMs);
+
+  // Closed buckets not yet published (capped at TELEM_HISTORY).
+  uint8_t pending(uint8_t window) const { return windows_[window].unpublished; }
+  uint8_t closed(uint8_t window) const { return windows_[window].count; }
+  // age 0 = most recently closed bucket.
+  TelemetryStats stats(uint8_t window, uint8_t age, uint8_t channel) const;
+  uint32_t bucketStartMs(uint8_t window, uint8_t age) const;
+
+  // Renders the pending buckets, oldest first. Returns the length (NUL
+  // terminated) or 0 when nothing is pending or cap is too small.
+  size_t writeJson(uint8_t window, uint32_t nowMs, char *buf, size_t cap) const;
+  void markPublished(uint8_t window) { windows_[window].unpublished = 0; }
+
+private:
+  struct Window {
+    bool open;
+    uint32_t openStartMs;
+    uint16_t accN[TELEM_CHANNELS];
+    int32_t accSum[TELEM_CHANNELS];
+    int16_t accMin[TELEM_CHANNELS];
+    int16_t accMax[TELEM_CHANNELS];
+
+    uint32_t startMs[TELEM_HISTORY];
+    uint16_t n[TELEM_CHANNELS][TELEM_HISTORY];
+    int16_t min[TELEM_CHANNELS][TELEM_HISTORY];
+    int16_t max[TELEM_CHANNELS][TELEM_HISTORY];
+    int16_t mean[TELEM_CHANNELS][TELEM_HISTORY];
+    uint8_t head; // next slot to write
+    uint8_t count;
+    uint8_t unpublished;
+  };
+
+  void closeBucket(Window &w);
+  uint8_t slot(const Window &w, uint8_t age) const;
+
+  Window windows_[TELEM_WINDOWS];
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "packet_registry.h"
+
+// Time sync v2: the slave asks, the master answers with its clock and the wall
+// clock, NTP style. With
+//   t1 request sent (slave clock)    t2 request received (master clock)
+//   t3 response sent (master clock)  t4 response received (slave clock)
+// offset = ((t2 - t1) + (t3 - t4)) / 2 maps slave time to master time and
+// delay = (t4 - t1) - (t3 - t2) is the round trip on air. The wall clock at
+// t3 then gives the slave sub-second time. Each request also carries t1/t4 of
+// the previous exchange, so the master tracks every peer's offset and skew
+// with the same estimator.
+static const uint8_t TIME_SYNC_REQUEST_TYPE = 22;
+static const uint8_t TIME_SYNC_RESPONSE_TYPE = 23;
+
+#pragma pack(push, 1)
+struct TimeSyncRequestPacket {
+  uint8_t type;    // 22
+  uint8_t seq;     // echoed in the response, never 0
+  uint8_t reserved[2];
+  uint32_t t1;     // slave millis at send
+  uint32_t prevT1; // previous answered exchange, both 0 when none
+  uint32_t prevT4;
+};
+
+// Also broadcast periodically with seq 0 and t1 = t2 = t3: no delay
+// compensation, enough for a slave that has not asked yet.
+struct TimeSyncResponsePacket {
+  uint8_t type;         // 23
+  uint8_t seq;
+  uint8_t valid;        // 1 when the wall-clock fields are set
+  uint8_t reserved;
+  uint32_t t1;          // echoed
+  uint32_t t2;          // master millis at request arrival
+  uint32_t t3;          // master millis at send
+  uint32_t epochSec;    // UTC wall clock at t3
+  uint16_t epochMs;
+  int16_t utcOffsetMin; // local time = UTC + offset (DST included)
+};
+#pragma pack(pop)
+
+EVE_PACKET(TimeSyncRequestPacket, TIME_SYNC_REQUEST_TYPE, 16);
+EVE_PACKET_FIELD(TimeSyncRequestPacket, t1, 4);
+EVE_PACKET_FIELD(TimeSyncRequestPacket, prevT4, 12);
+EVE_PACKET(TimeSyncResponsePacket, TIME_SYNC_RESPONSE_TYPE, 24);
+EVE_PACKET_FIELD(TimeSyncResponsePacket, t1, 4);
+EVE_PACKET_FIELD(TimeSyncResponsePacket, epochSec, 16);
+EVE_PACKET_FIELD(TimeSyncResponsePacket, utcOffsetMin, 22);
+
+static const uint8_t TIME_SYNC_WINDOW = 8;
+// Skew is measured between filtered offsets at least this far apart; the
+// anchor moves up once they are TIME_SYNC_SKEW_MAX_SPAN_MS apart.
+static const uint32_t TIME_SYNC_SKEW_MIN_SPAN_MS = 60000;
+static const uint32_t TIME_SYNC_SKEW_MAX_SPAN_MS = 30UL * 60UL * 1000UL;
+
+// Offset and delay from the exchanges of one client (the side sending t1/t4)
+// against one server. Keeps the last TIME_SYNC_WINDOW samples and trusts the
+// one with the smallest delay (queueing only ever adds delay, and the error of
+// a sample is bounded by half its delay); skew is the drift of that offset
+// over time.
+class TimeSyncEstimator {
+public:
+  TimeSyncEstimator();
+
+  void reset();
+  // Returns false (and ignores the sample) when the timestamps are not
+  // causal, i.e. the delay would be negative.
+  bool sample(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4);
+
+  bool valid() const { return count_ > 0; }
+  // server - client in ms, of the best sample in the window.
+  int32_t offsetMs() const;
+  uint32_t delayMs() const;
+  // Client clock rate against the server's: positive when the client runs slow.
+  int32_t skewPpm() const { return skewPpm_; }
+  uint32_t samples() const { return samples_; }
+  // Client millis to server millis, with skew applied since the best sample.
+  uint32_t toServer(uint32_t clientMs) const;
+
+private:
+  struct Sample {
+    int32_t offsetMs;
+    uint32_t delayMs;
+    uint32_t atMs; // client time of the sample (t4)
+  };
+
+  const Sample &best() const;
+
+  Sample window_[TIME_SYNC_WINDOW];
+  uint8_t count_;
+  uint8_t next_;
+  bool anchored_;
+  Sample anchor_;
+  int32_t skewPpm_;
+  uint32_t samples_;
+};
+
+static const uint32_t TIME_SYNC_WEEK_MS = 7UL * 24UL * 3600UL * 1000UL;
+
+// Milliseconds since local Monday 00:00 for a UTC wall-clock time.
+uint32_t localWeekMs(uint32_t epochSec, uint16_t ms, int16_t utcOffsetMin);
+// How late (negative: early) an action at localWeekMs(...) ran against the
+// start of the scheduled minute, wrapped into half a week either side.
+int32_t executionLagMs(uint32_t actualWeekMs, uint8_t weekdayMon0, uint16_t minuteOfDay);
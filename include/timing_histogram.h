@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bucket 0 holds 0 us, bucket k >= 1 holds [2^(k-1), 2^k) us; the last bucket
+// also takes everything above (about 4 s).
+static const uint8_t TIMING_BUCKETS = 24;
+
+typedef uint32_t (*TimingClock)();
+
+// Fixed-size log2 histogram of durations in microseconds.
+class TimingHistogram {
+public:
+  TimingHistogram() { reset(); }
+
+  void reset();
+  void record(uint32_t us) {
+    uint8_t b = us == 0 ? 0 : (uint8_t)(32 - __builtin_clz(us));
+    if (b >= TIMING_BUCKETS) b = TIMING_BUCKETS - 1;
+    buckets_[b]++;
+    count_++;
+    sumUs_ += us;
+    if (us > maxUs_) maxUs_ = us;
+  }
+
+  uint32_t count() const { return count_; }
+  uint32_t maxUs() const { return maxUs_; }
+  uint32_t meanUs() const { return count_ ? (uint32_t)(sumUs_ / count_) : 0; }
+  uint32_t bucket(uint8_t b) const { return buckets_[b]; }
+  // Exclusive upper edge of bucket b in us.
+  static uint32_t bucketLimitUs(uint8_t b) { return b == 0 ? 1 : (b >= 32 ? UINT32_MAX : 1u << b); }
+  // Upper edge of the bucket holding the given percentile (0..100), capped at
+  // the observed maximum.
+  uint32_t percentileUs(uint8_t pct) const;
+
+  // {"n":N,"mean_us":N,"p50_us":N,"p99_us":N,"max_us":N}; 0 if cap is too small.
+  size_t writeJson(char *buf, size_t cap) const;
+
+private:
+  uint32_t buckets_[TIMING_BUCKETS];
+  uint32_t count_;
+  uint64_t sumUs_;
+  uint32_t maxUs_;
+};
+
+// Records the time between construction and destruction.
+class ScopedTiming {
+public:
+  ScopedTiming(TimingHistogram &h, TimingClock clock) : h_(h), clock_(clock), start_(clock()) {}
+  ~ScopedTiming() { h_.record(clock_() - start_); }
+
+  ScopedTiming(const ScopedTiming &) = delete;
+  ScopedTiming &operator=(const ScopedTiming &) = delete;
+
+private:
+  TimingHistogram &h_;
+  TimingClock clock_;
+  uint32_t start_;
+};
@@ -0,0 +1,125 @@
+#include "damage_tracker.h"
+
+#include <string.h>
+
+namespace {
+
+const uint32_t FNV_OFFSET = 2166136261u;
+const uint32_t FNV_PRIME = 16777619u;
+
+int16_t clampInt(int32_t v, int32_t lo, int32_t hi) {
+  if (v < lo) return (int16_t)lo;
+  if (v > hi) return (int16_t)hi;
+  return (int16_t)v;
+}
+
+} // namespace
+
+DamageTracker::DamageTracker(uint16_t width, uint16_t height) : forceAll_(true), lastBytes_(0) {
+  if (width > DAMAGE_TILE_SIZE * DAMAGE_MAX_TILES_X) width = DAMAGE_TILE_SIZE * DAMAGE_MAX_TILES_X;
+  if (height > DAMAGE_TILE_SIZE * DAMAGE_MAX_TILES_Y) height = DAMAGE_TILE_SIZE * DAMAGE_MAX_TILES_Y;
+  width_ = width;
+  height_ = height;
+  tilesX_ = (uint8_t)((width + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE);
+  tilesY_ = (uint8_t)((height + DAMAGE_TILE_SIZE - 1) / DAMAGE_TILE_SIZE);
+  memset(touched_, 0, sizeof(touched_));
+  memset(previous_, 0, sizeof(previous_));
+  memset(hash_, 0, sizeof(hash_));
+}
+
+void DamageTracker::markRect(int16_t x, int16_t y, int16_t w, int16_t h) {
+  if (w <= 0 || h <= 0) return;
+  int16_t x0 = clampInt(x, 0, width_);
+  int16_t y0 = clampInt(y, 0, height_);
+  int16_t x1 = clampInt((int32_t)x + w, 0, width_);
+  int16_t y1 = clampInt((int32_t)y + h, 0, height_);
+  if (x0 >= x1 || y0 >= y1) return;
+
+  uint8_t tx0 = x0 / DAMAGE_TILE_SIZE, tx1 = (x1 - 1) / DAMAGE_TILE_SIZE;
+  uint8_t ty0 = y0 / DAMAGE_TILE_SIZE, ty1 = (y1 - 1) / DAMAGE_TILE_SIZE;
+  uint16_t bits = (uint16_t)(((1u << (tx1 + 1)) - 1) & ~((1u << tx0) - 1));
+  for (uint8_t ty = ty0; ty <= ty1; ty++) touched_[ty] |= bits;
+}
+
+void DamageTracker::markPixel(int16_t x, int16_t y) {
+  if (x < 0 || y < 0 || x >= width_ || y >= height_) return;
+  touched_[y / DAMAGE_TILE_SIZE] |= (uint16_t)(1u << (x / DAMAGE_TILE_SIZE));
+}
+
+uint32_t DamageTracker::tileHash(const void *fb, uint8_t bitsPerPixel, uint8_t tx, uint8_t ty) const {
+  uint16_t x0 = tx * DAMAGE_TILE_SIZE;
+  uint16_t y0 = ty * DAMAGE_TILE_SIZE;
+  uint16_t x1 = (x0 + DAMAGE_TILE_SIZE < width_) ? x0 + DAMAGE_TILE_SIZE : width_;
+  uint16_t y1 = (y0 + DAMAGE_TILE_SIZE < height_) ? y0 + DAMAGE_TILE_SIZE : height_;
+  uint32_t h = FNV_OFFSET;
+  if (bitsPerPixel == 16) {
+    for (uint16_t y = y0; y < y1; y++) {
+      const uint16_t *row = (const uint16_t *)fb + (uint32_t)y * width_;
+      for (uint16_t x = x0; x < x1; x++) h = (h ^ row[x]) * FNV_PRIME;
+    }
+    return h;
+  }
+  // Tiles start on a byte boundary at any depth up to 8 bpp (16 px * bpp is
+  // a whole number of bytes); a partial last byte also hashes the row padding,
+  // which drawing never touches.
+  uint32_t stride = ((uint32_t)width_ * bitsPerPixel + 7) / 8;
+  uint32_t b0 = (uint32_t)x0 * bitsPerPixel / 8;
+  uint32_t b1 = ((uint32_t)x1 * bitsPerPixel + 7) / 8;
+  for (uint16_t y = y0; y < y1; y++) {
+    const uint8_t *row = (const uint8_t *)fb + y * stride;
+    for (uint32_t b = b0; b < b1; b++) h = (h ^ row[b]) * FNV_PRIME;
+  }
+  return h;
+}
+
+uint16_t DamageTracker::collect(const void *fb, uint8_t bitsPerPixel) {
+  const uint16_t allTiles = (uint16_t)((1u << tilesX_) - 1);
+  int16_t openAt[DAMAGE_MAX_TILES_X];
+  int16_t nextOpen[DAMAGE_MAX_TILES_X];
+  for (uint8_t i = 0; i < DAMAGE_MAX_TILES_X; i++) openAt[i] = -1;
+
+  uint16_t n = 0;
+  lastBytes_ = 0;
+  for (uint8_t ty = 0; ty < tilesY_; ty++) {
+    uint16_t candidates = forceAll_ ? allTiles : (uint16_t)(touched_[ty] | previous_[ty]);
+    uint16_t dirty = 0;
+    for (uint8_t tx = 0; tx < tilesX_; tx++) {
+      if (!((candidates >> tx) & 1)) continue;
+      uint32_t h = tileHash(fb, bitsPerPixel, tx, ty);
+      if (forceAll_ || h != hash_[ty][tx]) dirty |= (uint16_t)(1u << tx);
+      hash_[ty][tx] = h;
+    }
+
+    for (uint8_t i = 0; i < DAMAGE_MAX_TILES_X; i++) nextOpen[i] = -1;
+    uint16_t y = ty * DAMAGE_TILE_SIZE;
+    uint16_t h = (y + DAMAGE_TILE_SIZE < height_) ? DAMAGE_TILE_SIZE : height_ - y;
+    uint8_t tx = 0;
+    while (tx < tilesX_) {
+      if (!((dirty >> tx) & 1)) {
+        tx++;
+        continue;
+      }
+      uint8_t start = tx;
+      while (tx < tilesX_ && ((dirty >> tx) & 1)) tx++;
+      uint16_t x = start * DAMAGE_TILE_SIZE;
+      uint16_t w = ((tx * DAMAGE_TILE_SIZE < width_) ? tx * DAMAGE_TILE_SIZE : width_) - x;
+
+      // Same column span as a window ending on the row above: grow it downwards.
+      int16_t k = openAt[start];
+      if (k >= 0 && rects_[k].w == w) {
+        rects_[k].h += h;
+      } else {
+        k = (int16_t)n++;
+        rects_[k] = DamageRect{x, y, w, h};
+      }
+      nextOpen[start] = k;
+      lastBytes_ += (uint32_t)w * h * 2;
+    }
+    memcpy(openAt, nextOpen, sizeof(openAt));
+  }
+
+  memcpy(previous_, touched_, sizeof(previous_));
+  memset(touched_, 0, sizeof(touched_));
+  forceAll_ = false;
+  return n;
+}
@@ -0,0 +1,147 @@
+#include "event_scheduler.h"
+
+#include <string.h>
+
+EventScheduler::EventScheduler() : size_(0), seq_(0) {
+  memset(timers_, 0, sizeof(timers_));
+  for (uint8_t i = 0; i < EVENT_SCHEDULER_CAPACITY; i++) {
+    timers_[i].heapPos = -1;
+    heap_[i] = -1;
+  }
+}
+
+int8_t EventScheduler::add(EventCallback cb, void *ctx, uint32_t periodMs) {
+  if (cb == nullptr) return -1;
+  for (uint8_t i = 0; i < EVENT_SCHEDULER_CAPACITY; i++) {
+    Timer &t = timers_[i];
+    if (t.used) continue;
+    t.used = true;
+    t.heapPos = -1;
+    t.due = 0;
+    t.period = periodMs;
+    t.seq = 0;
+    t.cb = cb;
+    t.ctx = ctx;
+    return (int8_t)i;
+  }
+  return -1;
+}
+
+int8_t EventScheduler::every(EventCallback cb, void *ctx, uint32_t periodMs, uint32_t nowMs) {
+  int8_t id = add(cb, ctx, periodMs);
+  if (id >= 0) armAt(id, nowMs + periodMs);
+  return id;
+}
+
+bool EventScheduler::remove(int8_t id) {
+  if (!valid(id)) return false;
+  disarm(id);
+  timers_[id].used = false;
+  return true;
+}
+
+bool EventScheduler::before(int8_t a, int8_t b) const {
+  const Timer &ta = timers_[a];
+  const Timer &tb = timers_[b];
+  if (ta.due != tb.due) return (int32_t)(ta.due - tb.due) < 0;
+  return (int32_t)(ta.seq - tb.seq) < 0;
+}
+
+void EventScheduler::place(uint8_t pos, int8_t id) {
+  heap_[pos] = id;
+  timers_[id].heapPos = (int8_t)pos;
+}
+
+void EventScheduler::siftUp(uint8_t pos) {
+  int8_t id = heap_[pos];
+  while (pos > 0) {
+    uint8_t parent = (uint8_t)((pos - 1) / 2);
+    if (!before(id, heap_[parent])) break;
+    place(pos, heap_[parent]);
+    pos = parent;
+  }
+  place(pos, id);
+}
+
+void EventScheduler::siftDown(uint8_t pos) {
+  int8_t id = heap_[pos];
+  for (;;) {
+    uint8_t child = (uint8_t)(2 * pos + 1);
+    if (child >= size_) break;
+    if (child + 1 < size_ && before(heap_[child + 1], heap_[child])) child++;
+    if (!before(heap_[child], id)) break;
+    place(pos, heap_[child]);
+    pos = child;
+  }
+  place(pos, id);
+}
+
+void EventScheduler::heapRemove(uint8_t pos) {
+  int8_t id = heap_[pos];
+  timers_[id].heapPos = -1;
+  size_--;
+  if (pos == size_) {
+    heap_[pos] = -1;
+    return;
+  }
+  int8_t moved = heap_[size_];
+  heap_[size_] = -1;
+  place(pos, moved);
+  siftDown(pos);
+  siftUp((uint8_t)timers_[moved].heapPos);
+}
+
+bool EventScheduler::armAt(int8_t id, uint32_t dueMs) {
+  if (!valid(id)) return false;
+  Timer &t = timers_[id];
+  t.due = dueMs;
+  t.seq = seq_++;
+  if (t.heapPos < 0) {
+    place(size_++, id);
+    siftUp((uint8_t)(size_ - 1));
+  } else {
+    siftUp((uint8_t)t.heapPos);
+    siftDown((uint8_t)t.heapPos);
+  }
+  return true;
+}
+
+bool EventScheduler::armNoLaterThan(int8_t id, uint32_t dueMs) {
+  if (!valid(id)) return false;
+  if (timers_[id].heapPos >= 0 && (int32_t)(timers_[id].due - dueMs) <= 0) return true;
+  return armAt(id, dueMs);
+}
+
+void EventScheduler::disarm(int8_t id) {
+  if (!valid(id) || timers_[id].heapPos < 0) return;
+  heapRemove((uint8_t)timers_[id].heapPos);
+}
+
+bool EventScheduler::armed(int8_t id) const { return valid(id) && timers_[id].heapPos >= 0; }
+
+uint32_t EventScheduler::dueAt(int8_t id) const { return valid(id) ? timers_[id].due : 0; }
+
+uint8_t EventScheduler::run(uint32_t nowMs) {
+  uint8_t ran = 0;
+  // Bounded so a callback that keeps re-arming itself in the past cannot spin.
+  for (uint16_t guard = 0; size_ > 0 && guard < 4 * EVENT_SCHEDULER_CAPACITY; guard++) {
+    int8_t id = heap_[0];
+    Timer &t = timers_[id];
+    if ((int32_t)(nowMs - t.due) < 0) break;
+    if (t.period > 0) {
+      uint32_t missed = (nowMs - t.due) / t.period;
+      armAt(id, t.due + (missed + 1) * t.period);
+    } else {
+      heapRemove(0);
+    }
+    t.cb(t.ctx);
+    ran++;
+  }
+  return ran;
+}
+
+uint32_t EventScheduler::msUntilNext(uint32_t nowMs) const {
+  if (size_ == 0) return EVENT_NO_DEADLINE;
+  int32_t d = (int32_t)(timers_[heap_[0]].due - nowMs);
+  return d > 0 ? (uint32_t)d : 0;
+}
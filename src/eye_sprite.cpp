@@ -0,0 +1,259 @@
+#include "eye_sprite.h"
+
+#include <string.h>
+
+namespace {
+
+// Adafruit_GFX::fillRoundRect and fillCircleHelper, emitting the center rect
+// and the corner columns to a sink instead of drawing them.
+template <typename Sink>
+void roundRectPrimitives(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, Sink &sink) {
+  int16_t maxRadius = ((w < h) ? w : h) / 2;
+  if (r > maxRadius) r = maxRadius;
+  sink.rect(x + r, y, w - 2 * r, h);
+
+  int16_t delta = h - 2 * r - 1;
+  int16_t rightX0 = x + w - r - 1, leftX0 = x + r, y0 = y + r;
+  int16_t f = 1 - r;
+  int16_t ddFx = 1;
+  int16_t ddFy = -2 * r;
+  int16_t cx = 0;
+  int16_t cy = r;
+  int16_t py = cy;
+  delta++;
+  while (cx < cy) {
+    if (f >= 0) {
+      cy--;
+      ddFy += 2;
+      f += ddFy;
+    }
+    cx++;
+    ddFx += 2;
+    f += ddFx;
+    if (cx < (cy + 1)) {
+      sink.vline(rightX0 + cx, y0 - cy, 2 * cy + delta);
+      sink.vline(leftX0 - cx, y0 - cy, 2 * cy + delta);
+    }
+    if (cy != py) {
+      sink.vline(rightX0 + py, y0 - cx, 2 * cx + delta);
+      sink.vline(leftX0 - py, y0 - cx, 2 * cx + delta);
+      py = cy;
+    }
+  }
+}
+
+// What TrackedCanvas16 does with those primitives: fillRect goes through
+// Adafruit_GFX::fillRect (one drawFastVLine per column), drawFastVLine clips
+// like GFXcanvas16.
+struct CanvasSink {
+  uint16_t *fb;
+  uint16_t fbW;
+  uint16_t fbH;
+  DamageTracker *damage;
+  uint16_t color;
+
+  void rect(int16_t x, int16_t y, int16_t w, int16_t h) {
+    if (damage != nullptr) damage->markRect(x, y, w, h);
+    for (int16_t i = x; i < x + w; i++) vline(i, y, h);
+  }
+
+  void vline(int16_t x, int16_t y, int16_t h) {
+    if (h < 0) {
+      y += h + 1;
+      h = -h;
+    }
+    if (damage != nullptr) damage->markRect(x, y, 1, h);
+    if (x < 0 || x >= fbW || y >= fbH || y + h - 1 < 0) return;
+    if (y < 0) {
+      h += y;
+      y = 0;
+    }
+    if (y + h > fbH) h = fbH - y;
+    uint16_t *p = fb + (uint32_t)y * fbW + x;
+    for (int16_t i = 0; i < h; i++, p += fbW) *p = color;
+  }
+};
+
+// Collects which columns of one row a shape drawn at (0, 0) covers. The corner
+// columns fillCircleHelper skips to avoid double drawing can leave holes, so a
+// row is not always a single run.
+struct RowSink {
+  int16_t row;
+  int16_t w;
+  bool covered[256];
+
+  void rect(int16_t x, int16_t y, int16_t ww, int16_t h) {
+    for (int16_t i = x; i < x + ww; i++) vline(i, y, h);
+  }
+
+  void vline(int16_t x, int16_t y, int16_t h) {
+    if (row >= y && row < y + h && x >= 0 && x < w) covered[x] = true;
+  }
+};
+
+// Emits the runs of each row followed by an end-of-row marker (w == 0);
+// returns how many spans that takes, writing them only while out has room.
+uint32_t encodeRows(uint8_t w, uint8_t h, uint8_t r, EyeSpan *out, uint32_t room) {
+  uint32_t n = 0;
+  RowSink sink;
+  sink.w = w;
+  for (int16_t row = 0; row < h; row++) {
+    sink.row = row;
+    memset(sink.covered, 0, sizeof(sink.covered));
+    roundRectPrimitives(0, 0, w, h, r, sink);
+    for (int16_t x = 0; x < w;) {
+      if (!sink.covered[x]) {
+        x++;
+        continue;
+      }
+      int16_t start = x;
+      while (x < w && sink.covered[x]) x++;
+      if (n < room) out[n] = EyeSpan{(uint8_t)start, (uint8_t)(x - start)};
+      n++;
+    }
+    if (n < room) out[n] = EyeSpan{0, 0};
+    n++;
+  }
+  return n;
+}
+
+// Two pixels per 32-bit store once aligned: half the stores of a pixel loop
+// on the ESP32-C3, which has no wider ones.
+inline void fillRun(uint16_t *p, int16_t n, uint16_t color) {
+  if (n <= 0) return;
+  if ((uintptr_t)p & 2) {
+    *p++ = color;
+    n--;
+  }
+  uint32_t pair = ((uint32_t)color << 16) | color;
+  for (; n >= 2; n -= 2, p += 2) memcpy(p, &pair, sizeof(pair));
+  if (n > 0) *p = color;
+}
+
+struct Rgb565Fill {
+  uint16_t *fb;
+  uint16_t fbW;
+  uint16_t color;
+  void operator()(int16_t x, int16_t y, int16_t w) { fillRun(fb + (uint32_t)y * fbW + x, w, color); }
+};
+
+struct CallbackFill {
+  EyeSpanFill fill;
+  void *ctx;
+  void operator()(int16_t x, int16_t y, int16_t w) { fill(ctx, x, y, w); }
+};
+
+float levelHeight(uint8_t eyeH, uint8_t level, uint8_t levels) {
+  float open = 1.0f - (float)level / (float)(levels - 1);
+  return (float)eyeH * open;
+}
+
+} // namespace
+
+void fillRoundRectInto(uint16_t *fb, uint16_t fbW, uint16_t fbH, DamageTracker *damage, int16_t x, int16_t y,
+                       int16_t w, int16_t h, int16_t r, uint16_t color) {
+  CanvasSink sink{fb, fbW, fbH, damage, color};
+  roundRectPrimitives(x, y, w, h, r, sink);
+}
+
+EyeSpriteCache::EyeSpriteCache(EyeSpan *spans, uint16_t capacity)
+    : spans_(spans), capacity_(capacity), used_(0), levels_(0) {
+  memset(white_, 0, sizeof(white_));
+  memset(&pupil_, 0, sizeof(pupil_));
+}
+
+uint16_t EyeSpriteCache::spansNeeded(uint8_t eyeW, uint8_t eyeH, uint8_t blinkLevels, uint8_t pupilW, uint8_t pupilH,
+                                     uint8_t pupilR) {
+  if (blinkLevels < 2 || blinkLevels > EYE_SPRITE_MAX_LEVELS) return 0;
+  uint32_t n = encodeRows(pupilW, pupilH, pupilR, nullptr, 0);
+  for (uint8_t k = 0; k < blinkLevels; k++) n += encodeRows(eyeW, (uint8_t)levelHeight(eyeH, k, blinkLevels), eyeW / 2, nullptr, 0);
+  return n > 0xFFFF ? 0xFFFF : (uint16_t)n;
+}
+
+bool EyeSpriteCache::rasterize(Sprite &s, uint8_t w, uint8_t h, uint8_t r) {
+  uint32_t n = encodeRows(w, h, r, spans_ + used_, capacity_ - used_);
+  if (used_ + n > capacity_) return false;
+  s.first = used_;
+  s.w = w;
+  s.h = h;
+  used_ = (uint16_t)(used_ + n);
+  return true;
+}
+
+bool EyeSpriteCache::build(uint8_t eyeW, uint8_t eyeH, uint8_t blinkLevels, uint8_t pupilW, uint8_t pupilH,
+                           uint8_t pupilR) {
+  used_ = 0;
+  levels_ = 0;
+  if (blinkLevels < 2 || blinkLevels > EYE_SPRITE_MAX_LEVELS) return false;
+  for (uint8_t k = 0; k < blinkLevels; k++) {
+    float eh = levelHeight(eyeH, k, blinkLevels);
+    if (!rasterize(white_[k], eyeW, (uint8_t)eh, eyeW / 2)) return false;
+    white_[k].eh = eh;
+  }
+  if (!rasterize(pupil_, pupilW, pupilH, pupilR)) return false;
+  pupil_.eh = pupilH;
+  levels_ = blinkLevels;
+  return true;
+}
+
+uint8_t EyeSpriteCache::levelFor(float blinkAmt) const {
+  if (levels_ == 0 || !(blinkAmt > 0.0f)) return 0;
+  if (blinkAmt >= 1.0f) return (uint8_t)(levels_ - 1);
+  return (uint8_t)(blinkAmt * (float)(levels_ - 1) + 0.5f);
+}
+
+template <typename Fill>
+void EyeSpriteCache::blit(Fill &fill, uint16_t fbW, uint16_t fbH, DamageTracker *damage, const Sprite &s, int16_t x,
+                          int16_t y) const {
+  if (damage != nullptr) damage->markRect(x, y, s.w, s.h);
+  const EyeSpan *span = spans_ + s.first;
+  for (int16_t row = 0; row < s.h; row++, span++) {
+    int16_t yy = y + row;
+    if (yy < 0 || yy >= fbH) {
+      while (span->w != 0) span++;
+      continue;
+    }
+    for (; span->w != 0; span++) {
+      int16_t x0 = x + span->x;
+      int16_t x1 = x0 + span->w;
+      if (x0 < 0) x0 = 0;
+      if (x1 > fbW) x1 = fbW;
+      if (x0 < x1) fill(x0, yy, x1 - x0);
+    }
+  }
+}
+
+void EyeSpriteCache::drawWhite(uint16_t *fb, uint16_t fbW, uint16_t fbH, DamageTracker *damage, float cx, float cy,
+                               uint8_t level, uint16_t color) const {
+  if (level >= levels_) return;
+  const Sprite &s = white_[level];
+  Rgb565Fill fill{fb, fbW, color};
+  blit(fill, fbW, fbH, damage, s, (int16_t)(cx - (float)s.w / 2), (int16_t)(cy - s.eh / 2));
+}
+
+void EyeSpriteCache::drawPupil(uint16_t *fb, uint16_t fbW, uint16_t fbH, DamageTracker *damage, int16_t x, int16_t y,
+                               uint16_t color) const {
+  if (levels_ == 0) return;
+  Rgb565Fill fill{fb, fbW, color};
+  blit(fill, fbW, fbH, damage, pupil_, x, y);
+}
+
+void EyeSpriteCache::drawWhite(EyeSpanFill fill, void *ctx, uint16_t fbW, uint16_t fbH, DamageTracker *damage,
+                               float cx, float cy, uint8_t level) const {
+  if (level >= levels_) return;
+  const Sprite &s = white_[level];
+  CallbackFill cb{fill, ctx};
+  blit(cb, fbW, fbH, damage, s, (int16_t)(cx - (float)s.w / 2), (int16_t)(cy - s.eh / 2));
+}
+
+void EyeSpriteCache::drawPupil(EyeSpanFill fill, void *ctx, uint16_t fbW, uint16_t fbH, DamageTracker *damage,
+                               int16_t x, int16_t y) const {
+  if (levels_ == 0) return;
+  CallbackFill cb{fill, ctx};
+  blit(cb, fbW, fbH, damage, pupil_, x, y);
+}
+
+size_t EyeSpriteCache::bytesUsed() const {
+  if (levels_ == 0) return 0;
+  return used_ * sizeof(EyeSpan) + (levels_ + 1) * sizeof(Sprite);
+}
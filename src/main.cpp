@@ -3,6 +3,7 @@
 #include <WiFi.h>
 #include <esp_now.h>
 #include <esp_wifi.h>
+#include <sys/time.h>
 #include <time.h>
 #include <Preferences.h>
 #include <PubSubClient.h>
@@ -10,7 +11,16 @@
 #include <Adafruit_GFX.h>
 #include <Adafruit_GC9A01A.h>
 
-#include "power_schedule_core.h"
+#include "damage_tracker.h"
+#include "event_scheduler.h"
+#include "eye_sprite.h"
+#include "paletted_framebuffer.h"
+#include "platform_task.h"
+#include "power_hal.h"
+#include "power_master.h"
+#include "snapshot_channel.h"
+#include "spsc_queue.h"
+#include "timing_histogram.h"
 
 // ================== TFT PINS (ESP32-C3) ==================
 #define PIN_SCK  4
@@ -19,8 +29,78 @@
 #define PIN_DC   10
 #define PIN_RST  1
 
+#if defined(EVE_DISPLAY_PALETTED)
+// Low-memory canvas (build with -D EVE_DISPLAY_PALETTED): 2 bpp with a
+// 4-color palette, 14 KB instead of GFXcanvas16's 115 KB. The scene only uses
+// BLACK, WHITE and BLUE, so the panel sees the same pixels; rows are expanded
+// to RGB565 during the push. Damage is tracked exactly like TrackedCanvas16.
+// Rotation 0 only.
+class TrackedCanvasPaletted : public Adafruit_GFX {
+public:
+  TrackedCanvasPaletted(uint8_t *pixels, uint16_t w, uint16_t h) : Adafruit_GFX(w, h), damage(w, h), fb(pixels, w, h) {}
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (tracking) damage.markPixel(x, y);
+    fb.setPixel(x, y, fb.indexFor(color));
+  }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override {
+    if (h < 0) { y += h + 1; h = -h; }
+    if (tracking) damage.markRect(x, y, 1, h);
+    fb.fillRect(x, y, 1, h, fb.indexFor(color));
+  }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override {
+    if (w < 0) { x += w + 1; w = -w; }
+    if (tracking) damage.markRect(x, y, w, 1);
+    fb.fillSpan(x, y, w, fb.indexFor(color));
+  }
+  // Adafruit_GFX::fillRect draws one drawFastVLine per column, so a negative
+  // height flips like it does there.
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+    if (h < 0) { y += h + 1; h = -h; }
+    if (tracking) damage.markRect(x, y, w, h);
+    fb.fillRect(x, y, w, h, fb.indexFor(color));
+  }
+  void fillScreen(uint16_t color) override { fb.fill(fb.indexFor(color)); }
+
+  DamageTracker damage;
+  PalettedFramebuffer fb;
+  bool tracking = true;
+};
+
+uint8_t canvasPixels[240 * 240 * PALETTE_BITS / 8];
+TrackedCanvasPaletted canvas(canvasPixels, 240, 240);
+#else
+// Canvas that records which tiles each primitive touches, so only the changed
+// windows are pushed over SPI instead of the whole 115 KB frame.
+class TrackedCanvas16 : public GFXcanvas16 {
+public:
+  TrackedCanvas16(uint16_t w, uint16_t h) : GFXcanvas16(w, h), damage(w, h) {}
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (tracking) damage.markPixel(x, y);
+    GFXcanvas16::drawPixel(x, y, color);
+  }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override {
+    if (tracking) { if (h < 0) { y += h + 1; h = -h; } damage.markRect(x, y, 1, h); }
+    GFXcanvas16::drawFastVLine(x, y, h, color);
+  }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override {
+    if (tracking) { if (w < 0) { x += w + 1; w = -w; } damage.markRect(x, y, w, 1); }
+    GFXcanvas16::drawFastHLine(x, y, w, color);
+  }
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) override {
+    if (tracking) damage.markRect(x, y, w, h);
+    GFXcanvas16::fillRect(x, y, w, h, color);
+  }
+
+  DamageTracker damage;
+  bool tracking = true;
+};
+
+TrackedCanvas16 canvas(240, 240);
+#endif
+
 Adafruit_GC9A01A tft(PIN_CS, PIN_DC, PIN_RST);
-GFXcanvas16 canvas(240, 240);
 
 #define BLACK 0x0000
 #define WHITE 0xFFFF
@@ -35,30 +115,95 @@ static const char* MQTT_HOST = "192.168.1.10";
 static const uint16_t MQTT_PORT = 1883;
 static const char* MQTT_CLIENT_ID = "eve-power-master";
 static const uint32_t WIFI_RETRY_MS = 5000;
+// Inbound relay/<n>/schedule/set (up to POWER_SCHEDULE_JSON_MAX), bulk
+// schedule/set or the retained state snapshot read back on reconnect, plus
+// topic; publishes are streamed and not bound by it. Bulk documents are
+// budgeted up to MQTT_BULK_INBOUND_CAP: with large tables a full-house
+// document beyond it is dropped by the client, and the per-relay topics
+// remain the way to send those.
+static const size_t MQTT_BULK_INBOUND_CAP = 4096;
+static const size_t MQTT_BULK_INBOUND_MAX =
+    POWER_BULK_SCHEDULE_JSON_MAX < MQTT_BULK_INBOUND_CAP ? POWER_BULK_SCHEDULE_JSON_MAX : MQTT_BULK_INBOUND_CAP;
+static const size_t MQTT_SINGLE_INBOUND_MAX =
+    POWER_SCHEDULE_JSON_MAX > POWER_SNAPSHOT_JSON_MAX ? POWER_SCHEDULE_JSON_MAX : POWER_SNAPSHOT_JSON_MAX;
+static const size_t MQTT_INBOUND_MAX =
+    MQTT_SINGLE_INBOUND_MAX > MQTT_BULK_INBOUND_MAX ? MQTT_SINGLE_INBOUND_MAX : MQTT_BULK_INBOUND_MAX;
+static const uint16_t MQTT_BUFFER_SIZE = MQTT_INBOUND_MAX + 128 > 768 ? MQTT_INBOUND_MAX + 128 : 768;
+static const uint8_t MQTT_DRAIN_PER_LOOP = 4;
+// loop() sleeps until the next timer or an ESP-NOW frame, but PubSubClient has
+// no event hook: its socket is polled at least this often.
+static const uint32_t LOOP_MAX_WAIT_MS = 10;
+
+// Frames are copied in the WiFi task and handed to PowerMaster in loop(), so
+// MQTT publishes, NVS writes and the peer table stay on one thread. Frames too
+// long for any master-bound packet are passed on empty (the sender is still
+// registered).
+static const uint8_t RX_PAYLOAD_MAX = 32;
+struct RxRecord {
+  uint8_t len;
+  uint8_t mac[6];
+  uint32_t atMs;
+  uint32_t callbackUs; // time spent in onEspNowRecv before the push
+  uint8_t data[RX_PAYLOAD_MAX];
+};
+static_assert(PowerMasterInbound::MAX_SIZE <= RX_PAYLOAD_MAX, "RX_PAYLOAD_MAX too small");
+SpscQueue<RxRecord, 16> rxQueue;
+uint32_t rxOverflowsLogged = 0;
+
+// Delivery reports from the send callback (WiFi task), drained in loop().
+struct TxStatus {
+  uint8_t mac[6];
+  bool ok;
+  uint32_t atMs;
+};
+SpscQueue<TxStatus, 16> txStatusQueue;
+
+// Per-phase timings (micros, log2 buckets), published every 60 s on
+// diag/timing/<phase> and reset; "diag" on the serial console dumps them.
+// render and push are recorded by the render task and copied in on publish.
+enum TimingPhase : uint8_t {
+  PHASE_LOOP = 0, // whole iteration except the idle delay
+  PHASE_RX,
+  PHASE_MQTT,
+  PHASE_SCHEDULE,
+  PHASE_RENDER,
+  PHASE_PUSH,
+  PHASE_IDLE,
+  PHASE_ESPNOW_CB,
+  PHASE_COUNT
+};
+static const char* const PHASE_NAME[PHASE_COUNT] = {"loop", "rx", "mqtt", "schedule", "render", "push", "idle", "espnow_cb"};
+TimingHistogram phaseTiming[PHASE_COUNT];
+
+uint32_t timingNowUs() { return micros(); }
+
+// The display runs in its own task: loop() only handles networking and
+// scheduling and hands the render task a snapshot of what to show. The render
+// task owns canvas, tft and the eye animation state; it sends its timings back
+// the same way. Render and loop() share the single core at equal priority, so
+// an SPI push delays loop() by at most one tick slice instead of a frame.
+static const uint32_t RENDER_FRAME_MS = 16;
+static const uint32_t RENDER_TASK_STACK = 6144;
+static const uint8_t RENDER_TASK_PRIORITY = 1; // same as the Arduino loop task
+static const uint32_t DISPLAY_SNAPSHOT_MS = 20;
+
+struct DisplaySnapshot {
+  TelemetryPacket pkt;
+  uint32_t lastPktAt;
+  uint32_t rxCount;
+  uint8_t peers;
+  bool timeSynced;
+};
+
+struct RenderTimings {
+  TimingHistogram render;
+  TimingHistogram push;
+};
+
+SnapshotChannel<DisplaySnapshot> displayChannel;
+SnapshotChannel<RenderTimings> renderTimingChannel;
+std::atomic<bool> renderTimingReset(false); // set by loop() after publishing
 
-static const uint32_t SCHEDULE_ACK_TIMEOUT_MS = 3000;
-static const uint8_t SCHEDULE_RETRY_MAX = 1;
-
-#pragma pack(push, 1)
-typedef struct {
-  float t;
-  float h;
-  uint8_t soil;
-  uint8_t batt;
-  uint8_t r1, r2, r3;
-  uint8_t presence;
-  uint32_t ms;
-} TelemetryPacket;
-
-typedef struct { uint8_t type; uint8_t ch; uint32_t ms; } HelloPacket;
-typedef struct { uint8_t type; uint16_t minuteOfDay; uint8_t weekdayMon0; uint8_t valid; uint32_t ms; } TimeSyncPacket;
-typedef struct { uint8_t type; uint8_t r1; uint8_t r2; uint8_t r3; uint8_t irrig; uint16_t liveSec; uint32_t ms; } CommandPacket;
-#pragma pack(pop)
-
-volatile bool hasPkt = false;
-TelemetryPacket rx;
-TelemetryPacket viewPkt;
-unsigned long lastPktAt = 0;
 volatile uint32_t rxCount = 0;
 
 struct Eye { float cx, cy; float w, h; };
@@ -71,7 +216,39 @@ uint32_t blinkStart = 0, nextBlink = 0;
 float ease(float t) { return t * t * (3 - 2 * t); }
 void scheduleBlink() { nextBlink = millis() + random(2000, 5000); }
 
+// Eye whites at EYE_BLINK_LEVELS heights and the pupil, rasterized once in
+// setup(); frames are span fills. A 180 ms blink spans ~11 frames, so 16
+// levels are not visibly stepped. Falls back to fillRoundRect if the build
+// fails.
+static const uint8_t EYE_BLINK_LEVELS = 16;
+static const uint16_t EYE_SPAN_CAPACITY = 1664; // 1594 for 70x95 + 36x44 at 16 levels
+EyeSpan eyeSpans[EYE_SPAN_CAPACITY];
+EyeSpriteCache eyeSprites(eyeSpans, EYE_SPAN_CAPACITY);
+
+#if defined(EVE_DISPLAY_PALETTED)
+void fillCanvasSpan(void* ctx, int16_t x, int16_t y, int16_t w) {
+  canvas.fb.fillSpan(x, y, w, *static_cast<uint8_t*>(ctx));
+}
+#endif
+
 void drawEye(const Eye& e, float lx, float ly, float blinkAmt) {
+  if (eyeSprites.ready()) {
+    uint8_t level = eyeSprites.levelFor(blinkAmt);
+    float px = e.cx + lx * 18;
+    float py = e.cy + ly * 12;
+#if defined(EVE_DISPLAY_PALETTED)
+    uint8_t index = canvas.fb.indexFor(BLUE);
+    eyeSprites.drawWhite(fillCanvasSpan, &index, canvas.width(), canvas.height(), &canvas.damage, e.cx, e.cy, level);
+    index = canvas.fb.indexFor(BLACK);
+    eyeSprites.drawPupil(fillCanvasSpan, &index, canvas.width(), canvas.height(), &canvas.damage, (int)(px - 18),
+                         (int)(py - 22));
+#else
+    uint16_t *buf = canvas.getBuffer();
+    eyeSprites.drawWhite(buf, canvas.width(), canvas.height(), &canvas.damage, e.cx, e.cy, level, BLUE);
+    eyeSprites.drawPupil(buf, canvas.width(), canvas.height(), &canvas.damage, (int)(px - 18), (int)(py - 22), BLACK);
+#endif
+    return;
+  }
   float open = 1.0f - blinkAmt;
   float ew = e.w;
   float eh = e.h * open;
@@ -81,191 +258,152 @@ void drawEye(const Eye& e, float lx, float ly, float blinkAmt) {
   canvas.fillRoundRect((int)(px - 18), (int)(py - 22), 36, 44, 18, BLACK);
 }
 
-static const uint8_t MAX_PEERS = 10;
-struct PeerSlot { bool used = false; uint8_t mac[6] = {0}; uint32_t lastSeenMs = 0; };
-PeerSlot peers[MAX_PEERS];
-
-bool macEqual(const uint8_t a[6], const uint8_t b[6]) { for (int i = 0; i < 6; i++) if (a[i] != b[i]) return false; return true; }
-int findPeerSlot(const uint8_t mac[6]) { for (int i = 0; i < MAX_PEERS; i++) if (peers[i].used && macEqual(peers[i].mac, mac)) return i; return -1; }
-int allocPeerSlot(const uint8_t mac[6]) { for (int i = 0; i < MAX_PEERS; i++) if (!peers[i].used) { peers[i].used = true; memcpy(peers[i].mac, mac, 6); peers[i].lastSeenMs = millis(); return i; } return -1; }
-
-bool addPeerIfNeeded(const uint8_t mac[6]) {
-  int idx = findPeerSlot(mac);
-  if (idx >= 0) { peers[idx].lastSeenMs = millis(); return true; }
-  idx = allocPeerSlot(mac);
-  if (idx < 0) return false;
-  esp_now_peer_info_t peer = {};
-  memcpy(peer.peer_addr, mac, 6);
-  peer.channel = ESPNOW_CHANNEL;
-  peer.encrypt = false;
-  esp_now_del_peer(mac);
-  return (esp_now_add_peer(&peer) == ESP_OK);
-}
 
 static const uint8_t BCAST_MAC[6] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
 
 WiFiClient wifiClient;
 PubSubClient mqtt(wifiClient);
 Preferences prefs;
+bool timeSynced = false;
 
-PowerRelaySchedule activeSchedules[3];
-PowerRelaySchedule pendingSchedules[3];
-bool waitingAck[3] = {false,false,false};
-uint8_t retryLeft[3] = {0,0,0};
-uint32_t ackDeadline[3] = {0,0,0};
-uint8_t relayState[3] = {0,0,0};
-
-String topicForRelay(uint8_t relay, const char* suffix) {
-  char b[96];
-  snprintf(b, sizeof(b), "progetto/EVE/POWER/relay/%u/%s", relay, suffix);
-  return String(b);
-}
-
-void mqttPublish(uint8_t relay, const char* suffix, const String &payload, bool retained = false) {
-  mqtt.publish(topicForRelay(relay, suffix).c_str(), payload.c_str(), retained);
-}
+// ---- Device HAL for PowerMaster ----
 
-void persistSchedule(uint8_t relay, const PowerRelaySchedule &s) {
-  prefs.putString((String("schedule_") + relay).c_str(), scheduleToJson(s).c_str());
-}
-
-void loadSchedules() {
-  for (uint8_t r = 1; r <= 3; r++) {
-    std::string err;
-    String raw = prefs.getString((String("schedule_") + r).c_str(), "[]");
-    if (!parseScheduleJson(raw.c_str(), activeSchedules[r-1], err)) activeSchedules[r-1].count = 0;
+class EspNowRadio : public RadioHal {
+public:
+  bool send(const uint8_t mac[6], const uint8_t* data, size_t len) override {
+    return esp_now_send(mac, data, len) == ESP_OK;
   }
-}
-
-void publishRetainedSchedules() {
-  for (uint8_t r = 1; r <= 3; r++) {
-    mqttPublish(r, "schedule/current", scheduleToJson(activeSchedules[r-1]).c_str(), true);
+  bool addPeer(const uint8_t mac[6]) override {
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, mac, 6);
+    peer.channel = ESPNOW_CHANNEL;
+    peer.encrypt = false;
+    esp_now_del_peer(mac);
+    return esp_now_add_peer(&peer) == ESP_OK;
   }
-}
-
-bool sendRulesPacket(uint8_t relay, const PowerRelaySchedule &schedule) {
-  PowerRelayRulesPacket pkt{};
-  if (!buildRulesPacket(relay, schedule, millis(), pkt)) return false;
-  bool sent = false;
-  for (int i = 0; i < MAX_PEERS; i++) {
-    if (!peers[i].used) continue;
-    if (esp_now_send(peers[i].mac, (uint8_t*)&pkt, sizeof(pkt)) == ESP_OK) sent = true;
+  void removePeer(const uint8_t mac[6]) override { esp_now_del_peer(mac); }
+};
+
+class PubSubMqtt : public MqttHal {
+public:
+  bool connected() override { return mqtt.connected(); }
+  // Streamed so retained schedules and telemetry batches are not bound by MQTT_BUFFER_SIZE.
+  bool publish(const char* topic, const uint8_t* payload, size_t len, bool retained) override {
+    if (!mqtt.beginPublish(topic, len, retained)) return false;
+    mqtt.write(payload, len);
+    return mqtt.endPublish();
   }
-  Serial.printf("[SCHEDULE] relay=%u send type14 count=%u sent=%d\n", relay, pkt.count, sent);
-  return sent;
-}
-
-void handleScheduleAck(const PowerScheduleAckPacket &ack) {
-  if (ack.ch < 1 || ack.ch > 3) return;
-  uint8_t idx = ack.ch - 1;
-  if (!waitingAck[idx]) return;
-
-  waitingAck[idx] = false;
-  if (ack.ok == 1) {
-    activeSchedules[idx] = pendingSchedules[idx];
-    persistSchedule(ack.ch, activeSchedules[idx]);
-    mqttPublish(ack.ch, "schedule/slave/ack", "OK", false);
-    mqttPublish(ack.ch, "schedule", "OK SCHEDULAZIONE", true);
-    mqttPublish(ack.ch, "schedule/current", scheduleToJson(activeSchedules[idx]).c_str(), true);
-  } else {
-    mqttPublish(ack.ch, "schedule/slave/ack", "ERROR", false);
+  bool subscribe(const char* topic) override { return mqtt.subscribe(topic); }
+  bool unsubscribe(const char* topic) override { return mqtt.unsubscribe(topic); }
+};
+
+class PrefsStore : public KvStoreHal {
+public:
+  bool hasKey(const char* key) override { return prefs.isKey(key); }
+  size_t getBytes(const char* key, uint8_t* buf, size_t cap) override { return prefs.getBytes(key, buf, cap); }
+  size_t putBytes(const char* key, const uint8_t* data, size_t len) override { return prefs.putBytes(key, data, len); }
+  size_t getString(const char* key, char* buf, size_t cap) override { return prefs.getString(key, buf, cap); }
+};
+
+class ArduinoClock : public ClockHal {
+public:
+  uint32_t millis() override { return ::millis(); }
+  uint32_t random() override { return esp_random(); }
+  bool localWeekTime(uint8_t &weekdayMon0, uint16_t &minuteOfDay) override {
+    if (!timeSynced) { struct tm tmNow; if (getLocalTime(&tmNow, 10)) timeSynced = true; }
+    if (!timeSynced) return false;
+    struct tm tmNow;
+    if (!getLocalTime(&tmNow, 10)) return false;
+    int w = tmNow.tm_wday;
+    weekdayMon0 = (uint8_t)((w == 0) ? 6 : (w - 1));
+    minuteOfDay = (uint16_t)(tmNow.tm_hour * 60 + tmNow.tm_min);
+    return true;
   }
-  Serial.printf("[SCHEDULE_ACK] relay=%u ok=%u count=%u ms=%lu\n", ack.ch, ack.ok, ack.count, (unsigned long)ack.ms);
-}
-
-void handleExecuted(const PowerExecutedPacket &ex) {
-  if (ex.ch < 1 || ex.ch > 3) return;
-  relayState[ex.ch - 1] = ex.state ? 1 : 0;
-  mqttPublish(ex.ch, "executed", ex.state ? "ON" : "OFF", false);
-  mqttPublish(ex.ch, "state", ex.state ? "ON" : "OFF", false);
-  Serial.printf("[EXECUTED] relay=%u state=%u minute=%u weekday=%u\n", ex.ch, ex.state, ex.minuteOfDay, ex.weekdayMon0);
-}
-
-void handleScheduleSet(uint8_t relay, const String &payload) {
-  std::string err;
-  PowerRelaySchedule candidate{};
-  if (!parseScheduleJson(payload.c_str(), candidate, err)) {
-    Serial.printf("[SCHEDULE] relay=%u invalid=%s\n", relay, err.c_str());
-    mqttPublish(relay, "schedule/slave/ack", "ERROR", false);
-    return;
+  bool wallClock(uint32_t &epochSec, uint16_t &ms, int16_t &utcOffsetMin) override {
+    if (!timeSynced) return false;
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    time_t t = tv.tv_sec;
+    struct tm local, utc;
+    localtime_r(&t, &local);
+    gmtime_r(&t, &utc);
+    int days = local.tm_year != utc.tm_year ? (local.tm_year > utc.tm_year ? 1 : -1) : local.tm_yday - utc.tm_yday;
+    epochSec = (uint32_t)tv.tv_sec;
+    ms = (uint16_t)(tv.tv_usec / 1000);
+    utcOffsetMin = (int16_t)(days * 1440 + (local.tm_hour - utc.tm_hour) * 60 + (local.tm_min - utc.tm_min));
+    return true;
   }
-
-  mqttPublish(relay, "schedule/slave/ack", "PENDING", false);
-
-  if (!waitingAck[relay-1] && schedulesEqual(candidate, activeSchedules[relay-1])) {
-    mqttPublish(relay, "schedule/current", scheduleToJson(activeSchedules[relay-1]).c_str(), true);
-    Serial.printf("[SCHEDULE] relay=%u idempotent no-op\n", relay);
-    return;
+};
+
+EspNowRadio radioHal;
+PubSubMqtt mqttHal;
+PrefsStore storeHal;
+ArduinoClock clockHal;
+// Every periodic job and deadline of loop() is a timer here.
+EventScheduler timers;
+PowerMaster master(radioHal, mqttHal, storeHal, clockHal, timers, ESPNOW_CHANNEL);
+
+void logLine(const char* line) { Serial.println(line); }
+
+// Render and push are measured in the render task; take its latest totals.
+void collectRenderTimings() {
+  RenderTimings rt;
+  if (renderTimingChannel.read(rt)) {
+    phaseTiming[PHASE_RENDER] = rt.render;
+    phaseTiming[PHASE_PUSH] = rt.push;
   }
+}
 
-  pendingSchedules[relay-1] = candidate;
-  waitingAck[relay-1] = true;
-  retryLeft[relay-1] = SCHEDULE_RETRY_MAX;
-  ackDeadline[relay-1] = millis() + SCHEDULE_ACK_TIMEOUT_MS;
-
-  if (!sendRulesPacket(relay, candidate)) {
-    Serial.printf("[SCHEDULE] relay=%u send failed\n", relay);
-    mqttPublish(relay, "schedule/slave/ack", "ERROR", false);
+void publishTimings() {
+  collectRenderTimings();
+  char suffix[32];
+  char json[112];
+  for (uint8_t i = 0; i < PHASE_COUNT; i++) {
+    snprintf(suffix, sizeof(suffix), "diag/timing/%s", PHASE_NAME[i]);
+    size_t n = phaseTiming[i].writeJson(json, sizeof(json));
+    if (n > 0) master.publish(suffix, json, n, false);
+    phaseTiming[i].reset();
   }
+  renderTimingReset.store(true);
 }
 
-void checkScheduleTimeouts() {
-  uint32_t now = millis();
-  for (uint8_t relay = 1; relay <= 3; relay++) {
-    uint8_t idx = relay - 1;
-    if (!waitingAck[idx]) continue;
-    if ((int32_t)(now - ackDeadline[idx]) < 0) continue;
-
-    if (retryLeft[idx] > 0) {
-      retryLeft[idx]--;
-      ackDeadline[idx] = now + SCHEDULE_ACK_TIMEOUT_MS;
-      sendRulesPacket(relay, pendingSchedules[idx]);
-      Serial.printf("[SCHEDULE] relay=%u retry\n", relay);
-    } else {
-      waitingAck[idx] = false;
-      mqttPublish(relay, "schedule/slave/ack", "ERROR", false);
-      Serial.printf("[SCHEDULE] relay=%u timeout\n", relay);
+void dumpTimings() {
+  collectRenderTimings();
+  char json[112];
+  for (uint8_t i = 0; i < PHASE_COUNT; i++) {
+    const TimingHistogram &h = phaseTiming[i];
+    if (h.writeJson(json, sizeof(json)) > 0) Serial.printf("[DIAG] %-9s %s\n", PHASE_NAME[i], json);
+    for (uint8_t b = 0; b < TIMING_BUCKETS; b++) {
+      if (h.bucket(b)) Serial.printf("[DIAG]   <%lu us: %lu\n", (unsigned long)TimingHistogram::bucketLimitUs(b), (unsigned long)h.bucket(b));
     }
   }
 }
 
-void mqttCallback(char* topic, byte* payload, unsigned int length) {
-  String t = String(topic);
-  String p;
-  for (unsigned int i = 0; i < length; i++) p += (char)payload[i];
-
-  for (uint8_t relay = 1; relay <= 3; relay++) {
-    if (t == topicForRelay(relay, "schedule/set")) {
-      handleScheduleSet(relay, p);
-      return;
-    }
-    if (t == topicForRelay(relay, "set")) {
-      CommandPacket cmd{};
-      cmd.type = 1;
-      cmd.r1 = cmd.r2 = cmd.r3 = 255;
-      cmd.irrig = 0;
-      cmd.liveSec = 60;
-      if (p == "ON") cmd.r1 = 1;
-      else if (p == "OFF") cmd.r1 = 0;
-      else if (p == "TOGGLE") cmd.r1 = 2;
-      if (relay == 2) { cmd.r2 = cmd.r1; cmd.r1 = 255; }
-      if (relay == 3) { cmd.r3 = cmd.r1; cmd.r1 = 255; }
-      for (int i = 0; i < MAX_PEERS; i++) if (peers[i].used) esp_now_send(peers[i].mac, (uint8_t*)&cmd, sizeof(cmd));
-      return;
+void pollSerialCommands() {
+  static char line[16];
+  static uint8_t lineLen = 0;
+  while (Serial.available() > 0) {
+    char c = (char)Serial.read();
+    if (c != '\n' && c != '\r') {
+      if (lineLen < sizeof(line) - 1) line[lineLen++] = c;
+      continue;
     }
+    line[lineLen] = '\0';
+    if (strcmp(line, "diag") == 0) dumpTimings();
+    lineLen = 0;
   }
 }
 
+void mqttCallback(char* topic, byte* payload, unsigned int length) {
+  master.onMqttMessage(topic, payload, length);
+}
+
 void ensureMqttConnected() {
   if (!mqtt.connected()) {
     Serial.printf("[MQTT] connecting %s:%u\n", MQTT_HOST, MQTT_PORT);
     if (mqtt.connect(MQTT_CLIENT_ID)) {
       Serial.println("[MQTT] connected");
-      for (uint8_t relay = 1; relay <= 3; relay++) {
-        mqtt.subscribe(topicForRelay(relay, "set").c_str());
-        mqtt.subscribe(topicForRelay(relay, "schedule/set").c_str());
-      }
-      publishRetainedSchedules();
+      master.onMqttConnected();
     } else {
       Serial.printf("[MQTT] connect failed state=%d\n", mqtt.state());
     }
@@ -273,32 +411,52 @@ void ensureMqttConnected() {
 }
 
 void onEspNowRecv(const esp_now_recv_info_t* info, const uint8_t* data, int len) {
+  uint32_t startUs = micros();
   rxCount = rxCount + 1;
-  const uint8_t* mac = (info != nullptr) ? info->src_addr : nullptr;
-  if (mac != nullptr) addPeerIfNeeded(mac);
-
-  if (len == (int)sizeof(TelemetryPacket)) {
-    memcpy((void*)&rx, data, sizeof(TelemetryPacket));
-    hasPkt = true;
-    lastPktAt = millis();
-    return;
+  RxRecord rec;
+  rec.len = 0;
+  rec.atMs = millis();
+  if (info != nullptr && info->src_addr != nullptr) memcpy(rec.mac, info->src_addr, 6);
+  else memset(rec.mac, 0, 6);
+  if (len > 0 && len <= (int)RX_PAYLOAD_MAX) {
+    rec.len = (uint8_t)len;
+    memcpy(rec.data, data, len);
   }
+  rec.callbackUs = micros() - startUs;
+  rxQueue.push(rec);
+  platformSignalEvent();
+}
 
-  if (len == (int)sizeof(PowerScheduleAckPacket) && data[0] == 15) {
-    PowerScheduleAckPacket ack;
-    memcpy(&ack, data, sizeof(ack));
-    handleScheduleAck(ack);
-    return;
+void drainRxQueue() {
+  RxRecord rec;
+  while (rxQueue.pop(rec)) {
+    phaseTiming[PHASE_ESPNOW_CB].record(rec.callbackUs);
+    master.onRadioFrame(rec.mac, rec.data, rec.len, rec.atMs);
   }
 
-  if (len == (int)sizeof(PowerExecutedPacket) && data[0] == 16) {
-    PowerExecutedPacket ex;
-    memcpy(&ex, data, sizeof(ex));
-    handleExecuted(ex);
-    return;
+  uint32_t overflows = rxQueue.overflows();
+  if (overflows != rxOverflowsLogged) {
+    Serial.printf("[ESPNOW] rx queue overflow dropped=%lu high_water=%lu/%lu\n", (unsigned long)(overflows - rxOverflowsLogged),
+                  (unsigned long)rxQueue.highWater(), (unsigned long)rxQueue.capacity());
+    rxOverflowsLogged = overflows;
   }
 }
 
+void onEspNowSent(const uint8_t* mac, esp_now_send_status_t status) {
+  if (mac == nullptr || memcmp(mac, BCAST_MAC, 6) == 0) return;
+  TxStatus st;
+  memcpy(st.mac, mac, 6);
+  st.ok = status == ESP_NOW_SEND_SUCCESS;
+  st.atMs = millis();
+  txStatusQueue.push(st);
+  platformSignalEvent();
+}
+
+void drainTxStatus() {
+  TxStatus st;
+  while (txStatusQueue.pop(st)) master.onRadioSent(st.mac, st.ok, st.atMs);
+}
+
 bool initEspNow() {
   WiFi.mode(WIFI_STA);
   delay(50);
@@ -308,6 +466,7 @@ bool initEspNow() {
   esp_wifi_set_promiscuous(false);
   if (esp_now_init() != ESP_OK) return false;
   esp_now_register_recv_cb(onEspNowRecv);
+  esp_now_register_send_cb(onEspNowSent);
   esp_now_peer_info_t bc = {};
   memcpy(bc.peer_addr, BCAST_MAC, 6);
   bc.channel = ESPNOW_CHANNEL;
@@ -317,17 +476,10 @@ bool initEspNow() {
   return true;
 }
 
-bool timeSynced = false;
-uint32_t lastWifiRetryAt = 0;
-
-void ensureWifiConnected() {
+void onWifiRetryTimer(void*) {
   if (strlen(WIFI_SSID) == 0) return;
   if (WiFi.status() == WL_CONNECTED) return;
 
-  uint32_t now = millis();
-  if ((int32_t)(now - lastWifiRetryAt) < (int32_t)WIFI_RETRY_MS) return;
-  lastWifiRetryAt = now;
-
   Serial.printf("[WIFI] reconnecting ssid=%s\n", WIFI_SSID);
   WiFi.disconnect(false, false);
   WiFi.begin(WIFI_SSID, WIFI_PASS);
@@ -344,36 +496,113 @@ void maybeInitWifiAndNtp() {
   for (int i = 0; i < 50; i++) { struct tm tmNow; if (getLocalTime(&tmNow, 200)) { timeSynced = true; break; } delay(100); }
 }
 
-bool buildTimeSync(TimeSyncPacket &ts) {
-  ts.type = 6;
-  ts.ms = millis();
-  if (!timeSynced) { struct tm tmNow; if (getLocalTime(&tmNow, 10)) timeSynced = true; }
-  if (!timeSynced) { ts.valid = 0; ts.minuteOfDay = 0; ts.weekdayMon0 = 0; return false; }
-  struct tm tmNow;
-  if (!getLocalTime(&tmNow, 10)) { ts.valid = 0; return false; }
-  int minuteOfDay = tmNow.tm_hour * 60 + tmNow.tm_min;
-  int w = tmNow.tm_wday;
-  int mon0 = (w == 0) ? 6 : (w - 1);
-  ts.valid = 1;
-  ts.minuteOfDay = (uint16_t)minuteOfDay;
-  ts.weekdayMon0 = (uint8_t)mon0;
-  return true;
-}
-
-void sendHello() { HelloPacket h{}; h.type = 2; h.ch = ESPNOW_CHANNEL; h.ms = millis(); esp_now_send(BCAST_MAC, (uint8_t*)&h, sizeof(h)); }
-void sendTimeSyncToPeers() { TimeSyncPacket ts{}; buildTimeSync(ts); for (int i = 0; i < MAX_PEERS; i++) if (peers[i].used) esp_now_send(peers[i].mac, (uint8_t*)&ts, sizeof(ts)); }
-uint32_t countPeers() { uint32_t c = 0; for (int i = 0; i < MAX_PEERS; i++) if (peers[i].used) c++; return c; }
-
-void drawOverlay(const TelemetryPacket& p, bool linkOk, uint32_t peersCount) {
+void drawOverlay(const DisplaySnapshot& snap, bool linkOk) {
+  const TelemetryPacket& p = snap.pkt;
   canvas.setTextColor(WHITE); canvas.setTextWrap(false); canvas.setTextSize(2); canvas.setCursor(10, 10); canvas.print("EVE");
   canvas.setTextSize(1); canvas.setCursor(10, 30); canvas.print("ESP-NOW: "); canvas.print(linkOk ? "OK" : "NO DATA");
-  canvas.setCursor(10, 40); canvas.print("RX: "); canvas.print((unsigned long)rxCount);
-  canvas.setCursor(10, 50); canvas.print("PEERS: "); canvas.print((unsigned long)peersCount);
+  canvas.setCursor(10, 40); canvas.print("RX: "); canvas.print((unsigned long)snap.rxCount);
+  canvas.setCursor(10, 50); canvas.print("PEERS: "); canvas.print((unsigned long)snap.peers);
   canvas.setTextSize(2); canvas.setCursor(10, 70); if (isnan(p.t)) canvas.print("T --.-C"); else canvas.printf("T %.1fC", p.t);
   canvas.setCursor(10, 95); if (isnan(p.h)) canvas.print("H --%"); else canvas.printf("H %d%%", (int)(p.h + 0.5f));
   canvas.setCursor(10, 120); canvas.printf("S %d%%", p.soil); canvas.setCursor(10, 145); canvas.printf("B %d%%", p.batt);
   canvas.setTextSize(1); canvas.setCursor(10, 170); canvas.printf("R1:%d R2:%d R3:%d PIR:%d", p.r1, p.r2, p.r3, p.presence);
-  canvas.setCursor(10, 185); canvas.print(timeSynced ? "TIME: OK" : "TIME: N/A");
+  canvas.setCursor(10, 185); canvas.print(snap.timeSynced ? "TIME: OK" : "TIME: N/A");
+}
+
+#if defined(EVE_DISPLAY_PALETTED)
+void pushDamage() {
+  uint16_t n = canvas.damage.collect(canvas.fb.pixels(), PALETTE_BITS);
+  if (n == 0) return;
+  static uint16_t line[240];
+  const DamageRect *rects = canvas.damage.rects();
+  tft.startWrite();
+  for (uint16_t i = 0; i < n; i++) {
+    const DamageRect &r = rects[i];
+    tft.setAddrWindow(r.x, r.y, r.w, r.h);
+    for (uint16_t row = 0; row < r.h; row++) {
+      canvas.fb.expand(r.x, r.y + row, r.w, line);
+      tft.writePixels(line, r.w); // blocking: line is reused for the next row
+    }
+  }
+  tft.endWrite();
+}
+#else
+void pushDamage() {
+  uint16_t n = canvas.damage.collect(canvas.getBuffer());
+  if (n == 0) return;
+  uint16_t *buf = canvas.getBuffer();
+  const DamageRect *rects = canvas.damage.rects();
+  tft.startWrite();
+  for (uint16_t i = 0; i < n; i++) {
+    const DamageRect &r = rects[i];
+    tft.setAddrWindow(r.x, r.y, r.w, r.h);
+    for (uint16_t row = 0; row < r.h; row++) tft.writePixels(buf + (uint32_t)(r.y + row) * canvas.width() + r.x, r.w);
+  }
+  tft.endWrite();
+}
+#endif
+
+void publishDisplaySnapshot() {
+  DisplaySnapshot snap;
+  snap.pkt = master.lastTelemetry();
+  snap.lastPktAt = master.lastTelemetryAt();
+  snap.rxCount = rxCount;
+  snap.peers = master.peers().count();
+  snap.timeSynced = timeSynced;
+  displayChannel.write(snap);
+}
+
+void onSnapshotTimer(void*) { publishDisplaySnapshot(); }
+void onTimingDiagTimer(void*) { publishTimings(); }
+
+void renderTask(void*) {
+  DisplaySnapshot snap;
+  memset(&snap, 0, sizeof(snap));
+  snap.pkt.t = NAN;
+  snap.pkt.h = NAN;
+  RenderTimings timings;
+  uint32_t lastTimingsAt = 0;
+
+  for (;;) {
+    uint32_t now = millis();
+    displayChannel.read(snap);
+    if (renderTimingReset.load()) {
+      timings.render.reset();
+      timings.push.reset();
+      renderTimingReset.store(false);
+    }
+
+    if (random(0, 100) < 2) { targetX = random(-10, 11) / 10.0f; targetY = random(-6, 7) / 10.0f; }
+    lookX += (targetX - lookX) * 0.12f;
+    lookY += (targetY - lookY) * 0.12f;
+
+    float blinkAmt = 0.0f;
+    if (!blinking && now > nextBlink) { blinking = true; blinkStart = now; }
+    if (blinking) {
+      float t = (now - blinkStart) / 180.0f;
+      if (t >= 1.0f) { blinking = false; scheduleBlink(); }
+      else blinkAmt = ease(t < 0.5 ? t*2 : (1 - t)*2);
+    }
+
+    {
+      ScopedTiming t(timings.render, timingNowUs);
+      // The clear is not damage: tiles drawn last frame are re-checked anyway.
+      canvas.tracking = false;
+      canvas.fillScreen(BLACK);
+      canvas.tracking = true;
+      drawEye(L, lookX, lookY, blinkAmt);
+      drawEye(R, lookX, lookY, blinkAmt);
+      drawOverlay(snap, (now - snap.lastPktAt) <= 5000);
+    }
+    {
+      ScopedTiming t(timings.push, timingNowUs);
+      pushDamage();
+    }
+    if (now - lastTimingsAt >= 1000) { lastTimingsAt = now; renderTimingChannel.write(timings); }
+
+    uint32_t spent = millis() - now;
+    platformSleepMs(spent < RENDER_FRAME_MS ? RENDER_FRAME_MS - spent : 1);
+  }
 }
 
 void setup() {
@@ -384,58 +613,58 @@ void setup() {
   tft.begin();
   tft.setRotation(0);
   canvas.fillScreen(BLACK);
-  tft.drawRGBBitmap(0, 0, canvas.getBuffer(), 240, 240);
+  pushDamage();
 
+  master.setLogger(logLine);
   if (!initEspNow()) Serial.println("ESP-NOW init FAIL");
-  memset((void*)&viewPkt, 0, sizeof(viewPkt));
-  viewPkt.t = NAN;
-  viewPkt.h = NAN;
 
   maybeInitWifiAndNtp();
   mqtt.setServer(MQTT_HOST, MQTT_PORT);
+  mqtt.setBufferSize(MQTT_BUFFER_SIZE);
   mqtt.setCallback(mqttCallback);
 
   prefs.begin("eve_power", false);
-  loadSchedules();
+  master.begin();
+  uint32_t now = millis();
+  timers.every(onSnapshotTimer, nullptr, DISPLAY_SNAPSHOT_MS, now);
+  timers.every(onTimingDiagTimer, nullptr, 60000, now);
+  timers.every(onWifiRetryTimer, nullptr, WIFI_RETRY_MS, now);
 
+  if (!eyeSprites.build((uint8_t)L.w, (uint8_t)L.h, EYE_BLINK_LEVELS, 36, 44, 18)) {
+    Serial.println("[EYE] sprite cache too small, drawing with fillRoundRect");
+  }
   scheduleBlink();
+  publishDisplaySnapshot();
+  if (!platformStartTask("render", renderTask, nullptr, RENDER_TASK_STACK, RENDER_TASK_PRIORITY)) {
+    Serial.println("render task start FAIL");
+  }
 }
 
 void loop() {
-  uint32_t now = millis();
-  if (hasPkt) { noInterrupts(); viewPkt = rx; hasPkt = false; interrupts(); }
-
-  static uint32_t lastHello = 0;
-  if (now - lastHello >= 800) { lastHello = now; sendHello(); }
-
-  static uint32_t lastTimeSync = 0;
-  if (now - lastTimeSync >= 5000) { lastTimeSync = now; sendTimeSyncToPeers(); }
-
-  if (WiFi.status() == WL_CONNECTED) {
-    ensureMqttConnected();
-    mqtt.loop();
-  } else {
-    ensureWifiConnected();
+  uint32_t loopStartUs = micros();
+  {
+    ScopedTiming t(phaseTiming[PHASE_RX], timingNowUs);
+    drainRxQueue();
+    drainTxStatus();
+  }
+  pollSerialCommands();
+  {
+    ScopedTiming t(phaseTiming[PHASE_MQTT], timingNowUs);
+    if (WiFi.status() == WL_CONNECTED) {
+      ensureMqttConnected();
+      mqtt.loop();
+      master.drainOutbox(MQTT_DRAIN_PER_LOOP);
+    }
   }
-  checkScheduleTimeouts();
-
-  if (random(0, 100) < 2) { targetX = random(-10, 11) / 10.0f; targetY = random(-6, 7) / 10.0f; }
-  lookX += (targetX - lookX) * 0.12f;
-  lookY += (targetY - lookY) * 0.12f;
-
-  float blinkAmt = 0.0f;
-  if (!blinking && now > nextBlink) { blinking = true; blinkStart = now; }
-  if (blinking) {
-    float t = (now - blinkStart) / 180.0f;
-    if (t >= 1.0f) { blinking = false; scheduleBlink(); }
-    else blinkAmt = ease(t < 0.5 ? t*2 : (1 - t)*2);
+  {
+    ScopedTiming t(phaseTiming[PHASE_SCHEDULE], timingNowUs);
+    timers.run(millis());
   }
 
-  canvas.fillScreen(BLACK);
-  drawEye(L, lookX, lookY, blinkAmt);
-  drawEye(R, lookX, lookY, blinkAmt);
-  bool linkOk = (now - lastPktAt) <= 5000;
-  drawOverlay(viewPkt, linkOk, countPeers());
-  tft.drawRGBBitmap(0, 0, canvas.getBuffer(), 240, 240);
-  delay(16);
+  phaseTiming[PHASE_LOOP].record(micros() - loopStartUs);
+  {
+    ScopedTiming t(phaseTiming[PHASE_IDLE], timingNowUs);
+    uint32_t wait = timers.msUntilNext(millis());
+    platformWaitForEvent(wait < LOOP_MAX_WAIT_MS ? wait : LOOP_MAX_WAIT_MS);
+  }
 }
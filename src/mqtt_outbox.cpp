@@ -0,0 +1,135 @@
+#include "mqtt_outbox.h"
+
+#include <string.h>
+
+namespace {
+
+uint32_t topicHash(const char *topic, size_t len) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)topic[i]) * 16777619u;
+  return h;
+}
+
+bool sendPlain(void *ctx, const char *topic, const uint8_t *payload, size_t len, bool retained) {
+  return (*static_cast<MqttOutboxSend *>(ctx))(topic, payload, len, retained);
+}
+
+} // namespace
+
+MqttOutbox::MqttOutbox() { clear(); }
+
+void MqttOutbox::clear() {
+  head_ = 0;
+  count_ = 0;
+  live_ = 0;
+  used_ = 0;
+  write_ = 0;
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+bool MqttOutbox::reserve(uint16_t n, uint16_t &offset, uint16_t &span) const {
+  if (count_ >= MQTT_OUTBOX_SLOTS || (uint32_t)used_ + n > MQTT_OUTBOX_ARENA) return false;
+  if (count_ == 0) {
+    offset = 0;
+    span = n;
+    return true;
+  }
+  uint16_t read = (uint16_t)((write_ + MQTT_OUTBOX_ARENA - used_) % MQTT_OUTBOX_ARENA);
+  if (read > write_) {
+    // Free space is the single gap between the tail and the head.
+    if (n > read - write_) return false;
+    offset = write_;
+    span = n;
+    return true;
+  }
+  if (n <= MQTT_OUTBOX_ARENA - write_) {
+    offset = write_;
+    span = n;
+    return true;
+  }
+  if (n > read) return false;
+  // Skip the tail end of the arena; the gap is released with this message.
+  offset = 0;
+  span = (uint16_t)(MQTT_OUTBOX_ARENA - write_ + n);
+  return (uint32_t)used_ + span <= MQTT_OUTBOX_ARENA;
+}
+
+void MqttOutbox::popHead() {
+  Slot &s = slots_[head_];
+  if (!s.dead) live_--;
+  used_ = (uint16_t)(used_ - s.span);
+  head_ = (uint8_t)((head_ + 1) % MQTT_OUTBOX_SLOTS);
+  count_--;
+  if (count_ == 0) write_ = 0;
+}
+
+void MqttOutbox::dropHead() {
+  if (!slots_[head_].dead) stats_.dropped++;
+  popHead();
+}
+
+bool MqttOutbox::enqueue(const char *topic, const char *payload, size_t len, bool retained, MqttOutboxKind kind) {
+  size_t topicLen = strlen(topic);
+  size_t need = topicLen + 1 + len;
+  if (topicLen == 0 || topicLen > 255 || need > MQTT_OUTBOX_ARENA) {
+    stats_.dropped++;
+    return false;
+  }
+  uint32_t hash = topicHash(topic, topicLen);
+
+  if (kind == MQTT_OUTBOX_STATE) {
+    for (uint8_t i = 0; i < count_; i++) {
+      Slot &s = slots_[(head_ + i) % MQTT_OUTBOX_SLOTS];
+      if (s.dead || s.kind != MQTT_OUTBOX_STATE || s.hash != hash || s.topicLen != topicLen) continue;
+      if (memcmp(arena_ + s.offset, topic, topicLen) != 0) continue;
+      s.dead = true;
+      live_--;
+      stats_.coalesced++;
+      break; // at most one live value per state topic
+    }
+  }
+
+  uint16_t offset = 0, span = 0;
+  while (!reserve((uint16_t)need, offset, span)) dropHead();
+
+  memcpy(arena_ + offset, topic, topicLen + 1);
+  if (len > 0) memcpy(arena_ + offset + topicLen + 1, payload, len);
+  Slot &s = slots_[(head_ + count_) % MQTT_OUTBOX_SLOTS];
+  s.offset = offset;
+  s.span = span;
+  s.payloadLen = (uint16_t)len;
+  s.topicLen = (uint8_t)topicLen;
+  s.kind = kind;
+  s.retained = retained;
+  s.dead = false;
+  s.hash = hash;
+  count_++;
+  live_++;
+  used_ = (uint16_t)(used_ + span);
+  write_ = (uint16_t)((offset + need) % MQTT_OUTBOX_ARENA);
+  stats_.enqueued++;
+  if (live_ > stats_.highWater) stats_.highWater = live_;
+  return true;
+}
+
+uint8_t MqttOutbox::drain(MqttOutboxSend send, uint8_t maxMessages) {
+  return drain(sendPlain, &send, maxMessages);
+}
+
+uint8_t MqttOutbox::drain(MqttOutboxContextSend send, void *ctx, uint8_t maxMessages) {
+  uint8_t sent = 0;
+  while (count_ > 0 && sent < maxMessages) {
+    const Slot &s = slots_[head_];
+    if (!s.dead) {
+      const char *topic = (const char *)(arena_ + s.offset);
+      if (!send(ctx, topic, arena_ + s.offset + s.topicLen + 1, s.payloadLen, s.retained)) {
+        stats_.sendFailures++;
+        break;
+      }
+      stats_.sent++;
+      sent++;
+    }
+    popHead();
+  }
+  return sent;
+}
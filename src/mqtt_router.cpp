@@ -0,0 +1,123 @@
+#include "mqtt_router.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const char RELAY_SEGMENT[] = "relay/";
+const size_t RELAY_SEGMENT_LEN = sizeof(RELAY_SEGMENT) - 1;
+
+uint32_t suffixHash(const char *s, size_t len, bool relayScoped) {
+  uint32_t h = relayScoped ? 0x811C9DC5u : 0x050C5D1Fu;
+  for (size_t i = 0; i < len; i++) h = (h ^ (uint8_t)s[i]) * 16777619u;
+  return h;
+}
+
+} // namespace
+
+MqttTopicRouter::MqttTopicRouter(const char *root, uint8_t relayCount) : relayCount_(relayCount), routeCount_(0) {
+  size_t n = strlen(root);
+  if (n >= sizeof(root_)) n = sizeof(root_) - 1;
+  memcpy(root_, root, n);
+  root_[n] = '\0';
+  rootLen_ = (uint8_t)n;
+  for (uint8_t i = 0; i < MQTT_ROUTER_TABLE_SIZE; i++) table_[i] = -1;
+}
+
+bool MqttTopicRouter::addRelayRoute(const char *suffix, MqttRouteHandler handler) {
+  return add(suffix, true, handler, nullptr, nullptr);
+}
+
+bool MqttTopicRouter::addRoute(const char *suffix, MqttRouteHandler handler) {
+  return add(suffix, false, handler, nullptr, nullptr);
+}
+
+bool MqttTopicRouter::addRelayRoute(const char *suffix, MqttRouteContextHandler handler, void *ctx) {
+  return add(suffix, true, nullptr, handler, ctx);
+}
+
+bool MqttTopicRouter::addRoute(const char *suffix, MqttRouteContextHandler handler, void *ctx) {
+  return add(suffix, false, nullptr, handler, ctx);
+}
+
+bool MqttTopicRouter::add(const char *suffix, bool relayScoped, MqttRouteHandler handler,
+                          MqttRouteContextHandler ctxHandler, void *ctx) {
+  size_t len = strlen(suffix);
+  if (routeCount_ >= MQTT_ROUTER_MAX_ROUTES || len == 0 || len >= MQTT_ROUTER_MAX_SUFFIX) return false;
+  if (handler == nullptr && ctxHandler == nullptr) return false;
+  if (find(suffix, len, relayScoped) >= 0) return false;
+
+  Route &r = routes_[routeCount_];
+  memcpy(r.suffix, suffix, len + 1);
+  r.len = (uint8_t)len;
+  r.relayScoped = relayScoped;
+  r.hash = suffixHash(suffix, len, relayScoped);
+  r.handler = handler;
+  r.ctxHandler = ctxHandler;
+  r.ctx = ctx;
+
+  uint8_t slot = r.hash & (MQTT_ROUTER_TABLE_SIZE - 1);
+  while (table_[slot] >= 0) slot = (slot + 1) & (MQTT_ROUTER_TABLE_SIZE - 1);
+  table_[slot] = (int8_t)routeCount_;
+  routeCount_++;
+  return true;
+}
+
+int8_t MqttTopicRouter::find(const char *suffix, size_t len, bool relayScoped) const {
+  uint32_t h = suffixHash(suffix, len, relayScoped);
+  uint8_t slot = h & (MQTT_ROUTER_TABLE_SIZE - 1);
+  while (table_[slot] >= 0) {
+    const Route &r = routes_[table_[slot]];
+    if (r.hash == h && r.len == len && r.relayScoped == relayScoped && memcmp(r.suffix, suffix, len) == 0) return table_[slot];
+    slot = (slot + 1) & (MQTT_ROUTER_TABLE_SIZE - 1);
+  }
+  return -1;
+}
+
+bool MqttTopicRouter::dispatch(const char *topic, const uint8_t *payload, size_t len) const {
+  if (topic == nullptr || strncmp(topic, root_, rootLen_) != 0) return false;
+  const char *rest = topic + rootLen_;
+  uint8_t relay = 0;
+  bool relayScoped = false;
+
+  if (strncmp(rest, RELAY_SEGMENT, RELAY_SEGMENT_LEN) == 0) {
+    const char *p = rest + RELAY_SEGMENT_LEN;
+    unsigned n = 0;
+    uint8_t digits = 0;
+    while (*p >= '0' && *p <= '9' && digits < 3) {
+      n = n * 10 + (unsigned)(*p - '0');
+      p++;
+      digits++;
+    }
+    if (digits == 0 || *p != '/' || n < 1 || n > relayCount_) return false;
+    relay = (uint8_t)n;
+    relayScoped = true;
+    rest = p + 1;
+  }
+
+  int8_t idx = find(rest, strlen(rest), relayScoped);
+  if (idx < 0) return false;
+  const Route &r = routes_[idx];
+  if (r.handler != nullptr) r.handler(relay, (const char *)payload, len);
+  else r.ctxHandler(r.ctx, relay, (const char *)payload, len);
+  return true;
+}
+
+size_t MqttTopicRouter::formatRelayTopic(char *buf, size_t cap, uint8_t relay, const char *suffix) const {
+  int n = snprintf(buf, cap, "%s%s%u/%s", root_, RELAY_SEGMENT, relay, suffix);
+  return (n < 0 || (size_t)n >= cap) ? 0 : (size_t)n;
+}
+
+size_t MqttTopicRouter::formatTopic(char *buf, size_t cap, const char *suffix) const {
+  int n = snprintf(buf, cap, "%s%s", root_, suffix);
+  return (n < 0 || (size_t)n >= cap) ? 0 : (size_t)n;
+}
+
+bool MqttTopicRouter::filterTopic(uint8_t index, char *buf, size_t cap) const {
+  if (index >= routeCount_) return false;
+  const Route &r = routes_[index];
+  int n = r.relayScoped ? snprintf(buf, cap, "%s%s+/%s", root_, RELAY_SEGMENT, r.suffix)
+                        : snprintf(buf, cap, "%s%s", root_, r.suffix);
+  return n > 0 && (size_t)n < cap;
+}
@@ -0,0 +1,65 @@
+#include "paletted_framebuffer.h"
+
+#include <string.h>
+
+PalettedFramebuffer::PalettedFramebuffer(uint8_t *pixels, uint16_t width, uint16_t height)
+    : pixels_(pixels), width_(width), height_(height), stride_(strideFor(width)), colors_(1) {
+  memset(palette_, 0, sizeof(palette_));
+  memset(pixels_, 0, bytesFor(width, height));
+}
+
+uint8_t PalettedFramebuffer::indexFor(uint16_t color) {
+  for (uint8_t i = 0; i < colors_; i++) {
+    if (palette_[i] == color) return i;
+  }
+  if (colors_ == PALETTE_SIZE) return 0;
+  palette_[colors_] = color;
+  return colors_++;
+}
+
+void PalettedFramebuffer::fill(uint8_t index) { memset(pixels_, (index & 3) * 0x55, bytesFor(width_, height_)); }
+
+void PalettedFramebuffer::fillRow(uint16_t y, uint16_t x0, uint16_t x1, uint8_t index) {
+  uint8_t *r = row(y);
+  uint8_t packed = (uint8_t)((index & 3) * 0x55);
+  // Leading pixels up to a byte boundary, whole bytes, trailing pixels.
+  while (x0 < x1 && (x0 & 3) != 0) {
+    uint8_t shift = (x0 & 3) * 2;
+    r[x0 >> 2] = (uint8_t)((r[x0 >> 2] & ~(3 << shift)) | ((index & 3) << shift));
+    x0++;
+  }
+  uint16_t whole = (uint16_t)((x1 - x0) >> 2);
+  if (whole > 0) {
+    memset(r + (x0 >> 2), packed, whole);
+    x0 = (uint16_t)(x0 + whole * 4);
+  }
+  while (x0 < x1) {
+    uint8_t shift = (x0 & 3) * 2;
+    r[x0 >> 2] = (uint8_t)((r[x0 >> 2] & ~(3 << shift)) | ((index & 3) << shift));
+    x0++;
+  }
+}
+
+void PalettedFramebuffer::fillSpan(int16_t x, int16_t y, int16_t w, uint8_t index) { fillRect(x, y, w, 1, index); }
+
+void PalettedFramebuffer::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t index) {
+  int32_t x0 = x, y0 = y, x1 = (int32_t)x + w, y1 = (int32_t)y + h;
+  if (x0 < 0) x0 = 0;
+  if (y0 < 0) y0 = 0;
+  if (x1 > width_) x1 = width_;
+  if (y1 > height_) y1 = height_;
+  if (x0 >= x1 || y0 >= y1) return;
+  for (int32_t yy = y0; yy < y1; yy++) fillRow((uint16_t)yy, (uint16_t)x0, (uint16_t)x1, index);
+}
+
+void PalettedFramebuffer::setPixel(int16_t x, int16_t y, uint8_t index) {
+  if (x < 0 || y < 0 || x >= width_ || y >= height_) return;
+  uint8_t *b = row((uint16_t)y) + (x >> 2);
+  uint8_t shift = (x & 3) * 2;
+  *b = (uint8_t)((*b & ~(3 << shift)) | ((index & 3) << shift));
+}
+
+void PalettedFramebuffer::expand(uint16_t x, uint16_t y, uint16_t w, uint16_t *out) const {
+  const uint8_t *r = row(y);
+  for (uint16_t i = 0; i < w; i++, x++) out[i] = palette_[(r[x >> 2] >> ((x & 3) * 2)) & 3];
+}
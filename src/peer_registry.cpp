@@ -0,0 +1,119 @@
+#include "peer_registry.h"
+
+#include <string.h>
+
+namespace {
+
+uint8_t macBucket(const uint8_t mac[6]) {
+  uint32_t h = 2166136261u;
+  for (int i = 0; i < 6; i++) h = (h ^ mac[i]) * 16777619u;
+  return (uint8_t)((h ^ (h >> 16)) & (PEER_REGISTRY_BUCKETS - 1));
+}
+
+// Entries may have been touched with a slightly later timestamp than nowMs.
+uint32_t idleFor(uint32_t nowMs, uint32_t lastSeenMs) {
+  return (int32_t)(nowMs - lastSeenMs) > 0 ? nowMs - lastSeenMs : 0;
+}
+
+} // namespace
+
+PeerRegistry::PeerRegistry() : count_(0), onEvict_(nullptr), onEvictCtx_(nullptr), evictCtx_(nullptr) {
+  memset(entries_, 0, sizeof(entries_));
+  for (uint8_t i = 0; i < PEER_REGISTRY_BUCKETS; i++) buckets_[i] = -1;
+}
+
+int8_t PeerRegistry::bucketOf(const uint8_t mac[6]) const {
+  uint8_t b = macBucket(mac);
+  while (buckets_[b] >= 0) {
+    if (memcmp(entries_[buckets_[b]].mac, mac, 6) == 0) return (int8_t)b;
+    b = (b + 1) & (PEER_REGISTRY_BUCKETS - 1);
+  }
+  return -1;
+}
+
+int8_t PeerRegistry::find(const uint8_t mac[6]) const {
+  int8_t b = bucketOf(mac);
+  return b < 0 ? -1 : buckets_[b];
+}
+
+int8_t PeerRegistry::touch(const uint8_t mac[6], uint32_t nowMs, uint32_t evictIdleMs, bool &added) {
+  added = false;
+  int8_t id = find(mac);
+  if (id >= 0) {
+    entries_[id].lastSeenMs = nowMs;
+    return id;
+  }
+
+  if (count_ >= PEER_REGISTRY_CAPACITY) {
+    int8_t victim = -1;
+    uint32_t victimIdle = 0;
+    for (uint8_t i = 0; i < PEER_REGISTRY_CAPACITY; i++) {
+      uint32_t idle = idleFor(nowMs, entries_[i].lastSeenMs);
+      if (entries_[i].used && idle >= evictIdleMs && (victim < 0 || idle > victimIdle)) {
+        victim = (int8_t)i;
+        victimIdle = idle;
+      }
+    }
+    if (victim < 0) return -1;
+    removeAt((uint8_t)victim);
+  }
+
+  for (uint8_t i = 0; i < PEER_REGISTRY_CAPACITY; i++) {
+    if (entries_[i].used) continue;
+    PeerEntry &e = entries_[i];
+    e.used = true;
+    memcpy(e.mac, mac, 6);
+    e.firstSeenMs = nowMs;
+    e.lastSeenMs = nowMs;
+    uint8_t b = macBucket(mac);
+    while (buckets_[b] >= 0) b = (b + 1) & (PEER_REGISTRY_BUCKETS - 1);
+    buckets_[b] = (int8_t)i;
+    count_++;
+    added = true;
+    return (int8_t)i;
+  }
+  return -1;
+}
+
+bool PeerRegistry::remove(const uint8_t mac[6]) {
+  int8_t id = find(mac);
+  if (id < 0) return false;
+  removeAt((uint8_t)id);
+  return true;
+}
+
+uint8_t PeerRegistry::expire(uint32_t nowMs, uint32_t maxIdleMs) {
+  uint8_t removed = 0;
+  for (uint8_t i = 0; i < PEER_REGISTRY_CAPACITY; i++) {
+    if (entries_[i].used && idleFor(nowMs, entries_[i].lastSeenMs) >= maxIdleMs) {
+      removeAt(i);
+      removed++;
+    }
+  }
+  return removed;
+}
+
+void PeerRegistry::removeAt(uint8_t id) {
+  PeerEntry &e = entries_[id];
+  int8_t hole = bucketOf(e.mac);
+  if (onEvict_ != nullptr) onEvict_(id, e.mac);
+  else if (onEvictCtx_ != nullptr) onEvictCtx_(evictCtx_, id, e.mac);
+  e.used = false;
+  count_--;
+  if (hole < 0) return;
+
+  // Backward-shift deletion: pull later members of the probe run into the hole.
+  uint8_t h = (uint8_t)hole;
+  buckets_[h] = -1;
+  uint8_t b = (h + 1) & (PEER_REGISTRY_BUCKETS - 1);
+  while (buckets_[b] >= 0) {
+    uint8_t home = macBucket(entries_[buckets_[b]].mac);
+    bool movable = (h <= b) ? (home <= h || home > b) : (home <= h && home > b);
+    if (movable) {
+      buckets_[h] = buckets_[b];
+      buckets_[b] = -1;
+      h = b;
+    }
+    b = (b + 1) & (PEER_REGISTRY_BUCKETS - 1);
+  }
+}
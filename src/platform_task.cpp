@@ -0,0 +1,71 @@
+#include "platform_task.h"
+
+#if defined(ARDUINO)
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+bool platformStartTask(const char *name, PlatformTaskFn fn, void *arg, uint32_t stackBytes, uint8_t priority) {
+  return xTaskCreate(fn, name, stackBytes, arg, priority, nullptr) == pdPASS;
+}
+
+void platformSleepMs(uint32_t ms) { vTaskDelay(pdMS_TO_TICKS(ms) ? pdMS_TO_TICKS(ms) : 1); }
+
+uint32_t platformMillis() { return millis(); }
+
+// Task notification of the waiting task; the handle is published on its first
+// wait, signals before that are dropped (the loop has not started yet).
+static TaskHandle_t volatile eventWaiter = nullptr;
+
+void platformWaitForEvent(uint32_t timeoutMs) {
+  eventWaiter = xTaskGetCurrentTaskHandle();
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+}
+
+void platformSignalEvent() {
+  TaskHandle_t waiter = eventWaiter;
+  if (waiter != nullptr) xTaskNotifyGive(waiter);
+}
+
+#else
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+bool platformStartTask(const char *name, PlatformTaskFn fn, void *arg, uint32_t stackBytes, uint8_t priority) {
+  (void)name;
+  (void)stackBytes;
+  (void)priority;
+  std::thread(fn, arg).detach();
+  return true;
+}
+
+void platformSleepMs(uint32_t ms) { std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+
+uint32_t platformMillis() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static std::mutex eventMutex;
+static std::condition_variable eventCv;
+static bool eventPending = false;
+
+void platformWaitForEvent(uint32_t timeoutMs) {
+  std::unique_lock<std::mutex> lock(eventMutex);
+  eventCv.wait_for(lock, std::chrono::milliseconds(timeoutMs), [] { return eventPending; });
+  eventPending = false;
+}
+
+void platformSignalEvent() {
+  {
+    std::lock_guard<std::mutex> lock(eventMutex);
+    eventPending = true;
+  }
+  eventCv.notify_one();
+}
+
+#endif
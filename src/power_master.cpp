@@ -0,0 +1,1079 @@
+#include "power_master.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const char *const SCHEDULE_STORE_KEY = "schedules";
+
+const uint32_t HELLO_PERIOD_MS = 800;
+const uint32_t TIME_SYNC_PERIOD_MS = 5000;
+const uint32_t PEER_EXPIRY_PERIOD_MS = 10000;
+const uint32_t TELEMETRY_PERIOD_MS = 1000;
+const uint32_t DIAG_PERIOD_MS = 60000;
+
+// These topics report individual events and must not be coalesced.
+const char *const MQTT_EVENT_SUFFIXES[] = {"schedule/slave/ack", "executed", "executed/lag", "schedule/mismatch"};
+
+MqttOutboxKind mqttKindOf(const char *suffix) {
+  for (const char *e : MQTT_EVENT_SUFFIXES) if (strcmp(suffix, e) == 0) return MQTT_OUTBOX_EVENT;
+  return MQTT_OUTBOX_STATE;
+}
+
+bool macEqual(const uint8_t a[6], const uint8_t b[6]) { return memcmp(a, b, 6) == 0; }
+
+bool payloadIs(const char *payload, size_t len, const char *literal) {
+  size_t n = strlen(literal);
+  return len == n && memcmp(payload, literal, n) == 0;
+}
+
+int16_t telemetryTenths(float v) {
+  if (isnan(v) || v < -3000.0f || v > 3000.0f) return TELEM_MISSING;
+  return (int16_t)lroundf(v * 10.0f);
+}
+
+} // namespace
+
+PowerMaster::PowerMaster(RadioHal &radio, MqttHal &mqtt, KvStoreHal &store, ClockHal &clock, EventScheduler &timers,
+                         uint8_t radioChannel)
+    : radio_(radio), mqtt_(mqtt), store_(store), clock_(clock), timers_(timers), radioChannel_(radioChannel),
+      log_(nullptr), routes_(RELAY_ROUTE_TTL_MS), routesToPublish_(0), router_("progetto/EVE/POWER/", POWER_RELAY_COUNT),
+      sendQueued_(0), nextBatchXfer_(0), schedulesDirty_(false), bulkRelays_(0), bulkOpen_(0), bulkFailed_(0), bulkUnchanged_(0),
+      snapshotDirty_(true), snapshotCheck_(false), retainedPublished_(false), retainedDrops_(0),
+      batchTimer_(-1), snapshotTimer_(-1), persistTimer_(-1), lastTelemetryAt_(0) {
+  memset(active_, 0, sizeof(active_));
+  memset(pending_, 0, sizeof(pending_));
+  memset(bulk_, 0, sizeof(bulk_));
+  memset(index_, 0, sizeof(index_));
+  memset(waitingAck_, 0, sizeof(waitingAck_));
+  memset(sendAttempts_, 0, sizeof(sendAttempts_));
+  memset(firstFrame_, 0, sizeof(firstFrame_));
+  memset(peerFrames_, 0, sizeof(peerFrames_));
+  memset(sentAtMs_, 0, sizeof(sentAtMs_));
+  memset(relayState_, SNAPSHOT_STATE_UNKNOWN, sizeof(relayState_));
+  memset(ackStatus_, SNAPSHOT_ACK_NONE, sizeof(ackStatus_));
+  memset(transferId_, 0, sizeof(transferId_));
+  memset(fragmentsHeld_, 0, sizeof(fragmentsHeld_));
+  memset(batchXfer_, 0, sizeof(batchXfer_));
+  memset(&lastTelemetry_, 0, sizeof(lastTelemetry_));
+  lastTelemetry_.t = NAN;
+  lastTelemetry_.h = NAN;
+  for (uint8_t i = 0; i < TELEMETRY_MAX_SLAVES; i++) telemetryOwner_[i] = -1;
+  for (uint8_t i = 0; i < POWER_RELAY_COUNT; i++) {
+    ackTimer_[i] = -1;
+    ackTimerCtx_[i].self = this;
+    ackTimerCtx_[i].relay = (uint8_t)(i + 1);
+  }
+
+  peers_.setEvictHandler(onPeerEvicted, this);
+  router_.addRelayRoute("set", onRelaySet, this);
+  router_.addRelayRoute("schedule/set", onScheduleSet, this);
+  router_.addRoute("schedule/set", onBulkScheduleSet, this);
+  router_.formatTopic(snapshotTopic_, sizeof(snapshotTopic_), "snapshot");
+}
+
+void PowerMaster::logf(const char *fmt, ...) {
+  if (log_ == nullptr) return;
+  char line[160];
+  va_list ap;
+  va_start(ap, fmt);
+  vsnprintf(line, sizeof(line), fmt, ap);
+  va_end(ap);
+  log_(line);
+}
+
+// ---- Timers ------------------------------------------------------------------
+
+void PowerMaster::onHelloTimer(void *ctx) { static_cast<PowerMaster *>(ctx)->sendHello(); }
+void PowerMaster::onTimeSyncTimer(void *ctx) { static_cast<PowerMaster *>(ctx)->sendTimeSync(); }
+void PowerMaster::onTelemetryTimer(void *ctx) { static_cast<PowerMaster *>(ctx)->publishTelemetry(); }
+void PowerMaster::onBatchTimer(void *ctx) { static_cast<PowerMaster *>(ctx)->flushScheduleSends(); }
+void PowerMaster::onPersistTimer(void *ctx) { static_cast<PowerMaster *>(ctx)->flushSchedules(); }
+
+void PowerMaster::onAckTimer(void *ctx) {
+  AckTimer *t = static_cast<AckTimer *>(ctx);
+  t->self->onAckTimeout(t->relay);
+}
+
+void PowerMaster::onSnapshotTimer(void *ctx) {
+  PowerMaster *self = static_cast<PowerMaster *>(ctx);
+  if (!self->snapshotCheck_) return;
+  self->endSnapshotCheck();
+  self->logf("[MQTT] no retained snapshot, republishing");
+  self->publishRetainedState();
+}
+
+void PowerMaster::onExpiryTimer(void *ctx) {
+  PowerMaster *self = static_cast<PowerMaster *>(ctx);
+  uint32_t now = self->clock_.millis();
+  self->peers_.expire(now, PEER_EXPIRE_MS);
+  self->routesToPublish_ |= self->routes_.expire(now);
+}
+
+void PowerMaster::onDiagTimer(void *ctx) {
+  PowerMaster *self = static_cast<PowerMaster *>(ctx);
+  self->routesToPublish_ = (1u << POWER_RELAY_COUNT) - 1;
+  self->publishOutboxStats();
+  self->publishPeerClocks();
+}
+
+// ---- MQTT ------------------------------------------------------------------
+
+void PowerMaster::onRelaySet(void *ctx, uint8_t relay, const char *payload, size_t len) {
+  static_cast<PowerMaster *>(ctx)->handleRelaySet(relay, payload, len);
+}
+
+void PowerMaster::onScheduleSet(void *ctx, uint8_t relay, const char *payload, size_t len) {
+  static_cast<PowerMaster *>(ctx)->handleScheduleSet(relay, payload, len);
+}
+
+void PowerMaster::onBulkScheduleSet(void *ctx, uint8_t, const char *payload, size_t len) {
+  static_cast<PowerMaster *>(ctx)->handleBulkScheduleSet(payload, len);
+}
+
+bool PowerMaster::sendQueued(void *ctx, const char *topic, const uint8_t *payload, size_t len, bool retained) {
+  return static_cast<PowerMaster *>(ctx)->mqtt_.publish(topic, payload, len, retained);
+}
+
+bool PowerMaster::onMqttMessage(const char *topic, const uint8_t *payload, size_t len) {
+  if (snapshotCheck_ && strcmp(topic, snapshotTopic_) == 0) {
+    handleBrokerSnapshot(payload, len);
+    return true;
+  }
+  return router_.dispatch(topic, payload, len);
+}
+
+void PowerMaster::onMqttConnected() {
+  char topic[96];
+  for (uint8_t i = 0; i < router_.filterCount(); i++) {
+    if (router_.filterTopic(i, topic, sizeof(topic))) mqtt_.subscribe(topic);
+  }
+  routesToPublish_ = (1u << POWER_RELAY_COUNT) - 1;
+  // Anything the outbox dropped may have been retained state the snapshot
+  // already counts as published, so matching versions prove nothing then.
+  if (!retainedPublished_ || outbox_.stats().dropped != retainedDrops_ || !mqtt_.subscribe(snapshotTopic_)) {
+    publishRetainedState();
+    return;
+  }
+  snapshotCheck_ = true;
+  timers_.armIn(snapshotTimer_, clock_.millis(), SNAPSHOT_CHECK_MS);
+}
+
+// The broker's retained snapshot, read back once per reconnect. The same
+// version means every retained topic it covers is already current there; only
+// the next-switch hints, which depend on the time, are refreshed.
+void PowerMaster::handleBrokerSnapshot(const uint8_t *payload, size_t len) {
+  uint32_t version = 0;
+  bool same = StateSnapshot::parseVersion((const char *)payload, len, version) && version == snapshot_.version();
+  endSnapshotCheck();
+  if (!same) {
+    logf("[MQTT] broker snapshot differs, republishing");
+    publishRetainedState();
+    return;
+  }
+  for (uint8_t r = 1; r <= POWER_RELAY_COUNT; r++) publishNextTransition(r);
+  logf("[MQTT] broker snapshot %08lx current, republish skipped", (unsigned long)version);
+}
+
+void PowerMaster::endSnapshotCheck() {
+  snapshotCheck_ = false;
+  timers_.disarm(snapshotTimer_);
+  mqtt_.unsubscribe(snapshotTopic_);
+}
+
+uint8_t PowerMaster::drainOutbox(uint8_t maxMessages) {
+  if (!mqtt_.connected()) return 0;
+  if (snapshotDirty_ && !snapshotCheck_) publishSnapshot();
+  if (routesToPublish_) {
+    for (uint8_t r = 1; r <= POWER_RELAY_COUNT; r++) if ((routesToPublish_ >> (r - 1)) & 1) publishRoute(r);
+    routesToPublish_ = 0;
+  }
+  return outbox_.drain(sendQueued, this, maxMessages);
+}
+
+bool PowerMaster::publish(const char *suffix, const char *payload, size_t len, bool retained) {
+  char topic[96];
+  if (router_.formatTopic(topic, sizeof(topic), suffix) == 0) return false;
+  return outbox_.enqueue(topic, payload, len, retained, mqttKindOf(suffix));
+}
+
+void PowerMaster::publishRelay(uint8_t relay, const char *suffix, const char *payload, bool retained) {
+  char topic[96];
+  if (router_.formatRelayTopic(topic, sizeof(topic), relay, suffix) == 0) return;
+  outbox_.enqueue(topic, payload, strlen(payload), retained, mqttKindOf(suffix));
+}
+
+void PowerMaster::publishOutboxStats() {
+  const MqttOutboxStats &st = outbox_.stats();
+  char json[192];
+  int n = snprintf(json, sizeof(json),
+                   "{\"depth\":%u,\"bytes\":%u,\"high_water\":%u,\"enqueued\":%lu,\"sent\":%lu,\"coalesced\":%lu,"
+                   "\"dropped\":%lu,\"failures\":%lu}",
+                   outbox_.depth(), outbox_.bytesUsed(), st.highWater, (unsigned long)st.enqueued,
+                   (unsigned long)st.sent, (unsigned long)st.coalesced, (unsigned long)st.dropped,
+                   (unsigned long)st.sendFailures);
+  if (n > 0 && (size_t)n < sizeof(json)) publish("diag/mqtt", json, (size_t)n, true);
+}
+
+// One retained document per slave that syncs with us: how far its clock is
+// from ours, how fast it drifts and the best round trip seen.
+void PowerMaster::publishPeerClocks() {
+  for (uint8_t i = 0; i < PEER_REGISTRY_CAPACITY; i++) {
+    const PeerEntry &p = peers_.entry(i);
+    const TimeSyncEstimator &est = peerClock_[i].est;
+    if (!p.used || !est.valid()) continue;
+    char suffix[32];
+    char json[112];
+    snprintf(suffix, sizeof(suffix), "diag/clock/%02X%02X%02X%02X%02X%02X", p.mac[0], p.mac[1], p.mac[2], p.mac[3],
+             p.mac[4], p.mac[5]);
+    int n = snprintf(json, sizeof(json), "{\"offset_ms\":%ld,\"rtt_ms\":%lu,\"skew_ppm\":%ld,\"samples\":%lu}",
+                     (long)est.offsetMs(), (unsigned long)est.delayMs(), (long)est.skewPpm(),
+                     (unsigned long)est.samples());
+    if (n > 0 && (size_t)n < sizeof(json)) publish(suffix, json, (size_t)n, true);
+  }
+}
+
+// ---- Peers and routes --------------------------------------------------------
+
+void PowerMaster::onPeerEvicted(void *ctx, uint8_t id, const uint8_t mac[6]) {
+  static_cast<PowerMaster *>(ctx)->evictPeer(id, mac);
+}
+
+void PowerMaster::evictPeer(uint8_t id, const uint8_t mac[6]) {
+  radio_.removePeer(mac);
+  routesToPublish_ |= routes_.forgetMac(mac);
+  peerRtt_[id].reset();
+  peerClock_[id] = PeerClock();
+  peerTx_[id] = PeerTx();
+  peerFrames_[id] = 0;
+  for (uint8_t i = 0; i < TELEMETRY_MAX_SLAVES; i++) {
+    if (telemetryOwner_[i] == (int8_t)id) telemetryOwner_[i] = -1;
+  }
+  logf("[PEER] evicted id=%u %02X:%02X:%02X:%02X:%02X:%02X", id, mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+}
+
+bool PowerMaster::addPeerIfNeeded(const uint8_t mac[6]) {
+  bool added = false;
+  int8_t id = peers_.touch(mac, clock_.millis(), PEER_EVICT_IDLE_MS, added);
+  if (id < 0) return false;
+  if (!added) return true;
+  if (radio_.addPeer(mac)) return true;
+  peers_.remove(mac);
+  return false;
+}
+
+bool PowerMaster::sendToAllPeers(const uint8_t *data, size_t len) {
+  bool sent = false;
+  for (uint8_t i = 0; i < PEER_REGISTRY_CAPACITY; i++) {
+    const PeerEntry &p = peers_.entry(i);
+    if (!p.used) continue;
+    if (sendToPeer(p.mac, data, len, 0)) sent = true;
+  }
+  return sent;
+}
+
+// MAC of the registered slave that owns the relay, nullptr while unknown.
+const uint8_t *PowerMaster::routedMac(uint8_t relay) {
+  const uint8_t *mac = routes_.lookup(relay, clock_.millis());
+  return mac != nullptr && peers_.find(mac) >= 0 ? mac : nullptr;
+}
+
+// Unicast to the slave that owns the relay once it is known; fan out to every
+// peer only until a route has been learned (discovery). schedule marks frames
+// carrying the relay's pending table.
+bool PowerMaster::sendToRelay(uint8_t relay, const uint8_t *data, size_t len, bool schedule) {
+  const uint8_t *mac = routedMac(relay);
+  if (mac != nullptr) {
+    routes_.countUnicast(relay);
+    return sendToPeer(mac, data, len, schedule ? (uint8_t)(1u << (relay - 1)) : 0);
+  }
+  routes_.countFanout(relay);
+  return sendToAllPeers(data, len);
+}
+
+// Every unicast goes through here so onRadioSent can tell which kind of frame
+// a delivery report may belong to.
+bool PowerMaster::sendToPeer(const uint8_t mac[6], const uint8_t *data, size_t len, uint8_t scheduleRelays) {
+  if (!radio_.send(mac, data, len)) return false;
+  int8_t id = peers_.find(mac);
+  if (id < 0) return true;
+  PeerTx &tx = peerTx_[id];
+  uint32_t now = clock_.millis();
+  if (tx.inFlight > 0 && now - tx.lastSendMs > TX_REPORT_STALE_MS) tx = PeerTx();
+  if (tx.inFlight < 0xFF) tx.inFlight++;
+  if (scheduleRelays == 0) {
+    tx.scheduleRun = 0;
+    tx.scheduleMask = 0;
+  } else {
+    if (tx.scheduleRun < 0xFF) tx.scheduleRun++;
+    tx.scheduleMask |= scheduleRelays;
+  }
+  tx.lastSendMs = now;
+  return true;
+}
+
+void PowerMaster::learnRoute(uint8_t relay, const uint8_t mac[6], uint32_t atMs) {
+  if (routes_.learn(relay, mac, atMs)) routesToPublish_ |= (uint8_t)(1u << (relay - 1));
+}
+
+void PowerMaster::publishRoute(uint8_t relay) {
+  const RelayRoute &r = routes_.route(relay);
+  char mac[20] = "null";
+  if (r.known) {
+    snprintf(mac, sizeof(mac), "\"%02X:%02X:%02X:%02X:%02X:%02X\"", r.mac[0], r.mac[1], r.mac[2], r.mac[3], r.mac[4],
+             r.mac[5]);
+  }
+  char json[192];
+  snprintf(json, sizeof(json),
+           "{\"mac\":%s,\"age_s\":%lu,\"unicast\":%lu,\"fanout\":%lu,\"changes\":%lu,\"expiries\":%lu}", mac,
+           r.known ? (unsigned long)((clock_.millis() - r.learnedMs) / 1000) : 0UL, (unsigned long)r.unicastSends,
+           (unsigned long)r.fanoutSends, (unsigned long)r.changes, (unsigned long)r.expiries);
+  publishRelay(relay, "route", json, true);
+}
+
+// ---- Persistence -------------------------------------------------------------
+
+void PowerMaster::markSchedulesDirty() {
+  if (schedulesDirty_) return;
+  schedulesDirty_ = true;
+  if (bulkOpen_ == 0) timers_.armIn(persistTimer_, clock_.millis(), SCHEDULE_PERSIST_DELAY_MS);
+}
+
+void PowerMaster::flushSchedules() {
+  if (!schedulesDirty_) return;
+  timers_.disarm(persistTimer_);
+  size_t n = encodeScheduleStore(active_, POWER_RELAY_COUNT, scratch_.store, sizeof(scratch_.store));
+  if (n == 0 || store_.putBytes(SCHEDULE_STORE_KEY, scratch_.store, n) != n) {
+    logf("[SCHEDULE] persist failed");
+    timers_.armIn(persistTimer_, clock_.millis(), SCHEDULE_PERSIST_DELAY_MS);
+    return;
+  }
+  schedulesDirty_ = false;
+  logf("[SCHEDULE] persisted bytes=%u", (unsigned)n);
+}
+
+// Legacy per-relay JSON keys, read only when the binary record is missing,
+// corrupt or from another version; the next flush migrates them.
+void PowerMaster::loadLegacySchedules() {
+  for (uint8_t r = 1; r <= POWER_RELAY_COUNT; r++) {
+    char key[16];
+    char *raw = scratch_.scheduleJson;
+    const char *err = "";
+    snprintf(key, sizeof(key), "schedule_%u", r);
+    size_t n = store_.hasKey(key) ? store_.getString(key, raw, sizeof(scratch_.scheduleJson)) : 0;
+    if (n == 0 || !parseScheduleJson(raw, strlen(raw), active_[r - 1], err)) active_[r - 1].count = 0;
+  }
+}
+
+void PowerMaster::begin() {
+  uint32_t now = clock_.millis();
+  timers_.every(onHelloTimer, this, HELLO_PERIOD_MS, now);
+  timers_.every(onTimeSyncTimer, this, TIME_SYNC_PERIOD_MS, now);
+  timers_.every(onExpiryTimer, this, PEER_EXPIRY_PERIOD_MS, now);
+  timers_.every(onTelemetryTimer, this, TELEMETRY_PERIOD_MS, now);
+  timers_.every(onDiagTimer, this, DIAG_PERIOD_MS, now);
+  batchTimer_ = timers_.add(onBatchTimer, this);
+  snapshotTimer_ = timers_.add(onSnapshotTimer, this);
+  persistTimer_ = timers_.add(onPersistTimer, this);
+  for (uint8_t i = 0; i < POWER_RELAY_COUNT; i++) ackTimer_[i] = timers_.add(onAckTimer, &ackTimerCtx_[i]);
+
+  bool loaded = false;
+  if (store_.hasKey(SCHEDULE_STORE_KEY)) {
+    size_t n = store_.getBytes(SCHEDULE_STORE_KEY, scratch_.store, sizeof(scratch_.store));
+    loaded = decodeScheduleStore(scratch_.store, n, active_, POWER_RELAY_COUNT);
+    if (!loaded) logf("[SCHEDULE] store invalid, falling back to JSON keys");
+  }
+  if (!loaded) {
+    loadLegacySchedules();
+    markSchedulesDirty();
+  }
+  for (uint8_t r = 0; r < POWER_RELAY_COUNT; r++) buildScheduleIndex(active_[r], index_[r]);
+  for (uint8_t r = 1; r <= POWER_RELAY_COUNT; r++) refreshSnapshot(r);
+}
+
+// ---- Retained schedule state -------------------------------------------------
+
+// Retained "next switch" hint for the app, from the compiled schedule index.
+void PowerMaster::publishNextTransition(uint8_t relay) {
+  uint8_t weekday = 0;
+  uint16_t minute = 0;
+  PowerScheduleTransition next{};
+  char json[64] = "{}";
+  if (clock_.localWeekTime(weekday, minute) && scheduleNextTransition(index_[relay - 1], weekday, minute, next)) {
+    uint16_t m = next.weekMinute % POWER_MINUTES_PER_DAY;
+    snprintf(json, sizeof(json), "{\"weekday\":%u,\"at\":\"%02u:%02u\",\"state\":\"%s\"}",
+             next.weekMinute / POWER_MINUTES_PER_DAY, m / 60, m % 60, next.state ? "ON" : "OFF");
+  }
+  publishRelay(relay, "schedule/next", json, true);
+}
+
+void PowerMaster::publishScheduleCurrent(uint8_t relay) {
+  char *json = scratch_.scheduleJson;
+  if (writeScheduleJson(active_[relay - 1], json, sizeof(scratch_.scheduleJson)) == 0) return;
+  publishRelay(relay, "schedule/current", json, true);
+}
+
+// Everything retained per relay, then the snapshot describing it.
+void PowerMaster::publishRetainedState() {
+  retainedDrops_ = outbox_.stats().dropped;
+  for (uint8_t r = 1; r <= POWER_RELAY_COUNT; r++) {
+    publishScheduleCurrent(r);
+    publishNextTransition(r);
+    if (relayState_[r - 1] != SNAPSHOT_STATE_UNKNOWN) publishRelay(r, "state", relayState_[r - 1] ? "ON" : "OFF", true);
+  }
+  snapshotDirty_ = true;
+  retainedPublished_ = true;
+}
+
+// ---- State snapshot ------------------------------------------------------------
+
+void PowerMaster::publishAck(uint8_t relay, SnapshotAck ack) {
+  publishRelay(relay, "schedule/slave/ack", snapshotAckName(ack));
+  if (ack != SNAPSHOT_ACK_PENDING) ackStatus_[relay - 1] = (uint8_t)ack;
+  refreshSnapshot(relay);
+}
+
+// Re-renders the relay's part of the snapshot when it changed; PENDING shows
+// while a table is in flight, the last outcome otherwise.
+void PowerMaster::refreshSnapshot(uint8_t relay) {
+  uint8_t idx = relay - 1;
+  SnapshotRelay r;
+  r.state = relayState_[idx];
+  r.ack = waitingAck_[idx] ? (uint8_t)SNAPSHOT_ACK_PENDING : ackStatus_[idx];
+  r.rules = active_[idx].count;
+  r.scheduleHash = scheduleHash(active_[idx]);
+  if (snapshot_.update(relay, r)) snapshotDirty_ = true;
+}
+
+void PowerMaster::publishSnapshot() {
+  size_t n = snapshot_.write(scratch_.snapshotJson, sizeof(scratch_.snapshotJson));
+  if (n > 0 && publish("snapshot", scratch_.snapshotJson, n, true)) snapshotDirty_ = false;
+}
+
+// ---- Schedule pipeline -------------------------------------------------------
+
+bool PowerMaster::sendRulesPacket(uint8_t relay, const PowerRelaySchedule &schedule) {
+  PowerRelayRulesPacket pkt{};
+  if (!buildRulesPacket(relay, schedule, clock_.millis(), pkt)) return false;
+  bool sent = sendToRelay(relay, (const uint8_t *)&pkt, sizeof(pkt), true);
+  logf("[SCHEDULE] relay=%u send type14 count=%u sent=%d", relay, pkt.count, sent);
+  return sent;
+}
+
+// Sends the fragments of the pending table the slave has not confirmed yet,
+// all of them on the first attempt.
+bool PowerMaster::sendRuleFragments(uint8_t relay) {
+  uint8_t idx = relay - 1;
+  const PowerRelaySchedule &s = pending_[idx];
+  uint8_t total = ruleFragmentCount(s.count);
+  uint8_t buf[POWER_FRAGMENT_FRAME_MAX];
+  uint8_t frames = 0;
+  bool sent = total > 0;
+  for (uint8_t i = 0; i < total; i++) {
+    if (fragmentsHeld_[idx] & (1u << i)) continue;
+    size_t n = encodeRuleFragment(relay, transferId_[idx], s.rules, s.count, i, clock_.millis(), buf, sizeof(buf));
+    sent = n > 0 && sendToRelay(relay, buf, n, true) && sent;
+    frames++;
+  }
+  logf("[SCHEDULE] relay=%u send type20 xfer=%u rules=%u fragments=%u/%u sent=%d", relay, transferId_[idx], s.count,
+       frames, total, sent);
+  return sent;
+}
+
+int8_t PowerMaster::routedPeer(uint8_t relay) {
+  const uint8_t *mac = routedMac(relay);
+  return mac != nullptr ? peers_.find(mac) : -1;
+}
+
+// Unrouted relays fan out and probe: whoever answers becomes the route.
+bool PowerMaster::peerLacks(uint8_t relay, uint8_t frameBit) {
+  int8_t id = routedPeer(relay);
+  return id >= 0 && (peerFrames_[id] & frameBit) != 0;
+}
+
+// Called for every ACK of a pending transfer, before it is committed. An ACK
+// to the first send proves the optional frame; one that only came after the
+// type-14 retries marks it missing unless the peer proved it before (a lost
+// frame on a capable peer looks the same).
+void PowerMaster::notePeerFrames(uint8_t idx, int8_t peerId, uint8_t ackType, bool baseMismatch) {
+  if (peerId < 0) return;
+  uint8_t &f = peerFrames_[peerId];
+  if (ackType == POWER_MULTI_ACK_TYPE) {
+    f = (uint8_t)((f | PEER_CAN_MULTI) & ~PEER_LACKS_MULTI);
+    return;
+  }
+  bool retried = sendAttempts_[idx] > 1;
+  if (firstFrame_[idx] == POWER_DELTA_RULES_TYPE) {
+    if (!retried || baseMismatch) f = (uint8_t)((f | PEER_CAN_DELTA) & ~PEER_LACKS_DELTA);
+    else if (!(f & PEER_CAN_DELTA)) f |= PEER_LACKS_DELTA;
+  } else if (firstFrame_[idx] == POWER_MULTI_RULES_TYPE && retried && !(f & PEER_CAN_MULTI)) {
+    f |= PEER_LACKS_MULTI;
+  }
+}
+
+uint32_t PowerMaster::relayRtoMs(uint8_t relay) {
+  int8_t id = routedPeer(relay);
+  return id >= 0 ? peerRtt_[id].timeoutMs() : RTT_INITIAL_RTO_MS;
+}
+
+// Arms the ACK deadline for the next send of the pending schedule: the RTO of
+// the routed slave for the first send, then jittered exponential backoff.
+void PowerMaster::armScheduleAttempt(uint8_t relay, uint32_t now) {
+  uint8_t idx = relay - 1;
+  uint32_t rto = relayRtoMs(relay);
+  sentAtMs_[idx] = now;
+  timers_.armIn(ackTimer_[idx], now, backoffDelayMs(rto, sendAttempts_[idx], RTT_MAX_RTO_MS, clock_.random()));
+  sendAttempts_[idx]++;
+}
+
+// Single-relay send; retries always use it so slaves without type-17 support
+// still converge after the first timeout. The first send is a type-19 delta
+// against the last acknowledged table when that is smaller than type 14 and
+// the peer is not known to lack type 19; retries and base mismatches carry
+// the full table. Tables too long for type 14 always travel as type-20
+// fragments.
+bool PowerMaster::sendScheduleAttempt(uint8_t relay) {
+  uint8_t idx = relay - 1;
+  bool first = sendAttempts_[idx] == 0;
+  armScheduleAttempt(relay, clock_.millis());
+  if (pending_[idx].count > POWER_RULES_PACKET_MAX) {
+    if (first) firstFrame_[idx] = POWER_FRAGMENT_TYPE;
+    return sendRuleFragments(relay);
+  }
+  if (first) firstFrame_[idx] = POWER_RULES_TYPE;
+  if (first && !peerLacks(relay, PEER_LACKS_DELTA)) {
+    uint8_t buf[POWER_DELTA_PACKET_MAX];
+    size_t n = buildDeltaPacket(relay, active_[idx], pending_[idx], clock_.millis(), buf, sizeof(buf));
+    if (n > 0 && n < sizeof(PowerRelayRulesPacket)) {
+      firstFrame_[idx] = POWER_DELTA_RULES_TYPE;
+      bool sent = sendToRelay(relay, buf, n, true);
+      logf("[SCHEDULE] relay=%u send type19 edits=%u bytes=%u sent=%d", relay, buf[14], (unsigned)n, sent);
+      return sent;
+    }
+  }
+  return sendRulesPacket(relay, pending_[idx]);
+}
+
+// One type-17 frame for every relay in mask; they share the same route (mac,
+// or nullptr to fan out). When the tables do not fit in one frame each relay
+// is sent on its own.
+bool PowerMaster::sendScheduleBatch(uint8_t mask, const uint8_t *mac) {
+  uint8_t buf[POWER_MULTI_RULES_MAX];
+  uint32_t now = clock_.millis();
+  if (++nextBatchXfer_ == 0) nextBatchXfer_ = 1;
+  uint8_t xfer = nextBatchXfer_;
+  size_t n = encodeMultiRulesPacket(pending_, mask, xfer, now, buf, sizeof(buf));
+  if (n == 0) {
+    bool sent = true;
+    for (uint8_t relay = 1; relay <= POWER_RELAY_COUNT; relay++) {
+      if (mask & (1u << (relay - 1))) sent = sendScheduleAttempt(relay) && sent;
+    }
+    return sent;
+  }
+  for (uint8_t relay = 1; relay <= POWER_RELAY_COUNT; relay++) {
+    if (!(mask & (1u << (relay - 1)))) continue;
+    if (sendAttempts_[relay - 1] == 0) firstFrame_[relay - 1] = POWER_MULTI_RULES_TYPE;
+    batchXfer_[relay - 1] = xfer;
+    armScheduleAttempt(relay, now);
+    if (mac != nullptr) routes_.countUnicast(relay);
+    else routes_.countFanout(relay);
+  }
+  bool sent = mac != nullptr ? sendToPeer(mac, buf, n, mask) : sendToAllPeers(buf, n);
+  logf("[SCHEDULE] relays=0x%02X send type17 xfer=%u bytes=%u sent=%d", mask, xfer, (unsigned)n, sent);
+  return sent;
+}
+
+void PowerMaster::beginScheduleTransfer(uint8_t relay, const PowerRelaySchedule &table) {
+  uint8_t idx = relay - 1;
+  pending_[idx] = table;
+  waitingAck_[idx] = true;
+  sendAttempts_[idx] = 0;
+  transferId_[idx]++;
+  fragmentsHeld_[idx] = 0;
+  batchXfer_[idx] = 0;
+  refreshSnapshot(relay);
+}
+
+void PowerMaster::queueScheduleSend(uint8_t relay) {
+  if (sendQueued_ == 0) timers_.armIn(batchTimer_, clock_.millis(), SCHEDULE_BATCH_WINDOW_MS);
+  sendQueued_ |= (uint8_t)(1u << (relay - 1));
+}
+
+// Groups the queued relays by destination slave: one frame per group, a plain
+// single-relay send when the group holds one relay. Tables that need
+// fragments are never grouped.
+void PowerMaster::flushScheduleSends() {
+  if (sendQueued_ == 0) return;
+  uint8_t remaining = sendQueued_;
+  sendQueued_ = 0;
+  while (remaining) {
+    uint8_t first = 1;
+    while (!(remaining & (1u << (first - 1)))) first++;
+    const uint8_t *mac = routedMac(first);
+    uint8_t group = 0;
+    bool alone = pending_[first - 1].count > POWER_RULES_PACKET_MAX;
+    for (uint8_t relay = first; relay <= POWER_RELAY_COUNT; relay++) {
+      if (!(remaining & (1u << (relay - 1)))) continue;
+      if (relay != first && (alone || pending_[relay - 1].count > POWER_RULES_PACKET_MAX)) continue;
+      const uint8_t *other = routedMac(relay);
+      if (mac == nullptr ? other == nullptr : (other != nullptr && macEqual(mac, other))) {
+        group |= (uint8_t)(1u << (relay - 1));
+      }
+    }
+    remaining &= (uint8_t)~group;
+
+    bool sent = true;
+    if (!(group & (group - 1))) {
+      sent = sendScheduleAttempt(first);
+    } else if (!peerLacks(first, PEER_LACKS_MULTI)) {
+      sent = sendScheduleBatch(group, mac);
+    } else {
+      for (uint8_t relay = first; relay <= POWER_RELAY_COUNT; relay++) {
+        if (group & (1u << (relay - 1))) sent = sendScheduleAttempt(relay) && sent;
+      }
+    }
+    if (sent) continue;
+    for (uint8_t relay = 1; relay <= POWER_RELAY_COUNT; relay++) {
+      if (!(group & (1u << (relay - 1)))) continue;
+      logf("[SCHEDULE] relay=%u send failed", relay);
+      publishAck(relay, SNAPSHOT_ACK_ERROR);
+    }
+  }
+}
+
+// Karn's rule: an ACK after a retransmission cannot be matched to a send.
+void PowerMaster::sampleAckRtt(uint8_t idx, int8_t peerId, uint32_t atMs) {
+  if (peerId >= 0 && sendAttempts_[idx] == 1 && (int32_t)(atMs - sentAtMs_[idx]) >= 0) {
+    peerRtt_[peerId].sample(atMs - sentAtMs_[idx]);
+  }
+}
+
+void PowerMaster::commitScheduleResult(uint8_t relay, bool ok) {
+  uint8_t idx = relay - 1;
+  waitingAck_[idx] = false;
+  timers_.disarm(ackTimer_[idx]);
+  if (ok) {
+    active_[idx] = pending_[idx];
+    buildScheduleIndex(active_[idx], index_[idx]);
+    markSchedulesDirty();
+    publishAck(relay, SNAPSHOT_ACK_OK);
+    publishRelay(relay, "schedule", "OK SCHEDULAZIONE", true);
+    publishScheduleCurrent(relay);
+    publishNextTransition(relay);
+  } else {
+    publishAck(relay, SNAPSHOT_ACK_ERROR);
+  }
+  settleBulk(relay, ok);
+}
+
+// A relay queued again for the batch window is not awaiting this deadline;
+// the batch re-arms it.
+void PowerMaster::onAckTimeout(uint8_t relay) {
+  uint8_t idx = relay - 1;
+  if (!awaiting(idx)) return;
+  if (sendAttempts_[idx] <= SCHEDULE_RETRY_BUDGET) {
+    sendScheduleAttempt(relay);
+    logf("[SCHEDULE] relay=%u retry %u/%u wait=%lu", relay, sendAttempts_[idx] - 1, SCHEDULE_RETRY_BUDGET,
+         (unsigned long)(timers_.dueAt(ackTimer_[idx]) - sentAtMs_[idx]));
+  } else {
+    waitingAck_[idx] = false;
+    if (routes_.invalidate(relay)) routesToPublish_ |= (uint8_t)(1u << idx);
+    publishAck(relay, SNAPSHOT_ACK_ERROR);
+    logf("[SCHEDULE] relay=%u timeout", relay);
+    settleBulk(relay, false);
+  }
+}
+
+void PowerMaster::handleScheduleAck(const PowerScheduleAckPacket &ack, int8_t peerId, uint32_t atMs) {
+  if (ack.ch < 1 || ack.ch > POWER_RELAY_COUNT) return;
+  uint8_t idx = ack.ch - 1;
+  if (!awaiting(idx)) return;
+
+  sampleAckRtt(idx, peerId, atMs);
+  notePeerFrames(idx, peerId, POWER_ACK_TYPE, ack.ok == POWER_ACK_BASE_MISMATCH);
+  if (ack.ok == POWER_ACK_BASE_MISMATCH) {
+    // The slave's table is not the one the delta was built on: resend in full.
+    logf("[SCHEDULE_ACK] relay=%u delta base mismatch, sending full table", ack.ch);
+    sendScheduleAttempt(ack.ch);
+    return;
+  }
+  commitScheduleResult(ack.ch, ack.ok == 1);
+  logf("[SCHEDULE_ACK] relay=%u ok=%u count=%u ms=%lu rtt=%lu attempts=%u", ack.ch, ack.ok, ack.count,
+       (unsigned long)ack.ms, (unsigned long)(atMs - sentAtMs_[idx]), sendAttempts_[idx]);
+}
+
+// Fragment ACKs that report new fragments push the deadline out by one RTO
+// without spending an attempt; the timeout then resends only what is missing.
+void PowerMaster::handleFragmentAck(const PowerFragmentAckPacket &ack, int8_t peerId, uint32_t atMs) {
+  if (ack.ch < 1 || ack.ch > POWER_RELAY_COUNT) return;
+  uint8_t idx = ack.ch - 1;
+  if (!awaiting(idx) || ack.xfer != transferId_[idx]) return;
+
+  if (ack.ok == POWER_ACK_INCOMPLETE) {
+    if ((ack.received & ~fragmentsHeld_[idx]) == 0) return;
+    if (fragmentsHeld_[idx] == 0) sampleAckRtt(idx, peerId, atMs);
+    fragmentsHeld_[idx] |= ack.received;
+    timers_.armIn(ackTimer_[idx], atMs, relayRtoMs(ack.ch));
+    return;
+  }
+  if (fragmentsHeld_[idx] == 0) sampleAckRtt(idx, peerId, atMs);
+  commitScheduleResult(ack.ch, ack.ok == 1);
+  logf("[SCHEDULE_ACK] relay=%u xfer=%u ok=%u ms=%lu rtt=%lu attempts=%u", ack.ch, ack.xfer, ack.ok,
+       (unsigned long)ack.ms, (unsigned long)(atMs - sentAtMs_[idx]), sendAttempts_[idx]);
+}
+
+// Only relays whose pending table went out in the echoed frame are settled: a
+// late ACK for an earlier batch must not commit a newer table.
+void PowerMaster::handleMultiScheduleAck(const PowerMultiScheduleAckPacket &ack, int8_t peerId, uint32_t atMs) {
+  bool sampled = false;
+  for (uint8_t relay = 1; relay <= POWER_RELAY_COUNT; relay++) {
+    uint8_t idx = relay - 1;
+    if (!(ack.relayMask & (1u << idx)) || !awaiting(idx)) continue;
+    if (ack.xfer == 0 || ack.xfer != batchXfer_[idx]) continue;
+    if (!sampled) { sampleAckRtt(idx, peerId, atMs); sampled = true; }
+    notePeerFrames(idx, peerId, POWER_MULTI_ACK_TYPE, false);
+    commitScheduleResult(relay, (ack.okMask & (1u << idx)) != 0);
+  }
+  logf("[SCHEDULE_ACK] relays=0x%02X xfer=%u ok=0x%02X ms=%lu", ack.relayMask, ack.xfer, ack.okMask,
+       (unsigned long)ack.ms);
+}
+
+void PowerMaster::handleExecuted(const PowerExecutedPacket &ex, int8_t peerId) {
+  if (ex.ch < 1 || ex.ch > POWER_RELAY_COUNT) return;
+  relayState_[ex.ch - 1] = ex.state ? 1 : 0;
+  refreshSnapshot(ex.ch);
+  publishRelay(ex.ch, "executed", ex.state ? "ON" : "OFF");
+  publishRelay(ex.ch, "state", ex.state ? "ON" : "OFF", true);
+  logf("[EXECUTED] relay=%u state=%u minute=%u weekday=%u", ex.ch, ex.state, ex.minuteOfDay, ex.weekdayMon0);
+
+  // Only a report for a minute the schedule switches at is the schedule's
+  // doing; anything else is a manual command (relay/<n>/set or on the slave).
+  int8_t expected = scheduleStateAt(index_[ex.ch - 1], ex.weekdayMon0, ex.minuteOfDay);
+  if (expected >= 0 && scheduleSwitchesAt(index_[ex.ch - 1], ex.weekdayMon0, ex.minuteOfDay) &&
+      (uint8_t)expected != relayState_[ex.ch - 1]) {
+    char json[96];
+    snprintf(json, sizeof(json), "{\"expected\":\"%s\",\"actual\":\"%s\",\"weekday\":%u,\"minute\":%u}",
+             expected ? "ON" : "OFF", ex.state ? "ON" : "OFF", ex.weekdayMon0, ex.minuteOfDay);
+    publishRelay(ex.ch, "schedule/mismatch", json);
+    logf("[EXECUTED] relay=%u mismatch expected=%d", ex.ch, expected);
+  }
+  publishNextTransition(ex.ch);
+  publishExecutionLag(ex, peerId);
+}
+
+// ex.ms is the slave's millis() when it switched; with its clock mapped onto
+// ours that is a wall-clock instant, compared with the start of the minute the
+// slave executed for. The uncertainty is half the best round trip.
+void PowerMaster::publishExecutionLag(const PowerExecutedPacket &ex, int8_t peerId) {
+  if (peerId < 0) return;
+  const TimeSyncEstimator &est = peerClock_[peerId].est;
+  uint32_t epochSec = 0;
+  uint16_t epochMs = 0;
+  int16_t utcOffsetMin = 0;
+  if (!est.valid() || !clock_.wallClock(epochSec, epochMs, utcOffsetMin)) return;
+  int32_t ago = (int32_t)(clock_.millis() - est.toServer(ex.ms));
+  int32_t lag = executionLagMs(localWeekMs(epochSec, epochMs, utcOffsetMin), ex.weekdayMon0, ex.minuteOfDay) - ago;
+  char json[96];
+  snprintf(json, sizeof(json), "{\"lag_ms\":%ld,\"uncertainty_ms\":%lu,\"skew_ppm\":%ld}", (long)lag,
+           (unsigned long)(est.delayMs() / 2), (long)est.skewPpm());
+  publishRelay(ex.ch, "executed/lag", json);
+  logf("[EXECUTED] relay=%u lag=%ld ms", ex.ch, (long)lag);
+}
+
+void PowerMaster::handleScheduleSet(uint8_t relay, const char *payload, size_t len) {
+  const char *err = "";
+  PowerRelaySchedule candidate{};
+  if (!parseScheduleJson(payload, len, candidate, err)) {
+    logf("[SCHEDULE] relay=%u invalid=%s", relay, err);
+    publishAck(relay, SNAPSHOT_ACK_ERROR);
+    return;
+  }
+
+  publishAck(relay, SNAPSHOT_ACK_PENDING);
+
+  if (!waitingAck_[relay - 1] && schedulesEqual(candidate, active_[relay - 1])) {
+    publishScheduleCurrent(relay);
+    logf("[SCHEDULE] relay=%u idempotent no-op", relay);
+    return;
+  }
+
+  beginScheduleTransfer(relay, candidate);
+  queueScheduleSend(relay);
+}
+
+// All relays in one document: validated as a whole before anything is sent,
+// unchanged tables skipped, the rest sent at once (one type-17 frame per
+// slave where they fit) and answered with one aggregated result on
+// <root>schedule/slave/ack. The store is written once, after the last relay
+// resolves.
+void PowerMaster::handleBulkScheduleSet(const char *payload, size_t len) {
+  uint8_t mask = 0, errorRelay = 0;
+  const char *err = "";
+  if (!parseBulkScheduleJson(payload, len, bulk_, POWER_RELAY_COUNT, mask, errorRelay, err)) {
+    logf("[SCHEDULE] bulk invalid=%s relay=%u", err, errorRelay);
+    char json[96];
+    int n = snprintf(json, sizeof(json), "{\"result\":\"ERROR\",\"error\":\"%s\",\"relay\":%u}", err, errorRelay);
+    if (n > 0 && (size_t)n < sizeof(json)) publish("schedule/slave/ack", json, (size_t)n, false);
+    return;
+  }
+  if (bulkOpen_) publishBulkResult("SUPERSEDED");
+
+  bulkRelays_ = mask;
+  bulkOpen_ = 0;
+  bulkFailed_ = 0;
+  bulkUnchanged_ = 0;
+  for (uint8_t relay = 1; relay <= POWER_RELAY_COUNT; relay++) {
+    uint8_t bit = (uint8_t)(1u << (relay - 1));
+    if (!(mask & bit)) continue;
+    if (!waitingAck_[relay - 1] && schedulesEqual(bulk_[relay - 1], active_[relay - 1])) {
+      bulkUnchanged_ |= bit;
+      continue;
+    }
+    beginScheduleTransfer(relay, bulk_[relay - 1]);
+    queueScheduleSend(relay);
+    bulkOpen_ |= bit;
+  }
+  logf("[SCHEDULE] bulk relays=0x%02X sending=0x%02X", mask, bulkOpen_);
+  if (bulkOpen_ == 0) {
+    publishBulkResult("OK");
+    flushSchedules(); // a superseded batch may have left acknowledged tables unwritten
+    return;
+  }
+  timers_.disarm(persistTimer_); // anything already dirty goes with the batch
+  publishBulkResult("PENDING");
+  flushScheduleSends(); // the whole set is known: no batch window
+}
+
+void PowerMaster::settleBulk(uint8_t relay, bool ok) {
+  uint8_t bit = (uint8_t)(1u << (relay - 1));
+  if (!(bulkOpen_ & bit)) return;
+  bulkOpen_ &= (uint8_t)~bit;
+  if (!ok) bulkFailed_ |= bit;
+  if (bulkOpen_ != 0) return;
+  publishBulkResult(bulkFailed_ ? "ERROR" : "OK");
+  flushSchedules();
+}
+
+// {"result":"PENDING|OK|ERROR|SUPERSEDED","relays":{"1":"OK","2":"UNCHANGED","3":"PENDING"}}
+void PowerMaster::publishBulkResult(const char *result) {
+  char json[48 + POWER_RELAY_COUNT * 20];
+  size_t n = (size_t)snprintf(json, sizeof(json), "{\"result\":\"%s\",\"relays\":{", result);
+  const char *sep = "";
+  for (uint8_t relay = 1; relay <= POWER_RELAY_COUNT; relay++) {
+    uint8_t bit = (uint8_t)(1u << (relay - 1));
+    if (!(bulkRelays_ & bit)) continue;
+    const char *status = "OK";
+    if (bulkOpen_ & bit) status = "PENDING";
+    else if (bulkUnchanged_ & bit) status = "UNCHANGED";
+    else if (bulkFailed_ & bit) status = "ERROR";
+    n += (size_t)snprintf(json + n, sizeof(json) - n, "%s\"%u\":\"%s\"", sep, relay, status);
+    sep = ",";
+  }
+  n += (size_t)snprintf(json + n, sizeof(json) - n, "}}");
+  publish("schedule/slave/ack", json, n, false);
+}
+
+void PowerMaster::handleRelaySet(uint8_t relay, const char *payload, size_t len) {
+  if (relay > 3) {
+    logf("[RELAY] relay=%u has no slot in the command packet", relay);
+    return;
+  }
+  CommandPacket cmd{};
+  cmd.type = POWER_COMMAND_TYPE;
+  cmd.r1 = cmd.r2 = cmd.r3 = 255;
+  cmd.irrig = 0;
+  cmd.liveSec = 60;
+  if (payloadIs(payload, len, "ON")) cmd.r1 = 1;
+  else if (payloadIs(payload, len, "OFF")) cmd.r1 = 0;
+  else if (payloadIs(payload, len, "TOGGLE")) cmd.r1 = 2;
+  if (relay == 2) { cmd.r2 = cmd.r1; cmd.r1 = 255; }
+  if (relay == 3) { cmd.r3 = cmd.r1; cmd.r1 = 255; }
+  sendToRelay(relay, (const uint8_t *)&cmd, sizeof(cmd), false);
+}
+
+// ---- Radio -------------------------------------------------------------------
+
+void PowerMaster::onRadioFrame(const uint8_t mac[6], const uint8_t *data, size_t len, uint32_t atMs) {
+  static const uint8_t ZERO_MAC[6] = {0};
+  if (!macEqual(mac, ZERO_MAC)) addPeerIfNeeded(mac);
+  RadioFrame frame{*this, mac, peers_.find(mac), atMs};
+  PacketDispatcher<RadioFrame, PowerMasterInbound>::dispatch(frame, data, len);
+}
+
+void PowerMaster::RadioFrame::onPacket(const TelemetryPacket &p) {
+  self.lastTelemetry_ = p;
+  self.lastTelemetryAt_ = atMs;
+  self.recordTelemetry(peerId, p, atMs);
+}
+
+void PowerMaster::RadioFrame::onPacket(const PowerScheduleAckPacket &ack) {
+  self.learnRoute(ack.ch, mac, atMs);
+  self.handleScheduleAck(ack, peerId, atMs);
+}
+
+void PowerMaster::RadioFrame::onPacket(const PowerMultiScheduleAckPacket &ack) {
+  for (uint8_t relay = 1; relay <= POWER_RELAY_COUNT; relay++) {
+    if (ack.relayMask & (1u << (relay - 1))) self.learnRoute(relay, mac, atMs);
+  }
+  self.handleMultiScheduleAck(ack, peerId, atMs);
+}
+
+void PowerMaster::RadioFrame::onPacket(const PowerFragmentAckPacket &ack) {
+  self.learnRoute(ack.ch, mac, atMs);
+  self.handleFragmentAck(ack, peerId, atMs);
+}
+
+void PowerMaster::RadioFrame::onPacket(const PowerExecutedPacket &ex) {
+  self.learnRoute(ex.ch, mac, atMs);
+  self.handleExecuted(ex, peerId);
+}
+
+void PowerMaster::RadioFrame::onPacket(const TimeSyncRequestPacket &req) {
+  self.handleTimeSyncRequest(req, mac, peerId, atMs);
+}
+
+// A unicast the radio could not deliver (after its own MAC retries) will never
+// be ACKed: back the peer's RTO off and retry after a short jittered delay
+// instead of waiting out the full ACK timeout.
+// Only a failed schedule frame pulls its relays' retry forward and counts as a
+// loss for the peer's RTO, once per attempt; failed commands and time-sync
+// answers leave both alone.
+void PowerMaster::onRadioSent(const uint8_t mac[6], bool ok, uint32_t atMs) {
+  if (macEqual(mac, POWER_BCAST_MAC)) return;
+  int8_t id = peers_.find(mac);
+  if (id < 0) return;
+  PeerTx &tx = peerTx_[id];
+  if (tx.inFlight == 0) return;
+  bool schedule = tx.scheduleRun >= tx.inFlight;
+  tx.inFlight--;
+  if (tx.scheduleRun > tx.inFlight) tx.scheduleRun = tx.inFlight;
+  uint8_t relays = schedule && !ok ? tx.scheduleMask : 0;
+  if (tx.scheduleRun == 0 || relays != 0) tx.scheduleMask = 0;
+
+  bool pulled = false;
+  for (uint8_t relay = 1; relay <= POWER_RELAY_COUNT; relay++) {
+    uint8_t idx = relay - 1;
+    if (!(relays & (1u << idx)) || !awaiting(idx)) continue;
+    if ((int32_t)(atMs - sentAtMs_[idx]) < 0) continue; // report for an older send
+    uint32_t retryAt = atMs + backoffDelayMs(RTT_MIN_RTO_MS, sendAttempts_[idx], RTT_MAX_RTO_MS, clock_.random());
+    timers_.armNoLaterThan(ackTimer_[idx], retryAt);
+    pulled = true;
+    logf("[SCHEDULE] relay=%u delivery failed, retry in %lu ms", relay, (unsigned long)(retryAt - atMs));
+  }
+  if (pulled) peerRtt_[id].onLoss();
+}
+
+void PowerMaster::sendHello() {
+  HelloPacket h{};
+  h.type = POWER_HELLO_TYPE;
+  h.ch = radioChannel_;
+  h.ms = clock_.millis();
+  radio_.send(POWER_BCAST_MAC, (const uint8_t *)&h, sizeof(h));
+}
+
+// Every slave needs the time: one broadcast frame instead of one unicast per peer.
+void PowerMaster::sendTimeSync() {
+  TimeSyncPacket ts{};
+  ts.type = POWER_TIME_SYNC_TYPE;
+  ts.ms = clock_.millis();
+  uint8_t mon0 = 0;
+  uint16_t minuteOfDay = 0;
+  if (clock_.localWeekTime(mon0, minuteOfDay)) {
+    ts.valid = 1;
+    ts.minuteOfDay = minuteOfDay;
+    ts.weekdayMon0 = mon0;
+  }
+  radio_.send(POWER_BCAST_MAC, (const uint8_t *)&ts, sizeof(ts));
+
+  TimeSyncResponsePacket resp{};
+  resp.type = TIME_SYNC_RESPONSE_TYPE;
+  resp.t1 = resp.t2 = clock_.millis();
+  if (fillTimeSyncResponse(resp)) radio_.send(POWER_BCAST_MAC, (const uint8_t *)&resp, sizeof(resp));
+}
+
+// Stamps t3 and the wall clock as late as possible before the send.
+bool PowerMaster::fillTimeSyncResponse(TimeSyncResponsePacket &resp) {
+  uint32_t epochSec = 0;
+  uint16_t epochMs = 0;
+  int16_t utcOffsetMin = 0;
+  resp.valid = clock_.wallClock(epochSec, epochMs, utcOffsetMin) ? 1 : 0;
+  resp.t3 = clock_.millis();
+  if (!resp.valid) return false;
+  resp.epochSec = epochSec;
+  resp.epochMs = epochMs;
+  resp.utcOffsetMin = utcOffsetMin;
+  return true;
+}
+
+// Answers at once (t2 is when the frame arrived) and, when the slave reports
+// how our previous reply fared, feeds that exchange to its clock estimate.
+// A reply without wall-clock time still carries t2/t3 for the offset.
+void PowerMaster::handleTimeSyncRequest(const TimeSyncRequestPacket &req, const uint8_t mac[6], int8_t peerId,
+                                        uint32_t atMs) {
+  if (peerId < 0 || req.seq == 0) return;
+  PeerClock &pc = peerClock_[peerId];
+  if (req.prevT1 != 0 && req.prevT1 == pc.lastT1) pc.est.sample(pc.lastT1, pc.lastT2, pc.lastT3, req.prevT4);
+
+  TimeSyncResponsePacket resp{};
+  resp.type = TIME_SYNC_RESPONSE_TYPE;
+  resp.seq = req.seq;
+  resp.t1 = req.t1;
+  resp.t2 = atMs;
+  fillTimeSyncResponse(resp);
+  if (!sendToPeer(mac, (const uint8_t *)&resp, sizeof(resp), 0)) return;
+  pc.lastT1 = req.t1;
+  pc.lastT2 = atMs;
+  pc.lastT3 = resp.t3;
+}
+
+// ---- Telemetry ---------------------------------------------------------------
+
+void PowerMaster::recordTelemetry(int8_t peerId, const TelemetryPacket &p, uint32_t atMs) {
+  if (peerId < 0) return;
+  int8_t slot = -1;
+  for (uint8_t i = 0; i < TELEMETRY_MAX_SLAVES && slot < 0; i++) if (telemetryOwner_[i] == peerId) slot = (int8_t)i;
+  for (uint8_t i = 0; i < TELEMETRY_MAX_SLAVES && slot < 0; i++) {
+    if (telemetryOwner_[i] >= 0) continue;
+    telemetryOwner_[i] = peerId;
+    telemetry_[i].reset();
+    slot = (int8_t)i;
+  }
+  if (slot < 0) return;
+
+  TelemetrySample s;
+  s.v[TELEM_TEMP] = telemetryTenths(p.t);
+  s.v[TELEM_HUM] = telemetryTenths(p.h);
+  s.v[TELEM_SOIL] = p.soil;
+  s.v[TELEM_BATT] = p.batt;
+  s.v[TELEM_R1] = p.r1 ? 100 : 0;
+  s.v[TELEM_R2] = p.r2 ? 100 : 0;
+  s.v[TELEM_R3] = p.r3 ? 100 : 0;
+  s.v[TELEM_PRESENCE] = p.presence ? 100 : 0;
+  telemetry_[slot].add(s, atMs);
+}
+
+// Straight to the client rather than through the outbox: a batch that cannot
+// be sent stays pending in its series and goes out on a later tick.
+void PowerMaster::publishTelemetry() {
+  uint32_t now = clock_.millis();
+  for (uint8_t i = 0; i < TELEMETRY_MAX_SLAVES; i++) {
+    if (telemetryOwner_[i] < 0) continue;
+    TelemetrySeries &series = telemetry_[i];
+    series.tick(now);
+    if (!mqtt_.connected()) continue;
+    const uint8_t *mac = peers_.entry((uint8_t)telemetryOwner_[i]).mac;
+    for (uint8_t w = 0; w < TELEM_WINDOWS; w++) {
+      if (series.pending(w) < TELEM_PUBLISH_BATCH[w]) continue;
+      size_t n = series.writeJson(w, now, telemetryJson_, sizeof(telemetryJson_));
+      char suffix[40];
+      char topic[96];
+      snprintf(suffix, sizeof(suffix), "telemetry/%02X%02X%02X%02X%02X%02X/%s", mac[0], mac[1], mac[2], mac[3], mac[4],
+               mac[5], TELEM_WINDOW_NAME[w]);
+      if (n == 0 || router_.formatTopic(topic, sizeof(topic), suffix) == 0) continue;
+      if (mqtt_.publish(topic, (const uint8_t *)telemetryJson_, n, false)) series.markPublished(w);
+    }
+  }
+}
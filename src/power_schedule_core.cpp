@@ -1,84 +1,98 @@
 #include "power_schedule_core.h"
 
 #include <ctype.h>
-#include <sstream>
+#include <string.h>
 
 namespace {
 
-void skipWs(const std::string &s, size_t &i) {
-  while (i < s.size() && isspace((unsigned char)s[i])) i++;
+struct Cursor {
+  const char *s;
+  size_t n;
+  size_t i;
+};
+
+struct View {
+  const char *p;
+  size_t n;
+};
+
+bool viewIs(const View &v, const char *literal) {
+  size_t n = strlen(literal);
+  return v.n == n && memcmp(v.p, literal, n) == 0;
+}
+
+void skipWs(Cursor &c) {
+  while (c.i < c.n && isspace((unsigned char)c.s[c.i])) c.i++;
 }
 
-bool expect(const std::string &s, size_t &i, char c) {
-  skipWs(s, i);
-  if (i >= s.size() || s[i] != c) return false;
-  i++;
+bool expect(Cursor &c, char ch) {
+  skipWs(c);
+  if (c.i >= c.n || c.s[c.i] != ch) return false;
+  c.i++;
   return true;
 }
 
-bool parseQuoted(const std::string &s, size_t &i, std::string &out) {
-  skipWs(s, i);
-  if (i >= s.size() || s[i] != '"') return false;
-  i++;
-  out.clear();
-  while (i < s.size() && s[i] != '"') {
-    out.push_back(s[i]);
-    i++;
-  }
-  if (i >= s.size()) return false;
-  i++;
+bool parseQuoted(Cursor &c, View &out) {
+  skipWs(c);
+  if (c.i >= c.n || c.s[c.i] != '"') return false;
+  c.i++;
+  out.p = c.s + c.i;
+  while (c.i < c.n && c.s[c.i] != '"') c.i++;
+  if (c.i >= c.n) return false;
+  out.n = (size_t)(c.s + c.i - out.p);
+  c.i++;
   return true;
 }
 
-bool parseRuleObject(const std::string &s, size_t &i, PowerScheduleRule &rule, std::string &error) {
-  if (!expect(s, i, '{')) {
+bool parseRuleObject(Cursor &c, PowerScheduleRule &rule, const char *&error) {
+  if (!expect(c, '{')) {
     error = "Expected '{'";
     return false;
   }
 
   bool hasAt = false, hasState = false, hasDays = false;
-  std::string at, state, days;
+  View at{}, state{}, days{};
 
   while (true) {
-    std::string key, value;
-    if (!parseQuoted(s, i, key)) {
+    View key{}, value{};
+    if (!parseQuoted(c, key)) {
       error = "Expected key";
       return false;
     }
-    if (!expect(s, i, ':')) {
+    if (!expect(c, ':')) {
       error = "Expected ':' after key";
       return false;
     }
-    if (!parseQuoted(s, i, value)) {
+    if (!parseQuoted(c, value)) {
       error = "Expected quoted value";
       return false;
     }
 
-    if (key == "at") {
+    if (viewIs(key, "at")) {
       at = value;
       hasAt = true;
-    } else if (key == "state") {
+    } else if (viewIs(key, "state")) {
       state = value;
       hasState = true;
-    } else if (key == "days") {
+    } else if (viewIs(key, "days")) {
       days = value;
       hasDays = true;
     }
 
-    skipWs(s, i);
-    if (i >= s.size()) {
+    skipWs(c);
+    if (c.i >= c.n) {
       error = "Unexpected end object";
       return false;
     }
-    if (s[i] == '}') {
-      i++;
+    if (c.s[c.i] == '}') {
+      c.i++;
       break;
     }
-    if (s[i] != ',') {
+    if (c.s[c.i] != ',') {
       error = "Expected ',' in object";
       return false;
     }
-    i++;
+    c.i++;
   }
 
   if (!hasAt || !hasState || !hasDays) {
@@ -86,13 +100,14 @@ bool parseRuleObject(const std::string &s, size_t &i, PowerScheduleRule &rule, s
     return false;
   }
 
-  if (at.size() != 5 || at[2] != ':') {
+  if (at.n != 5 || at.p[2] != ':') {
     error = "Invalid at format";
     return false;
   }
-  int hh = (at[0] - '0') * 10 + (at[1] - '0');
-  int mm = (at[3] - '0') * 10 + (at[4] - '0');
-  if (!isdigit(at[0]) || !isdigit(at[1]) || !isdigit(at[3]) || !isdigit(at[4])) {
+  int hh = (at.p[0] - '0') * 10 + (at.p[1] - '0');
+  int mm = (at.p[3] - '0') * 10 + (at.p[4] - '0');
+  if (!isdigit((unsigned char)at.p[0]) || !isdigit((unsigned char)at.p[1]) || !isdigit((unsigned char)at.p[3]) ||
+      !isdigit((unsigned char)at.p[4])) {
     error = "Invalid at digits";
     return false;
   }
@@ -102,21 +117,21 @@ bool parseRuleObject(const std::string &s, size_t &i, PowerScheduleRule &rule, s
   }
 
   uint8_t st = 0;
-  if (state == "ON") st = 1;
-  else if (state == "OFF") st = 0;
+  if (viewIs(state, "ON")) st = 1;
+  else if (viewIs(state, "OFF")) st = 0;
   else {
     error = "Invalid state";
     return false;
   }
 
-  if (days.size() != 7) {
+  if (days.n != 7) {
     error = "days length must be 7";
     return false;
   }
   uint8_t mask = 0;
   for (size_t d = 0; d < 7; d++) {
-    if (days[d] == '1') mask |= (1 << d);
-    else if (days[d] != '0') {
+    if (days.p[d] == '1') mask |= (1 << d);
+    else if (days.p[d] != '0') {
       error = "days must be binary";
       return false;
     }
@@ -129,91 +144,659 @@ bool parseRuleObject(const std::string &s, size_t &i, PowerScheduleRule &rule, s
   return true;
 }
 
-} // namespace
+const char RULE_AT[] = "{\"at\":\"";
+const char RULE_STATE[] = "\",\"state\":\"";
+const char RULE_DAYS[] = "\",\"days\":\"";
+const char RULE_END[] = "\"}";
 
-bool parseScheduleJson(const std::string &json, PowerRelaySchedule &out, std::string &error) {
-  out.count = 0;
-  size_t i = 0;
-  if (!expect(json, i, '[')) {
+size_t numberLength(uint8_t v) {
+  return v >= 100 ? 3 : 2; // "%02d"
+}
+
+size_t ruleJsonLength(const PowerScheduleRule &r) {
+  return (sizeof(RULE_AT) - 1) + numberLength(r.hh) + 1 + numberLength(r.mm) + (sizeof(RULE_STATE) - 1) +
+         (r.state ? 2 : 3) + (sizeof(RULE_DAYS) - 1) + 7 + (sizeof(RULE_END) - 1);
+}
+
+char *putLiteral(char *p, const char *s, size_t n) {
+  memcpy(p, s, n);
+  return p + n;
+}
+
+char *putNumber(char *p, uint8_t v) {
+  if (v >= 100) *p++ = (char)('0' + v / 100);
+  *p++ = (char)('0' + (v / 10) % 10);
+  *p++ = (char)('0' + v % 10);
+  return p;
+}
+
+void putU16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+void putU32(uint8_t *p, uint32_t v) {
+  for (int i = 0; i < 4; i++) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+uint16_t getU16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+uint32_t getU32(const uint8_t *p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+bool ruleValid(const PowerScheduleRule &r) {
+  return r.hh <= 23 && r.mm <= 59 && r.state <= 1 && r.daysMask <= 0x7F;
+}
+
+bool rulesEqual(const PowerScheduleRule &a, const PowerScheduleRule &b) {
+  return a.hh == b.hh && a.mm == b.mm && a.state == b.state && a.daysMask == b.daysMask;
+}
+
+// 3-byte wire form shared by the multi-relay and delta frames.
+uint8_t *putCompactRule(uint8_t *p, const PowerScheduleRule &rule) {
+  uint16_t minute = (uint16_t)(rule.hh * 60 + rule.mm);
+  p[0] = (uint8_t)(minute & 0xFF);
+  p[1] = (uint8_t)((minute >> 8) | (rule.state ? 0x80 : 0));
+  p[2] = (uint8_t)(rule.daysMask & 0x7F);
+  return p + 3;
+}
+
+bool compactRuleValid(const uint8_t *p) {
+  uint16_t minute = (uint16_t)(p[0] | ((p[1] & 0x07) << 8));
+  return minute < POWER_MINUTES_PER_DAY && !(p[1] & 0x78) && !(p[2] & 0x80);
+}
+
+PowerScheduleRule getCompactRule(const uint8_t *p) {
+  uint16_t minute = (uint16_t)(p[0] | ((p[1] & 0x07) << 8));
+  return PowerScheduleRule{(uint8_t)(minute / 60), (uint8_t)(minute % 60), (uint8_t)(p[1] >> 7), p[2]};
+}
+
+#define POWER_STR_(x) #x
+#define POWER_STR(x) POWER_STR_(x)
+const char TOO_MANY_RULES[] = "Too many rules (max " POWER_STR(EVE_POWER_MAX_SCHEDULE_RULES) ")";
+
+// One rules array at the cursor, without the check for trailing input.
+bool parseRulesArray(Cursor &c, PowerScheduleRule *rules, uint16_t capacity, uint16_t &count, const char *&error) {
+  count = 0;
+  if (!expect(c, '[')) {
     error = "Expected '['";
     return false;
   }
 
-  skipWs(json, i);
-  if (i < json.size() && json[i] == ']') {
-    i++;
+  skipWs(c);
+  if (c.i < c.n && c.s[c.i] == ']') {
+    c.i++;
     return true;
   }
 
   while (true) {
-    if (out.count >= POWER_MAX_SCHEDULE_RULES) {
-      error = "Too many rules (max 10)";
+    if (count >= capacity) {
+      error = capacity == POWER_MAX_SCHEDULE_RULES ? TOO_MANY_RULES : "Too many rules";
       return false;
     }
 
-    if (!parseRuleObject(json, i, out.rules[out.count], error)) return false;
-    out.count++;
+    if (!parseRuleObject(c, rules[count], error)) return false;
+    count++;
 
-    skipWs(json, i);
-    if (i >= json.size()) {
+    skipWs(c);
+    if (c.i >= c.n) {
       error = "Unexpected end array";
       return false;
     }
-    if (json[i] == ']') {
-      i++;
-      break;
+    if (c.s[c.i] == ']') {
+      c.i++;
+      return true;
     }
-    if (json[i] != ',') {
+    if (c.s[c.i] != ',') {
       error = "Expected ',' between rules";
       return false;
     }
-    i++;
+    c.i++;
   }
+}
 
-  skipWs(json, i);
-  if (i != json.size()) {
+bool expectEnd(Cursor &c, const char *&error) {
+  skipWs(c);
+  if (c.i != c.n) {
     error = "Trailing chars";
     return false;
   }
   return true;
 }
 
-std::string scheduleToJson(const PowerRelaySchedule &schedule) {
-  std::ostringstream oss;
-  oss << "[";
-  for (uint8_t i = 0; i < schedule.count; i++) {
-    const PowerScheduleRule &r = schedule.rules[i];
-    if (i) oss << ",";
-    char at[8];
-    snprintf(at, sizeof(at), "%02d:%02d", (int)r.hh, (int)r.mm);
-    char days[8];
-    for (int d = 0; d < 7; d++) days[d] = ((r.daysMask >> d) & 1) ? '1' : '0';
-    days[7] = '\0';
-    oss << "{\"at\":\"" << at << "\",\"state\":\"" << (r.state ? "ON" : "OFF") << "\",\"days\":\"" << days << "\"}";
-  }
-  oss << "]";
-  return oss.str();
-}
-
-bool schedulesEqual(const PowerRelaySchedule &a, const PowerRelaySchedule &b) {
-  if (a.count != b.count) return false;
-  for (uint8_t i = 0; i < a.count; i++) {
-    if (a.rules[i].hh != b.rules[i].hh || a.rules[i].mm != b.rules[i].mm ||
-        a.rules[i].state != b.rules[i].state || a.rules[i].daysMask != b.rules[i].daysMask) {
+} // namespace
+
+bool parseScheduleRules(const char *json, size_t len, PowerScheduleRule *rules, uint16_t capacity, uint16_t &count,
+                        const char *&error) {
+  Cursor c{json, len, 0};
+  return parseRulesArray(c, rules, capacity, count, error) && expectEnd(c, error);
+}
+
+bool parseBulkScheduleRules(const char *json, size_t len, uint8_t relayCount, PowerScheduleRule *const *rules,
+                            uint16_t capacity, uint16_t *counts, uint8_t &relayMask, uint8_t &errorRelay,
+                            const char *&error) {
+  relayMask = 0;
+  errorRelay = 0;
+  Cursor c{json, len, 0};
+  if (!expect(c, '{')) {
+    error = "Expected '{'";
+    return false;
+  }
+  skipWs(c);
+  if (c.i < c.n && c.s[c.i] == '}') {
+    error = "No relays";
+    return false;
+  }
+
+  while (true) {
+    View key{};
+    if (!parseQuoted(c, key)) {
+      error = "Expected relay key";
+      return false;
+    }
+    uint8_t relay = (key.n == 1 && key.p[0] >= '1' && key.p[0] <= '9') ? (uint8_t)(key.p[0] - '0') : 0;
+    if (relay == 0 || relay > relayCount) {
+      error = "Unknown relay";
+      return false;
+    }
+    errorRelay = relay;
+    if (relayMask & (1u << (relay - 1))) {
+      error = "Duplicate relay";
+      return false;
+    }
+    if (!expect(c, ':')) {
+      error = "Expected ':'";
+      return false;
+    }
+    if (!parseRulesArray(c, rules[relay - 1], capacity, counts[relay - 1], error)) return false;
+    relayMask |= (uint8_t)(1u << (relay - 1));
+    errorRelay = 0;
+
+    skipWs(c);
+    if (c.i >= c.n) {
+      error = "Unexpected end object";
+      return false;
+    }
+    if (c.s[c.i] == '}') {
+      c.i++;
+      break;
+    }
+    if (c.s[c.i] != ',') {
+      error = "Expected ',' between relays";
       return false;
     }
+    c.i++;
+  }
+  return expectEnd(c, error);
+}
+
+size_t scheduleRulesJsonLength(const PowerScheduleRule *rules, uint16_t count) {
+  size_t n = 2;
+  for (uint16_t i = 0; i < count; i++) n += (i ? 1 : 0) + ruleJsonLength(rules[i]);
+  return n;
+}
+
+size_t writeScheduleRulesJson(const PowerScheduleRule *rules, uint16_t count, char *buf, size_t cap) {
+  size_t n = scheduleRulesJsonLength(rules, count);
+  if (buf == nullptr || cap < n) return 0;
+  char *p = buf;
+  *p++ = '[';
+  for (uint16_t i = 0; i < count; i++) {
+    const PowerScheduleRule &r = rules[i];
+    if (i) *p++ = ',';
+    p = putLiteral(p, RULE_AT, sizeof(RULE_AT) - 1);
+    p = putNumber(p, r.hh);
+    *p++ = ':';
+    p = putNumber(p, r.mm);
+    p = putLiteral(p, RULE_STATE, sizeof(RULE_STATE) - 1);
+    p = r.state ? putLiteral(p, "ON", 2) : putLiteral(p, "OFF", 3);
+    p = putLiteral(p, RULE_DAYS, sizeof(RULE_DAYS) - 1);
+    for (int d = 0; d < 7; d++) *p++ = ((r.daysMask >> d) & 1) ? '1' : '0';
+    p = putLiteral(p, RULE_END, sizeof(RULE_END) - 1);
+  }
+  *p++ = ']';
+  if (cap > n) *p = '\0';
+  return n;
+}
+
+uint32_t powerCrc32(const uint8_t *data, size_t len) {
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+  }
+  return ~crc;
+}
+
+size_t encodeScheduleStore(const PowerRelaySchedule *schedules, uint8_t relayCount, uint8_t *buf, size_t cap) {
+  size_t payload = 0;
+  for (uint8_t r = 0; r < relayCount; r++) {
+    if (schedules[r].count > POWER_MAX_SCHEDULE_RULES) return 0;
+    payload += 1 + schedules[r].count * 4;
+  }
+  size_t total = 8 + payload + 4;
+  if (buf == nullptr || cap < total) return 0;
+
+  putU32(buf, POWER_SCHEDULE_STORE_MAGIC);
+  buf[4] = POWER_SCHEDULE_STORE_VERSION;
+  buf[5] = relayCount;
+  putU16(buf + 6, (uint16_t)payload);
+  uint8_t *p = buf + 8;
+  for (uint8_t r = 0; r < relayCount; r++) {
+    *p++ = (uint8_t)schedules[r].count;
+    for (uint16_t i = 0; i < schedules[r].count; i++) {
+      const PowerScheduleRule &rule = schedules[r].rules[i];
+      *p++ = rule.hh;
+      *p++ = rule.mm;
+      *p++ = rule.state;
+      *p++ = rule.daysMask;
+    }
+  }
+  putU32(p, powerCrc32(buf, 8 + payload));
+  return total;
+}
+
+bool decodeScheduleStore(const uint8_t *buf, size_t len, PowerRelaySchedule *schedules, uint8_t relayCount) {
+  if (buf == nullptr || len < 12) return false;
+  if (getU32(buf) != POWER_SCHEDULE_STORE_MAGIC || buf[4] != POWER_SCHEDULE_STORE_VERSION || buf[5] != relayCount) return false;
+  size_t payload = getU16(buf + 6);
+  if (len != 8 + payload + 4) return false;
+  if (getU32(buf + 8 + payload) != powerCrc32(buf, 8 + payload)) return false;
+
+  // Validate the whole payload before touching the caller's schedules.
+  const uint8_t *p = buf + 8;
+  const uint8_t *end = p + payload;
+  for (uint8_t r = 0; r < relayCount; r++) {
+    if (p >= end) return false;
+    uint8_t count = *p++;
+    if (count > POWER_MAX_SCHEDULE_RULES || (size_t)(end - p) < (size_t)count * 4) return false;
+    for (uint8_t i = 0; i < count; i++, p += 4) {
+      if (!ruleValid(PowerScheduleRule{p[0], p[1], p[2], p[3]})) return false;
+    }
+  }
+  if (p != end) return false;
+
+  p = buf + 8;
+  for (uint8_t r = 0; r < relayCount; r++) {
+    schedules[r] = PowerRelaySchedule{};
+    schedules[r].count = *p++;
+    for (uint16_t i = 0; i < schedules[r].count; i++, p += 4) {
+      schedules[r].rules[i] = PowerScheduleRule{p[0], p[1], p[2], p[3]};
+    }
+  }
+  return true;
+}
+
+void buildScheduleIndex(const PowerRelaySchedule &schedule, PowerScheduleIndex &out) {
+  // Expand rules in list order; the stable insertion sort keeps later rules
+  // after earlier ones at the same minute so they win the dedup below. Sorting
+  // and both passes work in place: each pass writes at or behind its reads.
+  // An entry replacing one at the same minute keeps the array within
+  // POWER_MAX_TRANSITIONS even when rules * 7 would not.
+  PowerScheduleTransition *all = out.transitions;
+  uint16_t n = 0;
+  uint16_t rules = schedule.count <= POWER_MAX_SCHEDULE_RULES ? schedule.count : POWER_MAX_SCHEDULE_RULES;
+  for (uint16_t i = 0; i < rules; i++) {
+    const PowerScheduleRule &r = schedule.rules[i];
+    if (!ruleValid(r)) continue;
+    for (uint8_t d = 0; d < 7; d++) {
+      if (!((r.daysMask >> d) & 1)) continue;
+      PowerScheduleTransition t{(uint16_t)(d * POWER_MINUTES_PER_DAY + r.hh * 60 + r.mm), r.state};
+      uint16_t j = n;
+      while (j > 0 && all[j - 1].weekMinute > t.weekMinute) j--;
+      if (j > 0 && all[j - 1].weekMinute == t.weekMinute) {
+        all[j - 1] = t;
+        continue;
+      }
+      for (uint16_t k = n; k > j; k--) all[k] = all[k - 1];
+      all[j] = t;
+      n++;
+    }
+  }
+  uint16_t m = n;
+
+  // Drop entries that do not change the state left by their (cyclic) predecessor.
+  out.count = 0;
+  for (uint16_t i = 0; i < m; i++) {
+    uint8_t prev = out.count > 0 ? out.transitions[out.count - 1].state : out.transitions[m - 1].state;
+    if (m > 1 && out.transitions[i].state == prev) continue;
+    out.transitions[out.count++] = out.transitions[i];
+  }
+  if (out.count == 0 && m > 0) out.count = 1; // constant state: keep one entry
+}
+
+int8_t scheduleStateAt(const PowerScheduleIndex &index, uint8_t weekdayMon0, uint16_t minuteOfDay) {
+  if (index.count == 0 || weekdayMon0 > 6 || minuteOfDay >= POWER_MINUTES_PER_DAY) return -1;
+  uint16_t t = weekdayMon0 * POWER_MINUTES_PER_DAY + minuteOfDay;
+  // Last entry with weekMinute <= t; before the first one the week wraps.
+  uint16_t lo = 0, hi = index.count;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if (index.transitions[mid].weekMinute <= t) lo = mid + 1;
+    else hi = mid;
+  }
+  return (int8_t)index.transitions[lo == 0 ? index.count - 1 : lo - 1].state;
+}
+
+bool scheduleSwitchesAt(const PowerScheduleIndex &index, uint8_t weekdayMon0, uint16_t minuteOfDay) {
+  if (weekdayMon0 > 6 || minuteOfDay >= POWER_MINUTES_PER_DAY) return false;
+  uint16_t t = weekdayMon0 * POWER_MINUTES_PER_DAY + minuteOfDay;
+  uint16_t lo = 0, hi = index.count;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if (index.transitions[mid].weekMinute < t) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo < index.count && index.transitions[lo].weekMinute == t;
+}
+
+bool scheduleNextTransition(const PowerScheduleIndex &index, uint8_t weekdayMon0, uint16_t minuteOfDay,
+                            PowerScheduleTransition &next) {
+  if (index.count < 2 || weekdayMon0 > 6 || minuteOfDay >= POWER_MINUTES_PER_DAY) return false;
+  uint16_t t = weekdayMon0 * POWER_MINUTES_PER_DAY + minuteOfDay;
+  uint16_t lo = 0, hi = index.count;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if (index.transitions[mid].weekMinute <= t) lo = mid + 1;
+    else hi = mid;
+  }
+  next = index.transitions[lo == index.count ? 0 : lo];
+  return true;
+}
+
+bool scheduleRulesEqual(const PowerScheduleRule *a, uint16_t aCount, const PowerScheduleRule *b, uint16_t bCount) {
+  if (aCount != bCount) return false;
+  for (uint16_t i = 0; i < aCount; i++) {
+    if (!rulesEqual(a[i], b[i])) return false;
   }
   return true;
 }
 
 bool buildRulesPacket(uint8_t relay, const PowerRelaySchedule &schedule, uint32_t nowMs, PowerRelayRulesPacket &out) {
-  if (relay < 1 || relay > 3 || schedule.count > POWER_MAX_SCHEDULE_RULES) return false;
+  if (relay < 1 || relay > POWER_RELAY_COUNT || schedule.count > POWER_RULES_PACKET_MAX) return false;
   out.type = 14;
   out.ch = relay;
-  out.count = schedule.count;
-  for (uint8_t i = 0; i < POWER_MAX_SCHEDULE_RULES; i++) {
+  out.count = (uint8_t)schedule.count;
+  for (uint8_t i = 0; i < POWER_RULES_PACKET_MAX; i++) {
     out.rules[i] = schedule.rules[i];
   }
   out.ms = nowMs;
   return true;
 }
+
+size_t encodeMultiRulesPacket(const PowerRelaySchedule *schedules, uint8_t relayMask, uint8_t xfer, uint32_t nowMs,
+                              uint8_t *buf, size_t cap) {
+  if (relayMask == 0 || relayMask >= (1u << POWER_RELAY_COUNT)) return 0;
+  size_t need = 7;
+  for (uint8_t r = 0; r < POWER_RELAY_COUNT; r++) {
+    if (!(relayMask & (1u << r))) continue;
+    if (schedules[r].count > POWER_RULES_PACKET_MAX) return 0;
+    need += 1 + (size_t)schedules[r].count * 3;
+  }
+  if (buf == nullptr || cap < need || need > POWER_RADIO_FRAME_MAX) return 0;
+
+  buf[0] = POWER_MULTI_RULES_TYPE;
+  buf[1] = relayMask;
+  buf[2] = xfer;
+  putU32(buf + 3, nowMs);
+  uint8_t *p = buf + 7;
+  for (uint8_t r = 0; r < POWER_RELAY_COUNT; r++) {
+    if (!(relayMask & (1u << r))) continue;
+    *p++ = (uint8_t)schedules[r].count;
+    for (uint8_t i = 0; i < schedules[r].count; i++) p = putCompactRule(p, schedules[r].rules[i]);
+  }
+  return need;
+}
+
+bool decodeMultiRulesPacket(const uint8_t *buf, size_t len, uint8_t &relayMask, uint8_t &xfer,
+                            PowerRelaySchedule *schedules, uint32_t &ms) {
+  if (buf == nullptr || len < 7 || buf[0] != POWER_MULTI_RULES_TYPE) return false;
+  uint8_t mask = buf[1];
+  if (mask == 0 || mask >= (1u << POWER_RELAY_COUNT)) return false;
+
+  const uint8_t *p = buf + 7;
+  const uint8_t *end = buf + len;
+  for (uint8_t r = 0; r < POWER_RELAY_COUNT; r++) {
+    if (!(mask & (1u << r))) continue;
+    if (p >= end) return false;
+    uint8_t count = *p++;
+    if (count > POWER_RULES_PACKET_MAX || (size_t)(end - p) < (size_t)count * 3) return false;
+    for (uint8_t i = 0; i < count; i++, p += 3) {
+      if (!compactRuleValid(p)) return false;
+    }
+  }
+  if (p != end) return false;
+
+  p = buf + 7;
+  for (uint8_t r = 0; r < POWER_RELAY_COUNT; r++) {
+    if (!(mask & (1u << r))) continue;
+    schedules[r] = PowerRelaySchedule{};
+    schedules[r].count = *p++;
+    for (uint8_t i = 0; i < schedules[r].count; i++, p += 3) schedules[r].rules[i] = getCompactRule(p);
+  }
+  relayMask = mask;
+  xfer = buf[2];
+  ms = getU32(buf + 3);
+  return true;
+}
+
+uint32_t scheduleRulesHash(const PowerScheduleRule *rules, uint16_t count) {
+  uint32_t h = 2166136261u;
+  h = (h ^ (uint8_t)count) * 16777619u;
+  if (count > 0xFF) h = (h ^ (uint8_t)(count >> 8)) * 16777619u;
+  for (uint16_t i = 0; i < count; i++) {
+    const PowerScheduleRule &r = rules[i];
+    const uint8_t bytes[4] = {r.hh, r.mm, r.state, r.daysMask};
+    for (uint8_t b : bytes) h = (h ^ b) * 16777619u;
+  }
+  return h;
+}
+
+bool diffSchedules(const PowerRelaySchedule &base, const PowerRelaySchedule &target, PowerScheduleDelta &out) {
+  out.count = 0;
+  if (base.count > POWER_RULES_PACKET_MAX || target.count > POWER_RULES_PACKET_MAX) return false;
+  const uint8_t n = (uint8_t)base.count, m = (uint8_t)target.count;
+  // Levenshtein table over rules: d[i][j] = edits turning base[0..i) into target[0..j).
+  uint8_t d[POWER_RULES_PACKET_MAX + 1][POWER_RULES_PACKET_MAX + 1];
+  for (uint8_t i = 0; i <= n; i++) d[i][0] = i;
+  for (uint8_t j = 0; j <= m; j++) d[0][j] = j;
+  for (uint8_t i = 1; i <= n; i++) {
+    for (uint8_t j = 1; j <= m; j++) {
+      uint8_t best = (uint8_t)(d[i - 1][j - 1] + (rulesEqual(base.rules[i - 1], target.rules[j - 1]) ? 0 : 1));
+      if (d[i - 1][j] + 1 < best) best = (uint8_t)(d[i - 1][j] + 1);
+      if (d[i][j - 1] + 1 < best) best = (uint8_t)(d[i][j - 1] + 1);
+      d[i][j] = best;
+    }
+  }
+
+  // Walk back from the end: edits come out with non-increasing base index, so
+  // applying them in order never shifts a position a later edit refers to.
+  uint8_t i = n, j = m;
+  while (i > 0 || j > 0) {
+    if (i > 0 && j > 0 && rulesEqual(base.rules[i - 1], target.rules[j - 1]) && d[i][j] == d[i - 1][j - 1]) {
+      i--;
+      j--;
+    } else if (i > 0 && j > 0 && d[i][j] == d[i - 1][j - 1] + 1) {
+      out.edits[out.count++] = PowerScheduleEdit{POWER_EDIT_REPLACE, (uint8_t)(i - 1), target.rules[j - 1]};
+      i--;
+      j--;
+    } else if (i > 0 && d[i][j] == d[i - 1][j] + 1) {
+      out.edits[out.count++] = PowerScheduleEdit{POWER_EDIT_DELETE, (uint8_t)(i - 1), PowerScheduleRule{}};
+      i--;
+    } else {
+      out.edits[out.count++] = PowerScheduleEdit{POWER_EDIT_INSERT, i, target.rules[j - 1]};
+      j--;
+    }
+  }
+  return true;
+}
+
+bool applyScheduleDelta(const PowerRelaySchedule &base, const PowerScheduleDelta &delta, PowerRelaySchedule &out) {
+  if (base.count > POWER_RULES_PACKET_MAX || delta.count > POWER_RULES_PACKET_MAX) return false;
+  // Inserts may run ahead of deletes at lower indices: leave room for both.
+  PowerScheduleRule work[POWER_RULES_PACKET_MAX * 2];
+  uint8_t count = (uint8_t)base.count;
+  for (uint8_t i = 0; i < count; i++) work[i] = base.rules[i];
+
+  for (uint8_t k = 0; k < delta.count; k++) {
+    const PowerScheduleEdit &e = delta.edits[k];
+    if (e.op != POWER_EDIT_DELETE && !ruleValid(e.rule)) return false;
+    switch (e.op) {
+      case POWER_EDIT_REPLACE:
+        if (e.index >= count) return false;
+        work[e.index] = e.rule;
+        break;
+      case POWER_EDIT_INSERT:
+        if (e.index > count || count >= POWER_RULES_PACKET_MAX * 2) return false;
+        for (uint8_t i = count; i > e.index; i--) work[i] = work[i - 1];
+        work[e.index] = e.rule;
+        count++;
+        break;
+      case POWER_EDIT_DELETE:
+        if (e.index >= count) return false;
+        for (uint8_t i = e.index; i + 1 < count; i++) work[i] = work[i + 1];
+        count--;
+        break;
+      default:
+        return false;
+    }
+  }
+  if (count > POWER_RULES_PACKET_MAX) return false;
+  out = PowerRelaySchedule{};
+  out.count = count;
+  for (uint8_t i = 0; i < count; i++) out.rules[i] = work[i];
+  return true;
+}
+
+size_t buildDeltaPacket(uint8_t relay, const PowerRelaySchedule &base, const PowerRelaySchedule &target, uint32_t nowMs,
+                        uint8_t *buf, size_t cap) {
+  if (relay < 1 || relay > POWER_RELAY_COUNT) return 0;
+  PowerScheduleDelta delta;
+  if (!diffSchedules(base, target, delta)) return 0;
+  size_t need = 15;
+  for (uint8_t k = 0; k < delta.count; k++) need += delta.edits[k].op == POWER_EDIT_DELETE ? 1 : 4;
+  if (buf == nullptr || cap < need) return 0;
+
+  buf[0] = POWER_DELTA_RULES_TYPE;
+  buf[1] = relay;
+  putU32(buf + 2, scheduleHash(base));
+  putU32(buf + 6, scheduleHash(target));
+  putU32(buf + 10, nowMs);
+  buf[14] = delta.count;
+  uint8_t *p = buf + 15;
+  for (uint8_t k = 0; k < delta.count; k++) {
+    const PowerScheduleEdit &e = delta.edits[k];
+    *p++ = (uint8_t)(e.op << 6 | e.index);
+    if (e.op != POWER_EDIT_DELETE) p = putCompactRule(p, e.rule);
+  }
+  return need;
+}
+
+bool decodeDeltaPacket(const uint8_t *buf, size_t len, uint8_t &relay, uint32_t &baseHash, uint32_t &targetHash,
+                       PowerScheduleDelta &delta, uint32_t &ms) {
+  if (buf == nullptr || len < 15 || buf[0] != POWER_DELTA_RULES_TYPE) return false;
+  if (buf[1] < 1 || buf[1] > POWER_RELAY_COUNT || buf[14] > POWER_RULES_PACKET_MAX) return false;
+  const uint8_t *p = buf + 15;
+  const uint8_t *end = buf + len;
+  PowerScheduleDelta out;
+  out.count = buf[14];
+  for (uint8_t k = 0; k < out.count; k++) {
+    if (p >= end) return false;
+    uint8_t op = *p >> 6, index = *p & 0x3F;
+    p++;
+    if (op > POWER_EDIT_DELETE || index > POWER_RULES_PACKET_MAX * 2) return false;
+    PowerScheduleRule rule{};
+    if (op != POWER_EDIT_DELETE) {
+      if (end - p < 3 || !compactRuleValid(p)) return false;
+      rule = getCompactRule(p);
+      p += 3;
+    }
+    out.edits[k] = PowerScheduleEdit{op, index, rule};
+  }
+  if (p != end) return false;
+  relay = buf[1];
+  baseHash = getU32(buf + 2);
+  targetHash = getU32(buf + 6);
+  ms = getU32(buf + 10);
+  delta = out;
+  return true;
+}
+
+uint8_t ruleFragmentCount(uint16_t count) {
+  uint16_t n = count == 0 ? 1 : (uint16_t)((count + POWER_FRAGMENT_RULES - 1) / POWER_FRAGMENT_RULES);
+  return n <= POWER_FRAGMENT_MAX ? (uint8_t)n : 0;
+}
+
+size_t encodeRuleFragment(uint8_t relay, uint8_t xfer, const PowerScheduleRule *rules, uint16_t count, uint8_t index,
+                          uint32_t nowMs, uint8_t *buf, size_t cap) {
+  uint8_t total = ruleFragmentCount(count);
+  if (relay < 1 || relay > POWER_RELAY_COUNT || index >= total) return 0;
+  uint16_t first = (uint16_t)(index * POWER_FRAGMENT_RULES);
+  uint16_t n = count - first < POWER_FRAGMENT_RULES ? (uint16_t)(count - first) : POWER_FRAGMENT_RULES;
+  size_t need = POWER_FRAGMENT_HEADER + (size_t)n * 3;
+  if (buf == nullptr || cap < need) return 0;
+  for (uint16_t i = 0; i < n; i++) {
+    if (!ruleValid(rules[first + i])) return 0;
+  }
+
+  buf[0] = POWER_FRAGMENT_TYPE;
+  buf[1] = relay;
+  buf[2] = xfer;
+  buf[3] = index;
+  buf[4] = total;
+  putU16(buf + 5, count);
+  putU32(buf + 7, scheduleRulesHash(rules, count));
+  putU32(buf + 11, nowMs);
+  uint8_t *p = buf + POWER_FRAGMENT_HEADER;
+  for (uint16_t i = 0; i < n; i++) p = putCompactRule(p, rules[first + i]);
+  return need;
+}
+
+bool decodeRuleFragment(const uint8_t *buf, size_t len, PowerRuleFragment &out) {
+  if (buf == nullptr || len < POWER_FRAGMENT_HEADER || buf[0] != POWER_FRAGMENT_TYPE) return false;
+  if (buf[1] < 1 || buf[1] > POWER_RELAY_COUNT) return false;
+  uint16_t count = getU16(buf + 5);
+  uint8_t total = ruleFragmentCount(count);
+  uint8_t index = buf[3];
+  if (total == 0 || buf[4] != total || index >= total) return false;
+  uint16_t first = (uint16_t)(index * POWER_FRAGMENT_RULES);
+  uint16_t n = count - first < POWER_FRAGMENT_RULES ? (uint16_t)(count - first) : POWER_FRAGMENT_RULES;
+  if (len != POWER_FRAGMENT_HEADER + (size_t)n * 3) return false;
+  for (uint16_t i = 0; i < n; i++) {
+    if (!compactRuleValid(buf + POWER_FRAGMENT_HEADER + i * 3)) return false;
+  }
+
+  out.relay = buf[1];
+  out.xfer = buf[2];
+  out.index = index;
+  out.total = total;
+  out.ruleCount = count;
+  out.tableHash = getU32(buf + 7);
+  out.ms = getU32(buf + 11);
+  out.frameRules = (uint8_t)n;
+  out.rules = buf + POWER_FRAGMENT_HEADER;
+  return true;
+}
+
+uint8_t acceptRuleFragment(PowerRuleTransferState &state, const PowerRuleFragment &fragment, PowerScheduleRule *rules,
+                           uint16_t capacity) {
+  if (fragment.ruleCount > capacity || fragment.index >= fragment.total) return 0;
+  if (!state.open || state.xfer != fragment.xfer || state.count != fragment.ruleCount ||
+      state.tableHash != fragment.tableHash) {
+    state = PowerRuleTransferState{true, fragment.xfer, fragment.total, fragment.ruleCount, fragment.tableHash, 0};
+  }
+
+  uint16_t first = (uint16_t)(fragment.index * POWER_FRAGMENT_RULES);
+  for (uint8_t i = 0; i < fragment.frameRules; i++) rules[first + i] = getCompactRule(fragment.rules + i * 3);
+  state.received |= 1u << fragment.index;
+
+  uint32_t all = state.total >= 32 ? 0xFFFFFFFFu : (1u << state.total) - 1;
+  if (state.received != all) return POWER_ACK_INCOMPLETE;
+  if (scheduleRulesHash(rules, state.count) == state.tableHash) return 1;
+  // Fragments of different tables under one xfer: collect them again.
+  state.received = 0;
+  return 0;
+}
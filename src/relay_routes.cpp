@@ -0,0 +1,67 @@
+#include "relay_routes.h"
+
+#include <string.h>
+
+RelayRouteTable::RelayRouteTable(uint32_t ttlMs) : ttlMs_(ttlMs) {
+  memset(routes_, 0, sizeof(routes_));
+}
+
+bool RelayRouteTable::learn(uint8_t relay, const uint8_t mac[6], uint32_t nowMs) {
+  if (!valid(relay)) return false;
+  RelayRoute &r = routes_[relay - 1];
+  bool changed = !r.known || memcmp(r.mac, mac, 6) != 0;
+  if (changed) {
+    r.known = true;
+    memcpy(r.mac, mac, 6);
+    r.learnedMs = nowMs;
+    r.changes++;
+  }
+  r.lastSeenMs = nowMs;
+  return changed;
+}
+
+const uint8_t *RelayRouteTable::lookup(uint8_t relay, uint32_t nowMs) {
+  if (!valid(relay)) return nullptr;
+  RelayRoute &r = routes_[relay - 1];
+  if (!r.known) return nullptr;
+  if ((int32_t)(nowMs - r.lastSeenMs) >= (int32_t)ttlMs_) {
+    r.known = false;
+    r.expiries++;
+    return nullptr;
+  }
+  return r.mac;
+}
+
+bool RelayRouteTable::invalidate(uint8_t relay) {
+  if (!valid(relay) || !routes_[relay - 1].known) return false;
+  routes_[relay - 1].known = false;
+  routes_[relay - 1].expiries++;
+  return true;
+}
+
+uint8_t RelayRouteTable::forgetMac(const uint8_t mac[6]) {
+  uint8_t mask = 0;
+  for (uint8_t relay = 1; relay <= POWER_RELAY_COUNT; relay++) {
+    if (routes_[relay - 1].known && memcmp(routes_[relay - 1].mac, mac, 6) == 0 && invalidate(relay)) {
+      mask |= (uint8_t)(1u << (relay - 1));
+    }
+  }
+  return mask;
+}
+
+uint8_t RelayRouteTable::expire(uint32_t nowMs) {
+  uint8_t mask = 0;
+  for (uint8_t relay = 1; relay <= POWER_RELAY_COUNT; relay++) {
+    bool wasKnown = routes_[relay - 1].known;
+    if (wasKnown && lookup(relay, nowMs) == nullptr) mask |= (uint8_t)(1u << (relay - 1));
+  }
+  return mask;
+}
+
+void RelayRouteTable::countUnicast(uint8_t relay) {
+  if (valid(relay)) routes_[relay - 1].unicastSends++;
+}
+
+void RelayRouteTable::countFanout(uint8_t relay) {
+  if (valid(relay)) routes_[relay - 1].fanoutSends++;
+}
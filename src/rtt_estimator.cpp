@@ -0,0 +1,51 @@
+#include "rtt_estimator.h"
+
+RttEstimator::RttEstimator(uint32_t initialRtoMs, uint32_t minRtoMs, uint32_t maxRtoMs)
+    : initialRtoMs_(initialRtoMs), minRtoMs_(minRtoMs), maxRtoMs_(maxRtoMs) {
+  reset();
+}
+
+void RttEstimator::reset() {
+  srtt8_ = 0;
+  rttvar4_ = 0;
+  backoffShift_ = 0;
+  samples_ = 0;
+  losses_ = 0;
+}
+
+void RttEstimator::sample(uint32_t rttMs) {
+  if (rttMs > maxRtoMs_) rttMs = maxRtoMs_;
+  if (samples_ == 0) {
+    srtt8_ = rttMs * 8;
+    rttvar4_ = rttMs * 2; // RTTVAR = R / 2
+  } else {
+    int32_t err = (int32_t)rttMs - (int32_t)(srtt8_ / 8);
+    uint32_t absErr = err < 0 ? (uint32_t)-err : (uint32_t)err;
+    // RTTVAR += (|err| - RTTVAR) / 4, SRTT += err / 8, both in fixed point.
+    rttvar4_ = rttvar4_ - rttvar4_ / 4 + absErr;
+    srtt8_ = (uint32_t)((int32_t)srtt8_ + err);
+  }
+  samples_++;
+  backoffShift_ = 0;
+}
+
+void RttEstimator::onLoss() {
+  losses_++;
+  if (backoffShift_ < 6) backoffShift_++;
+}
+
+uint32_t RttEstimator::timeoutMs() const {
+  uint32_t rto = samples_ == 0 ? initialRtoMs_ : srtt8_ / 8 + rttvar4_;
+  if (rto < minRtoMs_) rto = minRtoMs_;
+  for (uint8_t i = 0; i < backoffShift_ && rto < maxRtoMs_; i++) rto *= 2;
+  return rto > maxRtoMs_ ? maxRtoMs_ : rto;
+}
+
+uint32_t backoffDelayMs(uint32_t baseMs, uint8_t attempt, uint32_t maxMs, uint32_t random) {
+  uint32_t d = baseMs > maxMs ? maxMs : baseMs;
+  for (uint8_t i = 0; i < attempt && d < maxMs; i++) d *= 2;
+  if (d > maxMs) d = maxMs;
+  if (attempt == 0) return d;
+  uint32_t half = d / 2;
+  return half + random % (d - half + 1);
+}
@@ -0,0 +1,109 @@
+#include "state_snapshot.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const char VERSION_KEY[] = "{\"version\":\"";
+const size_t VERSION_KEY_LEN = sizeof(VERSION_KEY) - 1;
+
+uint32_t fnv1a(uint32_t h, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) h = (h ^ data[i]) * 16777619u;
+  return h;
+}
+
+int hexDigit(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+} // namespace
+
+const char *snapshotAckName(uint8_t ack) {
+  switch (ack) {
+    case SNAPSHOT_ACK_PENDING: return "PENDING";
+    case SNAPSHOT_ACK_OK: return "OK";
+    case SNAPSHOT_ACK_ERROR: return "ERROR";
+    default: return "";
+  }
+}
+
+StateSnapshot::StateSnapshot() : version_(0), segmentBuilds_(0) {
+  memset(relays_, 0, sizeof(relays_));
+  memset(segments_, 0, sizeof(segments_));
+  memset(segmentLen_, 0, sizeof(segmentLen_));
+  memset(segmentHash_, 0, sizeof(segmentHash_));
+  PowerRelaySchedule empty{};
+  for (uint8_t i = 0; i < POWER_RELAY_COUNT; i++) {
+    relays_[i].state = SNAPSHOT_STATE_UNKNOWN;
+    relays_[i].scheduleHash = scheduleHash(empty);
+    render(i);
+  }
+}
+
+bool StateSnapshot::update(uint8_t relay, const SnapshotRelay &r) {
+  if (relay < 1 || relay > POWER_RELAY_COUNT) return false;
+  SnapshotRelay &cur = relays_[relay - 1];
+  if (cur.state == r.state && cur.ack == r.ack && cur.rules == r.rules && cur.scheduleHash == r.scheduleHash) {
+    return false;
+  }
+  cur = r;
+  render((uint8_t)(relay - 1));
+  return true;
+}
+
+// Renders one relay and refolds the version from the per-relay hashes, so the
+// other relays' text is neither rebuilt nor rehashed.
+void StateSnapshot::render(uint8_t idx) {
+  const SnapshotRelay &r = relays_[idx];
+  char state[8] = "null";
+  if (r.state != SNAPSHOT_STATE_UNKNOWN) snprintf(state, sizeof(state), "\"%s\"", r.state ? "ON" : "OFF");
+  char ack[12] = "null";
+  if (r.ack != SNAPSHOT_ACK_NONE) snprintf(ack, sizeof(ack), "\"%s\"", snapshotAckName(r.ack));
+  int n = snprintf(segments_[idx], SNAPSHOT_SEGMENT_MAX, "\"%u\":{\"state\":%s,\"ack\":%s,\"rules\":%u,\"schedule\":\"%08lx\"}",
+                   idx + 1, state, ack, r.rules, (unsigned long)r.scheduleHash);
+  segmentLen_[idx] = (uint8_t)n;
+  segmentHash_[idx] = fnv1a(2166136261u, (const uint8_t *)segments_[idx], (size_t)n);
+  segmentBuilds_++;
+
+  uint32_t v = 2166136261u;
+  for (uint8_t i = 0; i < POWER_RELAY_COUNT; i++) {
+    const uint8_t bytes[4] = {(uint8_t)segmentHash_[i], (uint8_t)(segmentHash_[i] >> 8),
+                              (uint8_t)(segmentHash_[i] >> 16), (uint8_t)(segmentHash_[i] >> 24)};
+    v = fnv1a(v, bytes, sizeof(bytes));
+  }
+  version_ = v;
+}
+
+size_t StateSnapshot::write(char *buf, size_t cap) const {
+  int n = snprintf(buf, cap, "%s%08lx\",\"relays\":{", VERSION_KEY, (unsigned long)version_);
+  if (n < 0 || (size_t)n >= cap) return 0;
+  size_t at = (size_t)n;
+  for (uint8_t i = 0; i < POWER_RELAY_COUNT; i++) {
+    if (at + segmentLen_[i] + 1 >= cap) return 0;
+    if (i > 0) buf[at++] = ',';
+    memcpy(buf + at, segments_[i], segmentLen_[i]);
+    at += segmentLen_[i];
+  }
+  if (at + 3 > cap) return 0;
+  buf[at++] = '}';
+  buf[at++] = '}';
+  buf[at] = '\0';
+  return at;
+}
+
+bool StateSnapshot::parseVersion(const char *payload, size_t len, uint32_t &version) {
+  if (len < VERSION_KEY_LEN + 9 || memcmp(payload, VERSION_KEY, VERSION_KEY_LEN) != 0) return false;
+  uint32_t v = 0;
+  for (size_t i = 0; i < 8; i++) {
+    int d = hexDigit(payload[VERSION_KEY_LEN + i]);
+    if (d < 0) return false;
+    v = (v << 4) | (uint32_t)d;
+  }
+  if (payload[VERSION_KEY_LEN + 8] != '"') return false;
+  version = v;
+  return true;
+}
@@ -0,0 +1,148 @@
+#include "telemetry_series.h"
+
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const char *const CHANNEL_KEY[TELEM_CHANNELS] = {"t", "h", "soil", "batt", "r1", "r2", "r3", "presence"};
+
+bool tenths(uint8_t channel) { return channel == TELEM_TEMP || channel == TELEM_HUM; }
+
+// Writes v (tenths when scaled) at p; returns chars written or -1 on overflow.
+int putValue(char *p, size_t room, int16_t v, bool scaled) {
+  int n;
+  if (scaled) {
+    int32_t a = v < 0 ? -(int32_t)v : v;
+    n = snprintf(p, room, "%s%ld.%ld", v < 0 ? "-" : "", (long)(a / 10), (long)(a % 10));
+  } else {
+    n = snprintf(p, room, "%d", v);
+  }
+  return n < 0 || (size_t)n >= room ? -1 : n;
+}
+
+} // namespace
+
+TelemetrySeries::TelemetrySeries() { reset(); }
+
+void TelemetrySeries::reset() { memset(windows_, 0, sizeof(windows_)); }
+
+void TelemetrySeries::closeBucket(Window &w) {
+  uint8_t s = w.head;
+  w.startMs[s] = w.openStartMs;
+  for (uint8_t c = 0; c < TELEM_CHANNELS; c++) {
+    uint16_t n = w.accN[c];
+    w.n[c][s] = n;
+    if (n == 0) {
+      w.min[c][s] = w.max[c][s] = w.mean[c][s] = TELEM_MISSING;
+      continue;
+    }
+    int32_t sum = w.accSum[c];
+    // Round half away from zero.
+    w.mean[c][s] = (int16_t)(sum >= 0 ? (sum + n / 2) / n : -((-sum + n / 2) / n));
+    w.min[c][s] = w.accMin[c];
+    w.max[c][s] = w.accMax[c];
+  }
+  w.head = (uint8_t)((w.head + 1) % TELEM_HISTORY);
+  if (w.count < TELEM_HISTORY) w.count++;
+  if (w.unpublished < TELEM_HISTORY) w.unpublished++;
+  w.open = false;
+}
+
+void TelemetrySeries::tick(uint32_t nowMs) {
+  for (uint8_t i = 0; i < TELEM_WINDOWS; i++) {
+    Window &w = windows_[i];
+    if (w.open && nowMs - w.openStartMs >= TELEM_WINDOW_MS[i]) closeBucket(w);
+  }
+}
+
+void TelemetrySeries::add(const TelemetrySample &sample, uint32_t nowMs) {
+  for (uint8_t i = 0; i < TELEM_WINDOWS; i++) {
+    Window &w = windows_[i];
+    uint32_t start = nowMs - nowMs % TELEM_WINDOW_MS[i];
+    // A sample stamped slightly before the open bucket (queued) joins it.
+    if (w.open && (int32_t)(start - w.openStartMs) > 0) closeBucket(w);
+    if (!w.open) {
+      w.open = true;
+      w.openStartMs = start;
+      memset(w.accN, 0, sizeof(w.accN));
+      memset(w.accSum, 0, sizeof(w.accSum));
+    }
+    for (uint8_t c = 0; c < TELEM_CHANNELS; c++) {
+      int16_t v = sample.v[c];
+      if (v == TELEM_MISSING) continue;
+      if (w.accN[c] == 0 || v < w.accMin[c]) w.accMin[c] = v;
+      if (w.accN[c] == 0 || v > w.accMax[c]) w.accMax[c] = v;
+      w.accSum[c] += v;
+      if (w.accN[c] < UINT16_MAX) w.accN[c]++;
+    }
+  }
+}
+
+uint8_t TelemetrySeries::slot(const Window &w, uint8_t age) const {
+  return (uint8_t)((w.head + TELEM_HISTORY - 1 - age) % TELEM_HISTORY);
+}
+
+TelemetryStats TelemetrySeries::stats(uint8_t window, uint8_t age, uint8_t channel) const {
+  const Window &w = windows_[window];
+  if (age >= w.count || channel >= TELEM_CHANNELS) return TelemetryStats{0, TELEM_MISSING, TELEM_MISSING, TELEM_MISSING};
+  uint8_t s = slot(w, age);
+  return TelemetryStats{w.n[channel][s], w.min[channel][s], w.max[channel][s], w.mean[channel][s]};
+}
+
+uint32_t TelemetrySeries::bucketStartMs(uint8_t window, uint8_t age) const {
+  const Window &w = windows_[window];
+  return age < w.count ? w.startMs[slot(w, age)] : 0;
+}
+
+size_t TelemetrySeries::writeJson(uint8_t window, uint32_t nowMs, char *buf, size_t cap) const {
+  const Window &w = windows_[window];
+  if (w.unpublished == 0 || buf == nullptr) return 0;
+  size_t len = 0;
+  int n = snprintf(buf, cap, "{\"window\":\"%s\",\"buckets\":[", TELEM_WINDOW_NAME[window]);
+  if (n < 0 || (size_t)n >= cap) return 0;
+  len = (size_t)n;
+
+  for (uint8_t age = w.unpublished; age-- > 0;) {
+    uint8_t s = slot(w, age);
+    uint32_t endMs = w.startMs[s] + TELEM_WINDOW_MS[window];
+    uint32_t agoS = (int32_t)(nowMs - endMs) > 0 ? (nowMs - endMs) / 1000 : 0;
+    uint16_t samples = 0;
+    for (uint8_t c = 0; c < TELEM_CHANNELS; c++) if (w.n[c][s] > samples) samples = w.n[c][s];
+    n = snprintf(buf + len, cap - len, "%s{\"ago\":%lu,\"n\":%u", age + 1 == w.unpublished ? "" : ",",
+                 (unsigned long)agoS, samples);
+    if (n < 0 || (size_t)n >= cap - len) return 0;
+    len += (size_t)n;
+
+    for (uint8_t c = 0; c < TELEM_CHANNELS; c++) {
+      if (w.n[c][s] == 0) {
+        n = snprintf(buf + len, cap - len, ",\"%s\":null", CHANNEL_KEY[c]);
+        if (n < 0 || (size_t)n >= cap - len) return 0;
+        len += (size_t)n;
+        continue;
+      }
+      n = snprintf(buf + len, cap - len, ",\"%s\":[", CHANNEL_KEY[c]);
+      if (n < 0 || (size_t)n >= cap - len) return 0;
+      len += (size_t)n;
+      const int16_t values[3] = {w.min[c][s], w.mean[c][s], w.max[c][s]};
+      for (uint8_t k = 0; k < 3; k++) {
+        if (k > 0) {
+          if (cap - len < 2) return 0;
+          buf[len++] = ',';
+        }
+        n = putValue(buf + len, cap - len, values[k], tenths(c));
+        if (n < 0) return 0;
+        len += (size_t)n;
+      }
+      if (cap - len < 2) return 0;
+      buf[len++] = ']';
+    }
+    if (cap - len < 2) return 0;
+    buf[len++] = '}';
+  }
+  if (cap - len < 3) return 0;
+  buf[len++] = ']';
+  buf[len++] = '}';
+  buf[len] = '\0';
+  return len;
+}
@@ -0,0 +1,84 @@
+#include "time_sync.h"
+
+#include <string.h>
+
+TimeSyncEstimator::TimeSyncEstimator() { reset(); }
+
+void TimeSyncEstimator::reset() {
+  memset(window_, 0, sizeof(window_));
+  memset(&anchor_, 0, sizeof(anchor_));
+  count_ = 0;
+  next_ = 0;
+  anchored_ = false;
+  skewPpm_ = 0;
+  samples_ = 0;
+}
+
+bool TimeSyncEstimator::sample(uint32_t t1, uint32_t t2, uint32_t t3, uint32_t t4) {
+  int32_t roundTrip = (int32_t)(t4 - t1);
+  int32_t held = (int32_t)(t3 - t2);
+  if (roundTrip < 0 || held < 0 || held > roundTrip) return false;
+
+  Sample &s = window_[next_];
+  s.offsetMs = (int32_t)(((int64_t)(int32_t)(t2 - t1) + (int32_t)(t3 - t4)) / 2);
+  s.delayMs = (uint32_t)(roundTrip - held);
+  s.atMs = t4;
+  next_ = (uint8_t)((next_ + 1) % TIME_SYNC_WINDOW);
+  if (count_ < TIME_SYNC_WINDOW) count_++;
+  samples_++;
+
+  const Sample &b = best();
+  if (!anchored_) {
+    anchor_ = b;
+    anchored_ = true;
+    return true;
+  }
+  uint32_t span = b.atMs - anchor_.atMs;
+  // Until the span is long enough, a cleaner sample makes a better anchor.
+  if ((int32_t)span < 0 || (span < TIME_SYNC_SKEW_MIN_SPAN_MS && b.delayMs < anchor_.delayMs)) {
+    anchor_ = b;
+    return true;
+  }
+  if (span >= TIME_SYNC_SKEW_MIN_SPAN_MS) {
+    skewPpm_ = (int32_t)((int64_t)(b.offsetMs - anchor_.offsetMs) * 1000000 / (int64_t)span);
+  }
+  if (span >= TIME_SYNC_SKEW_MAX_SPAN_MS) anchor_ = b;
+  return true;
+}
+
+const TimeSyncEstimator::Sample &TimeSyncEstimator::best() const {
+  uint8_t bi = 0;
+  for (uint8_t i = 1; i < count_; i++) {
+    if (window_[i].delayMs < window_[bi].delayMs) bi = i;
+  }
+  return window_[bi];
+}
+
+int32_t TimeSyncEstimator::offsetMs() const { return valid() ? best().offsetMs : 0; }
+
+uint32_t TimeSyncEstimator::delayMs() const { return valid() ? best().delayMs : 0; }
+
+uint32_t TimeSyncEstimator::toServer(uint32_t clientMs) const {
+  if (!valid()) return clientMs;
+  const Sample &b = best();
+  int64_t since = (int32_t)(clientMs - b.atMs);
+  return clientMs + (uint32_t)b.offsetMs + (uint32_t)(int32_t)(since * skewPpm_ / 1000000);
+}
+
+uint32_t localWeekMs(uint32_t epochSec, uint16_t ms, int16_t utcOffsetMin) {
+  int64_t local = (int64_t)epochSec + (int64_t)utcOffsetMin * 60;
+  if (local < 0) local = 0;
+  uint32_t days = (uint32_t)(local / 86400);
+  uint32_t secOfDay = (uint32_t)(local % 86400);
+  uint32_t weekday = (days + 3) % 7; // 1970-01-01 was a Thursday
+  return (weekday * 86400UL + secOfDay) * 1000UL + ms % 1000;
+}
+
+int32_t executionLagMs(uint32_t actualWeekMs, uint8_t weekdayMon0, uint16_t minuteOfDay) {
+  int64_t scheduled = ((int64_t)weekdayMon0 * 1440 + minuteOfDay) * 60000;
+  int64_t lag = (int64_t)actualWeekMs - scheduled;
+  const int64_t week = TIME_SYNC_WEEK_MS;
+  while (lag > week / 2) lag -= week;
+  while (lag <= -week / 2) lag += week;
+  return (int32_t)lag;
+}
@@ -0,0 +1,35 @@
+#include "timing_histogram.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void TimingHistogram::reset() {
+  memset(buckets_, 0, sizeof(buckets_));
+  count_ = 0;
+  sumUs_ = 0;
+  maxUs_ = 0;
+}
+
+uint32_t TimingHistogram::percentileUs(uint8_t pct) const {
+  if (count_ == 0) return 0;
+  if (pct > 100) pct = 100;
+  // Smallest bucket whose cumulative count reaches ceil(count * pct / 100).
+  uint64_t rank = ((uint64_t)count_ * pct + 99) / 100;
+  if (rank == 0) rank = 1;
+  uint64_t seen = 0;
+  for (uint8_t b = 0; b < TIMING_BUCKETS; b++) {
+    seen += buckets_[b];
+    if (seen >= rank) {
+      uint32_t limit = bucketLimitUs(b);
+      return limit > maxUs_ ? maxUs_ : limit;
+    }
+  }
+  return maxUs_;
+}
+
+size_t TimingHistogram::writeJson(char *buf, size_t cap) const {
+  int n = snprintf(buf, cap, "{\"n\":%lu,\"mean_us\":%lu,\"p50_us\":%lu,\"p99_us\":%lu,\"max_us\":%lu}",
+                   (unsigned long)count_, (unsigned long)meanUs(), (unsigned long)percentileUs(50),
+                   (unsigned long)percentileUs(99), (unsigned long)maxUs_);
+  return n < 0 || (size_t)n >= cap ? 0 : (size_t)n;
+}
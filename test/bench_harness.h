@@ -0,0 +1,79 @@
+#pragma once
+
+// Minimal self-contained micro-benchmark harness for host builds.
+// Include from exactly one translation unit per executable: it replaces the
+// global operator new/delete to count allocations.
+//
+// Each case prints one JSON line:
+//   {"bench":"<name>","iterations":N,"ns_per_op":X,"allocs_per_op":Y}
+// Pass --quick to run a short smoke pass (used by ctest).
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+
+static size_t g_benchAllocs = 0;
+
+void *operator new(size_t n) {
+  g_benchAllocs++;
+  void *p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void *operator new[](size_t n) {
+  g_benchAllocs++;
+  void *p = malloc(n ? n : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+struct BenchConfig {
+  double minTimeMs = 200.0;
+  bool quick = false;
+};
+
+inline BenchConfig benchConfigFromArgs(int argc, char **argv) {
+  BenchConfig cfg;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quick") == 0) {
+      cfg.quick = true;
+      cfg.minTimeMs = 2.0;
+    }
+  }
+  return cfg;
+}
+
+// Keeps results observable so the optimizer cannot drop the work.
+static volatile uint64_t g_benchSink = 0;
+inline void benchKeep(uint64_t v) { g_benchSink = g_benchSink + v; }
+
+template <typename Fn>
+void runBench(const BenchConfig &cfg, const char *name, Fn fn) {
+  typedef std::chrono::steady_clock Clock;
+  fn(); // warm-up
+
+  uint64_t iterations = 1;
+  double elapsedNs = 0;
+  size_t allocs = 0;
+  while (true) {
+    size_t allocsBefore = g_benchAllocs;
+    Clock::time_point t0 = Clock::now();
+    for (uint64_t i = 0; i < iterations; i++) fn();
+    Clock::time_point t1 = Clock::now();
+    allocs = g_benchAllocs - allocsBefore;
+    elapsedNs = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    if (elapsedNs >= cfg.minTimeMs * 1e6 || iterations >= (1ull << 32)) break;
+    iterations *= (elapsedNs < cfg.minTimeMs * 1e5) ? 10 : 2;
+  }
+
+  printf("{\"bench\":\"%s\",\"iterations\":%llu,\"ns_per_op\":%.2f,\"allocs_per_op\":%.3f}\n", name,
+         (unsigned long long)iterations, elapsedNs / iterations, (double)allocs / iterations);
+  fflush(stdout);
+}
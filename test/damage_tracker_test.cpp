@@ -0,0 +1,130 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "damage_tracker.h"
+
+static const int W = 240;
+static const int H = 240;
+
+struct Frame {
+  std::vector<uint16_t> px;
+  Frame() : px(W * H, 0) {}
+};
+
+void fillRect(Frame &f, DamageTracker &dt, int x, int y, int w, int h, uint16_t color) {
+  dt.markRect(x, y, w, h);
+  for (int yy = y; yy < y + h; yy++) {
+    if (yy < 0 || yy >= H) continue;
+    for (int xx = x; xx < x + w; xx++) {
+      if (xx < 0 || xx >= W) continue;
+      f.px[yy * W + xx] = color;
+    }
+  }
+}
+
+// Same shape of work as loop(): clear, two eyes, overlay text blocks.
+void drawScene(Frame &f, DamageTracker &dt, int frame) {
+  std::fill(f.px.begin(), f.px.end(), 0);
+  int look = (frame / 3) % 20 - 10;
+  int blink = (frame % 40 < 4) ? (frame % 40) * 20 : 0;
+  for (int cx : {80, 160}) {
+    int eh = 95 - blink;
+    if (eh < 0) eh = 0;
+    fillRect(f, dt, cx - 35, 120 - eh / 2, 70, eh, 0x001F);
+    fillRect(f, dt, cx + look - 18, 120 - 22, 36, 44, 0x0000);
+  }
+  fillRect(f, dt, 10, 10, 36, 14, 0xFFFF);                    // "EVE"
+  fillRect(f, dt, 10, 40, 30 + (frame / 10) % 5 * 6, 8, 0xFFFF); // RX counter grows
+  fillRect(f, dt, 10, 185, 54, 8, 0xFFFF);                    // TIME line
+}
+
+bool insideAny(const DamageRect *rects, uint16_t n, int x, int y) {
+  for (uint16_t i = 0; i < n; i++) {
+    if (x >= rects[i].x && x < rects[i].x + rects[i].w && y >= rects[i].y && y < rects[i].y + rects[i].h) return true;
+  }
+  return false;
+}
+
+void applyPush(std::vector<uint16_t> &panel, const Frame &f, const DamageRect *rects, uint16_t n) {
+  for (uint16_t i = 0; i < n; i++) {
+    for (int y = rects[i].y; y < rects[i].y + rects[i].h; y++) {
+      memcpy(&panel[y * W + rects[i].x], &f.px[y * W + rects[i].x], rects[i].w * 2);
+    }
+  }
+}
+
+void test_first_collect_pushes_everything() {
+  DamageTracker dt(W, H);
+  Frame f;
+  uint16_t n = dt.collect(f.px.data());
+  assert(n == 1);
+  assert(dt.rects()[0].x == 0 && dt.rects()[0].y == 0 && dt.rects()[0].w == W && dt.rects()[0].h == H);
+  assert(dt.lastBytes() == (uint32_t)W * H * 2);
+}
+
+void test_untouched_frame_pushes_nothing() {
+  DamageTracker dt(W, H);
+  Frame f;
+  dt.collect(f.px.data());
+  assert(dt.collect(f.px.data()) == 0);
+  // Redrawing identical content is tracked but filtered by the tile hashes.
+  fillRect(f, dt, 30, 30, 20, 20, 0xFFFF);
+  assert(dt.collect(f.px.data()) > 0);
+  fillRect(f, dt, 30, 30, 20, 20, 0xFFFF);
+  assert(dt.collect(f.px.data()) == 0);
+}
+
+void test_erased_content_is_pushed() {
+  DamageTracker dt(W, H);
+  Frame f;
+  dt.collect(f.px.data());
+  fillRect(f, dt, 100, 100, 10, 10, 0xFFFF);
+  assert(dt.collect(f.px.data()) == 1);
+  std::fill(f.px.begin(), f.px.end(), 0); // untracked clear, like fillScreen
+  assert(dt.collect(f.px.data()) == 1);
+  assert(insideAny(dt.rects(), 1, 105, 105));
+}
+
+void test_scene_diff_covered_by_pushed_regions() {
+  DamageTracker dt(W, H);
+  Frame f;
+  std::vector<uint16_t> panel(W * H, 0xAAAA);
+  const uint32_t fullBytes = (uint32_t)W * H * 2;
+  uint64_t total = 0;
+  uint32_t maxBytes = 0;
+  const int frames = 200;
+
+  for (int frame = 0; frame < frames; frame++) {
+    drawScene(f, dt, frame);
+    uint16_t n = dt.collect(f.px.data());
+    for (int y = 0; y < H; y++) {
+      for (int x = 0; x < W; x++) {
+        if (panel[y * W + x] != f.px[y * W + x]) assert(insideAny(dt.rects(), n, x, y));
+      }
+    }
+    applyPush(panel, f, dt.rects(), n);
+    assert(panel == f.px);
+    if (frame > 0) {
+      total += dt.lastBytes();
+      if (dt.lastBytes() > maxBytes) maxBytes = dt.lastBytes();
+    }
+  }
+
+  uint32_t avg = (uint32_t)(total / (frames - 1));
+  printf("damage_tracker frames=%d full_bytes=%u avg_bytes=%u max_bytes=%u avg_pct=%.1f\n", frames - 1,
+         (unsigned)fullBytes, (unsigned)avg, (unsigned)maxBytes, 100.0 * avg / fullBytes);
+  assert(avg < fullBytes / 2);
+}
+
+int main() {
+  test_first_collect_pushes_everything();
+  test_untouched_frame_pushes_nothing();
+  test_erased_content_is_pushed();
+  test_scene_diff_covered_by_pushed_regions();
+  std::cout << "All damage tracker tests passed\n";
+  return 0;
+}
@@ -0,0 +1,250 @@
+#include <assert.h>
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "event_scheduler.h"
+
+namespace {
+
+struct Log {
+  std::vector<int> fired;
+};
+
+struct Tag {
+  Log *log;
+  int tag;
+};
+
+void record(void *ctx) {
+  Tag &t = *static_cast<Tag *>(ctx);
+  t.log->fired.push_back(t.tag);
+}
+
+} // namespace
+
+void test_runs_in_deadline_order() {
+  EventScheduler s;
+  Log log;
+  Tag a{&log, 1}, b{&log, 2}, c{&log, 3}, d{&log, 4};
+  int8_t ia = s.add(record, &a), ib = s.add(record, &b), ic = s.add(record, &c), id = s.add(record, &d);
+  s.armAt(ia, 300);
+  s.armAt(ib, 100);
+  s.armAt(ic, 200);
+  s.armAt(id, 100); // same deadline as b, armed later
+  assert(s.armedCount() == 4);
+  assert(s.msUntilNext(0) == 100);
+  assert(s.run(99) == 0);
+  assert(s.run(250) == 3);
+  assert((log.fired == std::vector<int>{2, 4, 3}));
+  assert(!s.armed(ib) && s.armed(ia));
+  assert(s.msUntilNext(250) == 50);
+  assert(s.run(1000) == 1);
+  assert(s.msUntilNext(1000) == EVENT_NO_DEADLINE);
+}
+
+void test_periodic_does_not_drift() {
+  EventScheduler s;
+  Log log;
+  Tag a{&log, 1};
+  int8_t id = s.every(record, &a, 100, 0);
+  assert(s.dueAt(id) == 100);
+  // Run late every time: the next deadline still sits on the 100 ms grid.
+  assert(s.run(107) == 1);
+  assert(s.dueAt(id) == 200);
+  assert(s.run(230) == 1);
+  assert(s.dueAt(id) == 300);
+  // A long stall skips the missed periods instead of replaying them.
+  assert(s.run(1055) == 1);
+  assert(s.dueAt(id) == 1100);
+  assert(log.fired.size() == 3);
+}
+
+void test_arm_variants() {
+  EventScheduler s;
+  Log log;
+  Tag a{&log, 1};
+  int8_t id = s.add(record, &a);
+  assert(!s.armed(id));
+  s.armIn(id, 1000, 50);
+  assert(s.dueAt(id) == 1050);
+  s.armNoLaterThan(id, 2000); // later: ignored
+  assert(s.dueAt(id) == 1050);
+  s.armNoLaterThan(id, 1010);
+  assert(s.dueAt(id) == 1010);
+  s.armAt(id, 5000); // armAt always replaces
+  assert(s.dueAt(id) == 5000);
+  s.disarm(id);
+  assert(!s.armed(id) && s.armedCount() == 0);
+  s.armNoLaterThan(id, 7000); // disarmed: arms
+  assert(s.armed(id) && s.dueAt(id) == 7000);
+  assert(s.remove(id));
+  assert(!s.armed(id) && !s.armAt(id, 1));
+  assert(s.add(nullptr, nullptr) == -1);
+}
+
+void test_capacity() {
+  EventScheduler s;
+  Log log;
+  Tag a{&log, 1};
+  for (uint8_t i = 0; i < EVENT_SCHEDULER_CAPACITY; i++) assert(s.add(record, &a) == (int8_t)i);
+  assert(s.add(record, &a) == -1);
+  s.remove(5);
+  assert(s.add(record, &a) == 5);
+}
+
+struct Rearm {
+  EventScheduler *s;
+  int8_t self;
+  int8_t other;
+  int runs;
+};
+
+void rearmSelf(void *ctx) {
+  Rearm &r = *static_cast<Rearm *>(ctx);
+  r.runs++;
+  if (r.runs < 3) r.s->armAt(r.self, r.s->dueAt(r.self) + 10); // one-shot: dueAt still holds the last deadline
+  if (r.other >= 0) r.s->remove(r.other);
+}
+
+void spin(void *ctx) {
+  Rearm &r = *static_cast<Rearm *>(ctx);
+  r.runs++;
+  r.s->armAt(r.self, 0); // always overdue
+}
+
+void test_callbacks_modify_timers() {
+  EventScheduler s;
+  Log log;
+  Tag victim{&log, 9};
+  Rearm r{&s, -1, -1, 0};
+  r.self = s.add(rearmSelf, &r);
+  r.other = s.add(record, &victim);
+  s.armAt(r.self, 100);
+  s.armAt(r.other, 105);
+  // The first run removes the victim before it is due; the re-arms land
+  // inside the same run() call and run in order.
+  assert(s.run(200) == 3);
+  assert(r.runs == 3 && log.fired.empty());
+  assert(s.armedCount() == 0);
+
+  Rearm sp{&s, -1, -1, 0};
+  sp.self = s.add(spin, &sp);
+  s.armAt(sp.self, 0);
+  uint8_t ran = s.run(10);
+  assert(ran > 0 && sp.runs == ran); // bounded
+  assert(s.armed(sp.self));
+}
+
+void test_wraparound() {
+  EventScheduler s;
+  Log log;
+  Tag a{&log, 1}, b{&log, 2};
+  uint32_t now = 0xFFFFFF00u;
+  int8_t ia = s.add(record, &a), ib = s.add(record, &b);
+  s.armIn(ia, now, 0x200); // wraps past zero
+  s.armIn(ib, now, 0x80);
+  assert(s.msUntilNext(now) == 0x80);
+  assert(s.run(now + 0x100) == 1);
+  assert(log.fired.back() == 2);
+  assert(s.msUntilNext(now + 0x100) == 0x100);
+  assert(s.run(0x100) == 1);
+  assert(log.fired.back() == 1);
+
+  int8_t ip = s.every(record, &a, 0x100, now);
+  assert(s.dueAt(ip) == 0);
+  assert(s.run(0x10) == 1 && s.dueAt(ip) == 0x100);
+}
+
+// Random add/arm/disarm/remove/run sequences against a plain map of deadlines.
+void test_matches_reference() {
+  std::mt19937 rng(1234);
+  for (int round = 0; round < 200; round++) {
+    EventScheduler s;
+    Log log;
+    std::vector<Tag> tags;
+    for (int i = 0; i < EVENT_SCHEDULER_CAPACITY; i++) tags.push_back(Tag{&log, i});
+    std::map<int, uint32_t> armed;   // id -> deadline
+    std::map<int, uint32_t> period;  // registered ids
+    uint32_t now = rng();
+    for (int step = 0; step < 300; step++) {
+      uint32_t op = rng() % 10;
+      int id = (int)(rng() % EVENT_SCHEDULER_CAPACITY);
+      if (op < 2) {
+        uint32_t p = rng() % 3 == 0 ? 1 + rng() % 500 : 0;
+        int expect = 0; // add() takes the lowest free slot
+        while (expect < EVENT_SCHEDULER_CAPACITY && period.count(expect)) expect++;
+        int8_t got = s.add(record, expect < EVENT_SCHEDULER_CAPACITY ? &tags[expect] : nullptr, p);
+        if (expect == EVENT_SCHEDULER_CAPACITY) {
+          assert(got == -1);
+        } else {
+          assert(got == expect);
+          period[got] = p;
+        }
+      } else if (op < 5) {
+        uint32_t due = now + rng() % 1000;
+        bool ok = s.armAt((int8_t)id, due);
+        assert(ok == (period.count(id) > 0));
+        if (ok) armed[id] = due;
+      } else if (op < 6) {
+        s.disarm((int8_t)id);
+        armed.erase(id);
+      } else if (op < 7) {
+        assert(s.remove((int8_t)id) == (period.count(id) > 0));
+        armed.erase(id);
+        period.erase(id);
+      } else {
+        now += rng() % 400;
+        // Expected: everything due, in deadline order.
+        std::vector<std::pair<int32_t, int>> due;
+        for (const auto &kv : armed) {
+          int32_t rel = (int32_t)(kv.second - now);
+          if (rel <= 0) due.push_back({rel, kv.first});
+        }
+        std::sort(due.begin(), due.end());
+        log.fired.clear();
+        uint8_t ran = s.run(now);
+        assert(ran == due.size());
+        for (size_t i = 0; i < due.size(); i++) {
+          int fid = due[i].second;
+          // Equal deadlines may run in either order here (arming order is not
+          // tracked by the reference), so compare deadlines, not ids.
+          assert(armed.count(log.fired[i]) && armed[log.fired[i]] == armed[fid]);
+        }
+        for (size_t i = 0; i < due.size(); i++) {
+          int fid = due[i].second;
+          uint32_t p = period[fid];
+          if (p == 0) {
+            armed.erase(fid);
+          } else {
+            uint32_t d = armed[fid];
+            armed[fid] = d + ((now - d) / p + 1) * p;
+          }
+        }
+      }
+      assert(s.armedCount() == armed.size());
+      for (const auto &kv : armed) assert(s.armed((int8_t)kv.first) && s.dueAt((int8_t)kv.first) == kv.second);
+      if (armed.empty()) {
+        assert(s.msUntilNext(now) == EVENT_NO_DEADLINE);
+      } else {
+        int32_t best = 0x7FFFFFFF;
+        for (const auto &kv : armed) best = std::min(best, (int32_t)(kv.second - now));
+        assert(s.msUntilNext(now) == (uint32_t)(best > 0 ? best : 0));
+      }
+    }
+  }
+}
+
+int main() {
+  test_runs_in_deadline_order();
+  test_periodic_does_not_drift();
+  test_arm_variants();
+  test_capacity();
+  test_callbacks_modify_timers();
+  test_wraparound();
+  test_matches_reference();
+  std::cout << "event_scheduler_test: all passed" << std::endl;
+  return 0;
+}
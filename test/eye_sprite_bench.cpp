@@ -0,0 +1,95 @@
+// Per-frame cost of drawing both eyes (white + pupil, with damage marking):
+// the fillRoundRect column walk the render task used before against span
+// blits from the sprite cache, at several blink quantizations. Each cache
+// setting also prints one memory line:
+//   {"bench":"eyes/memory","levels":N,"spans":N,"bytes":N}
+
+#include <math.h>
+#include <string>
+#include <vector>
+
+#include "bench_harness.h"
+#include "eye_sprite.h"
+
+namespace {
+
+const int W = 240;
+const int H = 240;
+const uint16_t BLUE = 0x001F;
+const uint16_t BLACK = 0x0000;
+
+struct EyePos {
+  float cx, cy;
+};
+const EyePos EYES[2] = {{80, 120}, {160, 120}};
+
+// A 64-frame loop: a blink over the first 11 frames (180 ms at 16 ms a
+// frame), the gaze drifting the whole time.
+struct FrameState {
+  float blinkAmt;
+  float lookX;
+  float lookY;
+};
+
+std::vector<FrameState> frames() {
+  std::vector<FrameState> v;
+  for (int i = 0; i < 64; i++) {
+    FrameState s;
+    float t = i * 16 / 180.0f;
+    if (t < 1.0f) {
+      float e = t < 0.5f ? t * 2 : (1 - t) * 2;
+      s.blinkAmt = e * e * (3 - 2 * e);
+    } else {
+      s.blinkAmt = 0.0f;
+    }
+    s.lookX = sinf(i * 0.1f);
+    s.lookY = cosf(i * 0.07f) * 0.6f;
+    v.push_back(s);
+  }
+  return v;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  BenchConfig cfg = benchConfigFromArgs(argc, argv);
+  std::vector<uint16_t> fb(W * H, 0);
+  DamageTracker damage(W, H);
+  const std::vector<FrameState> seq = frames();
+  size_t frame = 0;
+
+  runBench(cfg, "eyes/fillroundrect", [&] {
+    const FrameState &s = seq[frame++ % seq.size()];
+    for (const EyePos &e : EYES) {
+      float eh = 95 * (1.0f - s.blinkAmt);
+      fillRoundRectInto(fb.data(), W, H, &damage, (int)(e.cx - 35), (int)(e.cy - eh / 2), 70, (int)eh, 35, BLUE);
+      float px = e.cx + s.lookX * 18;
+      float py = e.cy + s.lookY * 12;
+      fillRoundRectInto(fb.data(), W, H, &damage, (int)(px - 18), (int)(py - 22), 36, 44, 18, BLACK);
+    }
+    benchKeep(fb[120 * W + 80]);
+  });
+
+  const uint8_t levelCounts[] = {4, 8, 16, 32, EYE_SPRITE_MAX_LEVELS};
+  for (uint8_t levels : levelCounts) {
+    std::vector<EyeSpan> spans(EyeSpriteCache::spansNeeded(70, 95, levels, 36, 44, 18));
+    EyeSpriteCache cache(spans.data(), (uint16_t)spans.size());
+    if (!cache.build(70, 95, levels, 36, 44, 18)) return 1;
+    printf("{\"bench\":\"eyes/memory\",\"levels\":%u,\"spans\":%u,\"bytes\":%u}\n", levels, (unsigned)spans.size(),
+           (unsigned)cache.bytesUsed());
+
+    std::string name = "eyes/sprite_cache/levels" + std::to_string(levels);
+    runBench(cfg, name.c_str(), [&] {
+      const FrameState &s = seq[frame++ % seq.size()];
+      uint8_t level = cache.levelFor(s.blinkAmt);
+      for (const EyePos &e : EYES) {
+        cache.drawWhite(fb.data(), W, H, &damage, e.cx, e.cy, level, BLUE);
+        float px = e.cx + s.lookX * 18;
+        float py = e.cy + s.lookY * 12;
+        cache.drawPupil(fb.data(), W, H, &damage, (int)(px - 18), (int)(py - 22), BLACK);
+      }
+      benchKeep(fb[120 * W + 80]);
+    });
+  }
+  return 0;
+}
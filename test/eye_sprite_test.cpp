@@ -0,0 +1,130 @@
+#include <assert.h>
+#include <math.h>
+#include <iostream>
+#include <vector>
+
+#include "eye_sprite.h"
+
+static const int W = 240;
+static const int H = 240;
+static const uint16_t BLUE = 0x001F;
+static const uint16_t BLACK = 0x0000;
+
+struct Frame {
+  std::vector<uint16_t> px;
+  Frame() : px(W * H, 0x1234) {}
+};
+
+// The eye as main.cpp drew it before the cache, with the same float math.
+void drawEyeReference(Frame &f, float cx, float cy, float ew, float eyeH, float blinkAmt) {
+  float open = 1.0f - blinkAmt;
+  float eh = eyeH * open;
+  fillRoundRectInto(f.px.data(), W, H, nullptr, (int)(cx - ew / 2), (int)(cy - eh / 2), (int)ew, (int)eh,
+                    (int)(ew * 0.5f), BLUE);
+}
+
+void test_white_matches_fillroundrect() {
+  const uint8_t levelCounts[] = {2, 5, 16, 33, EYE_SPRITE_MAX_LEVELS};
+  // On screen, and hanging off every edge.
+  const float centers[][2] = {{80, 120}, {160, 120}, {10, 120}, {235, 120}, {120, 5}, {120, 236}, {-20, -30}, {3.7f, 200.4f}};
+  for (uint8_t levels : levelCounts) {
+    std::vector<EyeSpan> spans(EyeSpriteCache::spansNeeded(70, 95, levels, 36, 44, 18));
+    EyeSpriteCache cache(spans.data(), (uint16_t)spans.size());
+    assert(cache.build(70, 95, levels, 36, 44, 18));
+    for (uint8_t k = 0; k < levels; k++) {
+      float blinkAmt = (float)k / (float)(levels - 1);
+      assert(cache.levelFor(blinkAmt) == k);
+      for (const float *c : centers) {
+        Frame expect, got;
+        drawEyeReference(expect, c[0], c[1], 70, 95, blinkAmt);
+        cache.drawWhite(got.px.data(), W, H, nullptr, c[0], c[1], k, BLUE);
+        assert(expect.px == got.px);
+      }
+    }
+    assert(cache.whiteHeight(0) == 95 && cache.whiteHeight(levels - 1) == 0);
+  }
+}
+
+void test_pupil_matches_fillroundrect() {
+  std::vector<EyeSpan> spans(EyeSpriteCache::spansNeeded(70, 95, 8, 36, 44, 18));
+  EyeSpriteCache cache(spans.data(), (uint16_t)spans.size());
+  assert(cache.build(70, 95, 8, 36, 44, 18));
+  for (int y = -50; y < H + 10; y += 7) {
+    for (int x = -40; x < W + 10; x += 13) {
+      Frame expect, got;
+      fillRoundRectInto(expect.px.data(), W, H, nullptr, (int16_t)x, (int16_t)y, 36, 44, 18, BLACK);
+      cache.drawPupil(got.px.data(), W, H, nullptr, (int16_t)x, (int16_t)y, BLACK);
+      assert(expect.px == got.px);
+    }
+  }
+}
+
+void test_damage_covers_drawn_pixels() {
+  std::vector<EyeSpan> spans(EyeSpriteCache::spansNeeded(70, 95, 16, 36, 44, 18));
+  EyeSpriteCache cache(spans.data(), (uint16_t)spans.size());
+  assert(cache.build(70, 95, 16, 36, 44, 18));
+  Frame f;
+  DamageTracker dt(W, H);
+  dt.collect(f.px.data()); // first frame is forced full
+  Frame before = f;
+  cache.drawWhite(f.px.data(), W, H, &dt, 80, 120, 3, BLUE);
+  cache.drawPupil(f.px.data(), W, H, &dt, 70, 100, BLACK);
+  uint16_t n = dt.collect(f.px.data());
+  assert(n > 0);
+  for (int y = 0; y < H; y++) {
+    for (int x = 0; x < W; x++) {
+      if (f.px[y * W + x] == before.px[y * W + x]) continue;
+      bool covered = false;
+      for (uint16_t i = 0; i < n && !covered; i++) {
+        const DamageRect &r = dt.rects()[i];
+        covered = x >= r.x && x < r.x + r.w && y >= r.y && y < r.y + r.h;
+      }
+      assert(covered);
+    }
+  }
+}
+
+void test_level_for() {
+  std::vector<EyeSpan> spans(EyeSpriteCache::spansNeeded(70, 95, 9, 36, 44, 18));
+  EyeSpriteCache cache(spans.data(), (uint16_t)spans.size());
+  assert(cache.levelFor(0.5f) == 0); // not built
+  assert(cache.build(70, 95, 9, 36, 44, 18));
+  assert(cache.levelFor(0.0f) == 0);
+  assert(cache.levelFor(-1.0f) == 0);
+  assert(cache.levelFor(NAN) == 0);
+  assert(cache.levelFor(1.0f) == 8);
+  assert(cache.levelFor(7.0f) == 8);
+  assert(cache.levelFor(0.5f) == 4);
+  assert(cache.levelFor(0.06f) == 0);
+  assert(cache.levelFor(0.07f) == 1);
+}
+
+void test_build_limits() {
+  uint16_t need = EyeSpriteCache::spansNeeded(70, 95, 16, 36, 44, 18);
+  std::vector<EyeSpan> spans(need);
+  EyeSpriteCache small(spans.data(), (uint16_t)(need - 1));
+  assert(!small.build(70, 95, 16, 36, 44, 18));
+  assert(!small.ready() && small.bytesUsed() == 0);
+
+  EyeSpriteCache cache(spans.data(), need);
+  assert(!cache.build(70, 95, 1, 36, 44, 18));
+  assert(!cache.build(70, 95, EYE_SPRITE_MAX_LEVELS + 1, 36, 44, 18));
+  assert(cache.build(70, 95, 16, 36, 44, 18));
+  assert(cache.ready() && cache.levels() == 16);
+  assert(cache.bytesUsed() >= need * sizeof(EyeSpan));
+
+  // Drawing a level that does not exist is a no-op.
+  Frame f, blank;
+  cache.drawWhite(f.px.data(), W, H, nullptr, 80, 120, 16, BLUE);
+  assert(f.px == blank.px);
+}
+
+int main() {
+  test_white_matches_fillroundrect();
+  test_pupil_matches_fillroundrect();
+  test_damage_covers_drawn_pixels();
+  test_level_for();
+  test_build_limits();
+  std::cout << "eye_sprite_test: all passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <string.h>
+#include <deque>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "mqtt_outbox.h"
+
+struct Sent {
+  std::string topic;
+  std::string payload;
+  bool retained;
+};
+
+static std::vector<Sent> g_sent;
+static bool g_linkUp = true;
+
+bool recordSend(const char *topic, const uint8_t *payload, size_t len, bool retained) {
+  if (!g_linkUp) return false;
+  g_sent.push_back(Sent{topic, std::string((const char *)payload, len), retained});
+  return true;
+}
+
+bool put(MqttOutbox &box, const std::string &topic, const std::string &payload, MqttOutboxKind kind, bool retained = false) {
+  return box.enqueue(topic.c_str(), payload.data(), payload.size(), retained, kind);
+}
+
+void test_fifo_and_coalescing() {
+  MqttOutbox box;
+  g_sent.clear();
+  g_linkUp = true;
+  put(box, "r/1/state", "ON", MQTT_OUTBOX_STATE);
+  put(box, "r/1/executed", "ON", MQTT_OUTBOX_EVENT);
+  put(box, "r/1/state", "OFF", MQTT_OUTBOX_STATE);
+  put(box, "r/1/executed", "OFF", MQTT_OUTBOX_EVENT);
+  put(box, "r/1/state", "ON", MQTT_OUTBOX_STATE, true);
+  put(box, "r/2/state", "OFF", MQTT_OUTBOX_STATE);
+  assert(box.depth() == 4);
+  assert(box.stats().coalesced == 2);
+
+  assert(box.drain(recordSend, 2) == 2);
+  assert(box.drain(recordSend, 10) == 2);
+  assert(box.depth() == 0 && box.bytesUsed() == 0);
+  assert(g_sent.size() == 4);
+  assert(g_sent[0].topic == "r/1/executed" && g_sent[0].payload == "ON");
+  assert(g_sent[1].topic == "r/1/executed" && g_sent[1].payload == "OFF");
+  assert(g_sent[2].topic == "r/1/state" && g_sent[2].payload == "ON" && g_sent[2].retained);
+  assert(g_sent[3].topic == "r/2/state");
+  assert(box.stats().sent == 4 && box.stats().enqueued == 6 && box.stats().highWater == 4);
+}
+
+void test_survives_disconnect() {
+  MqttOutbox box;
+  g_sent.clear();
+  g_linkUp = false;
+  put(box, "a", "1", MQTT_OUTBOX_EVENT);
+  put(box, "b", "2", MQTT_OUTBOX_EVENT);
+  assert(box.drain(recordSend, 4) == 0);
+  assert(box.depth() == 2 && box.stats().sendFailures == 1);
+  g_linkUp = true;
+  assert(box.drain(recordSend, 4) == 2);
+  assert(g_sent.size() == 2 && g_sent[0].topic == "a" && g_sent[1].topic == "b");
+}
+
+void test_drops_oldest_when_full() {
+  MqttOutbox box;
+  g_sent.clear();
+  g_linkUp = true;
+  for (int i = 0; i < MQTT_OUTBOX_SLOTS + 5; i++) put(box, "ev", std::to_string(i), MQTT_OUTBOX_EVENT);
+  assert(box.depth() == MQTT_OUTBOX_SLOTS);
+  assert(box.stats().dropped == 5);
+  box.drain(recordSend, 255);
+  assert(g_sent.front().payload == "5" && g_sent.back().payload == std::to_string(MQTT_OUTBOX_SLOTS + 4));
+
+  // Byte-bound: large payloads evict by space, not slot count.
+  std::string big(1500, 'x');
+  for (int i = 0; i < 4; i++) assert(put(box, "big", big + std::to_string(i), MQTT_OUTBOX_EVENT));
+  assert(box.depth() == 2 && box.bytesUsed() <= MQTT_OUTBOX_ARENA);
+  std::string huge(MQTT_OUTBOX_ARENA, 'y');
+  assert(!put(box, "huge", huge, MQTT_OUTBOX_EVENT));
+  assert(box.depth() == 2);
+}
+
+// Against a model without drops: everything queued must come out in order,
+// with each state topic represented only by its latest value.
+void test_randomized_against_model() {
+  std::mt19937 rng(2024);
+  MqttOutbox box;
+  g_sent.clear();
+  std::deque<Sent> model;
+  for (int step = 0; step < 200000; step++) {
+    uint32_t r = rng() % 10;
+    if (r < 6 && box.depth() < MQTT_OUTBOX_SLOTS / 2) {
+      bool state = rng() % 2;
+      std::string topic = std::string(state ? "s/" : "e/") + std::to_string(rng() % 6);
+      std::string payload(rng() % 120, (char)('a' + rng() % 26));
+      if (state) {
+        for (auto it = model.begin(); it != model.end(); ++it) {
+          if (it->topic == topic) {
+            model.erase(it);
+            break;
+          }
+        }
+      }
+      put(box, topic, payload, state ? MQTT_OUTBOX_STATE : MQTT_OUTBOX_EVENT);
+      model.push_back(Sent{topic, payload, false});
+    } else {
+      g_linkUp = rng() % 5 != 0;
+      size_t before = g_sent.size();
+      box.drain(recordSend, (uint8_t)(1 + rng() % 4));
+      for (size_t k = before; k < g_sent.size(); k++) {
+        assert(!model.empty());
+        assert(g_sent[k].topic == model.front().topic && g_sent[k].payload == model.front().payload);
+        model.pop_front();
+      }
+    }
+    assert(box.depth() == model.size());
+  }
+  assert(box.stats().dropped == 0);
+  assert(box.stats().coalesced > 1000);
+}
+
+int main() {
+  test_fifo_and_coalescing();
+  test_survives_disconnect();
+  test_drops_oldest_when_full();
+  test_randomized_against_model();
+  std::cout << "All mqtt outbox tests passed\n";
+  return 0;
+}
@@ -0,0 +1,126 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include "mqtt_router.h"
+
+static size_t g_allocs = 0;
+
+void *operator new(size_t n) {
+  g_allocs++;
+  void *p = malloc(n);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+static std::string g_last;
+static uint8_t g_relay = 0;
+static int g_calls = 0;
+
+void onSet(uint8_t relay, const char *payload, size_t len) {
+  g_calls++;
+  g_relay = relay;
+  g_last = "set:" + std::string(payload, len);
+}
+
+void onScheduleSet(uint8_t relay, const char *payload, size_t len) {
+  g_calls++;
+  g_relay = relay;
+  g_last = "schedule:" + std::string(payload, len);
+}
+
+void onBulk(uint8_t relay, const char *payload, size_t len) {
+  g_calls++;
+  g_relay = relay;
+  g_last = "bulk:" + std::string(payload, len);
+}
+
+MqttTopicRouter makeRouter() {
+  MqttTopicRouter r("progetto/EVE/POWER/", 3);
+  assert(r.addRelayRoute("set", onSet));
+  assert(r.addRelayRoute("schedule/set", onScheduleSet));
+  assert(r.addRoute("schedule/set", onBulk));
+  assert(!r.addRelayRoute("set", onSet));
+  return r;
+}
+
+bool send(const MqttTopicRouter &r, const char *topic, const char *payload) {
+  return r.dispatch(topic, (const uint8_t *)payload, strlen(payload));
+}
+
+void test_dispatch() {
+  MqttTopicRouter r = makeRouter();
+  assert(send(r, "progetto/EVE/POWER/relay/2/set", "ON"));
+  assert(g_relay == 2 && g_last == "set:ON");
+  assert(send(r, "progetto/EVE/POWER/relay/3/schedule/set", "[]"));
+  assert(g_relay == 3 && g_last == "schedule:[]");
+  assert(send(r, "progetto/EVE/POWER/schedule/set", "{}"));
+  assert(g_relay == 0 && g_last == "bulk:{}");
+}
+
+void test_rejects() {
+  MqttTopicRouter r = makeRouter();
+  g_calls = 0;
+  assert(!send(r, "progetto/EVE/POWER/relay/0/set", "ON"));
+  assert(!send(r, "progetto/EVE/POWER/relay/4/set", "ON"));
+  assert(!send(r, "progetto/EVE/POWER/relay/x/set", "ON"));
+  assert(!send(r, "progetto/EVE/POWER/relay/1", "ON"));
+  assert(!send(r, "progetto/EVE/POWER/relay/1/state", "ON"));
+  assert(!send(r, "progetto/EVE/POWER/relay/1/set/extra", "ON"));
+  assert(!send(r, "progetto/EVE/OTHER/relay/1/set", "ON"));
+  assert(!send(r, "progetto/EVE/POWER/set", "ON"));
+  assert(g_calls == 0);
+}
+
+void test_payload_is_length_delimited() {
+  MqttTopicRouter r = makeRouter();
+  const uint8_t buf[] = {'O', 'F', 'F', 'X', 'Y'};
+  assert(r.dispatch("progetto/EVE/POWER/relay/1/set", buf, 3));
+  assert(g_last == "set:OFF");
+}
+
+void test_dispatch_does_not_allocate() {
+  MqttTopicRouter r("progetto/EVE/POWER/", 3);
+  static int hits = 0;
+  struct H { static void count(uint8_t, const char *, size_t) { hits++; } };
+  r.addRelayRoute("set", H::count);
+  r.addRelayRoute("schedule/set", H::count);
+  size_t before = g_allocs;
+  for (int i = 0; i < 1000; i++) {
+    r.dispatch("progetto/EVE/POWER/relay/1/schedule/set", (const uint8_t *)"[]", 2);
+    r.dispatch("progetto/EVE/POWER/relay/3/set", (const uint8_t *)"ON", 2);
+    r.dispatch("progetto/EVE/POWER/relay/9/set", (const uint8_t *)"ON", 2);
+  }
+  assert(g_allocs == before);
+  assert(hits == 2000);
+}
+
+void test_topics() {
+  MqttTopicRouter r = makeRouter();
+  char buf[96];
+  assert(r.formatRelayTopic(buf, sizeof(buf), 2, "schedule/current") > 0);
+  assert(strcmp(buf, "progetto/EVE/POWER/relay/2/schedule/current") == 0);
+  assert(r.formatRelayTopic(buf, 10, 2, "schedule/current") == 0);
+
+  assert(r.filterCount() == 3);
+  assert(r.filterTopic(0, buf, sizeof(buf)) && strcmp(buf, "progetto/EVE/POWER/relay/+/set") == 0);
+  assert(r.filterTopic(1, buf, sizeof(buf)) && strcmp(buf, "progetto/EVE/POWER/relay/+/schedule/set") == 0);
+  assert(r.filterTopic(2, buf, sizeof(buf)) && strcmp(buf, "progetto/EVE/POWER/schedule/set") == 0);
+  assert(!r.filterTopic(3, buf, sizeof(buf)));
+  assert(!r.filterTopic(0, buf, 20));
+}
+
+int main() {
+  test_dispatch();
+  test_rejects();
+  test_payload_is_length_delimited();
+  test_dispatch_does_not_allocate();
+  test_topics();
+  std::cout << "All mqtt router tests passed\n";
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include <assert.h>
+#include <string.h>
+#include <iostream>
+#include <vector>
+
+#include "packet_registry.h"
+#include "power_master.h"
+#include "power_schedule_core.h"
+#include "time_sync.h"
+
+template <typename Packet>
+std::vector<uint8_t> wire(const Packet &p) {
+  const uint8_t *b = reinterpret_cast<const uint8_t *>(&p);
+  return std::vector<uint8_t>(b, b + sizeof(p));
+}
+
+// Byte-for-byte layouts, as the slave firmware (naturally aligned structs on
+// the same little-endian target) sends and expects them.
+void test_wire_layouts() {
+  PowerRelayRulesPacket rules{};
+  rules.type = 14;
+  rules.ch = 2;
+  rules.count = 1;
+  rules.rules[0] = PowerScheduleRule{6, 30, 1, 0x1F};
+  rules.rules[9] = PowerScheduleRule{23, 59, 0, 0x40};
+  rules.ms = 0x11223344;
+  std::vector<uint8_t> r = wire(rules);
+  assert(r.size() == 48);
+  const uint8_t head[] = {14, 2, 1, 6, 30, 1, 0x1F};
+  assert(memcmp(r.data(), head, sizeof(head)) == 0);
+  const uint8_t tail[] = {23, 59, 0, 0x40, 0, 0x44, 0x33, 0x22, 0x11};
+  assert(memcmp(r.data() + 39, tail, sizeof(tail)) == 0);
+
+  PowerScheduleAckPacket ack{15, 3, 1, 10, 0xA1B2C3D4};
+  assert(wire(ack) == (std::vector<uint8_t>{15, 3, 1, 10, 0xD4, 0xC3, 0xB2, 0xA1}));
+
+  PowerExecutedPacket ex{16, 1, 1, 0, 0x0102, 6, 0, 0x0A0B0C0D};
+  assert(wire(ex) == (std::vector<uint8_t>{16, 1, 1, 0, 0x02, 0x01, 6, 0, 0x0D, 0x0C, 0x0B, 0x0A}));
+
+  PowerMultiScheduleAckPacket multi{18, 0x05, 0x04, 0, 7};
+  assert(wire(multi) == (std::vector<uint8_t>{18, 5, 4, 0, 7, 0, 0, 0}));
+
+  PowerFragmentAckPacket frag{21, 4, 9, POWER_ACK_INCOMPLETE, 0x80000003, 0x100};
+  assert(wire(frag) == (std::vector<uint8_t>{21, 4, 9, 3, 0x03, 0, 0, 0x80, 0, 1, 0, 0}));
+
+  TimeSyncRequestPacket req{22, 7, {0, 0}, 0x01020304, 0x05060708, 0x090A0B0C};
+  assert(wire(req) == (std::vector<uint8_t>{22, 7, 0, 0, 4, 3, 2, 1, 8, 7, 6, 5, 0x0C, 0x0B, 0x0A, 9}));
+
+  TimeSyncResponsePacket resp{23, 7, 1, 0, 1, 2, 3, 0x65920080, 999, -60};
+  assert(wire(resp) == (std::vector<uint8_t>{23, 7, 1, 0, 1, 0, 0, 0, 2, 0, 0, 0, 3, 0, 0, 0, 0x80, 0x00, 0x92, 0x65,
+                                             0xE7, 0x03, 0xC4, 0xFF}));
+
+  TelemetryPacket tel{};
+  tel.t = 1.0f;
+  tel.soil = 30;
+  tel.presence = 1;
+  tel.ms = 0x01020304;
+  std::vector<uint8_t> t = wire(tel);
+  assert(t.size() == 18);
+  assert(t[0] == 0x00 && t[1] == 0x00 && t[2] == 0x80 && t[3] == 0x3F); // 1.0f
+  assert(t[8] == 30 && t[13] == 1 && t[14] == 4 && t[17] == 1);
+
+  HelloPacket hello{2, 1, 0x0A0B0C0D};
+  assert(wire(hello) == (std::vector<uint8_t>{2, 1, 0x0D, 0x0C, 0x0B, 0x0A}));
+
+  TimeSyncPacket ts{6, 0x021C, 3, 1, 0x11};
+  assert(wire(ts) == (std::vector<uint8_t>{6, 0x1C, 0x02, 3, 1, 0x11, 0, 0, 0}));
+
+  CommandPacket cmd{1, 1, 255, 0, 0, 60, 5};
+  assert(wire(cmd) == (std::vector<uint8_t>{1, 1, 255, 0, 0, 60, 0, 5, 0, 0, 0}));
+}
+
+void test_registry_metadata() {
+  static_assert(PacketTraits<PowerExecutedPacket>::TYPE == 16, "");
+  static_assert(PacketTraits<TelemetryPacket>::TYPE == PACKET_UNTYPED, "");
+  static_assert(PowerMasterInbound::MAX_SIZE == sizeof(TelemetryPacket), "");
+  static_assert(PowerMasterInbound::valid(), "");
+  static_assert(!PacketSet<PowerScheduleAckPacket, PowerMultiScheduleAckPacket, PowerScheduleAckPacket>::valid(),
+                "duplicate type byte");
+  static_assert(PacketSet<PowerScheduleAckPacket, PowerExecutedPacket>::slotOf(16) == 2, "");
+  static_assert(PacketSet<PowerScheduleAckPacket, PowerExecutedPacket>::slotOf(17) == 0, "");
+
+  uint8_t buf[16] = {16};
+  assert(packetAs<PowerExecutedPacket>(buf, 12) == reinterpret_cast<const PowerExecutedPacket *>(buf));
+  assert(packetAs<PowerExecutedPacket>(buf, 11) == nullptr);
+  assert(packetAs<PowerScheduleAckPacket>(buf, 8) == nullptr); // type byte 16, not 15
+}
+
+struct Recorder {
+  std::vector<int> seen;
+  const uint8_t *lastAt = nullptr;
+  void onPacket(const TelemetryPacket &p) { seen.push_back(-1); lastAt = reinterpret_cast<const uint8_t *>(&p); }
+  void onPacket(const PowerScheduleAckPacket &p) { seen.push_back(p.type); lastAt = &p.type; }
+  void onPacket(const PowerExecutedPacket &p) { seen.push_back(p.type); lastAt = &p.type; }
+  void onPacket(const PowerMultiScheduleAckPacket &p) { seen.push_back(p.type); lastAt = &p.type; }
+  void onPacket(const PowerFragmentAckPacket &p) { seen.push_back(p.type); lastAt = &p.type; }
+  void onPacket(const TimeSyncRequestPacket &p) { seen.push_back(p.type); lastAt = &p.type; }
+};
+
+typedef PacketDispatcher<Recorder, PowerMasterInbound> Dispatch;
+
+// Every byte value and every length up to the largest frame: exactly the
+// registered (type, size) pairs and 18-byte telemetry are delivered, in place.
+void test_dispatch_table() {
+  const int types[] = {15, 16, 18, 21, 22};
+  const size_t sizes[] = {8, 12, 8, 12, 16};
+  uint8_t frame[POWER_RADIO_FRAME_MAX] = {};
+  for (int type = 0; type < 256; type++) {
+    frame[0] = (uint8_t)type;
+    for (size_t len = 0; len <= POWER_RADIO_FRAME_MAX; len++) {
+      Recorder rec;
+      bool ok = Dispatch::dispatch(rec, frame, len);
+      int expected = 0;
+      for (size_t i = 0; i < 5; i++) if (types[i] == type && sizes[i] == len) expected = type;
+      if (len == sizeof(TelemetryPacket) && expected == 0) expected = -1;
+      if (expected == 0) {
+        assert(!ok && rec.seen.empty());
+      } else {
+        assert(ok && rec.seen.size() == 1 && rec.seen[0] == expected);
+        assert(rec.lastAt == frame); // zero-copy
+      }
+    }
+  }
+}
+
+// A telemetry frame whose first float byte happens to be a registered type is
+// still telemetry: the lengths differ.
+void test_telemetry_with_type_like_first_byte() {
+  TelemetryPacket tel{};
+  uint8_t raw[18];
+  memcpy(raw, &tel, sizeof(raw));
+  raw[0] = 15;
+  Recorder rec;
+  assert(Dispatch::dispatch(rec, raw, sizeof(raw)));
+  assert(rec.seen.size() == 1 && rec.seen[0] == -1);
+}
+
+int main() {
+  test_wire_layouts();
+  test_registry_metadata();
+  test_dispatch_table();
+  test_telemetry_with_type_like_first_byte();
+  std::cout << "packet_registry_test: all passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,191 @@
+#include <assert.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "damage_tracker.h"
+#include "eye_sprite.h"
+#include "paletted_framebuffer.h"
+
+static const int W = 240;
+static const int H = 240;
+static const uint16_t BLACK = 0x0000;
+static const uint16_t WHITE = 0xFFFF;
+static const uint16_t BLUE = 0x001F;
+
+// The RGB565 canvas the paletted one must match.
+struct Rgb565 {
+  std::vector<uint16_t> px;
+  Rgb565() : px(W * H, BLACK) {}
+  void fillRect(int x, int y, int w, int h, uint16_t c) {
+    for (int yy = y; yy < y + h; yy++) {
+      for (int xx = x; xx < x + w; xx++) {
+        if (xx >= 0 && yy >= 0 && xx < W && yy < H) px[yy * W + xx] = c;
+      }
+    }
+  }
+};
+
+std::vector<uint16_t> expandAll(const PalettedFramebuffer &fb) {
+  std::vector<uint16_t> out(fb.width() * fb.height());
+  for (uint16_t y = 0; y < fb.height(); y++) fb.expand(0, y, fb.width(), out.data() + y * fb.width());
+  return out;
+}
+
+void test_primitives_match_rgb565() {
+  std::vector<uint8_t> store(PalettedFramebuffer::bytesFor(W, H));
+  assert(store.size() == 14400);
+  PalettedFramebuffer fb(store.data(), W, H);
+  Rgb565 ref;
+  assert(expandAll(fb) == ref.px);
+
+  const uint16_t colors[] = {BLACK, WHITE, BLUE};
+  std::mt19937 rng(7);
+  for (int i = 0; i < 3000; i++) {
+    uint16_t c = colors[rng() % 3];
+    int x = (int)(rng() % (W + 40)) - 20, y = (int)(rng() % (H + 40)) - 20;
+    switch (rng() % 4) {
+      case 0:
+        fb.setPixel((int16_t)x, (int16_t)y, fb.indexFor(c));
+        ref.fillRect(x, y, 1, 1, c);
+        break;
+      case 1: {
+        int w = (int)(rng() % 70) - 5;
+        fb.fillSpan((int16_t)x, (int16_t)y, (int16_t)w, fb.indexFor(c));
+        ref.fillRect(x, y, w, 1, c);
+        break;
+      }
+      case 2: {
+        int w = (int)(rng() % 50), h = (int)(rng() % 50);
+        fb.fillRect((int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h, fb.indexFor(c));
+        ref.fillRect(x, y, w, h, c);
+        break;
+      }
+      default:
+        if (rng() % 50 == 0) {
+          fb.fill(fb.indexFor(c));
+          ref.fillRect(0, 0, W, H, c);
+        }
+        break;
+    }
+    if (i % 100 == 0) assert(expandAll(fb) == ref.px);
+  }
+  assert(expandAll(fb) == ref.px);
+  assert(fb.colors() == 3);
+}
+
+void test_palette_overflow() {
+  std::vector<uint8_t> store(PalettedFramebuffer::bytesFor(16, 4));
+  PalettedFramebuffer fb(store.data(), 16, 4);
+  assert(fb.colors() == 1 && fb.color(0) == BLACK);
+  assert(fb.indexFor(BLACK) == 0);
+  assert(fb.indexFor(WHITE) == 1);
+  assert(fb.indexFor(BLUE) == 2);
+  assert(fb.indexFor(0xF800) == 3);
+  assert(fb.indexFor(0x07E0) == 0); // full
+  assert(fb.indexFor(BLUE) == 2);
+  assert(fb.colors() == PALETTE_SIZE);
+}
+
+struct PalettedSpan {
+  PalettedFramebuffer *fb;
+  uint8_t index;
+};
+
+void fillPaletted(void *ctx, int16_t x, int16_t y, int16_t w) {
+  PalettedSpan &s = *static_cast<PalettedSpan *>(ctx);
+  s.fb->fillSpan(x, y, w, s.index);
+}
+
+// The render task's frame on both backends: clear (not damage), two eyes from
+// the sprite cache, overlay blocks; then the damage push into a simulated
+// panel. Windows and panel contents must be identical every frame.
+void test_frames_match_rgb565_backend() {
+  std::vector<EyeSpan> spans(EyeSpriteCache::spansNeeded(70, 95, 16, 36, 44, 18));
+  EyeSpriteCache eyes(spans.data(), (uint16_t)spans.size());
+  assert(eyes.build(70, 95, 16, 36, 44, 18));
+
+  std::vector<uint16_t> rgb(W * H, BLACK), panelRgb(W * H, 0x5555);
+  std::vector<uint8_t> store(PalettedFramebuffer::bytesFor(W, H));
+  PalettedFramebuffer pal(store.data(), W, H);
+  std::vector<uint16_t> panelPal(W * H, 0x5555);
+  DamageTracker dtRgb(W, H), dtPal(W, H);
+  std::vector<uint16_t> line(W);
+
+  std::mt19937 rng(3);
+  for (int frame = 0; frame < 200; frame++) {
+    float blink = (frame % 40) < 11 ? (float)(frame % 40) / 10.0f : 0.0f;
+    if (blink > 1.0f) blink = 2.0f - blink;
+    uint8_t level = eyes.levelFor(blink);
+    int16_t lookX = (int16_t)((frame * 7) % 37 - 18), lookY = (int16_t)((frame * 5) % 25 - 12);
+
+    std::fill(rgb.begin(), rgb.end(), BLACK);
+    pal.fill(pal.indexFor(BLACK));
+    PalettedSpan blue{&pal, pal.indexFor(BLUE)}, black{&pal, pal.indexFor(BLACK)};
+    const float cx[2] = {80, 160};
+    for (float x : cx) {
+      eyes.drawWhite(rgb.data(), W, H, &dtRgb, x, 120, level, BLUE);
+      eyes.drawWhite(fillPaletted, &blue, W, H, &dtPal, x, 120, level);
+      int16_t px = (int16_t)(x + lookX - 18), py = (int16_t)(120 + lookY - 22);
+      eyes.drawPupil(rgb.data(), W, H, &dtRgb, px, py, BLACK);
+      eyes.drawPupil(fillPaletted, &black, W, H, &dtPal, px, py);
+    }
+    // Overlay: a counter that changes now and then, as text would.
+    for (int i = 0; i < 6; i++) {
+      int x = 10 + i * 12, y = 10 + (frame / 25 % 3) * 9, w = 10, h = 14;
+      if ((rng() & 1) == 0) continue;
+      for (int yy = y; yy < y + h; yy++) std::fill(rgb.begin() + yy * W + x, rgb.begin() + yy * W + x + w, WHITE);
+      dtRgb.markRect((int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h);
+      pal.fillRect((int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h, pal.indexFor(WHITE));
+      dtPal.markRect((int16_t)x, (int16_t)y, (int16_t)w, (int16_t)h);
+    }
+    assert(expandAll(pal) == rgb);
+
+    uint16_t nRgb = dtRgb.collect(rgb.data());
+    uint16_t nPal = dtPal.collect(pal.pixels(), PALETTE_BITS);
+    assert(nRgb == nPal);
+    assert(dtRgb.lastBytes() == dtPal.lastBytes());
+    for (uint16_t i = 0; i < nRgb; i++) {
+      const DamageRect &a = dtRgb.rects()[i], &b = dtPal.rects()[i];
+      assert(a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h);
+      for (uint16_t row = 0; row < a.h; row++) {
+        uint16_t y = a.y + row;
+        std::copy(rgb.begin() + y * W + a.x, rgb.begin() + y * W + a.x + a.w, panelRgb.begin() + y * W + a.x);
+        pal.expand(b.x, y, b.w, line.data());
+        std::copy(line.begin(), line.begin() + b.w, panelPal.begin() + y * W + b.x);
+      }
+    }
+    assert(panelRgb == rgb);
+    assert(panelPal == panelRgb);
+  }
+}
+
+void test_damage_on_partial_byte_rows() {
+  // 250 px at 2 bpp: 62.5 bytes of pixels per row, the last tile is 10 px.
+  const uint16_t w = 250, h = 20;
+  std::vector<uint8_t> store(PalettedFramebuffer::bytesFor(w, h));
+  assert(PalettedFramebuffer::strideFor(w) == 63);
+  PalettedFramebuffer fb(store.data(), w, h);
+  DamageTracker dt(w, h);
+  assert(dt.collect(fb.pixels(), PALETTE_BITS) > 0); // first frame is forced full
+
+  fb.setPixel(249, 19, fb.indexFor(WHITE));
+  dt.markPixel(249, 19);
+  assert(dt.collect(fb.pixels(), PALETTE_BITS) == 1);
+  assert(dt.rects()[0].x == 240 && dt.rects()[0].w == 10 && dt.rects()[0].y == 16 && dt.rects()[0].h == 4);
+
+  // Redrawing the same content is not damage.
+  fb.setPixel(249, 19, fb.indexFor(WHITE));
+  dt.markPixel(249, 19);
+  assert(dt.collect(fb.pixels(), PALETTE_BITS) == 0);
+}
+
+int main() {
+  test_primitives_match_rgb565();
+  test_palette_overflow();
+  test_frames_match_rgb565_backend();
+  test_damage_on_partial_byte_rows();
+  std::cout << "paletted_framebuffer_test: all passed" << std::endl;
+  return 0;
+}
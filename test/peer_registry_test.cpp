@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <string.h>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "peer_registry.h"
+
+typedef std::vector<uint8_t> Mac;
+
+static std::vector<Mac> g_evicted;
+
+void recordEvict(uint8_t id, const uint8_t mac[6]) {
+  (void)id;
+  g_evicted.push_back(Mac(mac, mac + 6));
+}
+
+Mac makeMac(uint32_t n) {
+  return Mac{0x24, 0x6F, (uint8_t)(n >> 16), (uint8_t)(n >> 8), (uint8_t)n, (uint8_t)(n * 7)};
+}
+
+void checkConsistent(const PeerRegistry &reg) {
+  uint8_t used = 0;
+  std::set<Mac> seen;
+  for (uint8_t i = 0; i < PEER_REGISTRY_CAPACITY; i++) {
+    const PeerEntry &e = reg.entry(i);
+    if (!e.used) continue;
+    used++;
+    Mac m(e.mac, e.mac + 6);
+    assert(seen.insert(m).second);
+    assert(reg.find(e.mac) == (int8_t)i);
+  }
+  assert(used == reg.count());
+}
+
+void test_touch_and_find() {
+  PeerRegistry reg;
+  bool added = false;
+  Mac a = makeMac(1);
+  int8_t id = reg.touch(a.data(), 100, 1000, added);
+  assert(id >= 0 && added);
+  assert(reg.touch(a.data(), 200, 1000, added) == id && !added);
+  assert(reg.entry(id).lastSeenMs == 200 && reg.entry(id).firstSeenMs == 100);
+  assert(reg.count() == 1);
+  assert(reg.find(makeMac(2).data()) == -1);
+}
+
+void test_full_table_refuses_fresh_and_evicts_stale() {
+  PeerRegistry reg;
+  g_evicted.clear();
+  reg.setEvictHandler(recordEvict);
+  bool added = false;
+  for (uint32_t i = 0; i < PEER_REGISTRY_CAPACITY; i++) assert(reg.touch(makeMac(i).data(), i, 60000, added) >= 0);
+  assert(reg.count() == PEER_REGISTRY_CAPACITY);
+
+  Mac newcomer = makeMac(1000);
+  assert(reg.touch(newcomer.data(), 50, 60000, added) == -1);
+  assert(g_evicted.empty());
+
+  // Everyone but peer 0 checks in again; peer 0 becomes the stale victim.
+  for (uint32_t i = 1; i < PEER_REGISTRY_CAPACITY; i++) reg.touch(makeMac(i).data(), 60000, 60000, added);
+  assert(reg.touch(newcomer.data(), 60010, 60000, added) >= 0 && added);
+  assert(g_evicted.size() == 1 && g_evicted[0] == makeMac(0));
+  assert(reg.find(makeMac(0).data()) == -1);
+  checkConsistent(reg);
+}
+
+void test_expire() {
+  PeerRegistry reg;
+  g_evicted.clear();
+  reg.setEvictHandler(recordEvict);
+  bool added = false;
+  for (uint32_t i = 0; i < 10; i++) reg.touch(makeMac(i).data(), i * 1000, 0, added);
+  assert(reg.expire(10000, 5000) == 6); // seen at 0..5000
+  assert(reg.count() == 4);
+  assert(g_evicted.size() == 6);
+  checkConsistent(reg);
+  // Touched after the expiry timestamp was taken: not idle.
+  assert(reg.expire(8000, 2500) == 0);
+}
+
+void test_churn_hundreds_of_macs() {
+  PeerRegistry reg;
+  g_evicted.clear();
+  reg.setEvictHandler(recordEvict);
+  std::mt19937 rng(1234);
+  std::map<Mac, uint32_t> lastSeen; // model of what should be registered
+  const uint32_t idleMs = 5000;
+  uint32_t now = 0;
+
+  for (int step = 0; step < 20000; step++) {
+    now += rng() % 50;
+    // A stable core of 8 slaves plus hundreds of transient/spoofed MACs.
+    Mac m = (rng() % 3 == 0) ? makeMac(rng() % 8) : makeMac(100 + rng() % 600);
+    size_t evictedBefore = g_evicted.size();
+    bool added = false;
+    int8_t id = reg.touch(m.data(), now, idleMs, added);
+    for (size_t k = evictedBefore; k < g_evicted.size(); k++) {
+      assert(now - lastSeen[g_evicted[k]] >= idleMs);
+      lastSeen.erase(g_evicted[k]);
+    }
+    if (id < 0) {
+      assert(reg.count() == PEER_REGISTRY_CAPACITY);
+    } else {
+      lastSeen[m] = now;
+    }
+
+    if (step % 500 == 0) {
+      size_t before = g_evicted.size();
+      reg.expire(now, 20000);
+      for (size_t k = before; k < g_evicted.size(); k++) lastSeen.erase(g_evicted[k]);
+    }
+    assert(reg.count() == lastSeen.size());
+    if (step % 97 == 0) checkConsistent(reg);
+  }
+
+  checkConsistent(reg);
+  for (const auto &kv : lastSeen) assert(reg.find(kv.first.data()) >= 0);
+  for (uint32_t i = 0; i < 8; i++) assert(reg.find(makeMac(i).data()) >= 0 || lastSeen.count(makeMac(i)) == 0);
+  assert(g_evicted.size() > 500);
+}
+
+int main() {
+  test_touch_and_find();
+  test_full_table_refuses_fresh_and_evicts_stale();
+  test_expire();
+  test_churn_hundreds_of_macs();
+  std::cout << "All peer registry tests passed\n";
+  return 0;
+}
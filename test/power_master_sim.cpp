@@ -0,0 +1,169 @@
+// End-to-end load run of PowerMaster on the host HAL: every relay is kept
+// busy with schedule/set -> type 14/17/19 -> ACK cycles against simulated
+// slaves, on a virtual clock that jumps straight to the next frame or timer
+// deadline. Prints one JSON line per link profile:
+//   {"sim":"<profile>","cycles":N,"ok":N,"error":N,"cycles_per_s":X,
+//    "virtual_s":X,"p50_ms":X,"p99_ms":X,"max_ms":X,"frames":N,"lost":N}
+// cycles_per_s is host throughput (wall clock); the latencies are virtual
+// time from schedule/set to the final schedule/slave/ack. Pass --quick for a
+// short smoke run (used by ctest), --cycles N to change the run length.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "power_master.h"
+#include "sim_hal.h"
+
+namespace {
+
+struct Profile {
+  const char *name;
+  uint8_t lossPct;
+  uint32_t latencyMinMs;
+  uint32_t latencyMaxMs;
+};
+
+const Profile PROFILES[] = {
+    {"clean", 0, 2, 6},
+    {"loss5", 5, 2, 10},
+    {"loss20", 20, 2, 30},
+};
+
+struct Driver {
+  uint32_t setAt[POWER_RELAY_COUNT];
+  bool inFlight[POWER_RELAY_COUNT];
+  uint32_t ok;
+  uint32_t error;
+  std::vector<uint32_t> latencies;
+  SimClock *clock;
+};
+
+void onPublish(void *ctx, const std::string &topic, const std::string &payload, bool) {
+  static const std::string PREFIX = "progetto/EVE/POWER/relay/";
+  static const std::string SUFFIX = "/schedule/slave/ack";
+  if (payload == "PENDING" || topic.size() != PREFIX.size() + 1 + SUFFIX.size()) return;
+  if (topic.compare(0, PREFIX.size(), PREFIX) != 0 || topic.compare(PREFIX.size() + 1, SUFFIX.size(), SUFFIX) != 0) return;
+  Driver &d = *static_cast<Driver *>(ctx);
+  uint8_t idx = (uint8_t)(topic[PREFIX.size()] - '1');
+  if (idx >= POWER_RELAY_COUNT || !d.inFlight[idx]) return;
+  d.inFlight[idx] = false;
+  d.latencies.push_back(d.clock->millis() - d.setAt[idx]);
+  if (payload == "OK") d.ok++;
+  else d.error++;
+}
+
+// Mostly one-rule edits of the applied table (delta frames), now and then a
+// whole new table; never equal to what is applied, so every set goes on air.
+PowerRelaySchedule nextSchedule(const PowerRelaySchedule &applied, uint32_t r) {
+  PowerRelaySchedule s = applied;
+  if (s.count == 0 || r % 8 == 0) {
+    s.count = (uint8_t)(1 + r % POWER_MAX_SCHEDULE_RULES);
+    for (uint8_t i = 0; i < s.count; i++) {
+      s.rules[i].hh = (uint8_t)((r >> 3) % 24);
+      s.rules[i].mm = (uint8_t)((r >> 8) % 60 + i) % 60;
+      s.rules[i].state = (uint8_t)(i & 1);
+      s.rules[i].daysMask = (uint8_t)(1 + (r >> 14) % 127);
+    }
+    if (!schedulesEqual(s, applied)) return s;
+  }
+  PowerScheduleRule &rule = s.rules[r % s.count];
+  rule.state ^= 1;
+  return s;
+}
+
+// Advances to the next radio event or timer deadline (at least 1 ms) and runs
+// everything due then, the way loop() wakes on the device.
+void step(SimClock &clock, SimRadioNet &net, EventScheduler &timers, PowerMaster &master) {
+  uint32_t wait = std::min(net.msUntilNext(), timers.msUntilNext(clock.millis()));
+  clock.advance(std::max<uint32_t>(1, std::min<uint32_t>(wait, 1000)));
+  net.step(master);
+  timers.run(clock.millis());
+  master.drainOutbox(32);
+}
+
+uint32_t percentile(std::vector<uint32_t> &v, double p) {
+  if (v.empty()) return 0;
+  size_t k = (size_t)(p * (double)(v.size() - 1));
+  std::nth_element(v.begin(), v.begin() + (long)k, v.end());
+  return v[k];
+}
+
+void runProfile(const Profile &profile, uint32_t cycles, const std::string &dir) {
+  static const uint8_t MAC_A[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+  static const uint8_t MAC_B[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x02};
+
+  SimLinkConfig link;
+  link.lossPct = profile.lossPct;
+  link.latencyMinMs = profile.latencyMinMs;
+  link.latencyMaxMs = profile.latencyMaxMs;
+  SimClock clock(42);
+  SimBroker broker;
+  FileKvStore store(dir);
+  SimRadioNet net(clock, link, 1234);
+  EventScheduler timers;
+  PowerMaster master(net, broker, store, clock, timers, 1);
+  net.addSlave(MAC_A, 0x3);
+  net.addSlave(MAC_B, 0x4);
+
+  Driver d;
+  memset(d.setAt, 0, sizeof(d.setAt));
+  memset(d.inFlight, 0, sizeof(d.inFlight));
+  d.ok = d.error = 0;
+  d.clock = &clock;
+  d.latencies.reserve(cycles);
+  broker.setListener(onPublish, &d);
+  master.begin();
+  master.onMqttConnected();
+
+  // Let both slaves announce themselves before the load starts.
+  while (clock.millis() < 3000) step(clock, net, timers, master);
+
+  uint32_t issued = 0;
+  uint32_t startMs = clock.millis();
+  char json[POWER_SCHEDULE_JSON_MAX + 1];
+  char topic[64];
+  std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+  while (d.ok + d.error < cycles) {
+    for (uint8_t idx = 0; idx < POWER_RELAY_COUNT && issued < cycles; idx++) {
+      if (d.inFlight[idx]) continue;
+      PowerRelaySchedule s = nextSchedule(master.activeSchedule(idx + 1), issued * 2654435761u);
+      size_t n = writeScheduleJson(s, json, sizeof(json));
+      snprintf(topic, sizeof(topic), "progetto/EVE/POWER/relay/%u/schedule/set", idx + 1);
+      d.inFlight[idx] = true;
+      d.setAt[idx] = clock.millis();
+      master.onMqttMessage(topic, (const uint8_t *)json, n);
+      issued++;
+    }
+    step(clock, net, timers, master);
+  }
+  double wallS = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  master.flushSchedules();
+
+  uint32_t done = d.ok + d.error;
+  uint32_t maxMs = d.latencies.empty() ? 0 : *std::max_element(d.latencies.begin(), d.latencies.end());
+  uint32_t p50 = percentile(d.latencies, 0.50);
+  uint32_t p99 = percentile(d.latencies, 0.99);
+  printf("{\"sim\":\"%s\",\"cycles\":%u,\"ok\":%u,\"error\":%u,\"cycles_per_s\":%.0f,\"virtual_s\":%.1f,"
+         "\"p50_ms\":%u,\"p99_ms\":%u,\"max_ms\":%u,\"frames\":%u,\"lost\":%u}\n",
+         profile.name, done, d.ok, d.error, wallS > 0 ? done / wallS : 0.0, (clock.millis() - startMs) / 1000.0, p50, p99,
+         maxMs, net.stats().sent, net.stats().lost);
+  fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  uint32_t cycles = 20000;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--quick") == 0) cycles = 300;
+    else if (strcmp(argv[i], "--cycles") == 0 && i + 1 < argc) cycles = (uint32_t)strtoul(argv[++i], nullptr, 10);
+  }
+  SimTempDir dir;
+  for (const Profile &p : PROFILES) runProfile(p, cycles, dir.path() + "/" + p.name);
+  return 0;
+}
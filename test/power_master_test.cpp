@@ -0,0 +1,635 @@
+#include <assert.h>
+#include <string.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "power_master.h"
+#include "sim_hal.h"
+
+static const uint8_t MAC_A[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+static const uint8_t MAC_B[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x02};
+
+PowerRelaySchedule makeSchedule(uint8_t n, uint8_t seed) {
+  PowerRelaySchedule s{};
+  s.count = n;
+  for (uint8_t i = 0; i < n; i++) {
+    s.rules[i].hh = (uint8_t)((seed + i * 3) % 24);
+    s.rules[i].mm = (uint8_t)((seed * 7 + i * 11) % 60);
+    s.rules[i].state = (uint8_t)((seed + i) & 1);
+    s.rules[i].daysMask = (uint8_t)(1 + (seed + i) % 127);
+  }
+  return s;
+}
+
+void test_set_ack_publish_and_persist() {
+  SimTempDir dir;
+  PowerRelaySchedule s = makeSchedule(4, 3);
+  {
+    SimRig rig(dir.path());
+    assert(rig.broker.subscribed("progetto/EVE/POWER/relay/2/schedule/set"));
+    rig.net.addSlave(MAC_A, 0x7);
+    rig.run(100); // first telemetry registers the slave
+    assert(rig.master.peers().count() == 1);
+
+    rig.set(1, s);
+    rig.run(200);
+    assert(rig.outcome(1) == "OK");
+    assert(schedulesEqual(rig.net.slave(0).tables[0], s));
+    assert(schedulesEqual(rig.master.activeSchedule(1), s));
+    std::string current;
+    char json[POWER_SCHEDULE_JSON_MAX + 1];
+    writeScheduleJson(s, json, sizeof(json));
+    assert(rig.broker.retained("progetto/EVE/POWER/relay/1/schedule/current", current) && current == json);
+    assert(rig.master.routes().route(1).known);
+
+    // Same table again: answered from the retained state, nothing on air.
+    SimNetStats before = rig.net.stats();
+    rig.set(1, s);
+    rig.run(100);
+    assert(rig.net.stats().byType[14] == before.byType[14] && rig.net.stats().byType[19] == before.byType[19]);
+    assert(!rig.master.awaitingAck(1));
+
+    // The first write is delayed and carries everything acknowledged so far.
+    assert(rig.store.writes() == 0);
+    rig.run(SCHEDULE_PERSIST_DELAY_MS);
+    assert(rig.store.writes() == 1);
+  }
+  // A fresh master on the same store starts from the acknowledged tables.
+  SimRig again(dir.path());
+  assert(schedulesEqual(again.master.activeSchedule(1), s));
+  assert(again.master.activeSchedule(2).count == 0);
+  again.run(10);
+  std::string current;
+  assert(again.broker.retained("progetto/EVE/POWER/relay/1/schedule/current", current) && current.size() > 2);
+}
+
+void test_batch_and_fallback_to_single_relay() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  rig.net.addSlave(MAC_A, 0x7);
+  rig.run(100);
+  // Learn the route first so the batch goes out as one unicast frame.
+  rig.set(1, makeSchedule(2, 1));
+  rig.run(200);
+  assert(rig.outcome(1) == "OK");
+
+  for (uint8_t r = 1; r <= 3; r++) rig.set(r, makeSchedule(3, (uint8_t)(10 + r)));
+  rig.run(200);
+  for (uint8_t r = 1; r <= 3; r++) assert(rig.outcome(r) == "OK");
+  assert(rig.net.stats().byType[POWER_MULTI_RULES_TYPE] >= 1);
+
+  // Older slave: type 17 is ignored, each relay converges on its type-14 retry.
+  rig.net.slave(0).multiRules = false;
+  for (uint8_t r = 1; r <= 3; r++) rig.set(r, makeSchedule(5, (uint8_t)(20 + r)));
+  rig.run(8000);
+  for (uint8_t r = 1; r <= 3; r++) {
+    assert(rig.outcome(r) == "OK");
+    assert(schedulesEqual(rig.net.slave(0).tables[r - 1], makeSchedule(5, (uint8_t)(20 + r))));
+  }
+}
+
+// ms from set to the final ACK on relay, 0 when none came within limitMs.
+uint32_t setLatency(SimRig &rig, uint8_t relay, const PowerRelaySchedule &s, uint32_t limitMs) {
+  rig.acks.clear();
+  rig.set(relay, s);
+  for (uint32_t t = 1; t <= limitMs; t++) {
+    rig.run(1);
+    if (!rig.outcome(relay).empty()) return rig.outcome(relay) == "OK" ? t : 0;
+  }
+  return 0;
+}
+
+// A slave without type 17/19 pays the timeout once per frame kind; after that
+// it is sent type 14 directly and answers at link speed.
+void test_legacy_slave_is_sent_type14_directly() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  SimSlave &legacy = rig.net.addSlave(MAC_A, 0x3);
+  legacy.deltaRules = false;
+  legacy.multiRules = false;
+  rig.run(100);
+  SimNetStats start = rig.net.stats();
+  uint32_t probe = setLatency(rig, 1, makeSchedule(3, 1), 10000); // type 19 first, then type 14
+  assert(probe >= RTT_INITIAL_RTO_MS / 2);
+  assert(rig.net.stats().byType[POWER_DELTA_RULES_TYPE] == start.byType[POWER_DELTA_RULES_TYPE] + 1);
+  for (uint8_t round = 0; round < 5; round++) {
+    SimNetStats before = rig.net.stats();
+    uint32_t ms = setLatency(rig, 1, makeSchedule(3, (uint8_t)(2 + round)), 10000);
+    assert(ms > 0 && ms < SCHEDULE_BATCH_WINDOW_MS + 50);
+    assert(rig.net.stats().byType[POWER_DELTA_RULES_TYPE] == before.byType[POWER_DELTA_RULES_TYPE]);
+  }
+  assert(rig.master.routes().route(1).known);
+
+  // Same for batches: one type 17 unanswered, then per-relay type 14.
+  assert(setLatency(rig, 2, makeSchedule(2, 9), 10000) > 0); // routes relay 2 to the same slave
+  for (uint8_t round = 0; round < 3; round++) {
+    rig.acks.clear();
+    SimNetStats before = rig.net.stats();
+    rig.set(1, makeSchedule(4, (uint8_t)(30 + round)));
+    rig.set(2, makeSchedule(4, (uint8_t)(40 + round)));
+    uint32_t t = 0;
+    while (t < 10000 && (rig.outcome(1).empty() || rig.outcome(2).empty())) {
+      rig.run(1);
+      t++;
+    }
+    assert(rig.outcome(1) == "OK" && rig.outcome(2) == "OK");
+    uint32_t multi = rig.net.stats().byType[POWER_MULTI_RULES_TYPE] - before.byType[POWER_MULTI_RULES_TYPE];
+    if (round == 0) {
+      assert(multi == 1); // the probe; its timeout is the learned RTO by now
+    } else {
+      assert(t < SCHEDULE_BATCH_WINDOW_MS + 50);
+      assert(multi == 0);
+    }
+  }
+
+  // A current slave keeps getting deltas and batches.
+  SimTempDir freshDir;
+  SimRig fresh(freshDir.path());
+  fresh.net.addSlave(MAC_A, 0x3);
+  fresh.run(100);
+  assert(setLatency(fresh, 1, makeSchedule(2, 1), 10000) > 0);
+  for (uint8_t round = 0; round < 3; round++) {
+    SimNetStats before = fresh.net.stats();
+    uint32_t ms = setLatency(fresh, 1, makeSchedule(3, (uint8_t)(2 + round)), 10000);
+    assert(ms > 0 && ms < SCHEDULE_BATCH_WINDOW_MS + 50);
+    assert(fresh.net.stats().byType[POWER_DELTA_RULES_TYPE] == before.byType[POWER_DELTA_RULES_TYPE] + 1);
+  }
+}
+
+// A type-18 ACK settles only the relays whose pending table went out in the
+// batch it echoes: a late answer to an earlier batch commits nothing.
+void test_stale_multi_ack_does_not_commit_newer_tables() {
+  SimLinkConfig link;
+  SimTempDir dir;
+  SimRig rig(dir.path(), link);
+  rig.net.addSlave(MAC_A, 0x3);
+  rig.run(100);
+  assert(setLatency(rig, 1, makeSchedule(2, 1), 10000) > 0);
+  assert(setLatency(rig, 2, makeSchedule(2, 2), 10000) > 0);
+  link.lossPct = 100;
+  link.telemetryMs = 0;
+  rig.net.setLink(link);
+
+  uint32_t batches = rig.net.stats().byType[POWER_MULTI_RULES_TYPE];
+  rig.set(1, makeSchedule(3, 10));
+  rig.set(2, makeSchedule(3, 20));
+  rig.run(SCHEDULE_BATCH_WINDOW_MS + 5);
+  assert(rig.net.stats().byType[POWER_MULTI_RULES_TYPE] == batches + 1);
+  uint8_t oldXfer = (uint8_t)(batches + 1);
+
+  rig.acks.clear();
+  PowerRelaySchedule newer[2] = {makeSchedule(4, 30), makeSchedule(4, 40)};
+  rig.set(1, newer[0]);
+  rig.set(2, newer[1]);
+  rig.run(SCHEDULE_BATCH_WINDOW_MS + 5);
+  assert(rig.net.stats().byType[POWER_MULTI_RULES_TYPE] == batches + 2);
+
+  PowerMultiScheduleAckPacket ack{POWER_MULTI_ACK_TYPE, 0x03, 0x03, oldXfer, rig.clock.millis()};
+  rig.master.onRadioFrame(MAC_A, (const uint8_t *)&ack, sizeof(ack), rig.clock.millis());
+  rig.run(1);
+  assert(rig.master.awaitingAck(1) && rig.master.awaitingAck(2));
+  assert(rig.outcome(1).empty() && rig.outcome(2).empty());
+  assert(schedulesEqual(rig.master.activeSchedule(1), makeSchedule(2, 1)));
+
+  ack.xfer = (uint8_t)(oldXfer + 1);
+  rig.master.onRadioFrame(MAC_A, (const uint8_t *)&ack, sizeof(ack), rig.clock.millis());
+  rig.run(1);
+  assert(rig.outcome(1) == "OK" && rig.outcome(2) == "OK");
+  assert(schedulesEqual(rig.master.activeSchedule(1), newer[0]));
+  assert(schedulesEqual(rig.master.activeSchedule(2), newer[1]));
+}
+
+uint32_t scheduleFrames(const SimRig &rig) {
+  const SimNetStats &st = rig.net.stats();
+  return st.byType[POWER_RULES_TYPE] + st.byType[POWER_DELTA_RULES_TYPE];
+}
+
+// Only failed schedule frames count against the peer: failed commands leave
+// its RTO and the pending schedule's deadline alone.
+void test_failed_command_leaves_schedule_timing_alone() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  SimSlave &slave = rig.net.addSlave(MAC_A, 0x1);
+  rig.run(100);
+  assert(setLatency(rig, 1, makeSchedule(2, 1), 10000) > 0);
+  int8_t id = rig.master.peers().find(MAC_A);
+  assert(id >= 0);
+  const RttEstimator &rtt = rig.master.peerRtt((uint8_t)id);
+  uint32_t rto = rtt.timeoutMs();
+  uint32_t losses = rtt.losses();
+
+  slave.failTypes = 1u << POWER_COMMAND_TYPE;
+  slave.relayMask = 0; // schedule frames arrive but are never answered
+  uint32_t frames = scheduleFrames(rig);
+  rig.set(1, makeSchedule(3, 2));
+  while (scheduleFrames(rig) == frames) rig.run(1);
+  uint32_t sentAt = rig.clock.millis();
+  for (int i = 0; i < 3; i++) {
+    assert(rig.master.onMqttMessage("progetto/EVE/POWER/relay/1/set", (const uint8_t *)"ON", 2));
+    rig.run(10);
+  }
+  while (scheduleFrames(rig) == frames + 1) rig.run(1);
+  assert(rig.clock.millis() - sentAt >= rto);
+  assert(rtt.losses() == losses && rtt.timeoutMs() == rto);
+
+  // A failed schedule frame still does, once per attempt.
+  slave.failTypes |= 1u << POWER_RULES_TYPE;
+  frames = scheduleFrames(rig);
+  while (scheduleFrames(rig) == frames) rig.run(1);
+  rig.run(20);
+  assert(rtt.losses() == losses + 1);
+}
+
+void test_dead_link_reports_error_after_retry_budget() {
+  SimLinkConfig link;
+  SimTempDir dir;
+  SimRig rig(dir.path(), link);
+  rig.net.addSlave(MAC_A, 0x1);
+  rig.run(100);
+  link.lossPct = 100;
+  link.telemetryMs = 0;
+  rig.net.setLink(link);
+
+  SimNetStats before = rig.net.stats();
+  rig.set(1, makeSchedule(3, 5));
+  rig.run(60000);
+  assert(rig.outcome(1) == "ERROR");
+  const SimNetStats &after = rig.net.stats();
+  uint32_t sends = (after.byType[14] - before.byType[14]) + (after.byType[19] - before.byType[19]);
+  assert(sends == 1u + SCHEDULE_RETRY_BUDGET);
+  assert(rig.master.activeSchedule(1).count == 0);
+}
+
+void test_lossy_link_converges_across_slaves() {
+  SimLinkConfig link;
+  link.lossPct = 20;
+  link.latencyMinMs = 1;
+  link.latencyMaxMs = 30;
+  SimTempDir dir;
+  SimRig rig(dir.path(), link);
+  rig.net.addSlave(MAC_A, 0x3);
+  rig.net.addSlave(MAC_B, 0x4);
+  rig.run(3000);
+  assert(rig.master.peers().count() == 2);
+
+  std::mt19937 rng(99);
+  uint32_t ok = 0;
+  for (int round = 0; round < 60; round++) {
+    rig.acks.clear();
+    for (uint8_t r = 1; r <= 3; r++) rig.set(r, makeSchedule((uint8_t)(1 + rng() % 10), (uint8_t)rng()));
+    for (int waited = 0; waited < 120 && (rig.outcome(1).empty() || rig.outcome(2).empty() || rig.outcome(3).empty());
+         waited++) {
+      rig.run(500);
+    }
+    for (uint8_t r = 1; r <= 3; r++) {
+      std::string result = rig.outcome(r);
+      assert(result == "OK" || result == "ERROR");
+      if (result != "OK") continue;
+      ok++;
+      // An applied table is exactly what the owning slave holds.
+      const SimSlave &owner = rig.net.slave(r == 3 ? 1 : 0);
+      assert(schedulesEqual(owner.tables[r - 1], rig.master.activeSchedule(r)));
+    }
+  }
+  assert(ok > 150);
+  assert(rig.net.stats().lost > 0);
+}
+
+static const char SNAPSHOT_TOPIC[] = "progetto/EVE/POWER/snapshot";
+
+void recordTopic(void *ctx, const std::string &topic, const std::string &, bool) {
+  static_cast<std::vector<std::string> *>(ctx)->push_back(topic);
+}
+
+size_t countSuffix(const std::vector<std::string> &topics, const std::string &suffix) {
+  size_t n = 0;
+  for (const std::string &t : topics) {
+    if (t.size() >= suffix.size() && t.compare(t.size() - suffix.size(), suffix.size(), suffix) == 0) n++;
+  }
+  return n;
+}
+
+void executed(SimRig &rig, uint8_t relay, uint8_t state, uint16_t minuteOfDay = 0) {
+  PowerExecutedPacket ex{16, relay, state, 0, minuteOfDay, 0, 0, rig.clock.millis()};
+  rig.master.onRadioFrame(MAC_A, (const uint8_t *)&ex, sizeof(ex), rig.clock.millis());
+}
+
+// Mismatches are reported for the minutes the schedule switches at, not for
+// manual overrides in between.
+void test_mismatch_only_at_scheduled_switches() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  rig.net.addSlave(MAC_A, 0x1);
+  rig.run(100);
+  PowerRelaySchedule s{};
+  s.count = 2;
+  s.rules[0] = PowerScheduleRule{7, 0, 1, 0x7F};
+  s.rules[1] = PowerScheduleRule{22, 0, 0, 0x7F};
+  rig.set(1, s);
+  rig.run(200);
+  assert(rig.outcome(1) == "OK");
+  std::vector<std::string> seen;
+  rig.setListener(recordTopic, &seen);
+
+  executed(rig, 1, 0, 10 * 60); // relay/1/set OFF during the ON period
+  executed(rig, 1, 1, 10 * 60 + 5);
+  executed(rig, 1, 1, 7 * 60);
+  executed(rig, 1, 0, 22 * 60);
+  rig.run(10);
+  assert(countSuffix(seen, "/schedule/mismatch") == 0);
+
+  executed(rig, 1, 0, 7 * 60);
+  rig.run(10);
+  assert(countSuffix(seen, "/schedule/mismatch") == 1);
+}
+
+// Drops the connection for a while, reconnects and records what the master
+// publishes from then on.
+void reconnect(SimRig &rig, std::vector<std::string> &seen) {
+  rig.broker.setConnected(false);
+  rig.run(50);
+  rig.broker.setConnected(true);
+  seen.clear();
+  rig.setListener(recordTopic, &seen);
+  rig.master.onMqttConnected();
+}
+
+void test_snapshot_tracks_relays_incrementally() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  rig.net.addSlave(MAC_A, 0x7);
+  rig.run(100);
+  rig.set(1, makeSchedule(3, 5));
+  rig.run(200);
+  assert(rig.outcome(1) == "OK");
+  executed(rig, 2, 1);
+  rig.run(10);
+
+  std::string doc, state;
+  assert(rig.broker.retained(SNAPSHOT_TOPIC, doc));
+  uint32_t version = 0;
+  assert(StateSnapshot::parseVersion(doc.data(), doc.size(), version) && version == rig.master.snapshot().version());
+  assert(doc.find("\"1\":{\"state\":null,\"ack\":\"OK\",\"rules\":3,") != std::string::npos);
+  assert(doc.find("\"2\":{\"state\":\"ON\",\"ack\":null,\"rules\":0,") != std::string::npos);
+  assert(rig.broker.retained("progetto/EVE/POWER/relay/2/state", state) && state == "ON");
+
+  // One relay changing renders one segment; a repeat renders nothing.
+  uint32_t builds = rig.master.snapshot().segmentBuilds();
+  executed(rig, 3, 0);
+  assert(rig.master.snapshot().segmentBuilds() == builds + 1);
+  executed(rig, 3, 0);
+  assert(rig.master.snapshot().segmentBuilds() == builds + 1);
+
+  // PENDING shows while a table is in flight.
+  rig.set(2, makeSchedule(2, 9));
+  assert(rig.master.snapshot().relay(2).ack == SNAPSHOT_ACK_PENDING);
+  rig.run(200);
+  assert(rig.master.snapshot().relay(2).ack == SNAPSHOT_ACK_OK && rig.master.snapshot().relay(2).rules == 2);
+}
+
+void test_reconnect_checks_broker_snapshot() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  rig.net.addSlave(MAC_A, 0x7);
+  rig.run(100);
+  rig.set(1, makeSchedule(3, 5));
+  rig.run(200);
+  executed(rig, 2, 1);
+  rig.run(10);
+  assert(rig.broker.subscriptionCount() == 3); // relay/+/set, relay/+/schedule/set, schedule/set
+
+  // The broker holds our version: no retained topic goes out again.
+  std::vector<std::string> seen;
+  reconnect(rig, seen);
+  assert(rig.master.checkingSnapshot());
+  rig.run(20);
+  assert(!rig.master.checkingSnapshot());
+  assert(countSuffix(seen, "/schedule/current") == 0 && countSuffix(seen, "/state") == 0);
+  assert(countSuffix(seen, "/snapshot") == 0);
+  assert(countSuffix(seen, "/schedule/next") == POWER_RELAY_COUNT);
+  assert(!rig.broker.subscribed(SNAPSHOT_TOPIC));
+  assert(rig.broker.subscribed("progetto/EVE/POWER/relay/3/schedule/set"));
+  assert(rig.broker.subscriptionCount() == 3);
+
+  // A relay switched while we were away: the versions differ, so everything
+  // retained is republished, including the known relay states.
+  rig.broker.setConnected(false);
+  executed(rig, 2, 0);
+  rig.run(10);
+  reconnect(rig, seen);
+  rig.run(20);
+  assert(countSuffix(seen, "/schedule/current") == POWER_RELAY_COUNT);
+  assert(countSuffix(seen, "/relay/2/state") >= 1);
+  assert(countSuffix(seen, "/relay/1/state") == 0); // never reported
+  std::string doc, state;
+  uint32_t version = 0;
+  assert(rig.broker.retained(SNAPSHOT_TOPIC, doc));
+  assert(StateSnapshot::parseVersion(doc.data(), doc.size(), version) && version == rig.master.snapshot().version());
+  assert(rig.broker.retained("progetto/EVE/POWER/relay/2/state", state) && state == "OFF");
+
+  // The broker lost its retained store: nothing arrives, and the master
+  // republishes once the check window has passed.
+  rig.broker.clearRetained();
+  reconnect(rig, seen);
+  rig.run(SNAPSHOT_CHECK_MS - 20);
+  assert(rig.master.checkingSnapshot());
+  assert(!rig.broker.retained("progetto/EVE/POWER/relay/1/schedule/current", doc));
+  rig.run(40);
+  assert(!rig.master.checkingSnapshot());
+  assert(rig.broker.retained("progetto/EVE/POWER/relay/1/schedule/current", doc));
+  assert(rig.broker.retained("progetto/EVE/POWER/relay/2/state", state) && state == "OFF");
+  assert(rig.broker.retained(SNAPSHOT_TOPIC, doc));
+  assert(!rig.broker.subscribed(SNAPSHOT_TOPIC));
+}
+
+// A burst overflows the outbox and drops retained state; the snapshot queued
+// after it still reaches the broker, which then matches ours without holding
+// what it describes.
+void test_reconnect_republishes_after_outbox_drop() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  rig.net.addSlave(MAC_A, 0x7);
+  rig.run(100);
+  PowerRelaySchedule s = makeSchedule(2, 7);
+  rig.set(3, s);
+  rig.run(200);
+  executed(rig, 2, 1);
+  rig.run(10);
+
+  executed(rig, 2, 0);
+  uint32_t dropped = rig.master.outbox().stats().dropped;
+  while (rig.master.outbox().stats().dropped < dropped + 2) rig.set(3, s); // unchanged: one ack each
+  rig.run(20);
+  std::string doc, state;
+  uint32_t version = 0;
+  assert(rig.broker.retained(SNAPSHOT_TOPIC, doc));
+  assert(StateSnapshot::parseVersion(doc.data(), doc.size(), version) && version == rig.master.snapshot().version());
+  assert(rig.broker.retained("progetto/EVE/POWER/relay/2/state", state) && state == "ON");
+
+  std::vector<std::string> seen;
+  reconnect(rig, seen);
+  rig.run(20);
+  assert(countSuffix(seen, "/schedule/current") == POWER_RELAY_COUNT);
+  assert(rig.broker.retained("progetto/EVE/POWER/relay/2/state", state) && state == "OFF");
+
+  // Republished in full: the next reconnect trusts the snapshot again.
+  reconnect(rig, seen);
+  rig.run(20);
+  assert(countSuffix(seen, "/schedule/current") == 0);
+}
+
+static const char BULK_SET[] = "progetto/EVE/POWER/schedule/set";
+static const char BULK_ACK[] = "progetto/EVE/POWER/schedule/slave/ack";
+
+std::string bulkDoc(const PowerRelaySchedule *tables, uint8_t mask) {
+  std::string doc = "{";
+  for (uint8_t r = 1; r <= 3; r++) {
+    if (!(mask & (1u << (r - 1)))) continue;
+    if (doc.size() > 1) doc += ",";
+    doc += "\"" + std::to_string(r) + "\":" + scheduleToJson(tables[r - 1]);
+  }
+  return doc + "}";
+}
+
+std::vector<std::string> payloadsOn(const SimRig &rig, const std::string &topic) {
+  std::vector<std::string> out;
+  for (const SimPublished &p : rig.acks) if (p.topic == topic) out.push_back(p.payload);
+  return out;
+}
+
+void test_bulk_set_applies_changed_relays_and_reports_once() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  rig.net.addSlave(MAC_A, 0x3);
+  rig.net.addSlave(MAC_B, 0x4);
+  rig.run(100);
+  PowerRelaySchedule tables[3] = {makeSchedule(3, 1), makeSchedule(2, 2), makeSchedule(4, 3)};
+  rig.set(2, tables[1]);
+  rig.run(200);
+  assert(rig.outcome(2) == "OK");
+  rig.run(SCHEDULE_PERSIST_DELAY_MS);
+  uint32_t writes = rig.store.writes();
+  rig.acks.clear();
+
+  // Relay 2 is unchanged; 1 and 3 go out at once, without the batch window.
+  std::string doc = bulkDoc(tables, 0x7);
+  SimNetStats before = rig.net.stats();
+  assert(rig.master.onMqttMessage(BULK_SET, (const uint8_t *)doc.data(), doc.size()));
+  assert(rig.net.stats().sent == before.sent + 2);
+  assert(rig.master.awaitingAck(1) && !rig.master.awaitingAck(2) && rig.master.awaitingAck(3));
+  rig.run(300);
+
+  std::vector<std::string> results = payloadsOn(rig, BULK_ACK);
+  assert(results.size() == 2);
+  assert(results[0] == "{\"result\":\"PENDING\",\"relays\":{\"1\":\"PENDING\",\"2\":\"UNCHANGED\",\"3\":\"PENDING\"}}");
+  assert(results[1] == "{\"result\":\"OK\",\"relays\":{\"1\":\"OK\",\"2\":\"UNCHANGED\",\"3\":\"OK\"}}");
+  for (uint8_t r = 1; r <= 3; r++) {
+    std::string topic = "progetto/EVE/POWER/relay/" + std::to_string(r) + "/schedule/slave/ack";
+    for (const std::string &p : payloadsOn(rig, topic)) assert(p != "PENDING");
+    assert(schedulesEqual(rig.master.activeSchedule(r), tables[r - 1]));
+  }
+  assert(schedulesEqual(rig.net.slave(0).tables[0], tables[0]));
+  assert(schedulesEqual(rig.net.slave(1).tables[2], tables[2]));
+
+  // Written once, as soon as the last relay resolved.
+  assert(rig.store.writes() == writes + 1);
+  rig.run(SCHEDULE_PERSIST_DELAY_MS + 100);
+  assert(rig.store.writes() == writes + 1);
+
+  // Everything unchanged: answered at once, nothing on air.
+  rig.acks.clear();
+  before = rig.net.stats();
+  assert(rig.master.onMqttMessage(BULK_SET, (const uint8_t *)doc.data(), doc.size()));
+  rig.run(50);
+  assert(rig.net.stats().sent == before.sent);
+  results = payloadsOn(rig, BULK_ACK);
+  assert(results.size() == 1 && results[0].find("\"result\":\"OK\"") != std::string::npos);
+}
+
+void test_bulk_set_is_all_or_nothing() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  rig.net.addSlave(MAC_A, 0x7);
+  rig.run(100);
+  std::string doc = "{\"1\":" + scheduleToJson(makeSchedule(2, 4)) +
+                    ",\"3\":[{\"at\":\"24:00\",\"state\":\"ON\",\"days\":\"1111111\"}]}";
+  SimNetStats before = rig.net.stats();
+  assert(rig.master.onMqttMessage(BULK_SET, (const uint8_t *)doc.data(), doc.size()));
+  rig.run(200);
+  assert(rig.net.stats().sent == before.sent);
+  assert(!rig.master.awaitingAck(1) && rig.master.activeSchedule(1).count == 0);
+  std::vector<std::string> results = payloadsOn(rig, BULK_ACK);
+  assert(results.size() == 1);
+  assert(results[0].find("\"result\":\"ERROR\"") != std::string::npos);
+  assert(results[0].find("\"relay\":3") != std::string::npos);
+  assert(rig.outcome(1).empty());
+}
+
+// A batch superseded by one with nothing to send still writes what the first
+// one had acknowledged: its persist timer stays disarmed until a batch closes.
+void test_bulk_set_superseded_by_unchanged_batch_persists() {
+  SimTempDir dir;
+  PowerRelaySchedule tables[3] = {makeSchedule(2, 8), makeSchedule(3, 9), PowerRelaySchedule{}};
+  {
+    SimRig rig(dir.path());
+    rig.net.addSlave(MAC_A, 0x1); // nobody answers for relay 2
+    rig.run(100);
+    std::string first = bulkDoc(tables, 0x3);
+    assert(rig.master.onMqttMessage(BULK_SET, (const uint8_t *)first.data(), first.size()));
+    rig.run(200);
+    assert(rig.outcome(1) == "OK" && rig.master.awaitingAck(2));
+    uint32_t writes = rig.store.writes();
+
+    rig.acks.clear();
+    std::string second = bulkDoc(tables, 0x1);
+    assert(rig.master.onMqttMessage(BULK_SET, (const uint8_t *)second.data(), second.size()));
+    rig.run(1);
+    std::vector<std::string> results = payloadsOn(rig, BULK_ACK);
+    assert(results.size() == 2);
+    assert(results[0].find("\"result\":\"SUPERSEDED\"") != std::string::npos);
+    assert(results[1] == "{\"result\":\"OK\",\"relays\":{\"1\":\"UNCHANGED\"}}");
+    assert(rig.store.writes() == writes + 1);
+  }
+  SimRig again(dir.path());
+  assert(schedulesEqual(again.master.activeSchedule(1), tables[0]));
+}
+
+// A relay that never answers fails alone; the others still apply, and the
+// batch reports the mix once the retry budget runs out.
+void test_bulk_set_reports_per_relay_failure() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  rig.net.addSlave(MAC_A, 0x3);
+  rig.run(100);
+  PowerRelaySchedule tables[3] = {makeSchedule(1, 5), makeSchedule(2, 6), makeSchedule(3, 7)};
+  std::string doc = bulkDoc(tables, 0x7);
+  assert(rig.master.onMqttMessage(BULK_SET, (const uint8_t *)doc.data(), doc.size()));
+  for (int i = 0; i < 120 && rig.master.awaitingAck(3); i++) rig.run(500);
+  std::vector<std::string> results = payloadsOn(rig, BULK_ACK);
+  assert(results.size() == 2);
+  assert(results[1] == "{\"result\":\"ERROR\",\"relays\":{\"1\":\"OK\",\"2\":\"OK\",\"3\":\"ERROR\"}}");
+  assert(schedulesEqual(rig.master.activeSchedule(2), tables[1]));
+  assert(rig.master.activeSchedule(3).count == 0);
+}
+
+int main() {
+  test_set_ack_publish_and_persist();
+  test_batch_and_fallback_to_single_relay();
+  test_legacy_slave_is_sent_type14_directly();
+  test_stale_multi_ack_does_not_commit_newer_tables();
+  test_failed_command_leaves_schedule_timing_alone();
+  test_dead_link_reports_error_after_retry_budget();
+  test_lossy_link_converges_across_slaves();
+  test_mismatch_only_at_scheduled_switches();
+  test_snapshot_tracks_relays_incrementally();
+  test_reconnect_checks_broker_snapshot();
+  test_reconnect_republishes_after_outbox_drop();
+  test_bulk_set_applies_changed_relays_and_reports_once();
+  test_bulk_set_is_all_or_nothing();
+  test_bulk_set_superseded_by_unchanged_batch_persists();
+  test_bulk_set_reports_per_relay_failure();
+  std::cout << "All power master tests passed\n";
+  return 0;
+}
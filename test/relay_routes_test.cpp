@@ -0,0 +1,53 @@
+#include <assert.h>
+#include <iostream>
+
+#include "relay_routes.h"
+
+static const uint8_t MAC_A[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x0A};
+static const uint8_t MAC_B[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x0B};
+
+void test_learn_and_lookup() {
+  RelayRouteTable t(1000);
+  assert(t.lookup(1, 0) == nullptr);
+  assert(t.learn(1, MAC_A, 10));
+  assert(!t.learn(1, MAC_A, 20));
+  assert(t.lookup(1, 500) == t.route(1).mac);
+  assert(t.route(1).learnedMs == 10 && t.route(1).lastSeenMs == 20);
+  assert(t.learn(1, MAC_B, 30));
+  assert(t.route(1).changes == 2);
+  assert(!t.learn(0, MAC_A, 0));
+  assert(!t.learn(POWER_RELAY_COUNT + 1, MAC_A, 0));
+  assert(t.lookup(2, 30) == nullptr);
+}
+
+void test_expiry_and_forget() {
+  RelayRouteTable t(1000);
+  t.learn(1, MAC_A, 0);
+  t.learn(2, MAC_A, 500);
+  t.learn(3, MAC_B, 500);
+  assert(t.expire(1200) == 0x01);
+  assert(t.lookup(1, 1200) == nullptr && t.route(1).expiries == 1);
+  assert(t.lookup(2, 1200) != nullptr);
+
+  assert(t.forgetMac(MAC_A) == 0x02);
+  assert(t.lookup(2, 1200) == nullptr);
+  assert(t.lookup(3, 1200) != nullptr);
+  assert(t.invalidate(3) && !t.invalidate(3));
+}
+
+void test_counters() {
+  RelayRouteTable t(1000);
+  t.countFanout(1);
+  t.learn(1, MAC_A, 0);
+  t.countUnicast(1);
+  t.countUnicast(1);
+  assert(t.route(1).fanoutSends == 1 && t.route(1).unicastSends == 2);
+}
+
+int main() {
+  test_learn_and_lookup();
+  test_expiry_and_forget();
+  test_counters();
+  std::cout << "All relay route tests passed\n";
+  return 0;
+}
@@ -0,0 +1,87 @@
+#include <assert.h>
+#include <iostream>
+#include <random>
+
+#include "rtt_estimator.h"
+
+void test_initial_timeout() {
+  RttEstimator e(3000, 100, 8000);
+  assert(!e.hasSample());
+  assert(e.timeoutMs() == 3000);
+}
+
+void test_converges_to_link_rtt() {
+  RttEstimator e(3000, 20, 8000);
+  e.sample(40);
+  assert(e.srttMs() == 40 && e.rttvarMs() == 20);
+  assert(e.timeoutMs() == 40 + 4 * 20);
+  for (int i = 0; i < 100; i++) e.sample(40);
+  assert(e.srttMs() == 40);
+  assert(e.timeoutMs() < 50);
+  assert(e.timeoutMs() >= 40);
+}
+
+void test_tracks_jitter() {
+  RttEstimator steady(3000, 1, 8000), jittery(3000, 1, 8000);
+  std::mt19937 rng(42);
+  for (int i = 0; i < 500; i++) {
+    steady.sample(30);
+    jittery.sample(10 + rng() % 60);
+  }
+  assert(jittery.srttMs() > 30 && jittery.srttMs() < 50);
+  assert(jittery.rttvarMs() > steady.rttvarMs());
+  assert(jittery.timeoutMs() > steady.timeoutMs());
+}
+
+void test_clamps() {
+  RttEstimator e(3000, 100, 8000);
+  e.sample(5);
+  for (int i = 0; i < 50; i++) e.sample(5);
+  assert(e.timeoutMs() == 100);
+  e.sample(60000);
+  assert(e.timeoutMs() <= 8000);
+}
+
+void test_loss_backs_off_until_next_sample() {
+  RttEstimator e(3000, 50, 8000);
+  for (int i = 0; i < 50; i++) e.sample(100);
+  uint32_t base = e.timeoutMs();
+  e.onLoss();
+  assert(e.timeoutMs() == base * 2);
+  e.onLoss();
+  assert(e.timeoutMs() == base * 4);
+  for (int i = 0; i < 20; i++) e.onLoss();
+  assert(e.timeoutMs() == (base * 64 < 8000 ? base * 64 : 8000)); // shift saturates
+  assert(e.losses() == 22);
+  e.sample(100);
+  assert(e.timeoutMs() <= base + 1);
+}
+
+void test_backoff_delay() {
+  assert(backoffDelayMs(200, 0, 8000, 12345) == 200);
+  std::mt19937 rng(7);
+  for (uint8_t attempt = 1; attempt < 8; attempt++) {
+    uint32_t d = 200u << attempt;
+    if (d > 8000) d = 8000;
+    uint32_t lo = 0xFFFFFFFF, hi = 0;
+    for (int i = 0; i < 2000; i++) {
+      uint32_t v = backoffDelayMs(200, attempt, 8000, rng());
+      assert(v >= d / 2 && v <= d);
+      if (v < lo) lo = v;
+      if (v > hi) hi = v;
+    }
+    assert(hi > lo); // jittered
+  }
+  assert(backoffDelayMs(20000, 0, 8000, 0) == 8000);
+}
+
+int main() {
+  test_initial_timeout();
+  test_converges_to_link_rtt();
+  test_tracks_jitter();
+  test_clamps();
+  test_loss_backs_off_until_next_sample();
+  test_backoff_delay();
+  std::cout << "All rtt estimator tests passed\n";
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include <string>
+
+#include "bench_harness.h"
+#include "legacy_schedule_codec.h"
+#include "power_schedule_core.h"
+
+namespace {
+
+PowerRelaySchedule fullSchedule() {
+  PowerRelaySchedule s{};
+  s.count = POWER_MAX_SCHEDULE_RULES;
+  for (uint8_t i = 0; i < s.count; i++) s.rules[i] = PowerScheduleRule{(uint8_t)(6 + i), (uint8_t)(i * 5), (uint8_t)(i & 1), 0x1F};
+  return s;
+}
+
+std::string whitespaceHeavy(const std::string &json) {
+  std::string out = "\n\t ";
+  bool inString = false;
+  for (char c : json) {
+    out += c;
+    if (c == '"') inString = !inString;
+    if (!inString && (c == '{' || c == ',' || c == ':' || c == '[')) out += "\r\n    \t  ";
+  }
+  out += " \n\n";
+  return out;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  BenchConfig cfg = benchConfigFromArgs(argc, argv);
+
+  const PowerRelaySchedule full = fullSchedule();
+  PowerRelaySchedule fullLastDiff = full;
+  fullLastDiff.rules[POWER_MAX_SCHEDULE_RULES - 1].state ^= 1;
+  const std::string fullJson = scheduleToJson(full);
+  const std::string spacedJson = whitespaceHeavy(fullJson);
+  const std::string truncatedJson = fullJson.substr(0, fullJson.size() - 2);
+  const std::string badStateJson = "[{\"at\":\"07:30\",\"state\":\"MAYBE\",\"days\":\"1111111\"}]";
+  std::string tooManyJson = fullJson;
+  tooManyJson.insert(tooManyJson.size() - 1, ",{\"at\":\"23:00\",\"state\":\"OFF\",\"days\":\"1111111\"}");
+
+  struct Input {
+    const char *name;
+    const std::string *json;
+  };
+  const Input parseInputs[] = {
+      {"parse/full10", &fullJson},
+      {"parse/whitespace10", &spacedJson},
+      {"parse/malformed_truncated", &truncatedJson},
+      {"parse/malformed_state", &badStateJson},
+      {"parse/malformed_too_many", &tooManyJson},
+  };
+
+  for (const Input &in : parseInputs) {
+    // The std::string codec the view parser replaced, against the view parser.
+    std::string name = std::string(in.name) + "/legacy";
+    runBench(cfg, name.c_str(), [&] {
+      PowerRelaySchedule s{};
+      std::string err;
+      benchKeep(legacy::parseScheduleJson(*in.json, s, err) ? s.count : err.size());
+    });
+    name = std::string(in.name) + "/view";
+    runBench(cfg, name.c_str(), [&] {
+      PowerRelaySchedule s{};
+      const char *err = "";
+      benchKeep(parseScheduleJson(in.json->data(), in.json->size(), s, err) ? s.count : (uintptr_t)err);
+    });
+  }
+
+  runBench(cfg, "serialize/full10/legacy", [&] { benchKeep(legacy::scheduleToJson(full).size()); });
+  runBench(cfg, "serialize/full10/buffer", [&] {
+    char buf[POWER_SCHEDULE_JSON_MAX + 1];
+    benchKeep(writeScheduleJson(full, buf, sizeof(buf)));
+  });
+
+  runBench(cfg, "equal/full10_same", [&] { benchKeep(schedulesEqual(full, full)); });
+  runBench(cfg, "equal/full10_last_differs", [&] { benchKeep(schedulesEqual(full, fullLastDiff)); });
+
+  runBench(cfg, "build_rules_packet/full10", [&] {
+    PowerRelayRulesPacket pkt{};
+    benchKeep(buildRulesPacket(2, full, 1234, pkt) ? pkt.count : 0);
+  });
+
+  runBench(cfg, "delta/full10_one_flip", [&] {
+    uint8_t buf[POWER_DELTA_PACKET_MAX];
+    benchKeep(buildDeltaPacket(2, full, fullLastDiff, 1234, buf, sizeof(buf)));
+  });
+  runBench(cfg, "delta/apply_one_flip", [&] {
+    PowerScheduleDelta delta;
+    diffSchedules(full, fullLastDiff, delta);
+    PowerRelaySchedule out;
+    benchKeep(applyScheduleDelta(full, delta, out) ? out.count : 0);
+  });
+  return 0;
+}
@@ -1,7 +1,10 @@
 #include <assert.h>
+#include <string.h>
 #include <iostream>
+#include <random>
 #include <string>
 
+#include "legacy_schedule_codec.h"
 #include "power_schedule_core.h"
 
 void test_validation() {
@@ -26,7 +29,7 @@ void test_json_to_packet() {
 void test_ack_and_executed_structs() {
   PowerScheduleAckPacket ack{15, 1, 1, 2, 777};
   assert(ack.type == 15 && ack.ok == 1);
-  PowerExecutedPacket ex{16, 3, 1, 480, 0, 999};
+  PowerExecutedPacket ex{16, 3, 1, 0, 480, 0, 0, 999};
   assert(ex.type == 16 && ex.state == 1 && ex.minuteOfDay == 480);
 }
 
@@ -39,11 +42,481 @@ void test_retained_payload_shape() {
   assert(out.find("1111100") != std::string::npos);
 }
 
+void test_view_codec_matches_string_api() {
+  const char *inputs[] = {
+      "[]",
+      " [ { \"at\" : \"23:59\" , \"state\" : \"OFF\", \"days\":\"0000001\", \"x\":\"y\" } ] ",
+      "[{\"at\":\"07:30\",\"state\":\"ON\",\"days\":\"1111111\"}]",
+      "{}",
+      "[{\"at\":\"7:30\",\"state\":\"ON\",\"days\":\"1111111\"}]",
+      "[{\"at\":\"07:3a\",\"state\":\"ON\",\"days\":\"1111111\"}]",
+      "[{\"at\":\"07:30\",\"state\":\"ON\",\"days\":\"111\"}]",
+      "[{\"at\":\"07:30\",\"state\":\"ON\",\"days\":\"1112111\"}]",
+      "[{\"at\":\"07:30\",\"state\":\"ON\"}]",
+      "[{\"at\":\"07:30\",\"state\":\"ON\",\"days\":\"1111111\"}",
+      "[{\"at\":\"07:30\",\"state\":\"ON\",\"days\":\"1111111\"}] x",
+      "[{\"at\" \"07:30\"}]",
+  };
+  for (const char *in : inputs) {
+    PowerRelaySchedule a{}, b{};
+    std::string errA;
+    const char *errB = "";
+    bool okA = parseScheduleJson(std::string(in), a, errA);
+    bool okB = parseScheduleJson(in, strlen(in), b, errB);
+    assert(okA == okB);
+    if (okA) assert(schedulesEqual(a, b));
+    else assert(errA == errB);
+  }
+
+  std::string tooMany = "[";
+  for (int i = 0; i < 11; i++) tooMany += std::string(i ? "," : "") + "{\"at\":\"01:00\",\"state\":\"ON\",\"days\":\"1000000\"}";
+  tooMany += "]";
+  PowerRelaySchedule s{};
+  const char *err = "";
+  assert(!parseScheduleJson(tooMany.data(), tooMany.size(), s, err));
+  assert(strcmp(err, "Too many rules (max 10)") == 0);
+}
+
+// Randomized check that the view/buffer codec behaves like the legacy one:
+// 200k documents (valid tables of 0..11 rules, then up to three random byte
+// edits) parse to the same table or fail with the same message, and every
+// generated table serializes byte-identically. The one intended difference:
+// legacy accepted anything after an empty "[]".
+void test_codec_matches_legacy_on_generated_inputs() {
+  static_assert(POWER_MAX_SCHEDULE_RULES == 10, "the legacy reference hardcodes the 10-rule message");
+  static const char ALPHABET[] = "{}[],:\" \t0123456789ONFatsdyx";
+  std::mt19937 rng(2024);
+  uint32_t accepted = 0, emptyWithTrailing = 0;
+  for (int iter = 0; iter < 200000; iter++) {
+    PowerRelaySchedule table{};
+    table.count = (uint8_t)(rng() % (POWER_MAX_SCHEDULE_RULES + 1));
+    for (uint8_t i = 0; i < table.count; i++) {
+      table.rules[i] = PowerScheduleRule{(uint8_t)(rng() % 24), (uint8_t)(rng() % 60), (uint8_t)(rng() % 2),
+                                         (uint8_t)(rng() % 128)};
+    }
+    std::string doc = legacy::scheduleToJson(table);
+    assert(doc == scheduleToJson(table));
+    if (table.count == POWER_MAX_SCHEDULE_RULES && rng() % 2) {
+      doc.insert(doc.size() - 1, "," + doc.substr(1, doc.find('}'))); // one rule too many
+    }
+
+    for (uint32_t edits = rng() % 4; edits > 0 && !doc.empty(); edits--) {
+      size_t at = rng() % doc.size();
+      char c = ALPHABET[rng() % (sizeof(ALPHABET) - 1)];
+      switch (rng() % 3) {
+        case 0: doc[at] = c; break;
+        case 1: doc.insert(doc.begin() + at, c); break;
+        default: doc.erase(at, 1); break;
+      }
+    }
+
+    PowerRelaySchedule a{}, b{};
+    std::string errA;
+    const char *errB = "";
+    bool okA = legacy::parseScheduleJson(doc, a, errA);
+    bool okB = parseScheduleJson(doc.data(), doc.size(), b, errB);
+    if (okA && a.count == 0 && !okB && strcmp(errB, "Trailing chars") == 0) {
+      emptyWithTrailing++;
+      continue;
+    }
+    assert(okA == okB);
+    if (okA) {
+      assert(schedulesEqual(a, b));
+      accepted++;
+    } else {
+      assert(errA == errB);
+    }
+  }
+  assert(accepted > 20000 && accepted < 180000); // both outcomes well exercised
+  assert(emptyWithTrailing > 0);
+}
+
+void test_bulk_parse() {
+  PowerRelaySchedule out[3] = {};
+  out[1].count = 7; // not listed: left alone
+  uint8_t mask = 0, errorRelay = 9;
+  const char *err = "";
+  const char doc[] = " { \"3\" : [{\"at\":\"06:10\",\"state\":\"OFF\",\"days\":\"1010101\"}],"
+                     "\"1\":[{\"at\":\"07:30\",\"state\":\"ON\",\"days\":\"1111111\"},"
+                     "{\"at\":\"22:00\",\"state\":\"OFF\",\"days\":\"1111111\"}] } ";
+  assert(parseBulkScheduleJson(doc, strlen(doc), out, 3, mask, errorRelay, err));
+  assert(mask == 0x5 && errorRelay == 0);
+  assert(out[0].count == 2 && out[0].rules[1].hh == 22);
+  assert(out[1].count == 7);
+  assert(out[2].count == 1 && out[2].rules[0].mm == 10);
+
+  // The same tables as the per-relay parser sees them.
+  PowerRelaySchedule single{};
+  std::string e;
+  assert(parseScheduleJson("[{\"at\":\"06:10\",\"state\":\"OFF\",\"days\":\"1010101\"}]", single, e));
+  assert(schedulesEqual(single, out[2]));
+
+  const char empty[] = "{\"2\":[]}";
+  assert(parseBulkScheduleJson(empty, strlen(empty), out, 3, mask, errorRelay, err));
+  assert(mask == 0x2 && out[1].count == 0);
+
+  struct Bad {
+    const char *json;
+    uint8_t relay;
+    const char *error;
+  };
+  const Bad bad[] = {
+      {"{}", 0, "No relays"},
+      {"[]", 0, "Expected '{'"},
+      {"{\"4\":[]}", 0, "Unknown relay"},
+      {"{\"0\":[]}", 0, "Unknown relay"},
+      {"{\"12\":[]}", 0, "Unknown relay"},
+      {"{\"1\":[],\"1\":[]}", 1, "Duplicate relay"},
+      {"{\"1\" []}", 1, "Expected ':'"},
+      {"{\"2\":[{\"at\":\"25:00\",\"state\":\"ON\",\"days\":\"1111111\"}]}", 2, nullptr},
+      {"{\"1\":[] \"2\":[]}", 0, "Expected ',' between relays"},
+      {"{\"1\":[]", 0, "Unexpected end object"},
+      {"{\"1\":[]} x", 0, "Trailing chars"},
+  };
+  for (const Bad &b : bad) {
+    err = "";
+    assert(!parseBulkScheduleJson(b.json, strlen(b.json), out, 3, mask, errorRelay, err));
+    assert(errorRelay == b.relay);
+    if (b.error != nullptr) assert(strcmp(err, b.error) == 0);
+    else assert(*err != '\0');
+  }
+
+  // Rule limits apply per relay.
+  std::string tooMany = "{\"2\":[";
+  for (int i = 0; i < 11; i++) tooMany += std::string(i ? "," : "") + "{\"at\":\"01:00\",\"state\":\"ON\",\"days\":\"1000000\"}";
+  tooMany += "]}";
+  assert(!parseBulkScheduleJson(tooMany.data(), tooMany.size(), out, 3, mask, errorRelay, err));
+  assert(errorRelay == 2 && strcmp(err, "Too many rules (max 10)") == 0);
+  assert(tooMany.size() < POWER_BULK_SCHEDULE_JSON_MAX);
+}
+
+void test_json_writer_exact_size() {
+  PowerRelaySchedule s{};
+  s.count = POWER_MAX_SCHEDULE_RULES;
+  for (uint8_t i = 0; i < s.count; i++) s.rules[i] = PowerScheduleRule{(uint8_t)(i * 2), (uint8_t)(i * 5), (uint8_t)(i & 1), 0x7F};
+
+  size_t n = scheduleJsonLength(s);
+  assert(n <= POWER_SCHEDULE_JSON_MAX);
+  char buf[POWER_SCHEDULE_JSON_MAX + 1];
+  assert(writeScheduleJson(s, buf, n - 1) == 0);
+  assert(writeScheduleJson(s, buf, n) == n);
+  assert(writeScheduleJson(s, buf, sizeof(buf)) == n);
+  assert(strlen(buf) == n);
+  assert(scheduleToJson(s) == std::string(buf, n));
+
+  PowerRelaySchedule back{};
+  const char *err = "";
+  assert(parseScheduleJson(buf, n, back, err));
+  assert(schedulesEqual(s, back));
+
+  PowerRelaySchedule empty{};
+  assert(scheduleToJson(empty) == "[]");
+}
+
+void test_binary_store_roundtrip() {
+  PowerRelaySchedule in[3] = {};
+  std::string err;
+  assert(parseScheduleJson("[{\"at\":\"07:30\",\"state\":\"ON\",\"days\":\"1111100\"},"
+                           "{\"at\":\"22:00\",\"state\":\"OFF\",\"days\":\"1111111\"}]", in[0], err));
+  in[2].count = POWER_MAX_SCHEDULE_RULES;
+  for (uint8_t i = 0; i < in[2].count; i++) in[2].rules[i] = PowerScheduleRule{i, (uint8_t)(i * 3), (uint8_t)(i & 1), 0x41};
+
+  uint8_t buf[scheduleStoreMaxSize(3)];
+  size_t n = encodeScheduleStore(in, 3, buf, sizeof(buf));
+  assert(n == 8 + (1 + 2 * 4) + 1 + (1 + 10 * 4) + 4);
+  assert(encodeScheduleStore(in, 3, buf, n - 1) == 0);
+
+  PowerRelaySchedule out[3] = {};
+  assert(decodeScheduleStore(buf, n, out, 3));
+  for (int r = 0; r < 3; r++) assert(schedulesEqual(in[r], out[r]));
+}
+
+void test_binary_store_rejects_bad_records() {
+  PowerRelaySchedule in[3] = {};
+  in[1].count = 1;
+  in[1].rules[0] = PowerScheduleRule{6, 0, 1, 0x7F};
+  uint8_t buf[scheduleStoreMaxSize(3)];
+  size_t n = encodeScheduleStore(in, 3, buf, sizeof(buf));
+
+  PowerRelaySchedule out[3] = {};
+  out[0].count = 1;
+  out[0].rules[0] = PowerScheduleRule{1, 2, 1, 3};
+  PowerRelaySchedule before = out[0];
+
+  uint8_t bad[sizeof(buf)];
+  memcpy(bad, buf, n);
+  bad[10] ^= 0x01; // payload bit flip
+  assert(!decodeScheduleStore(bad, n, out, 3));
+  memcpy(bad, buf, n);
+  bad[4] = POWER_SCHEDULE_STORE_VERSION + 1; // unknown version
+  assert(!decodeScheduleStore(bad, n, out, 3));
+  assert(!decodeScheduleStore(buf, n - 1, out, 3));
+  assert(!decodeScheduleStore(buf, n, out, 2));
+  assert(!decodeScheduleStore(nullptr, 0, out, 3));
+  assert(schedulesEqual(out[0], before));
+}
+
+void test_multi_rules_packet_roundtrip() {
+  PowerRelaySchedule in[3] = {};
+  in[0].count = POWER_MAX_SCHEDULE_RULES;
+  for (uint8_t i = 0; i < in[0].count; i++) in[0].rules[i] = PowerScheduleRule{(uint8_t)(i * 2 + 3), (uint8_t)(i * 6), (uint8_t)(i & 1), (uint8_t)(0x7F >> i % 7)};
+  in[2].count = 2;
+  in[2].rules[0] = PowerScheduleRule{0, 0, 1, 0x01};
+  in[2].rules[1] = PowerScheduleRule{23, 59, 0, 0x40};
+
+  uint8_t buf[POWER_MULTI_RULES_MAX];
+  size_t n = encodeMultiRulesPacket(in, 0x07, 9, 4242, buf, sizeof(buf));
+  assert(n == 7 + (1 + 30) + 1 + (1 + 6));
+  assert(n < sizeof(PowerRelayRulesPacket) * 2); // three relays in less than two type-14 frames
+  assert(buf[0] == POWER_MULTI_RULES_TYPE && buf[1] == 0x07 && buf[2] == 9);
+  assert(encodeMultiRulesPacket(in, 0x07, 9, 4242, buf, n - 1) == 0);
+  assert(encodeMultiRulesPacket(in, 0x08, 9, 4242, buf, sizeof(buf)) == 0);
+
+  PowerRelaySchedule out[3] = {};
+  uint8_t mask = 0, xfer = 0;
+  uint32_t ms = 0;
+  assert(decodeMultiRulesPacket(buf, n, mask, xfer, out, ms));
+  assert(mask == 0x07 && xfer == 9 && ms == 4242);
+  for (int r = 0; r < 3; r++) assert(schedulesEqual(in[r], out[r]));
+
+  // Subset: only relay 3 travels.
+  n = encodeMultiRulesPacket(in, 0x04, 10, 1, buf, sizeof(buf));
+  assert(n == 7 + 1 + 6);
+  PowerRelaySchedule sub[3] = {};
+  sub[0] = in[0];
+  assert(decodeMultiRulesPacket(buf, n, mask, xfer, sub, ms) && mask == 0x04 && xfer == 10);
+  assert(schedulesEqual(sub[2], in[2]) && schedulesEqual(sub[0], in[0]));
+}
+
+void test_multi_rules_packet_rejects_bad_frames() {
+  PowerRelaySchedule in[3] = {};
+  in[1].count = 1;
+  in[1].rules[0] = PowerScheduleRule{12, 0, 1, 0x1F};
+  uint8_t buf[POWER_MULTI_RULES_MAX];
+  size_t n = encodeMultiRulesPacket(in, 0x02, 1, 7, buf, sizeof(buf));
+
+  PowerRelaySchedule out[3] = {};
+  out[1].count = 1;
+  out[1].rules[0] = PowerScheduleRule{1, 1, 0, 1};
+  PowerRelaySchedule before = out[1];
+  uint8_t mask = 0, xfer = 0;
+  uint32_t ms = 0;
+  uint8_t bad[sizeof(buf)];
+
+  assert(!decodeMultiRulesPacket(buf, n - 1, mask, xfer, out, ms));
+  memcpy(bad, buf, n);
+  bad[0] = 14;
+  assert(!decodeMultiRulesPacket(bad, n, mask, xfer, out, ms));
+  memcpy(bad, buf, n);
+  bad[1] = 0;
+  assert(!decodeMultiRulesPacket(bad, n, mask, xfer, out, ms));
+  memcpy(bad, buf, n);
+  bad[8] = 0xA0; bad[9] = 0x05; // minute 1440
+  assert(!decodeMultiRulesPacket(bad, n, mask, xfer, out, ms));
+  memcpy(bad, buf, n);
+  bad[7] = POWER_MAX_SCHEDULE_RULES + 1;
+  assert(!decodeMultiRulesPacket(bad, n, mask, xfer, out, ms));
+  assert(schedulesEqual(out[1], before));
+}
+
+PowerRelaySchedule randomSchedule(std::mt19937 &rng) {
+  PowerRelaySchedule s{};
+  s.count = rng() % (POWER_MAX_SCHEDULE_RULES + 1);
+  // Small alphabet so tables share rules and the diff has matches to find.
+  for (uint8_t i = 0; i < s.count; i++) s.rules[i] = PowerScheduleRule{(uint8_t)(6 + rng() % 3), (uint8_t)(rng() % 2 * 30), (uint8_t)(rng() % 2), 0x1F};
+  return s;
+}
+
+void test_schedule_delta_roundtrip() {
+  std::mt19937 rng(99);
+  for (int iter = 0; iter < 20000; iter++) {
+    PowerRelaySchedule base = randomSchedule(rng);
+    PowerRelaySchedule target = base;
+    switch (iter % 4) {
+      case 0: target = randomSchedule(rng); break;
+      case 1: if (target.count) target.rules[rng() % target.count].state ^= 1; break;
+      case 2:
+        if (target.count) {
+          uint8_t at = rng() % target.count;
+          for (uint8_t i = at; i + 1 < target.count; i++) target.rules[i] = target.rules[i + 1];
+          target.count--;
+        }
+        break;
+      default:
+        if (target.count < POWER_MAX_SCHEDULE_RULES) {
+          uint8_t at = rng() % (target.count + 1);
+          for (uint8_t i = target.count; i > at; i--) target.rules[i] = target.rules[i - 1];
+          target.rules[at] = PowerScheduleRule{23, 15, 1, 0x60};
+          target.count++;
+        }
+        break;
+    }
+
+    PowerScheduleDelta delta;
+    diffSchedules(base, target, delta);
+    assert(delta.count <= (base.count > target.count ? base.count : target.count));
+    if (iter % 4 != 0) assert(delta.count <= 1); // single edits stay single
+    PowerRelaySchedule applied{};
+    assert(applyScheduleDelta(base, delta, applied));
+    assert(schedulesEqual(applied, target));
+    assert(scheduleHash(applied) == scheduleHash(target));
+
+    uint8_t buf[POWER_DELTA_PACKET_MAX];
+    size_t n = buildDeltaPacket(2, base, target, 55, buf, sizeof(buf));
+    assert(n >= 15 && n <= sizeof(buf));
+    uint8_t relay = 0;
+    uint32_t baseHash = 0, targetHash = 0, ms = 0;
+    PowerScheduleDelta wire;
+    assert(decodeDeltaPacket(buf, n, relay, baseHash, targetHash, wire, ms));
+    assert(relay == 2 && ms == 55 && baseHash == scheduleHash(base) && targetHash == scheduleHash(target));
+    assert(applyScheduleDelta(base, wire, applied) && schedulesEqual(applied, target));
+  }
+}
+
+void test_schedule_delta_is_small_for_small_changes() {
+  PowerRelaySchedule base{};
+  base.count = POWER_MAX_SCHEDULE_RULES;
+  for (uint8_t i = 0; i < base.count; i++) base.rules[i] = PowerScheduleRule{(uint8_t)(6 + i), 0, (uint8_t)(i & 1), 0x7F};
+  PowerRelaySchedule flipped = base;
+  flipped.rules[4].state ^= 1;
+  uint8_t buf[POWER_DELTA_PACKET_MAX];
+  assert(buildDeltaPacket(1, base, flipped, 0, buf, sizeof(buf)) == 15 + 4);
+  assert(buildDeltaPacket(1, base, base, 0, buf, sizeof(buf)) == 15);
+  assert(scheduleHash(base) != scheduleHash(flipped));
+
+  // Rewriting every rule is larger than the full type-14 packet: caller falls back.
+  PowerRelaySchedule rewritten = base;
+  for (uint8_t i = 0; i < rewritten.count; i++) rewritten.rules[i].mm = 45;
+  assert(buildDeltaPacket(1, base, rewritten, 0, buf, sizeof(buf)) >= sizeof(PowerRelayRulesPacket));
+}
+
+void test_schedule_delta_rejects_bad_input() {
+  PowerRelaySchedule base{};
+  base.count = 2;
+  base.rules[0] = PowerScheduleRule{7, 0, 1, 0x7F};
+  base.rules[1] = PowerScheduleRule{8, 0, 0, 0x7F};
+  PowerRelaySchedule out{};
+  PowerScheduleDelta d{};
+  d.count = 1;
+  d.edits[0] = PowerScheduleEdit{POWER_EDIT_DELETE, 2, PowerScheduleRule{}};
+  assert(!applyScheduleDelta(base, d, out));
+  d.edits[0] = PowerScheduleEdit{POWER_EDIT_INSERT, 3, PowerScheduleRule{9, 0, 1, 1}};
+  assert(!applyScheduleDelta(base, d, out));
+  d.edits[0] = PowerScheduleEdit{POWER_EDIT_REPLACE, 0, PowerScheduleRule{24, 0, 1, 1}};
+  assert(!applyScheduleDelta(base, d, out));
+  d.edits[0] = PowerScheduleEdit{3, 0, PowerScheduleRule{9, 0, 1, 1}};
+  assert(!applyScheduleDelta(base, d, out));
+
+  // Growing past POWER_MAX_SCHEDULE_RULES is refused.
+  PowerRelaySchedule full{};
+  full.count = POWER_MAX_SCHEDULE_RULES;
+  d.edits[0] = PowerScheduleEdit{POWER_EDIT_INSERT, 0, PowerScheduleRule{9, 0, 1, 1}};
+  assert(!applyScheduleDelta(full, d, out));
+
+  PowerRelaySchedule target = base;
+  target.rules[1].state = 1;
+  uint8_t buf[POWER_DELTA_PACKET_MAX];
+  size_t n = buildDeltaPacket(3, base, target, 0, buf, sizeof(buf));
+  uint8_t relay;
+  uint32_t bh, th, ms;
+  assert(!decodeDeltaPacket(buf, n - 1, relay, bh, th, d, ms));
+  buf[1] = 4;
+  assert(!decodeDeltaPacket(buf, n, relay, bh, th, d, ms));
+  assert(buildDeltaPacket(0, base, target, 0, buf, sizeof(buf)) == 0);
+  assert(buildDeltaPacket(1, base, target, 0, buf, 15) == 0);
+}
+
+// Reference: replay the rules minute by minute over two weeks.
+int8_t bruteForceStateAt(const PowerRelaySchedule &s, uint16_t weekMinute) {
+  int8_t state = -1;
+  for (int pass = 0; pass < 2; pass++) {
+    for (uint16_t t = 0; t < POWER_MINUTES_PER_WEEK; t++) {
+      uint8_t day = t / POWER_MINUTES_PER_DAY;
+      uint16_t mod = t % POWER_MINUTES_PER_DAY;
+      for (uint8_t i = 0; i < s.count; i++) {
+        const PowerScheduleRule &r = s.rules[i];
+        if (((r.daysMask >> day) & 1) && r.hh * 60 + r.mm == mod) state = r.state;
+      }
+      if (pass == 1 && t == weekMinute) return state;
+    }
+  }
+  return state;
+}
+
+void test_schedule_index_matches_replay() {
+  PowerRelaySchedule s{};
+  std::string err;
+  assert(parseScheduleJson("[{\"at\":\"07:00\",\"state\":\"ON\",\"days\":\"1111100\"},"
+                           "{\"at\":\"22:30\",\"state\":\"OFF\",\"days\":\"1111111\"},"
+                           "{\"at\":\"09:00\",\"state\":\"ON\",\"days\":\"0000011\"},"
+                           "{\"at\":\"12:00\",\"state\":\"ON\",\"days\":\"1111111\"},"
+                           "{\"at\":\"07:00\",\"state\":\"OFF\",\"days\":\"0000100\"}]", s, err));
+  PowerScheduleIndex idx{};
+  buildScheduleIndex(s, idx);
+  for (uint16_t t = 0; t < POWER_MINUTES_PER_WEEK; t += 7) {
+    assert(scheduleStateAt(idx, t / POWER_MINUTES_PER_DAY, t % POWER_MINUTES_PER_DAY) == bruteForceStateAt(s, t));
+  }
+  // Friday 07:00: the later OFF rule wins over the earlier ON rule.
+  assert(scheduleStateAt(idx, 4, 7 * 60) == 0);
+  assert(scheduleStateAt(idx, 0, 7 * 60) == 1);
+  // Monday 00:00 still carries Sunday 22:30 OFF.
+  assert(scheduleStateAt(idx, 0, 0) == 0);
+
+  PowerScheduleTransition next{};
+  assert(scheduleNextTransition(idx, 0, 7 * 60, next));
+  assert(next.weekMinute == 22 * 60 + 30 && next.state == 0); // 12:00 ON is not a switch
+  assert(scheduleNextTransition(idx, 6, 23 * 60, next));
+  assert(next.weekMinute == 7 * 60 && next.state == 1);       // wraps to Monday
+
+  assert(scheduleSwitchesAt(idx, 0, 7 * 60) && scheduleSwitchesAt(idx, 6, 22 * 60 + 30));
+  assert(!scheduleSwitchesAt(idx, 0, 12 * 60)); // fires, but changes nothing
+  assert(!scheduleSwitchesAt(idx, 0, 7 * 60 + 1) && !scheduleSwitchesAt(idx, 0, 0));
+  assert(!scheduleSwitchesAt(idx, 7, 7 * 60) && !scheduleSwitchesAt(idx, 0, POWER_MINUTES_PER_DAY));
+}
+
+void test_schedule_index_edge_cases() {
+  PowerRelaySchedule s{};
+  PowerScheduleIndex idx{};
+  PowerScheduleTransition next{};
+  buildScheduleIndex(s, idx);
+  assert(idx.count == 0);
+  assert(scheduleStateAt(idx, 0, 0) == -1);
+  assert(!scheduleNextTransition(idx, 0, 0, next));
+
+  s.count = 2;
+  s.rules[0] = PowerScheduleRule{8, 0, 1, 0x7F};
+  s.rules[1] = PowerScheduleRule{20, 0, 1, 0x7F};
+  buildScheduleIndex(s, idx);
+  assert(idx.count == 1);
+  assert(scheduleStateAt(idx, 3, 600) == 1);
+  assert(!scheduleNextTransition(idx, 3, 600, next));
+
+  s.count = POWER_MAX_SCHEDULE_RULES;
+  for (uint8_t i = 0; i < s.count; i++) s.rules[i] = PowerScheduleRule{(uint8_t)(i * 2), 0, (uint8_t)(i & 1), 0x7F};
+  buildScheduleIndex(s, idx);
+  assert(idx.count == POWER_MAX_TRANSITIONS);
+  assert(scheduleStateAt(idx, 6, 1439) == 1);
+  assert(scheduleStateAt(idx, 7, 0) == -1);
+}
+
 int main() {
   test_validation();
   test_json_to_packet();
   test_ack_and_executed_structs();
   test_retained_payload_shape();
+  test_view_codec_matches_string_api();
+  test_codec_matches_legacy_on_generated_inputs();
+  test_bulk_parse();
+  test_json_writer_exact_size();
+  test_binary_store_roundtrip();
+  test_binary_store_rejects_bad_records();
+  test_schedule_index_matches_replay();
+  test_schedule_index_edge_cases();
+  test_multi_rules_packet_roundtrip();
+  test_multi_rules_packet_rejects_bad_frames();
+  test_schedule_delta_roundtrip();
+  test_schedule_delta_is_small_for_small_changes();
+  test_schedule_delta_rejects_bad_input();
   std::cout << "All schedule tests passed\n";
   return 0;
 }
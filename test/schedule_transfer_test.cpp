@@ -0,0 +1,321 @@
+// Built against the wide configuration (8 relays, 240 rules; see
+// CMakeLists.txt): the fragment codec and reassembly with tables of hundreds
+// of rules, and fragmented transfers through PowerMaster end to end.
+
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "power_master.h"
+#include "sim_hal.h"
+
+static_assert(POWER_RELAY_COUNT == 8 && POWER_MAX_SCHEDULE_RULES == 240, "built with the wide configuration");
+
+static const uint8_t MAC_A[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+
+typedef PowerRelayScheduleT<600> BigSchedule;
+
+template <uint16_t N>
+void fillRandom(PowerRelayScheduleT<N> &s, uint16_t count, std::mt19937 &rng) {
+  s.count = count;
+  for (uint16_t i = 0; i < count; i++) {
+    s.rules[i] = PowerScheduleRule{(uint8_t)(rng() % 24), (uint8_t)(rng() % 60), (uint8_t)(rng() % 2),
+                                   (uint8_t)(1 + rng() % 127)};
+  }
+}
+
+std::vector<std::vector<uint8_t>> fragmentsOf(uint8_t relay, uint8_t xfer, const BigSchedule &s) {
+  std::vector<std::vector<uint8_t>> out;
+  uint8_t total = ruleFragmentCount(s.count);
+  for (uint8_t i = 0; i < total; i++) {
+    std::vector<uint8_t> frame(POWER_RADIO_FRAME_MAX + 1);
+    size_t n = encodeRuleFragment(relay, xfer, s.rules, s.count, i, 1000 + i, frame.data(), frame.size());
+    assert(n > 0 && n <= POWER_RADIO_FRAME_MAX);
+    frame.resize(n);
+    out.push_back(frame);
+  }
+  return out;
+}
+
+void test_json_with_hundreds_of_rules() {
+  std::mt19937 rng(5);
+  BigSchedule s{};
+  fillRandom(s, 500, rng);
+  std::string json = scheduleToJson(s);
+  BigSchedule back{};
+  std::string err;
+  assert(parseScheduleJson(json, back, err));
+  assert(back.count == 500 && schedulesEqual(s, back));
+
+  PowerRelayScheduleT<100> small{};
+  assert(!parseScheduleJson(json, small, err) && err == "Too many rules");
+  PowerRelaySchedule configured{};
+  assert(!parseScheduleJson(json, configured, err) && err == "Too many rules (max 240)");
+  assert(parseScheduleJson(scheduleToJson(small), configured, err));
+}
+
+void test_fragments_reassemble_in_any_order() {
+  assert(ruleFragmentCount(0) == 1);
+  assert(ruleFragmentCount(POWER_FRAGMENT_RULES) == 1);
+  assert(ruleFragmentCount(POWER_FRAGMENT_RULES + 1) == 2);
+  assert(ruleFragmentCount(POWER_FRAGMENT_RULES * POWER_FRAGMENT_MAX) == POWER_FRAGMENT_MAX);
+  assert(ruleFragmentCount(POWER_FRAGMENT_RULES * POWER_FRAGMENT_MAX + 1) == 0);
+
+  std::mt19937 rng(11);
+  const uint16_t sizes[] = {0, 1, 77, 78, 79, 240, 311, 600};
+  for (uint16_t count : sizes) {
+    BigSchedule s{};
+    fillRandom(s, count, rng);
+    std::vector<std::vector<uint8_t>> frames = fragmentsOf(3, 9, s);
+    assert(frames.size() == ruleFragmentCount(count));
+
+    // Shuffled, with every fragment delivered twice.
+    std::vector<size_t> order;
+    for (size_t i = 0; i < frames.size(); i++) order.push_back(i), order.push_back(i);
+    std::shuffle(order.begin(), order.end(), rng);
+    PowerRuleReassembler<600> r;
+    std::vector<bool> seen(frames.size(), false);
+    size_t distinct = 0;
+    for (size_t k : order) {
+      PowerRuleFragment f;
+      assert(decodeRuleFragment(frames[k].data(), frames[k].size(), f));
+      assert(f.relay == 3 && f.xfer == 9 && f.ruleCount == count && f.index == k);
+      if (!seen[k]) distinct++;
+      seen[k] = true;
+      uint8_t ok = r.accept(f);
+      assert(ok == (distinct == frames.size() ? 1 : POWER_ACK_INCOMPLETE));
+    }
+    assert(schedulesEqual(r.table(), s));
+  }
+}
+
+void test_reassembly_restarts_and_rejects() {
+  std::mt19937 rng(17);
+  BigSchedule a{}, b{};
+  fillRandom(a, 300, rng);
+  fillRandom(b, 300, rng);
+  std::vector<std::vector<uint8_t>> fa = fragmentsOf(1, 1, a), fb = fragmentsOf(1, 2, b);
+  PowerRuleReassembler<600> r;
+  PowerRuleFragment f;
+
+  // Half of table a, then table b under a new transfer: only b's fragments count.
+  for (size_t i = 0; i < 2; i++) {
+    assert(decodeRuleFragment(fa[i].data(), fa[i].size(), f));
+    assert(r.accept(f) == POWER_ACK_INCOMPLETE);
+  }
+  assert(r.received() == 0x3);
+  for (size_t i = 0; i < fb.size(); i++) {
+    assert(decodeRuleFragment(fb[i].data(), fb[i].size(), f));
+    assert(r.accept(f) == (i + 1 == fb.size() ? 1 : POWER_ACK_INCOMPLETE));
+  }
+  assert(r.transfer() == 2 && schedulesEqual(r.table(), b));
+
+  // A table larger than the receiver is refused outright.
+  PowerRuleReassembler<240> small;
+  assert(decodeRuleFragment(fa[0].data(), fa[0].size(), f));
+  assert(small.accept(f) == 0 && small.received() == 0);
+
+  // A fragment altered in flight (valid rules, wrong table) fails the hash.
+  std::vector<uint8_t> bad = fa[2];
+  bad[POWER_FRAGMENT_HEADER + 2] ^= 0x01;
+  PowerRuleReassembler<600> r2;
+  for (size_t i = 0; i < fa.size(); i++) {
+    const std::vector<uint8_t> &frame = i == 2 ? bad : fa[i];
+    assert(decodeRuleFragment(frame.data(), frame.size(), f));
+    assert(r2.accept(f) == (i + 1 == fa.size() ? 0 : POWER_ACK_INCOMPLETE));
+  }
+  assert(r2.received() == 0);
+
+  // Malformed frames.
+  std::vector<uint8_t> m = fa[0];
+  assert(!decodeRuleFragment(m.data(), m.size() - 1, f));
+  m[4]++; // total disagrees with the rule count
+  assert(!decodeRuleFragment(m.data(), m.size(), f));
+  m = fa[3];
+  m[3] = 4; // index past the last fragment
+  assert(!decodeRuleFragment(m.data(), m.size(), f));
+  m = fa[0];
+  m[1] = POWER_RELAY_COUNT + 1;
+  assert(!decodeRuleFragment(m.data(), m.size(), f));
+  m = fa[0];
+  m[POWER_FRAGMENT_HEADER] = 0xA0;
+  m[POWER_FRAGMENT_HEADER + 1] = 0x05; // minute 1440
+  assert(!decodeRuleFragment(m.data(), m.size(), f));
+}
+
+// ---- PowerMaster -------------------------------------------------------------
+
+PowerRelaySchedule randomSchedule(uint16_t count, uint32_t seed) {
+  std::mt19937 rng(seed);
+  PowerRelaySchedule s{};
+  fillRandom(s, count, rng);
+  return s;
+}
+
+void test_master_fragments_long_tables() {
+  SimTempDir dir;
+  PowerRelaySchedule big = randomSchedule(POWER_MAX_SCHEDULE_RULES, 1);
+  PowerRelaySchedule small = randomSchedule(4, 2);
+  {
+    SimRig rig(dir.path());
+    rig.net.addSlave(MAC_A, 0xFF);
+    rig.run(100);
+
+    // Relay 7 needs four fragments; relays 1 and 2 still share one type-17 frame.
+    rig.set(7, big);
+    rig.set(1, small);
+    rig.set(2, small);
+    rig.run(300);
+    assert(rig.outcome(7) == "OK" && rig.outcome(1) == "OK" && rig.outcome(2) == "OK");
+    assert(rig.net.stats().byType[POWER_FRAGMENT_TYPE] == 4);
+    assert(rig.net.stats().byType[POWER_MULTI_RULES_TYPE] == 1);
+    assert(schedulesEqual(rig.net.slave(0).tables[6], big));
+    assert(schedulesEqual(rig.master.activeSchedule(7), big));
+    std::string current;
+    assert(rig.broker.retained("progetto/EVE/POWER/relay/7/schedule/current", current) && current == scheduleToJson(big));
+
+    // Shrinking back under the type-14 limit goes back to the small frames.
+    rig.set(7, small);
+    rig.run(300);
+    assert(rig.outcome(7) == "OK" && rig.net.stats().byType[POWER_FRAGMENT_TYPE] == 4);
+    rig.set(7, big);
+    rig.run(300);
+    assert(rig.outcome(7) == "OK" && rig.net.stats().byType[POWER_FRAGMENT_TYPE] == 8);
+    rig.run(SCHEDULE_PERSIST_DELAY_MS);
+  }
+  SimRig again(dir.path());
+  assert(schedulesEqual(again.master.activeSchedule(7), big));
+  assert(schedulesEqual(again.master.activeSchedule(2), small));
+}
+
+void test_legacy_slave_times_out() {
+  SimTempDir dir;
+  SimRig rig(dir.path());
+  rig.net.addSlave(MAC_A, 0x01).fragmentRules = false;
+  rig.run(100);
+  rig.set(1, randomSchedule(30, 3));
+  rig.run(60000);
+  assert(rig.outcome(1) == "ERROR");
+  assert(rig.net.stats().byType[POWER_FRAGMENT_TYPE] == 1u + SCHEDULE_RETRY_BUDGET);
+  assert(rig.master.activeSchedule(1).count == 0);
+}
+
+void test_lossy_link_converges_with_long_tables() {
+  SimLinkConfig link;
+  link.lossPct = 20;
+  link.latencyMinMs = 1;
+  link.latencyMaxMs = 20;
+  SimTempDir dir;
+  SimRig rig(dir.path(), link);
+  rig.net.addSlave(MAC_A, 0xFF);
+  rig.run(3000);
+
+  uint32_t ok = 0;
+  for (uint32_t round = 0; round < 20; round++) {
+    rig.acks.clear();
+    for (uint8_t r = 1; r <= 3; r++) rig.set(r, randomSchedule((uint16_t)(80 + (round * 7 + r * 13) % 160), round * 8 + r));
+    for (int waited = 0; waited < 120 && (rig.outcome(1).empty() || rig.outcome(2).empty() || rig.outcome(3).empty());
+         waited++) {
+      rig.run(500);
+    }
+    for (uint8_t r = 1; r <= 3; r++) {
+      assert(rig.outcome(r) == "OK" || rig.outcome(r) == "ERROR");
+      if (rig.outcome(r) != "OK") continue;
+      ok++;
+      assert(schedulesEqual(rig.net.slave(0).tables[r - 1], rig.master.activeSchedule(r)));
+    }
+  }
+  assert(ok > 50);
+  assert(rig.net.stats().lost > 0);
+}
+
+// Records what the master puts on air; the test plays the slave by hand.
+struct CaptureRadio : RadioHal {
+  std::vector<std::vector<uint8_t>> frames;
+  bool send(const uint8_t *, const uint8_t *data, size_t len) override {
+    frames.push_back(std::vector<uint8_t>(data, data + len));
+    return true;
+  }
+  bool addPeer(const uint8_t *) override { return true; }
+  void removePeer(const uint8_t *) override {}
+};
+
+void test_retry_resends_only_missing_fragments() {
+  SimClock clock(5);
+  SimBroker broker;
+  SimTempDir dir;
+  FileKvStore store(dir.path());
+  CaptureRadio radio;
+  EventScheduler timers;
+  PowerMaster master(radio, broker, store, clock, timers, 1);
+  master.begin();
+  master.onMqttConnected();
+
+  TelemetryPacket hello{};
+  master.onRadioFrame(MAC_A, (const uint8_t *)&hello, sizeof(hello), clock.millis()); // registers the peer
+
+  PowerRelaySchedule s = randomSchedule(200, 7); // 3 fragments
+  std::string json = scheduleToJson(s);
+  assert(master.onMqttMessage("progetto/EVE/POWER/relay/4/schedule/set", (const uint8_t *)json.data(), json.size()));
+  radio.frames.clear();
+  for (int i = 0; i < 100; i++) {
+    clock.advance(1);
+    timers.run(clock.millis());
+  }
+  std::vector<std::vector<uint8_t>> sent;
+  for (const std::vector<uint8_t> &f : radio.frames) {
+    if (f[0] == POWER_FRAGMENT_TYPE) sent.push_back(f);
+  }
+  assert(sent.size() == 3);
+
+  // Fragment 1 is lost; the slave acknowledges 0 and 2 as they arrive.
+  PowerRuleReassembler<POWER_MAX_SCHEDULE_RULES> slave;
+  PowerRuleFragment f;
+  for (size_t i : {0, 2}) {
+    assert(decodeRuleFragment(sent[i].data(), sent[i].size(), f));
+    PowerFragmentAckPacket ack{POWER_FRAGMENT_ACK_TYPE, 4, f.xfer, slave.accept(f), slave.received(), clock.millis()};
+    assert(ack.ok == POWER_ACK_INCOMPLETE);
+    master.onRadioFrame(MAC_A, (const uint8_t *)&ack, sizeof(ack), clock.millis());
+  }
+
+  radio.frames.clear();
+  for (int i = 0; i < 10000 && radio.frames.empty(); i++) {
+    clock.advance(1);
+    timers.run(clock.millis());
+  }
+  assert(radio.frames.size() == 1);
+  assert(decodeRuleFragment(radio.frames[0].data(), radio.frames[0].size(), f) && f.index == 1);
+  PowerFragmentAckPacket ack{POWER_FRAGMENT_ACK_TYPE, 4, f.xfer, slave.accept(f), slave.received(), clock.millis()};
+  assert(ack.ok == 1 && schedulesEqual(slave.table(), s));
+  master.onRadioFrame(MAC_A, (const uint8_t *)&ack, sizeof(ack), clock.millis());
+  assert(!master.awaitingAck(4));
+  assert(schedulesEqual(master.activeSchedule(4), s));
+
+  // An ACK for an older transfer does not touch a newer one.
+  PowerRelaySchedule next = randomSchedule(100, 8);
+  json = scheduleToJson(next);
+  assert(master.onMqttMessage("progetto/EVE/POWER/relay/4/schedule/set", (const uint8_t *)json.data(), json.size()));
+  for (int i = 0; i < 100; i++) {
+    clock.advance(1);
+    timers.run(clock.millis());
+  }
+  assert(master.awaitingAck(4));
+  master.onRadioFrame(MAC_A, (const uint8_t *)&ack, sizeof(ack), clock.millis());
+  assert(master.awaitingAck(4));
+}
+
+int main() {
+  test_json_with_hundreds_of_rules();
+  test_fragments_reassemble_in_any_order();
+  test_reassembly_restarts_and_rejects();
+  test_master_fragments_long_tables();
+  test_legacy_slave_times_out();
+  test_lossy_link_converges_with_long_tables();
+  test_retry_resends_only_missing_fragments();
+  std::cout << "schedule_transfer_test: all passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,424 @@
+#include "sim_hal.h"
+
+#include <assert.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+namespace {
+
+uint32_t xorshift(uint32_t &s) {
+  s ^= s << 13;
+  s ^= s >> 17;
+  s ^= s << 5;
+  return s;
+}
+
+std::vector<uint8_t> macKey(const uint8_t mac[6]) { return std::vector<uint8_t>(mac, mac + 6); }
+
+int removeEntry(const char *path, const struct stat *, int, struct FTW *) { return remove(path); }
+
+} // namespace
+
+// ---- SimClock ----------------------------------------------------------------
+
+uint32_t SimClock::random() { return xorshift(rng_); }
+
+bool SimClock::localWeekTime(uint8_t &weekdayMon0, uint16_t &minuteOfDay) {
+  if (weekMinuteAtZero_ < 0) return false;
+  uint32_t m = ((uint32_t)weekMinuteAtZero_ + nowMs_ / 60000) % POWER_MINUTES_PER_WEEK;
+  weekdayMon0 = (uint8_t)(m / POWER_MINUTES_PER_DAY);
+  minuteOfDay = (uint16_t)(m % POWER_MINUTES_PER_DAY);
+  return true;
+}
+
+bool SimClock::wallClock(uint32_t &epochSec, uint16_t &ms, int16_t &utcOffsetMin) {
+  if (weekMinuteAtZero_ < 0) return false;
+  epochSec = SIM_EPOCH_MONDAY + (uint32_t)weekMinuteAtZero_ * 60 + nowMs_ / 1000;
+  ms = (uint16_t)(nowMs_ % 1000);
+  utcOffsetMin = 0;
+  return true;
+}
+
+// ---- SimBroker ---------------------------------------------------------------
+
+bool SimBroker::publish(const char *topic, const uint8_t *payload, size_t len, bool retained) {
+  if (!connected_) return false;
+  publishes_++;
+  std::string value((const char *)payload, len);
+  if (retained) retained_[topic] = value;
+  if (listener_ != nullptr) listener_(listenerCtx_, topic, value, retained);
+  if (subscribed(topic)) inbound_.push_back(std::make_pair(std::string(topic), value));
+  return true;
+}
+
+bool SimBroker::subscribe(const char *topic) {
+  if (!connected_) return false;
+  subscriptions_.insert(topic);
+  for (std::map<std::string, std::string>::const_iterator it = retained_.begin(); it != retained_.end(); ++it) {
+    if (filterMatches(topic, it->first)) inbound_.push_back(*it);
+  }
+  return true;
+}
+
+bool SimBroker::unsubscribe(const char *topic) {
+  if (!connected_) return false;
+  subscriptions_.erase(topic);
+  return true;
+}
+
+void SimBroker::setConnected(bool connected) {
+  if (!connected) {
+    subscriptions_.clear();
+    inbound_.clear();
+  }
+  connected_ = connected;
+}
+
+void SimBroker::step(PowerMaster &master) {
+  while (connected_ && !inbound_.empty()) {
+    std::pair<std::string, std::string> m = inbound_.front();
+    inbound_.pop_front();
+    master.onMqttMessage(m.first.c_str(), (const uint8_t *)m.second.data(), m.second.size());
+  }
+}
+
+bool SimBroker::subscribed(const std::string &topic) const {
+  for (std::set<std::string>::const_iterator it = subscriptions_.begin(); it != subscriptions_.end(); ++it) {
+    if (filterMatches(*it, topic)) return true;
+  }
+  return false;
+}
+
+bool SimBroker::filterMatches(const std::string &filter, const std::string &topic) {
+  size_t f = 0, t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') return true;
+    size_t fEnd = filter.find('/', f);
+    size_t tEnd = topic.find('/', t);
+    if (fEnd == std::string::npos) fEnd = filter.size();
+    if (tEnd == std::string::npos) tEnd = topic.size();
+    if (t > topic.size()) return false;
+    if (!(fEnd - f == 1 && filter[f] == '+') && filter.compare(f, fEnd - f, topic, t, tEnd - t) != 0) return false;
+    f = fEnd + 1;
+    t = tEnd + 1;
+  }
+  return t > topic.size();
+}
+
+bool SimBroker::retained(const std::string &topic, std::string &payload) const {
+  std::map<std::string, std::string>::const_iterator it = retained_.find(topic);
+  if (it == retained_.end()) return false;
+  payload = it->second;
+  return true;
+}
+
+// ---- FileKvStore -------------------------------------------------------------
+
+FileKvStore::FileKvStore(const std::string &dir) : dir_(dir), writes_(0) { mkdir(dir_.c_str(), 0755); }
+
+bool FileKvStore::read(const char *key, std::string &out) {
+  FILE *f = fopen(path(key).c_str(), "rb");
+  if (f == nullptr) return false;
+  out.clear();
+  char buf[512];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.append(buf, n);
+  fclose(f);
+  return true;
+}
+
+bool FileKvStore::hasKey(const char *key) {
+  struct stat st;
+  return stat(path(key).c_str(), &st) == 0;
+}
+
+size_t FileKvStore::getBytes(const char *key, uint8_t *buf, size_t cap) {
+  std::string v;
+  if (!read(key, v) || v.size() > cap) return 0;
+  memcpy(buf, v.data(), v.size());
+  return v.size();
+}
+
+size_t FileKvStore::putBytes(const char *key, const uint8_t *data, size_t len) {
+  std::string tmp = path(key) + ".tmp";
+  FILE *f = fopen(tmp.c_str(), "wb");
+  if (f == nullptr) return 0;
+  bool ok = fwrite(data, 1, len, f) == len;
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path(key).c_str()) != 0) return 0;
+  writes_++;
+  return len;
+}
+
+size_t FileKvStore::getString(const char *key, char *buf, size_t cap) {
+  std::string v;
+  if (!read(key, v) || v.size() + 1 > cap) return 0;
+  memcpy(buf, v.c_str(), v.size() + 1);
+  return v.size() + 1;
+}
+
+// ---- SimRadioNet -------------------------------------------------------------
+
+SimRadioNet::SimRadioNet(SimClock &clock, const SimLinkConfig &link, uint32_t seed)
+    : clock_(clock), link_(link), rng_(seed ? seed : 1), seq_(0) {
+  memset(&stats_, 0, sizeof(stats_));
+}
+
+uint32_t SimRadioNet::latency() {
+  uint32_t span = link_.latencyMaxMs > link_.latencyMinMs ? link_.latencyMaxMs - link_.latencyMinMs + 1 : 1;
+  return link_.latencyMinMs + xorshift(rng_) % span;
+}
+
+bool SimRadioNet::lost() {
+  if (link_.lossPct == 0 || xorshift(rng_) % 100 >= link_.lossPct) return false;
+  stats_.lost++;
+  return true;
+}
+
+int16_t SimRadioNet::findSlave(const uint8_t mac[6]) const {
+  for (size_t i = 0; i < slaves_.size(); i++) if (memcmp(slaves_[i].mac, mac, 6) == 0) return (int16_t)i;
+  return -1;
+}
+
+void SimRadioNet::push(uint8_t kind, int16_t slave, const uint8_t mac[6], const uint8_t *data, size_t len, bool ok) {
+  Frame f;
+  f.at = clock_.millis() + latency();
+  f.seq = seq_++;
+  f.kind = kind;
+  f.slave = slave;
+  f.ok = ok;
+  memcpy(f.mac, mac, 6);
+  if (len > 0) f.data.assign(data, data + len);
+  queue_.push(f);
+}
+
+SimSlave &SimRadioNet::addSlave(const uint8_t mac[6], uint8_t relayMask) {
+  slaves_.push_back(SimSlave());
+  SimSlave &s = slaves_.back();
+  memcpy(s.mac, mac, 6);
+  s.relayMask = relayMask;
+  // Spread first telemetry so slaves do not all announce on the same tick.
+  s.lastTelemetryMs = clock_.millis() - link_.telemetryMs + (uint32_t)slaves_.size();
+  return s;
+}
+
+bool SimRadioNet::addPeer(const uint8_t mac[6]) {
+  peers_.insert(macKey(mac));
+  return true;
+}
+
+void SimRadioNet::removePeer(const uint8_t mac[6]) { peers_.erase(macKey(mac)); }
+
+// Like ESP-NOW: unicast needs a registered peer; a unicast lost on air comes
+// back as a failed delivery report, broadcast has no report.
+bool SimRadioNet::send(const uint8_t mac[6], const uint8_t *data, size_t len) {
+  bool broadcast = memcmp(mac, POWER_BCAST_MAC, 6) == 0;
+  if (!broadcast && peers_.count(macKey(mac)) == 0) {
+    stats_.sendFailures++;
+    return false;
+  }
+  stats_.sent++;
+  if (len > 0 && data[0] < 32) stats_.byType[data[0]]++;
+  if (broadcast) {
+    for (size_t i = 0; i < slaves_.size(); i++) {
+      if (!lost()) push(TO_SLAVE, (int16_t)i, slaves_[i].mac, data, len, true);
+    }
+    return true;
+  }
+  int16_t target = findSlave(mac);
+  bool delivered = !lost();
+  if (target >= 0 && len > 0 && data[0] < 32 && (slaves_[target].failTypes & (1u << data[0]))) delivered = false;
+  if (delivered && target >= 0) push(TO_SLAVE, target, mac, data, len, true);
+  push(TX_REPORT, -1, mac, nullptr, 0, delivered && target >= 0);
+  return true;
+}
+
+void SimRadioNet::fromSlave(int16_t slave, const uint8_t *data, size_t len) {
+  if (!lost()) push(TO_MASTER, slave, slaves_[slave].mac, data, len, true);
+}
+
+void SimRadioNet::deliverToSlave(int16_t idx, const std::vector<uint8_t> &data) {
+  SimSlave &s = slaves_[idx];
+  s.framesReceived++;
+  if (data.empty()) return;
+  uint8_t type = data[0];
+
+  if (const PowerRelayRulesPacket *rules = packetAs<PowerRelayRulesPacket>(data.data(), data.size())) {
+    const PowerRelayRulesPacket &pkt = *rules;
+    if (pkt.ch < 1 || pkt.ch > POWER_RELAY_COUNT || !(s.relayMask & (1u << (pkt.ch - 1)))) return;
+    PowerScheduleAckPacket ack{POWER_ACK_TYPE, pkt.ch, 0, pkt.count, clock_.millis()};
+    if (pkt.count <= POWER_RULES_PACKET_MAX) {
+      PowerRelaySchedule &t = s.tables[pkt.ch - 1];
+      t.count = pkt.count;
+      memcpy(t.rules, pkt.rules, sizeof(pkt.rules));
+      ack.ok = 1;
+    }
+    fromSlave(idx, (const uint8_t *)&ack, sizeof(ack));
+  } else if (type == POWER_MULTI_RULES_TYPE && s.multiRules) {
+    PowerRelaySchedule decoded[POWER_RELAY_COUNT];
+    uint8_t mask = 0, xfer = 0;
+    uint32_t ms = 0;
+    bool ok = decodeMultiRulesPacket(data.data(), data.size(), mask, xfer, decoded, ms);
+    uint8_t mine = mask & s.relayMask;
+    if (mine == 0) return;
+    if (ok) {
+      for (uint8_t r = 0; r < POWER_RELAY_COUNT; r++) if (mine & (1u << r)) s.tables[r] = decoded[r];
+    }
+    PowerMultiScheduleAckPacket ack{POWER_MULTI_ACK_TYPE, mine, ok ? mine : (uint8_t)0, xfer, clock_.millis()};
+    fromSlave(idx, (const uint8_t *)&ack, sizeof(ack));
+  } else if (type == POWER_DELTA_RULES_TYPE && s.deltaRules) {
+    uint8_t relay = 0;
+    uint32_t baseHash = 0, targetHash = 0, ms = 0;
+    PowerScheduleDelta delta;
+    if (!decodeDeltaPacket(data.data(), data.size(), relay, baseHash, targetHash, delta, ms)) return;
+    if (!(s.relayMask & (1u << (relay - 1)))) return;
+    PowerRelaySchedule &t = s.tables[relay - 1];
+    PowerRelaySchedule next;
+    PowerScheduleAckPacket ack{15, relay, POWER_ACK_BASE_MISMATCH, (uint8_t)t.count, clock_.millis()};
+    if (scheduleHash(t) == baseHash && applyScheduleDelta(t, delta, next) && scheduleHash(next) == targetHash) {
+      t = next;
+      ack.ok = 1;
+      ack.count = (uint8_t)t.count;
+    }
+    fromSlave(idx, (const uint8_t *)&ack, sizeof(ack));
+  } else if (type == POWER_FRAGMENT_TYPE && s.fragmentRules) {
+    PowerRuleFragment frag;
+    if (!decodeRuleFragment(data.data(), data.size(), frag)) return;
+    if (!(s.relayMask & (1u << (frag.relay - 1)))) return;
+    PowerRuleReassembler<POWER_MAX_SCHEDULE_RULES> &r = s.reassembly[frag.relay - 1];
+    uint8_t ok = r.accept(frag);
+    if (ok == 1) s.tables[frag.relay - 1] = r.table();
+    PowerFragmentAckPacket ack{POWER_FRAGMENT_ACK_TYPE, frag.relay, frag.xfer, ok, r.received(), clock_.millis()};
+    fromSlave(idx, (const uint8_t *)&ack, sizeof(ack));
+  } else if (const TimeSyncResponsePacket *sync = packetAs<TimeSyncResponsePacket>(data.data(), data.size())) {
+    const TimeSyncResponsePacket &resp = *sync;
+    if (resp.seq == 0 || resp.seq != s.syncSeq || resp.t1 != s.syncT1) return; // broadcast or stale
+    uint32_t t4 = s.localMs(clock_.millis());
+    if (!s.sync.sample(resp.t1, resp.t2, resp.t3, t4)) return;
+    s.syncPrevT1 = resp.t1;
+    s.syncPrevT4 = t4;
+    if (resp.valid) {
+      s.wallKnown = true;
+      s.wallAtT3Ms = (uint64_t)resp.epochSec * 1000 + resp.epochMs;
+      s.wallT3 = resp.t3;
+    }
+  }
+}
+
+uint32_t SimRadioNet::msUntilNext() const {
+  uint32_t now = clock_.millis();
+  uint32_t best = 0xFFFFFFFFu;
+  if (!queue_.empty()) {
+    int32_t d = (int32_t)(queue_.top().at - now);
+    best = d > 0 ? (uint32_t)d : 0;
+  }
+  if (link_.timeSyncMs > 0) {
+    for (size_t i = 0; i < slaves_.size(); i++) {
+      uint32_t elapsed = now - slaves_[i].lastSyncMs;
+      uint32_t d = elapsed >= link_.timeSyncMs ? 0 : link_.timeSyncMs - elapsed;
+      if (d < best) best = d;
+    }
+  }
+  if (link_.telemetryMs > 0) {
+    for (size_t i = 0; i < slaves_.size(); i++) {
+      uint32_t elapsed = now - slaves_[i].lastTelemetryMs;
+      uint32_t d = elapsed >= link_.telemetryMs ? 0 : link_.telemetryMs - elapsed;
+      if (d < best) best = d;
+    }
+  }
+  return best;
+}
+
+void SimRadioNet::step(PowerMaster &master) {
+  uint32_t now = clock_.millis();
+  if (link_.telemetryMs > 0) {
+    for (size_t i = 0; i < slaves_.size(); i++) {
+      SimSlave &s = slaves_[i];
+      if (now - s.lastTelemetryMs < link_.telemetryMs) continue;
+      s.lastTelemetryMs = now;
+      TelemetryPacket p{};
+      p.t = 21.5f;
+      p.h = 40.0f;
+      p.soil = 30;
+      p.batt = 90;
+      p.ms = now;
+      fromSlave((int16_t)i, (const uint8_t *)&p, sizeof(p));
+    }
+  }
+  if (link_.timeSyncMs > 0) {
+    for (size_t i = 0; i < slaves_.size(); i++) {
+      SimSlave &s = slaves_[i];
+      if (now - s.lastSyncMs < link_.timeSyncMs) continue;
+      s.lastSyncMs = now;
+      s.syncSeq = (uint8_t)(s.syncSeq == 255 ? 1 : s.syncSeq + 1);
+      s.syncT1 = s.localMs(now);
+      TimeSyncRequestPacket req{TIME_SYNC_REQUEST_TYPE, s.syncSeq, {0, 0}, s.syncT1, s.syncPrevT1, s.syncPrevT4};
+      fromSlave((int16_t)i, (const uint8_t *)&req, sizeof(req));
+    }
+  }
+
+  while (!queue_.empty() && (int32_t)(now - queue_.top().at) >= 0) {
+    Frame f = queue_.top();
+    queue_.pop();
+    if (f.kind == TO_SLAVE) deliverToSlave(f.slave, f.data);
+    else if (f.kind == TO_MASTER) master.onRadioFrame(f.mac, f.data.data(), f.data.size(), now);
+    else master.onRadioSent(f.mac, f.ok, now);
+  }
+}
+
+// ---- SimRig ------------------------------------------------------------------
+
+SimRig::SimRig(const std::string &dir, const SimLinkConfig &link)
+    : clock(3), store(dir), net(clock, link), master(net, broker, store, clock, timers, 1), listener_(nullptr),
+      listenerCtx_(nullptr) {
+  broker.setListener(onPublish, this);
+  master.begin();
+  master.onMqttConnected();
+}
+
+void SimRig::onPublish(void *ctx, const std::string &topic, const std::string &payload, bool retained) {
+  SimRig *self = static_cast<SimRig *>(ctx);
+  if (topic.find("/schedule/slave/ack") != std::string::npos) self->acks.push_back({topic, payload});
+  if (self->listener_) self->listener_(self->listenerCtx_, topic, payload, retained);
+}
+
+void SimRig::run(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    clock.advance(1);
+    net.step(master);
+    broker.step(master);
+    timers.run(clock.millis());
+    master.drainOutbox(32);
+  }
+}
+
+void SimRig::set(uint8_t relay, const PowerRelaySchedule &s) {
+  std::string json = scheduleToJson(s);
+  std::string topic = "progetto/EVE/POWER/relay/" + std::to_string(relay) + "/schedule/set";
+  // Not inside assert(): eve_sim may be built with NDEBUG.
+  bool routed = master.onMqttMessage(topic.c_str(), (const uint8_t *)json.data(), json.size());
+  assert(routed);
+  (void)routed;
+}
+
+std::string SimRig::outcome(uint8_t relay) const {
+  std::string topic = "progetto/EVE/POWER/relay/" + std::to_string(relay) + "/schedule/slave/ack";
+  for (size_t i = acks.size(); i-- > 0;) {
+    if (acks[i].topic != topic) continue;
+    return acks[i].payload == "PENDING" ? "" : acks[i].payload;
+  }
+  return "";
+}
+
+// ---- SimTempDir --------------------------------------------------------------
+
+SimTempDir::SimTempDir() {
+  char tmpl[] = "/tmp/eve_sim_XXXXXX";
+  if (mkdtemp(tmpl) == nullptr) abort();
+  path_ = tmpl;
+}
+
+SimTempDir::~SimTempDir() { nftw(path_.c_str(), removeEntry, 8, FTW_DEPTH | FTW_PHYS); }
@@ -0,0 +1,261 @@
+#pragma once
+
+// Host implementations of the PowerMaster HAL (power_hal.h): a virtual clock,
+// an in-process broker stand-in, a file-backed key-value store and an ESP-NOW
+// network of simulated slaves with configurable loss and latency. Everything
+// runs on the caller's thread; time only moves when the driver advances it.
+
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <map>
+#include <queue>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "event_scheduler.h"
+#include "power_hal.h"
+#include "power_master.h"
+#include "power_schedule_core.h"
+#include "time_sync.h"
+
+// 2024-01-01 00:00 UTC, a Monday: SimClock's week minute 0.
+static const uint32_t SIM_EPOCH_MONDAY = 1704067200;
+
+class SimClock : public ClockHal {
+public:
+  explicit SimClock(uint32_t seed = 1) : nowMs_(0), rng_(seed ? seed : 1), weekMinuteAtZero_(-1) {}
+
+  uint32_t millis() override { return nowMs_; }
+  uint32_t random() override;
+  bool localWeekTime(uint8_t &weekdayMon0, uint16_t &minuteOfDay) override;
+  // UTC, with the week minute counted from Monday 2024-01-01 00:00.
+  bool wallClock(uint32_t &epochSec, uint16_t &ms, int16_t &utcOffsetMin) override;
+
+  void advance(uint32_t ms) { nowMs_ += ms; }
+  // Minute of the week at millis() == 0; -1 leaves wall-clock time unknown.
+  void setWeekMinute(int32_t weekMinuteAtZero) { weekMinuteAtZero_ = weekMinuteAtZero; }
+
+private:
+  uint32_t nowMs_;
+  uint32_t rng_;
+  int32_t weekMinuteAtZero_;
+};
+
+typedef void (*SimBrokerListener)(void *ctx, const std::string &topic, const std::string &payload, bool retained);
+
+// Accepts everything while connected; keeps the retained value per topic and
+// reports every publish to the listener. Subscriptions are MQTT filters (+ and
+// #); messages for them (the retained ones on subscribe, then every matching
+// publish) wait until step() hands them to the master. Disconnecting drops
+// the subscriptions, like a clean session.
+class SimBroker : public MqttHal {
+public:
+  SimBroker() : connected_(true), publishes_(0), listener_(nullptr), listenerCtx_(nullptr) {}
+
+  bool connected() override { return connected_; }
+  bool publish(const char *topic, const uint8_t *payload, size_t len, bool retained) override;
+  bool subscribe(const char *topic) override;
+  bool unsubscribe(const char *topic) override;
+
+  void setConnected(bool connected);
+  void setListener(SimBrokerListener listener, void *ctx) { listener_ = listener; listenerCtx_ = ctx; }
+  // Delivers the queued inbound messages.
+  void step(PowerMaster &master);
+  bool retained(const std::string &topic, std::string &payload) const;
+  // A broker restart without persistence.
+  void clearRetained() { retained_.clear(); }
+  // True when a subscription covers topic.
+  bool subscribed(const std::string &topic) const;
+  size_t subscriptionCount() const { return subscriptions_.size(); }
+  uint32_t publishes() const { return publishes_; }
+
+  static bool filterMatches(const std::string &filter, const std::string &topic);
+
+private:
+  bool connected_;
+  uint32_t publishes_;
+  std::map<std::string, std::string> retained_;
+  std::set<std::string> subscriptions_;
+  std::deque<std::pair<std::string, std::string> > inbound_;
+  SimBrokerListener listener_;
+  void *listenerCtx_;
+};
+
+// One file per key under dir, replaced atomically on write.
+class FileKvStore : public KvStoreHal {
+public:
+  explicit FileKvStore(const std::string &dir);
+
+  bool hasKey(const char *key) override;
+  size_t getBytes(const char *key, uint8_t *buf, size_t cap) override;
+  size_t putBytes(const char *key, const uint8_t *data, size_t len) override;
+  size_t getString(const char *key, char *buf, size_t cap) override;
+
+  uint32_t writes() const { return writes_; }
+
+private:
+  std::string path(const char *key) const { return dir_ + "/" + key; }
+  bool read(const char *key, std::string &out);
+
+  std::string dir_;
+  uint32_t writes_;
+};
+
+struct SimLinkConfig {
+  uint8_t lossPct = 0;      // per frame and direction
+  uint32_t latencyMinMs = 2;
+  uint32_t latencyMaxMs = 6;
+  uint32_t telemetryMs = 2000; // slave telemetry period, 0 = silent
+  uint32_t timeSyncMs = 0;     // slave time-sync request period, 0 = never asks
+};
+
+// A slave as the master sees it: owns the relays in relayMask, applies type
+// 14/17/19/20 and answers type 15/18/21. Older firmware can be modelled by
+// turning off type-17, type-19 or type-20 support (those frames are then
+// ignored). Unicast frames whose type has its bit set in failTypes never reach
+// it and come back as failed delivery reports. Its clock runs driftPpm fast
+// and starts clockOffsetMs ahead of the master's; it syncs to the master with
+// type 22/23 when the link asks for it.
+struct SimSlave {
+  uint8_t mac[6];
+  uint8_t relayMask;
+  bool multiRules = true;
+  bool deltaRules = true;
+  bool fragmentRules = true;
+  uint32_t failTypes = 0;
+  PowerRelaySchedule tables[POWER_RELAY_COUNT] = {};
+  PowerRuleReassembler<POWER_MAX_SCHEDULE_RULES> reassembly[POWER_RELAY_COUNT];
+  uint32_t framesReceived = 0;
+  uint32_t lastTelemetryMs = 0;
+
+  int32_t clockOffsetMs = 0;
+  int32_t driftPpm = 0;
+  TimeSyncEstimator sync;   // master clock against this slave's
+  uint8_t syncSeq = 0;
+  uint32_t syncT1 = 0;      // outstanding request
+  uint32_t syncPrevT1 = 0;  // last answered exchange
+  uint32_t syncPrevT4 = 0;
+  uint32_t lastSyncMs = 0;  // master time of the last request
+  bool wallKnown = false;
+  uint64_t wallAtT3Ms = 0;  // UTC ms of the answer the estimate used last
+  uint32_t wallT3 = 0;
+
+  // The slave's millis() at master time masterMs.
+  uint32_t localMs(uint32_t masterMs) const {
+    return masterMs + (uint32_t)clockOffsetMs + (uint32_t)(int32_t)((int64_t)masterMs * driftPpm / 1000000);
+  }
+  // UTC ms the slave believes it is at its own time local, false until synced.
+  bool wallMs(uint32_t local, uint64_t &out) const {
+    if (!wallKnown || !sync.valid()) return false;
+    out = wallAtT3Ms + (uint64_t)(int64_t)(int32_t)(sync.toServer(local) - wallT3);
+    return true;
+  }
+};
+
+struct SimNetStats {
+  uint32_t sent;          // frames handed to the radio by the master
+  uint32_t lost;          // frames dropped in either direction
+  uint32_t sendFailures;  // send() refused (unknown peer)
+  uint32_t byType[32];    // master -> slave frames by type byte
+};
+
+class SimRadioNet : public RadioHal {
+public:
+  SimRadioNet(SimClock &clock, const SimLinkConfig &link, uint32_t seed = 7);
+
+  bool send(const uint8_t mac[6], const uint8_t *data, size_t len) override;
+  bool addPeer(const uint8_t mac[6]) override;
+  void removePeer(const uint8_t mac[6]) override;
+
+  SimSlave &addSlave(const uint8_t mac[6], uint8_t relayMask);
+  SimSlave &slave(size_t i) { return slaves_[i]; }
+  void setLink(const SimLinkConfig &link) { link_ = link; }
+  // Delivers everything due at the current time: frames to slaves (which may
+  // answer), frames and delivery reports to the master. Slaves also emit their
+  // periodic telemetry here.
+  void step(PowerMaster &master);
+  bool idle() const { return queue_.empty(); }
+  // Time until the next frame or telemetry is due, for drivers that jump the
+  // clock straight to the next event.
+  uint32_t msUntilNext() const;
+  const SimNetStats &stats() const { return stats_; }
+
+private:
+  enum Kind : uint8_t { TO_SLAVE, TO_MASTER, TX_REPORT };
+  struct Frame {
+    uint32_t at;
+    uint32_t seq;
+    uint8_t kind;
+    int16_t slave;
+    bool ok;
+    uint8_t mac[6];
+    std::vector<uint8_t> data;
+    bool operator>(const Frame &o) const { return at != o.at ? (int32_t)(at - o.at) > 0 : seq > o.seq; }
+  };
+
+  uint32_t latency();
+  bool lost();
+  int16_t findSlave(const uint8_t mac[6]) const;
+  void push(uint8_t kind, int16_t slave, const uint8_t mac[6], const uint8_t *data, size_t len, bool ok);
+  void fromSlave(int16_t slave, const uint8_t *data, size_t len);
+  void deliverToSlave(int16_t slave, const std::vector<uint8_t> &data);
+
+  SimClock &clock_;
+  SimLinkConfig link_;
+  uint32_t rng_;
+  uint32_t seq_;
+  std::deque<SimSlave> slaves_; // stable references
+  std::set<std::vector<uint8_t>> peers_;
+  std::priority_queue<Frame, std::vector<Frame>, std::greater<Frame>> queue_;
+  SimNetStats stats_;
+};
+
+struct SimPublished {
+  std::string topic;
+  std::string payload;
+};
+
+// PowerMaster wired to the simulated platform, stepped 1 ms at a time the way
+// loop() drives it on the device. The schedule/slave/ack publishes (per relay
+// and bulk) are kept in order; every publish also goes to the listener, if set.
+struct SimRig {
+  SimClock clock;
+  SimBroker broker;
+  FileKvStore store;
+  SimRadioNet net;
+  EventScheduler timers;
+  PowerMaster master;
+  std::vector<SimPublished> acks;
+
+  explicit SimRig(const std::string &dir, const SimLinkConfig &link = SimLinkConfig());
+
+  void setListener(SimBrokerListener listener, void *ctx) { listener_ = listener; listenerCtx_ = ctx; }
+  void run(uint32_t ms);
+  // Publishes s to relay/<relay>/schedule/set.
+  void set(uint8_t relay, const PowerRelaySchedule &s);
+  // Final outcome of the last set on relay (skips PENDING), "" while open.
+  std::string outcome(uint8_t relay) const;
+
+private:
+  static void onPublish(void *ctx, const std::string &topic, const std::string &payload, bool retained);
+
+  SimBrokerListener listener_;
+  void *listenerCtx_;
+};
+
+// A fresh directory under /tmp for FileKvStore, removed with everything in it
+// when it goes out of scope.
+class SimTempDir {
+public:
+  SimTempDir();
+  ~SimTempDir();
+  SimTempDir(const SimTempDir &) = delete;
+  SimTempDir &operator=(const SimTempDir &) = delete;
+
+  const std::string &path() const { return path_; }
+
+private:
+  std::string path_;
+};
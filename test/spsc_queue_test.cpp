@@ -0,0 +1,84 @@
+#include <assert.h>
+#include <iostream>
+#include <thread>
+
+#include "spsc_queue.h"
+
+struct Record {
+  uint32_t seq;
+  uint8_t payload[28];
+};
+
+void test_fifo_and_overflow() {
+  SpscQueue<int, 4> q;
+  int v = 0;
+  assert(!q.pop(v));
+  for (int i = 0; i < 4; i++) assert(q.push(i));
+  assert(!q.push(99));
+  assert(q.overflows() == 1);
+  assert(q.highWater() == 4);
+  for (int i = 0; i < 4; i++) {
+    assert(q.pop(v));
+    assert(v == i);
+  }
+  assert(!q.pop(v));
+  assert(q.size() == 0);
+  assert(q.highWater() == 4);
+}
+
+void test_wraparound() {
+  SpscQueue<int, 8> q;
+  int v = 0;
+  for (int i = 0; i < 1000; i++) {
+    assert(q.push(i));
+    assert(q.push(i + 1));
+    assert(q.pop(v) && v == i);
+    assert(q.pop(v) && v == i + 1);
+  }
+  assert(q.overflows() == 0);
+  assert(q.highWater() == 2);
+}
+
+void test_threaded_burst() {
+  static SpscQueue<Record, 16> q;
+  const uint32_t total = 200000;
+  uint32_t accepted = 0;
+
+  std::thread producer([&] {
+    for (uint32_t i = 0; i < total; i++) {
+      Record r{};
+      r.seq = i;
+      for (uint8_t k = 0; k < sizeof(r.payload); k++) r.payload[k] = (uint8_t)(i + k);
+      if (q.push(r)) accepted++;
+    }
+  });
+
+  uint32_t received = 0;
+  int64_t lastSeq = -1;
+  Record r{};
+  while (true) {
+    if (q.pop(r)) {
+      assert((int64_t)r.seq > lastSeq);
+      for (uint8_t k = 0; k < sizeof(r.payload); k++) assert(r.payload[k] == (uint8_t)(r.seq + k));
+      lastSeq = r.seq;
+      received++;
+      continue;
+    }
+    if (lastSeq == (int64_t)total - 1) break;
+    if (received + q.overflows() == total && q.size() == 0) break;
+  }
+  producer.join();
+  while (q.pop(r)) received++;
+
+  assert(received == accepted);
+  assert(accepted + q.overflows() == total);
+  assert(q.highWater() <= 16);
+}
+
+int main() {
+  test_fifo_and_overflow();
+  test_wraparound();
+  test_threaded_burst();
+  std::cout << "All spsc queue tests passed\n";
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include <assert.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+
+#include "state_snapshot.h"
+
+std::string document(const StateSnapshot &s) {
+  char buf[POWER_SNAPSHOT_JSON_MAX];
+  size_t n = s.write(buf, sizeof(buf));
+  assert(n > 0 && n == strlen(buf));
+  return buf;
+}
+
+SnapshotRelay relayOf(uint8_t state, uint8_t ack, uint16_t rules, uint32_t hash) {
+  SnapshotRelay r;
+  r.state = state;
+  r.ack = ack;
+  r.rules = rules;
+  r.scheduleHash = hash;
+  return r;
+}
+
+void test_initial_document() {
+  StateSnapshot a, b;
+  assert(a.version() == b.version());
+  assert(a.segmentBuilds() == POWER_RELAY_COUNT);
+  std::string doc = document(a);
+  assert(doc.compare(0, 12, "{\"version\":\"") == 0);
+  assert(doc.find("\"1\":{\"state\":null,\"ack\":null,\"rules\":0,\"schedule\":\"") != std::string::npos);
+  assert(doc.substr(doc.size() - 2) == "}}");
+
+  uint32_t v = 0;
+  assert(StateSnapshot::parseVersion(doc.data(), doc.size(), v) && v == a.version());
+}
+
+void test_incremental_update_and_version() {
+  StateSnapshot s;
+  uint32_t initial = s.version();
+  uint32_t builds = s.segmentBuilds();
+
+  assert(s.update(2, relayOf(1, SNAPSHOT_ACK_OK, 4, 0xDEADBEEF)));
+  assert(s.segmentBuilds() == builds + 1);
+  assert(s.version() != initial);
+  std::string doc = document(s);
+  assert(doc.find("\"2\":{\"state\":\"ON\",\"ack\":\"OK\",\"rules\":4,\"schedule\":\"deadbeef\"}") != std::string::npos);
+  assert(doc.find("\"1\":{\"state\":null") != std::string::npos);
+
+  // Unchanged input renders nothing.
+  assert(!s.update(2, relayOf(1, SNAPSHOT_ACK_OK, 4, 0xDEADBEEF)));
+  assert(s.segmentBuilds() == builds + 1);
+  assert(!s.update(0, relayOf(0, 0, 0, 0)) && !s.update(POWER_RELAY_COUNT + 1, relayOf(0, 0, 0, 0)));
+
+  // Each field moves the version; the version is a function of the content.
+  uint32_t on = s.version();
+  assert(s.update(2, relayOf(0, SNAPSHOT_ACK_OK, 4, 0xDEADBEEF)) && s.version() != on);
+  assert(s.update(2, relayOf(0, SNAPSHOT_ACK_PENDING, 4, 0xDEADBEEF)) && s.version() != on);
+  assert(s.update(2, relayOf(1, SNAPSHOT_ACK_OK, 4, 0xDEADBEEF)) && s.version() == on);
+  StateSnapshot fresh;
+  assert(fresh.update(2, relayOf(1, SNAPSHOT_ACK_OK, 4, 0xDEADBEEF)) && fresh.version() == on);
+
+  // The same relay content on another relay is a different document.
+  StateSnapshot other;
+  assert(other.update(1, relayOf(1, SNAPSHOT_ACK_OK, 4, 0xDEADBEEF)) && other.version() != on);
+}
+
+void test_worst_case_fits_and_small_buffers_fail() {
+  StateSnapshot s;
+  for (uint8_t r = 1; r <= POWER_RELAY_COUNT; r++) s.update(r, relayOf(0, SNAPSHOT_ACK_PENDING, 65535, 0xFFFFFFFF));
+  std::string doc = document(s);
+  assert(doc.size() < POWER_SNAPSHOT_JSON_MAX);
+
+  char small[64];
+  assert(s.write(small, sizeof(small)) == 0);
+  char exact[POWER_SNAPSHOT_JSON_MAX];
+  assert(s.write(exact, doc.size() + 1) == doc.size());
+  assert(s.write(exact, doc.size()) == 0);
+}
+
+void test_parse_version() {
+  uint32_t v = 7;
+  const char ok[] = "{\"version\":\"0a1B2c3D\",\"relays\":{}}";
+  assert(StateSnapshot::parseVersion(ok, strlen(ok), v) && v == 0x0A1B2C3D);
+  const char *bad[] = {"", "{}", "{\"version\":\"0a1b2c3\"}", "{\"version\":\"0a1b2c3g\"}", "{\"version\":\"0a1b2c3d0\"}",
+                       "{ \"version\":\"0a1b2c3d\"}", "OK"};
+  for (const char *b : bad) {
+    v = 7;
+    assert(!StateSnapshot::parseVersion(b, strlen(b), v) && v == 7);
+  }
+  // Length-delimited: the digits must be inside len.
+  assert(!StateSnapshot::parseVersion(ok, 20, v));
+}
+
+void test_ack_names() {
+  assert(strcmp(snapshotAckName(SNAPSHOT_ACK_PENDING), "PENDING") == 0);
+  assert(strcmp(snapshotAckName(SNAPSHOT_ACK_OK), "OK") == 0);
+  assert(strcmp(snapshotAckName(SNAPSHOT_ACK_ERROR), "ERROR") == 0);
+  assert(strcmp(snapshotAckName(SNAPSHOT_ACK_NONE), "") == 0);
+}
+
+int main() {
+  test_initial_document();
+  test_incremental_update_and_version();
+  test_worst_case_fits_and_small_buffers_fail();
+  test_parse_version();
+  test_ack_names();
+  std::cout << "state_snapshot_test: all passed" << std::endl;
+  return 0;
+}
@@ -0,0 +1,31 @@
+#include "bench_harness.h"
+#include "telemetry_series.h"
+
+int main(int argc, char **argv) {
+  BenchConfig cfg = benchConfigFromArgs(argc, argv);
+
+  TelemetrySample sample;
+  for (uint8_t c = 0; c < TELEM_CHANNELS; c++) sample.v[c] = (int16_t)(100 + c);
+
+  // Packet rate of one slave at ~5 Hz: mostly accumulate, a close every 50 samples.
+  TelemetrySeries series;
+  uint32_t now = 0;
+  runBench(cfg, "telemetry/add_5hz", [&] {
+    now += 200;
+    sample.v[TELEM_TEMP] = (int16_t)(now & 0xFF);
+    series.add(sample, now);
+    benchKeep(series.pending(0));
+  });
+
+  TelemetrySeries full;
+  for (uint32_t t = 0; t < 70000; t += 200) full.add(sample, t);
+  full.tick(70000);
+  runBench(cfg, "telemetry/write_json_10s_batch", [&] {
+    char buf[TELEM_JSON_MAX];
+    benchKeep(full.writeJson(0, 70000, buf, sizeof(buf)));
+  });
+
+  printf("{\"bench\":\"telemetry/footprint\",\"bytes_per_slave\":%zu,\"json_max\":%zu}\n", sizeof(TelemetrySeries),
+         TELEM_JSON_MAX);
+  return 0;
+}
@@ -0,0 +1,123 @@
+#include <assert.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+
+#include "telemetry_series.h"
+
+TelemetrySample makeSample(int16_t temp, int16_t soil, bool r1) {
+  TelemetrySample s;
+  for (uint8_t c = 0; c < TELEM_CHANNELS; c++) s.v[c] = 0;
+  s.v[TELEM_TEMP] = temp;
+  s.v[TELEM_HUM] = 555;
+  s.v[TELEM_SOIL] = soil;
+  s.v[TELEM_BATT] = 90;
+  s.v[TELEM_R1] = r1 ? 100 : 0;
+  return s;
+}
+
+void test_ten_second_buckets() {
+  TelemetrySeries ts;
+  // One sample per second for 25 s: buckets [0,10) and [10,20) close, [20,30) stays open.
+  for (uint32_t sec = 0; sec < 25; sec++) ts.add(makeSample((int16_t)(200 + sec), (int16_t)sec, sec % 2 == 0), sec * 1000);
+  assert(ts.closed(0) == 2 && ts.pending(0) == 2);
+  assert(ts.closed(1) == 0 && ts.closed(2) == 0);
+
+  TelemetryStats older = ts.stats(0, 1, TELEM_TEMP);
+  assert(older.n == 10 && older.min == 200 && older.max == 209 && older.mean == 205); // 204.5 rounds up
+  TelemetryStats newer = ts.stats(0, 0, TELEM_SOIL);
+  assert(newer.n == 10 && newer.min == 10 && newer.max == 19 && newer.mean == 15);
+  assert(ts.stats(0, 0, TELEM_R1).mean == 50); // on half the time
+  assert(ts.bucketStartMs(0, 0) == 10000 && ts.bucketStartMs(0, 1) == 0);
+
+  ts.tick(29999);
+  assert(ts.closed(0) == 2);
+  ts.tick(30000);
+  assert(ts.closed(0) == 3 && ts.stats(0, 0, TELEM_TEMP).n == 5);
+}
+
+void test_windows_agree_on_long_runs() {
+  TelemetrySeries ts;
+  // 30 minutes at one sample per 2 s, temperature ramps and wraps every minute.
+  for (uint32_t t = 0; t < 1800000; t += 2000) ts.add(makeSample((int16_t)(-50 + (t / 2000) % 30), 40, false), t);
+  ts.tick(1800000);
+  assert(ts.closed(0) == TELEM_HISTORY && ts.closed(1) == TELEM_HISTORY && ts.closed(2) == 2);
+  assert(ts.pending(0) == TELEM_HISTORY);
+
+  for (uint8_t w = 0; w < 2; w++) {
+    TelemetryStats s = ts.stats(w, 0, TELEM_TEMP);
+    assert(s.min >= -50 && s.max <= -21 && s.min <= s.mean && s.mean <= s.max);
+  }
+  TelemetryStats minute = ts.stats(1, 0, TELEM_TEMP);
+  assert(minute.n == 30 && minute.min == -50 && minute.max == -21);
+  TelemetryStats quarter = ts.stats(2, 0, TELEM_TEMP);
+  assert(quarter.n == 450 && quarter.min == -50 && quarter.max == -21);
+  assert(quarter.mean == -36); // mean of -50..-21 is -35.5
+  assert(ts.stats(2, 0, TELEM_SOIL).mean == 40);
+}
+
+void test_missing_channels() {
+  TelemetrySeries ts;
+  TelemetrySample s = makeSample(TELEM_MISSING, 10, false);
+  ts.add(s, 0);
+  s.v[TELEM_TEMP] = 215;
+  ts.add(s, 1000);
+  ts.add(makeSample(TELEM_MISSING, 12, false), 2000);
+  ts.tick(10000);
+  TelemetryStats t = ts.stats(0, 0, TELEM_TEMP);
+  assert(t.n == 1 && t.mean == 215);
+  assert(ts.stats(0, 0, TELEM_SOIL).n == 3);
+
+  TelemetrySeries silent;
+  TelemetrySample none;
+  for (uint8_t c = 0; c < TELEM_CHANNELS; c++) none.v[c] = TELEM_MISSING;
+  silent.add(none, 0);
+  silent.tick(10000);
+  assert(silent.stats(0, 0, TELEM_HUM).n == 0);
+  char buf[TELEM_JSON_MAX];
+  assert(silent.writeJson(0, 10000, buf, sizeof(buf)) > 0);
+  assert(strstr(buf, "\"h\":null") != nullptr);
+}
+
+void test_json_batch() {
+  TelemetrySeries ts;
+  char buf[TELEM_JSON_MAX];
+  assert(ts.writeJson(0, 0, buf, sizeof(buf)) == 0);
+
+  ts.add(makeSample(-5, 33, true), 1000);
+  ts.add(makeSample(215, 35, true), 2000);
+  ts.add(makeSample(300, 40, false), 12000);
+  ts.tick(25000);
+  assert(ts.pending(0) == 2);
+  size_t n = ts.writeJson(0, 25000, buf, sizeof(buf));
+  assert(n == strlen(buf));
+  std::string json(buf);
+  assert(json.rfind("{\"window\":\"10s\",\"buckets\":[{\"ago\":15,\"n\":2,\"t\":[-0.5,10.5,21.5],\"h\":[55.5,55.5,55.5],"
+                    "\"soil\":[33,34,35],\"batt\":[90,90,90],\"r1\":[100,100,100],", 0) == 0);
+  assert(json.find("{\"ago\":5,\"n\":1,\"t\":[30.0,30.0,30.0]") != std::string::npos);
+  assert(json.compare(json.size() - 3, 3, "}]}") == 0);
+  assert(ts.writeJson(0, 25000, buf, n) == 0); // no room for the terminator
+  ts.markPublished(0);
+  assert(ts.pending(0) == 0 && ts.writeJson(0, 25000, buf, sizeof(buf)) == 0);
+}
+
+void test_worst_case_fits() {
+  TelemetrySeries ts;
+  TelemetrySample s;
+  for (uint8_t c = 0; c < TELEM_CHANNELS; c++) s.v[c] = -32767;
+  for (uint32_t i = 0; i < 200; i++) ts.add(s, 0xF0000000u + i * 10000);
+  ts.tick(0xF0000000u + 300 * 10000);
+  assert(ts.pending(0) == TELEM_HISTORY);
+  char buf[TELEM_JSON_MAX];
+  assert(ts.writeJson(0, 0xFFFFFFFFu, buf, sizeof(buf)) > 0);
+}
+
+int main() {
+  test_ten_second_buckets();
+  test_windows_agree_on_long_runs();
+  test_missing_channels();
+  test_json_batch();
+  test_worst_case_fits();
+  std::cout << "All telemetry series tests passed\n";
+  return 0;
+}
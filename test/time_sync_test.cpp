@@ -0,0 +1,224 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "power_master.h"
+#include "sim_hal.h"
+#include "time_sync.h"
+
+static const uint8_t MAC_A[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x01};
+static const uint8_t MAC_B[6] = {0x24, 0x6F, 0x28, 0x00, 0x00, 0x02};
+
+// One exchange between a client whose clock reads server * (1 + ppm) + offset
+// and the server, with the given one-way delays and server hold time.
+struct Link {
+  int64_t offsetMs;
+  double ppm;
+  uint32_t clientAt(uint64_t serverMs) const {
+    return (uint32_t)(int64_t)((double)serverMs * (1.0 + ppm * 1e-6) + (double)offsetMs);
+  }
+  bool exchange(TimeSyncEstimator &est, uint64_t serverMs, uint32_t up, uint32_t hold, uint32_t down) const {
+    uint32_t t1 = clientAt(serverMs);
+    uint32_t t2 = (uint32_t)(serverMs + up);
+    uint32_t t3 = t2 + hold;
+    uint32_t t4 = clientAt(serverMs + up + hold + down);
+    return est.sample(t1, t2, t3, t4);
+  }
+};
+
+void test_symmetric_exchange_is_exact() {
+  TimeSyncEstimator est;
+  assert(!est.valid() && est.offsetMs() == 0);
+  Link link{-12345, 0};
+  assert(link.exchange(est, 100000, 4, 1, 4));
+  assert(est.valid());
+  assert(est.offsetMs() == 12345);
+  assert(est.delayMs() == 8);
+  assert(est.toServer(link.clientAt(200000)) == 200000);
+
+  // Across the wrap of either clock.
+  TimeSyncEstimator wrap;
+  Link late{(int64_t)0xFFFFFF00u, 0};
+  assert(late.exchange(wrap, 1000, 3, 0, 3));
+  assert(wrap.offsetMs() == 256);
+  assert(wrap.toServer(late.clientAt(5000)) == 5000);
+}
+
+void test_rejects_noncausal_samples() {
+  TimeSyncEstimator est;
+  assert(!est.sample(1000, 50, 60, 1005)); // held longer than the round trip
+  assert(!est.sample(1000, 50, 40, 1100)); // answered before it arrived
+  assert(!est.sample(1000, 50, 60, 990));  // came back before it left
+  assert(!est.valid() && est.samples() == 0);
+}
+
+// Queueing on either leg biases a single sample by half the asymmetry; the
+// lowest-delay sample in the window bounds the error by half its delay.
+void test_min_delay_filter_under_jitter() {
+  std::mt19937 rng(5);
+  Link link{73000, 0};
+  TimeSyncEstimator est;
+  uint64_t t = 5000;
+  for (int i = 0; i < 200; i++, t += 2000) {
+    uint32_t up = 2 + rng() % 3, down = 2 + rng() % 3;
+    if (rng() % 3 == 0) up += rng() % 80;  // congested uplink
+    if (rng() % 4 == 0) down += rng() % 40;
+    assert(link.exchange(est, t, up, rng() % 5, down));
+    int32_t err = est.offsetMs() + 73000;
+    assert((uint32_t)abs(err) <= est.delayMs() / 2 + 1);
+    if (i >= TIME_SYNC_WINDOW) assert(abs(err) <= 5);
+  }
+  assert(est.samples() == 200);
+  assert(est.delayMs() <= 8);
+}
+
+void test_skew_tracks_drift() {
+  const double ppms[] = {40.0, -75.0, 0.0};
+  for (double ppm : ppms) {
+    std::mt19937 rng(9);
+    Link link{-5000, ppm};
+    TimeSyncEstimator est;
+    uint64_t t = 1000;
+    for (int i = 0; i < 120; i++, t += 10000) {
+      assert(link.exchange(est, t, 3 + rng() % 10, 1, 3 + rng() % 10));
+    }
+    // Offset is server - client: a client running fast falls behind it.
+    assert(abs(est.skewPpm() + (int32_t)ppm) <= 5);
+    // Mapping client times well past the last sample stays within a few ms.
+    for (uint64_t s = t; s < t + 60000; s += 7000) {
+      int32_t err = (int32_t)(est.toServer(link.clientAt(s)) - (uint32_t)s);
+      assert(abs(err) <= 6);
+    }
+  }
+}
+
+void test_week_helpers() {
+  assert(localWeekMs(SIM_EPOCH_MONDAY, 0, 0) == 0);
+  assert(localWeekMs(0, 0, 0) == 3UL * 86400000UL); // a Thursday
+  assert(localWeekMs(SIM_EPOCH_MONDAY, 250, 60) == 3600250);
+  assert(localWeekMs(SIM_EPOCH_MONDAY, 0, -60) == TIME_SYNC_WEEK_MS - 3600000); // still Sunday locally
+
+  assert(executionLagMs(9 * 3600000 + 420, 0, 9 * 60) == 420);
+  assert(executionLagMs(9 * 3600000 - 300, 0, 9 * 60) == -300);
+  // Scheduled Sunday 23:59, ran 200 ms into Monday.
+  assert(executionLagMs(200, 6, 23 * 60 + 59) == 60200);
+  // Scheduled Monday 00:00, ran half a second early on Sunday.
+  assert(executionLagMs(TIME_SYNC_WEEK_MS - 500, 0, 0) == -500);
+}
+
+// UTC ms at the rig's current time, with the clock set to week minute 8.
+uint64_t wallMs(SimRig &rig) { return (uint64_t)SIM_EPOCH_MONDAY * 1000 + 8 * 60000 + rig.clock.millis(); }
+
+void recordLag(void *ctx, const std::string &topic, const std::string &payload, bool) {
+  std::vector<std::string> *lags = static_cast<std::vector<std::string> *>(ctx);
+  if (topic.find("/executed/lag") != std::string::npos) lags->push_back(payload);
+}
+
+long jsonLong(const std::string &json, const char *key) {
+  size_t at = json.find(std::string("\"") + key + "\":");
+  assert(at != std::string::npos);
+  return strtol(json.c_str() + at + strlen(key) + 3, nullptr, 10);
+}
+
+// Slaves with offset, drifting clocks and jittery asymmetric links agree with
+// the master's wall clock to within tens of ms, and the master sees each
+// slave's offset and skew.
+void test_sim_slaves_align_and_master_tracks_skew() {
+  SimLinkConfig link;
+  link.latencyMinMs = 2;
+  link.latencyMaxMs = 30;
+  link.telemetryMs = 0;
+  link.timeSyncMs = 2000;
+  SimTempDir dir;
+  SimRig rig(dir.path(), link);
+  rig.clock.setWeekMinute(8);
+  rig.net.addSlave(MAC_A, 0x1);
+  rig.net.addSlave(MAC_B, 0x2);
+  rig.net.slave(0).clockOffsetMs = 987654;
+  rig.net.slave(0).driftPpm = 80;
+  rig.net.slave(1).clockOffsetMs = -4321;
+  rig.net.slave(1).driftPpm = -50;
+
+  rig.run(5 * 60 * 1000);
+  for (size_t i = 0; i < 2; i++) {
+    SimSlave &s = rig.net.slave(i);
+    uint64_t believed = 0;
+    assert(s.wallMs(s.localMs(rig.clock.millis()), believed));
+    int64_t err = (int64_t)(believed - wallMs(rig));
+    assert(err > -20 && err < 20);
+
+    int8_t id = rig.master.peers().find(s.mac);
+    assert(id >= 0);
+    const TimeSyncEstimator &est = rig.master.peerClock((uint8_t)id);
+    assert(est.valid() && est.samples() > 100);
+    int32_t trueOffset = (int32_t)(rig.clock.millis() - s.localMs(rig.clock.millis()));
+    assert(abs(est.offsetMs() - trueOffset) <= 20);
+    assert(abs(est.skewPpm() + s.driftPpm) <= 15);
+  }
+
+  std::string diag;
+  assert(rig.broker.retained("progetto/EVE/POWER/diag/clock/246F28000001", diag));
+  assert(jsonLong(diag, "samples") > 50);
+  assert(abs(jsonLong(diag, "skew_ppm") + 80) <= 15);
+}
+
+// Executed reports carry the slave's millis(): with its clock tracked the
+// master turns that into lag behind the scheduled minute.
+void test_execution_lag_from_executed_packets() {
+  SimLinkConfig link;
+  link.telemetryMs = 0;
+  link.timeSyncMs = 1000;
+  SimTempDir dir;
+  SimRig rig(dir.path(), link);
+  std::vector<std::string> lags;
+  rig.setListener(recordLag, &lags);
+  rig.clock.setWeekMinute(8);
+  SimSlave &a = rig.net.addSlave(MAC_A, 0x1);
+  a.clockOffsetMs = 250000;
+  a.driftPpm = 30;
+
+  // Before any exchange there is nothing to measure against.
+  PowerExecutedPacket early{16, 1, 1, 0, 8, 0, 0, a.localMs(100)};
+  rig.master.onRadioFrame(MAC_A, (const uint8_t *)&early, sizeof(early), rig.clock.millis());
+  rig.run(10);
+  assert(lags.empty());
+
+  rig.run(3 * 60 * 1000 - 10);
+  // Minute 11 of Monday starts at master millis 180000; the slave switched
+  // 350 ms late and reports it 40 ms after that.
+  uint32_t ranAt = 180000 + 350;
+  rig.run(ranAt + 40 - rig.clock.millis());
+  PowerExecutedPacket ex{16, 1, 1, 0, 11, 0, 0, a.localMs(ranAt)};
+  rig.master.onRadioFrame(MAC_A, (const uint8_t *)&ex, sizeof(ex), rig.clock.millis());
+  rig.run(5);
+  assert(lags.size() == 1);
+  long lag = jsonLong(lags[0], "lag_ms");
+  assert(lag >= 340 && lag <= 360);
+  assert(jsonLong(lags[0], "uncertainty_ms") <= 6);
+
+  // An early switch shows as negative lag.
+  ranAt = 240000 - 120;
+  rig.run(ranAt + 10 - rig.clock.millis());
+  PowerExecutedPacket ex2{16, 1, 0, 0, 12, 0, 0, a.localMs(ranAt)};
+  rig.master.onRadioFrame(MAC_A, (const uint8_t *)&ex2, sizeof(ex2), rig.clock.millis());
+  rig.run(5);
+  assert(lags.size() == 2);
+  lag = jsonLong(lags[1], "lag_ms");
+  assert(lag >= -130 && lag <= -110);
+}
+
+int main() {
+  test_symmetric_exchange_is_exact();
+  test_rejects_noncausal_samples();
+  test_min_delay_filter_under_jitter();
+  test_skew_tracks_drift();
+  test_week_helpers();
+  test_sim_slaves_align_and_master_tracks_skew();
+  test_execution_lag_from_executed_packets();
+  std::cout << "time_sync_test: all passed" << std::endl;
+  return 0;
+}
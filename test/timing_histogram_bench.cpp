@@ -0,0 +1,32 @@
+#include <chrono>
+
+#include "bench_harness.h"
+#include "timing_histogram.h"
+
+uint32_t steadyClockUs() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint32_t g_fakeUs = 0;
+uint32_t fakeClock() { return g_fakeUs += 3; }
+
+int main(int argc, char **argv) {
+  BenchConfig cfg = benchConfigFromArgs(argc, argv);
+
+  // Recording must stay negligible against a 16 ms loop: a handful of timers
+  // per iteration at well under 1 us each, clock reads included.
+  TimingHistogram h;
+  runBench(cfg, "timing/scoped_steady_clock", [&] {
+    ScopedTiming t(h, steadyClockUs);
+  });
+  benchKeep(h.count());
+
+  // The histogram alone, without the cost of reading a real clock.
+  TimingHistogram fake;
+  runBench(cfg, "timing/scoped_fake_clock", [&] {
+    ScopedTiming t(fake, fakeClock);
+  });
+  benchKeep(fake.count());
+  return 0;
+}
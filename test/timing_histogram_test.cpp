@@ -0,0 +1,78 @@
+#include <assert.h>
+#include <string.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "timing_histogram.h"
+
+static uint32_t g_fakeUs = 0;
+uint32_t fakeClock() { return g_fakeUs; }
+
+uint32_t steadyClockUs() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void test_buckets() {
+  TimingHistogram h;
+  h.record(0);
+  h.record(1);
+  h.record(2);
+  h.record(3);
+  h.record(4);
+  h.record(1000);
+  h.record(0xFFFFFFFFu);
+  assert(h.bucket(0) == 1 && h.bucket(1) == 1 && h.bucket(2) == 2 && h.bucket(3) == 1);
+  assert(h.bucket(10) == 1); // [512, 1024)
+  assert(h.bucket(TIMING_BUCKETS - 1) == 1);
+  assert(h.count() == 7 && h.maxUs() == 0xFFFFFFFFu);
+}
+
+void test_percentiles_and_mean() {
+  TimingHistogram h;
+  assert(h.percentileUs(50) == 0 && h.meanUs() == 0);
+  for (int i = 0; i < 990; i++) h.record(100); // bucket [64, 128)
+  for (int i = 0; i < 10; i++) h.record(5000);  // bucket [4096, 8192)
+  assert(h.percentileUs(50) == 128);
+  assert(h.percentileUs(99) == 128);
+  assert(h.percentileUs(100) == 5000); // capped at the maximum
+  assert(h.meanUs() == (990 * 100 + 10 * 5000) / 1000);
+
+  char buf[128];
+  size_t n = h.writeJson(buf, sizeof(buf));
+  assert(n == strlen(buf));
+  assert(std::string(buf) == "{\"n\":1000,\"mean_us\":149,\"p50_us\":128,\"p99_us\":128,\"max_us\":5000}");
+  assert(h.writeJson(buf, 10) == 0);
+  h.reset();
+  assert(h.count() == 0 && h.maxUs() == 0 && h.bucket(7) == 0);
+}
+
+void test_scoped_timing() {
+  TimingHistogram h;
+  g_fakeUs = 0xFFFFFF00u; // wraps inside the scope
+  {
+    ScopedTiming t(h, fakeClock);
+    g_fakeUs += 0x200;
+  }
+  assert(h.count() == 1 && h.maxUs() == 0x200);
+}
+
+// Against the real clock every scope lands in the histogram; the cost per
+// timer is measured by timing_histogram_bench.
+void test_steady_clock() {
+  TimingHistogram h;
+  for (int i = 0; i < 1000; i++) {
+    ScopedTiming t(h, steadyClockUs);
+  }
+  assert(h.count() == 1000 && h.percentileUs(50) <= h.percentileUs(100));
+}
+
+int main() {
+  test_buckets();
+  test_percentiles_and_mean();
+  test_scoped_timing();
+  test_steady_clock();
+  std::cout << "All timing histogram tests passed\n";
+  return 0;
+}